@@ -0,0 +1,369 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace
+{
+    const int QuantizedMax = 65535;
+
+    //Per frame values of one track, rotation x, y, z, w or vector x, y, z, 0.
+    typedef std::vector<glm::vec4> TrackSamples;
+
+    glm::vec4 normalizeRotation(const glm::vec4& q)
+    {
+        float length = std::sqrt(glm::dot(q, q));
+        return length > 0.0f ? q / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    TrackSamples gatherTrack(const RawClip& raw, int bone, int type)
+    {
+        TrackSamples samples(raw.frameCount);
+        for (int frame = 0; frame < raw.frameCount; frame++)
+        {
+            const BoneTransform& transform = raw.frames[(size_t)frame * raw.boneCount + bone];
+            if (type == TrackRotation)
+            {
+                glm::quat q = transform.rotation;
+                glm::vec4 value = normalizeRotation(glm::vec4(q.x, q.y, q.z, q.w));
+
+                //q and -q are the same rotation, keep neighbours in one hemisphere so lerp takes the short path.
+                if (frame > 0 && glm::dot(value, samples[frame - 1]) < 0.0f) value = -value;
+                samples[frame] = value;
+            }
+            else
+            {
+                samples[frame] = glm::vec4(type == TrackTranslation ? transform.translation : transform.scale, 0.0f);
+            }
+        }
+        return samples;
+    }
+
+    float maxDifference(const glm::vec4& a, const glm::vec4& b)
+    {
+        glm::vec4 d = glm::abs(a - b);
+        return std::max(std::max(d.x, d.y), std::max(d.z, d.w));
+    }
+
+    glm::vec4 interpolate(const glm::vec4& a, const glm::vec4& b, float t, bool rotation)
+    {
+        glm::vec4 value = a + (b - a) * t;
+        return rotation ? normalizeRotation(value) : value;
+    }
+
+    //Greedy piecewise linear fit: every key reaches as far ahead as the tolerance allows.
+    std::vector<int> reduceKeys(const TrackSamples& exact, const TrackSamples& decoded, float tolerance, bool rotation)
+    {
+        int frameCount = (int)exact.size();
+        std::vector<int> keys(1, 0);
+
+        bool constant = true;
+        for (int frame = 1; frame < frameCount && constant; frame++)
+        {
+            constant = maxDifference(decoded[0], exact[frame]) <= tolerance;
+        }
+        if (constant) return keys;
+
+        int start = 0;
+        for (int end = start + 2; end < frameCount; end++)
+        {
+            bool fits = true;
+            for (int frame = start + 1; frame < end && fits; frame++)
+            {
+                float t = (float)(frame - start) / (end - start);
+                fits = maxDifference(interpolate(decoded[start], decoded[end], t, rotation), exact[frame]) <= tolerance;
+            }
+
+            if (!fits)
+            {
+                start = end - 1;
+                keys.push_back(start);
+            }
+        }
+
+        keys.push_back(frameCount - 1);
+        return keys;
+    }
+
+    //False when quantizing alone already misses the tolerance.
+    bool quantizeTrack(const TrackSamples& exact, int components, float tolerance, bool rotation, AnimationTrack& track,
+        std::vector<uint16_t>& quantized, TrackSamples& decoded)
+    {
+        glm::vec4 lo = exact[0], hi = exact[0];
+        for (size_t frame = 1; frame < exact.size(); frame++)
+        {
+            lo = glm::min(lo, exact[frame]);
+            hi = glm::max(hi, exact[frame]);
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+            track.minimum[c] = c < components ? lo[c] : 0.0f;
+            track.step[c] = c < components ? (hi[c] - lo[c]) / QuantizedMax : 0.0f;
+        }
+
+        //Quantize every frame first, so key reduction measures the error of what is actually decoded.
+        //Keys are decoded frames, so each of them has to be within tolerance too, not just what is interpolated.
+        quantized.assign(exact.size() * 4, 0);
+        decoded.resize(exact.size());
+        for (size_t frame = 0; frame < exact.size(); frame++)
+        {
+            decoded[frame] = glm::vec4(0.0f);
+            for (int c = 0; c < components; c++)
+            {
+                long q = track.step[c] > 0.0f ? std::lrint((exact[frame][c] - track.minimum[c]) / track.step[c]) : 0;
+                q = std::min(std::max(q, 0L), (long)QuantizedMax);
+                quantized[frame * 4 + c] = (uint16_t)q;
+                decoded[frame][c] = track.minimum[c] + q * track.step[c];
+            }
+
+            glm::vec4 sampled = rotation ? normalizeRotation(decoded[frame]) : decoded[frame];
+            if (maxDifference(sampled, exact[frame]) > tolerance) return false;
+        }
+        return true;
+    }
+
+    void compressTrack(const TrackSamples& exact, int components, float tolerance, bool rotation, AnimationTrack& track, AnimationClip& clip)
+    {
+        std::vector<uint16_t> quantized;
+        TrackSamples decoded;
+        bool fits = quantizeTrack(exact, components, tolerance, rotation, track, quantized, decoded);
+
+        //Floats only lose what key reduction drops.
+        std::vector<int> keys = reduceKeys(exact, fits ? decoded : exact, tolerance, rotation);
+
+        track.firstKey = (uint32_t)clip.keyFrames.size();
+        track.keyCount = (uint32_t)keys.size();
+        track.encoding = fits ? TrackQuantized : TrackFloat;
+        track.firstValue = (uint32_t)(fits ? clip.keyValues.size() : clip.floatValues.size());
+        for (size_t k = 0; k < keys.size(); k++)
+        {
+            clip.keyFrames.push_back((uint16_t)keys[k]);
+            for (int c = 0; c < components; c++)
+            {
+                if (fits) clip.keyValues.push_back(quantized[keys[k] * 4 + c]);
+                else clip.floatValues.push_back(exact[keys[k]][c]);
+            }
+        }
+
+        if (!fits)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                track.minimum[c] = 0.0f;
+                track.step[c] = 0.0f;
+            }
+        }
+    }
+
+    //Four components of one key, the 4th lane of vector tracks reads the next value but has step 0.
+    SIMD_INLINE Float4 decodeKey(const uint16_t* key, const Float4& minimum, const Float4& step)
+    {
+#ifdef SIMD_SSE2
+        __m128i packed = _mm_loadl_epi64((const __m128i*)key);
+        Float4 value = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+#else
+        Float4 value((float)key[0], (float)key[1], (float)key[2], (float)key[3]);
+#endif
+        return minimum + value * step;
+    }
+
+    SIMD_INLINE Float4 loadKey(const AnimationClip& clip, const AnimationTrack& track, int components, uint32_t key, const Float4& minimum, const Float4& step)
+    {
+        if (track.encoding == TrackFloat) return Float4::load(&clip.floatValues[track.firstValue + key * components]);
+        return decodeKey(&clip.keyValues[track.firstValue + key * components], minimum, step);
+    }
+
+    void normalizeRotation(float* q)
+    {
+        float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+        for (int c = 0; c < 4; c++) q[c] *= inverse;
+    }
+
+    void sampleTrack(const AnimationClip& clip, const AnimationTrack& track, int components, float frame, uint32_t& cursor, float* output)
+    {
+        const uint16_t* frames = &clip.keyFrames[track.firstKey];
+        Float4 minimum = Float4::load(track.minimum);
+        Float4 step = Float4::load(track.step);
+
+        if (track.keyCount == 1)
+        {
+            loadKey(clip, track, components, 0, minimum, step).store(output);
+            if (components == 3) output[3] = 0.0f;
+            return;
+        }
+
+        //Step forward from last frame's key, anything else (loop restart, scrubbing) is a binary search.
+        uint32_t last = track.keyCount - 1;
+        uint32_t key = cursor < last ? cursor : 0;
+        if (frames[key] > frame)
+        {
+            key = (uint32_t)(std::upper_bound(frames, frames + last, frame) - frames) - 1;
+        }
+        while (key + 1 < last && frames[key + 1] <= frame) key++;
+        cursor = key;
+
+        float t = (frame - frames[key]) / (float)(frames[key + 1] - frames[key]);
+        t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+
+        Float4 a = loadKey(clip, track, components, key, minimum, step);
+        Float4 b = loadKey(clip, track, components, key + 1, minimum, step);
+        (a + (b - a) * Float4(t)).store(output);
+
+        if (components == 4) normalizeRotation(output);
+        else output[3] = 0.0f;
+    }
+}
+
+size_t AnimationClip::memorySize() const
+{
+    return sizeof(AnimationClip) + tracks.size() * sizeof(AnimationTrack) +
+        keyFrames.size() * sizeof(uint16_t) + keyValues.size() * sizeof(uint16_t) + floatValues.size() * sizeof(float);
+}
+
+size_t rawClipSize(const RawClip& raw)
+{
+    return sizeof(RawClip) + raw.frames.size() * sizeof(BoneTransform);
+}
+
+bool compressClip(const RawClip& raw, AnimationClip& clip, const ClipCompressionSettings& settings)
+{
+    clip = AnimationClip();
+    //Sampling needs at least one key per track.
+    if (raw.frameCount <= 0 || raw.frameCount > MaxClipFrames) return false;
+
+    clip.frameRate = raw.frameRate;
+    clip.frameCount = raw.frameCount;
+    clip.boneCount = raw.boneCount;
+    clip.tracks.resize((size_t)raw.boneCount * TracksPerBone);
+
+    for (int bone = 0; bone < raw.boneCount; bone++)
+    {
+        for (int type = 0; type < TracksPerBone; type++)
+        {
+            bool rotation = type == TrackRotation;
+            float tolerance = rotation ? settings.rotationTolerance :
+                (type == TrackTranslation ? settings.translationTolerance : settings.scaleTolerance);
+
+            compressTrack(gatherTrack(raw, bone, type), rotation ? 4 : 3, tolerance, rotation,
+                clip.tracks[bone * TracksPerBone + type], clip);
+        }
+    }
+
+    clip.keyValues.push_back(0);
+    clip.floatValues.push_back(0.0f);
+    return true;
+}
+
+BoneTransform Pose::bone(int index) const
+{
+    const float* v = &values[(size_t)index * PoseFloatsPerBone];
+
+    BoneTransform transform;
+    transform.rotation = glm::quat(v[3], v[0], v[1], v[2]);
+    transform.translation = glm::vec3(v[4], v[5], v[6]);
+    transform.scale = glm::vec3(v[8], v[9], v[10]);
+    return transform;
+}
+
+void sampleClip(const AnimationClip& clip, float time, AnimationCursor& cursor, Pose& pose)
+{
+    pose.resize(clip.boneCount);
+    cursor.keys.resize(clip.tracks.size(), 0);
+
+    float frame = time * clip.frameRate;
+    float lastFrame = (float)(clip.frameCount > 0 ? clip.frameCount - 1 : 0);
+    frame = frame < 0.0f ? 0.0f : (frame > lastFrame ? lastFrame : frame);
+
+    //Tracks are stored bone by bone in pose order, so keys, cursors and output are all walked front to back.
+    for (int bone = 0; bone < clip.boneCount; bone++)
+    {
+        float* output = &pose.values[(size_t)bone * PoseFloatsPerBone];
+        for (int type = 0; type < TracksPerBone; type++)
+        {
+            int track = bone * TracksPerBone + type;
+            sampleTrack(clip, clip.tracks[track], type == TrackRotation ? 4 : 3, frame, cursor.keys[track], output + type * 4);
+        }
+    }
+}
+
+void blendPoses(const Pose& a, const Pose& b, float weight, Pose& output)
+{
+    int boneCount = std::min(a.boneCount(), b.boneCount());
+    output.resize(boneCount);
+
+    Float4 w(weight);
+    for (int bone = 0; bone < boneCount; bone++)
+    {
+        const float* va = &a.values[(size_t)bone * PoseFloatsPerBone];
+        const float* vb = &b.values[(size_t)bone * PoseFloatsPerBone];
+        float* vo = &output.values[(size_t)bone * PoseFloatsPerBone];
+
+        Float4 ra = Float4::load(va);
+        Float4 rb = Float4::load(vb);
+        float hemisphere = va[0] * vb[0] + va[1] * vb[1] + va[2] * vb[2] + va[3] * vb[3];
+        if (hemisphere < 0.0f) rb = -rb;
+
+        Float4 translation = Float4::load(va + 4) + (Float4::load(vb + 4) - Float4::load(va + 4)) * w;
+        Float4 scale = Float4::load(va + 8) + (Float4::load(vb + 8) - Float4::load(va + 8)) * w;
+
+        (ra + (rb - ra) * w).store(vo);
+        translation.store(vo + 4);
+        scale.store(vo + 8);
+        normalizeRotation(vo);
+    }
+}
+
+void poseToMatrices(const Pose& pose, glm::mat4* local)
+{
+    for (int bone = 0; bone < pose.boneCount(); bone++)
+    {
+        BoneTransform transform = pose.bone(bone);
+
+        glm::mat4 m = glm::mat4_cast(transform.rotation);
+        m[0] *= transform.scale.x;
+        m[1] *= transform.scale.y;
+        m[2] *= transform.scale.z;
+        m[3] = glm::vec4(transform.translation, 1.0f);
+        local[bone] = m;
+    }
+}
+
+void evaluateCharacter(AnimatedCharacter& character)
+{
+    const BlendTree& tree = *character.tree;
+    character.cursors.resize(tree.nodes.size());
+
+    //Poses are evaluated on a stack, reused between characters so steady state sampling doesn't allocate.
+    thread_local std::vector<Pose> stack;
+    if (stack.size() < tree.nodes.size()) stack.resize(tree.nodes.size());
+
+    int top = 0;
+    for (size_t i = 0; i < tree.nodes.size(); i++)
+    {
+        const BlendNode& node = tree.nodes[i];
+        if (node.type == BlendClip)
+        {
+            sampleClip(*tree.clips[node.clip], character.parameters[i], character.cursors[i], stack[top++]);
+        }
+        else
+        {
+            blendPoses(stack[top - 2], stack[top - 1], character.parameters[i], stack[top - 2]);
+            top--;
+        }
+    }
+
+    if (top > 0) character.pose.values.assign(stack[top - 1].values.begin(), stack[top - 1].values.end());
+}
+
+void evaluateCharacters(AnimatedCharacter* characters, int count)
+{
+    parallelFor(count, 16, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++) evaluateCharacter(characters[i]);
+    });
+}
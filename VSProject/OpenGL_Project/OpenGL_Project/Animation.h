@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//Keyframed bone animation: clips are compressed once at load time and sampled into poses every frame,
+//a small blend tree per character mixes the poses of several clips.
+
+struct BoneTransform
+{
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+//Uncompressed clip, boneCount transforms per frame, frame after frame.
+struct RawClip
+{
+    float frameRate = 30.0f;
+    int frameCount = 0;
+    int boneCount = 0;
+    std::vector<BoneTransform> frames;
+};
+
+//Largest error (per component) a removed or quantized key may introduce.
+struct ClipCompressionSettings
+{
+    float translationTolerance = 0.001f;
+    float rotationTolerance = 0.0005f;
+    float scaleTolerance = 0.001f;
+};
+
+//Every bone has three tracks, track index = bone * TracksPerBone + TrackType.
+enum TrackType
+{
+    TrackRotation,
+    TrackTranslation,
+    TrackScale,
+    TracksPerBone
+};
+
+enum TrackEncoding
+{
+    TrackQuantized,     //16 bit per component inside the track's [minimum, minimum + 65535 * step] box, in keyValues.
+    TrackFloat          //Plain floats in floatValues, for tracks whose range 16 bits can't cover within tolerance.
+};
+
+//Rotations use all 4 components, translation and scale 3 (the 4th lane has step 0).
+struct AnimationTrack
+{
+    uint32_t firstKey;
+    uint32_t firstValue;
+    uint32_t keyCount;
+    uint32_t encoding;
+    float minimum[4];
+    float step[4];
+};
+
+struct AnimationClip
+{
+    float frameRate = 30.0f;
+    int frameCount = 0;
+    int boneCount = 0;
+    std::vector<AnimationTrack> tracks;
+    std::vector<uint16_t> keyFrames;        //Frame number of every key, per track in increasing order.
+    std::vector<uint16_t> keyValues;        //Quantized components, one padding value at the end for 4 wide loads.
+    std::vector<float> floatValues;         //Components of TrackFloat tracks, padded the same way.
+
+    float duration() const { return frameCount > 1 ? (frameCount - 1) / frameRate : 0.0f; }
+    size_t memorySize() const;
+};
+
+//Key frame numbers are 16 bit.
+const int MaxClipFrames = 65536;
+
+//Quantizes every track and drops the keys that linear interpolation of their neighbours reproduces within tolerance.
+//Rotations are sign aligned frame to frame first, so neighbouring keys always interpolate the short way.
+//A track spanning a range too big for its tolerance at 16 bits (range / 65535 / 2 > tolerance, e.g. long root
+//motion) keeps its keys as floats instead. Fails when the clip has no frames or more than MaxClipFrames, clip is
+//left empty then.
+bool compressClip(const RawClip& raw, AnimationClip& clip, const ClipCompressionSettings& settings = ClipCompressionSettings());
+
+size_t rawClipSize(const RawClip& raw);
+
+//Local bone transforms, per bone rotation (x, y, z, w), translation (x, y, z, 0), scale (x, y, z, 0).
+const int PoseFloatsPerBone = 12;
+
+struct Pose
+{
+    std::vector<float> values;
+
+    void resize(int boneCount) { values.resize((size_t)boneCount * PoseFloatsPerBone); }
+    int boneCount() const { return (int)(values.size() / PoseFloatsPerBone); }
+    BoneTransform bone(int index) const;
+};
+
+//Key position of every track from the last sample, so playing forward only steps over a key now and then.
+struct AnimationCursor
+{
+    std::vector<uint32_t> keys;
+};
+
+//Sample at time seconds (clamped to the clip), the cursor is resized on first use.
+void sampleClip(const AnimationClip& clip, float time, AnimationCursor& cursor, Pose& pose);
+
+//output = mix(a, b, weight) with normalized shortest path rotations, output may be a or b.
+void blendPoses(const Pose& a, const Pose& b, float weight, Pose& output);
+
+//Local bone matrices (translate * rotate * scale), the hierarchy is up to the caller.
+void poseToMatrices(const Pose& pose, glm::mat4* local);
+
+enum BlendNodeType
+{
+    BlendClip,      //Samples clips[clip] at the node's parameter (seconds).
+    BlendLerp       //Mixes the two poses produced just before it by the node's parameter.
+};
+
+struct BlendNode
+{
+    BlendNodeType type;
+    int clip;
+};
+
+//Nodes are listed children first (post order), the last node produces the final pose.
+struct BlendTree
+{
+    std::vector<const AnimationClip*> clips;
+    std::vector<BlendNode> nodes;
+};
+
+struct AnimatedCharacter
+{
+    const BlendTree* tree = nullptr;
+    std::vector<float> parameters;          //One per tree node.
+    std::vector<AnimationCursor> cursors;   //One per tree node, only clip nodes use theirs.
+    Pose pose;
+};
+
+void evaluateCharacter(AnimatedCharacter& character);
+
+//Characters are independent, so they are spread over the parallelFor threads.
+void evaluateCharacters(AnimatedCharacter* characters, int count);
@@ -0,0 +1,109 @@
+#include "BumpArena.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+const size_t BumpArena::Alignment;
+
+namespace
+{
+    size_t alignUp(size_t size)
+    {
+        return (size + BumpArena::Alignment - 1) & ~(BumpArena::Alignment - 1);
+    }
+}
+
+BumpArena::BumpArena(size_t size)
+    : blockSize(alignUp(size))
+{
+}
+
+BumpArena::~BumpArena()
+{
+    for (size_t i = 0; i < blocks.size(); i++) std::free(blocks[i].allocation);
+}
+
+void* BumpArena::allocate(size_t size)
+{
+    size = alignUp(size == 0 ? 1 : size);
+    if (size == 0) return nullptr;
+
+    if (blocks.empty() || blocks[current].size - blocks[current].used < size)
+    {
+        //The blocks after the current one are empty, take the first that is big enough.
+        size_t next = blocks.empty() ? 0 : current + 1;
+        while (next < blocks.size() && blocks[next].size < size) next++;
+
+        if (next == blocks.size())
+        {
+            Block block;
+            block.size = size > blockSize ? size : blockSize;
+            block.allocation = (unsigned char*)std::malloc(block.size + Alignment - 1);
+            if (block.allocation == nullptr) return nullptr;
+            block.memory = (unsigned char*)alignUp((size_t)(uintptr_t)block.allocation);
+            block.used = 0;
+            blocks.push_back(block);
+        }
+
+        current = next;
+        blocks[current].used = 0;
+    }
+
+    Block& block = blocks[current];
+    last = block.used;
+    block.used += size;
+
+    size_t inUse = usage();
+    if (inUse > peak) peak = inUse;
+    return block.memory + last;
+}
+
+void* BumpArena::reallocate(void* p, size_t oldSize, size_t newSize)
+{
+    if (p == nullptr) return allocate(newSize);
+
+    Block* block = blocks.empty() ? nullptr : &blocks[current];
+    if (block != nullptr && p == block->memory + last && alignUp(newSize) <= block->size - last)
+    {
+        block->used = last + alignUp(newSize == 0 ? 1 : newSize);
+        size_t inUse = usage();
+        if (inUse > peak) peak = inUse;
+        return p;
+    }
+
+    void* moved = allocate(newSize);
+    if (moved != nullptr) std::memcpy(moved, p, oldSize < newSize ? oldSize : newSize);
+    return moved;
+}
+
+void BumpArena::rewind(Marker marker)
+{
+    if (blocks.empty()) return;
+
+    for (size_t i = marker.block + 1; i <= current && i < blocks.size(); i++) blocks[i].used = 0;
+    current = marker.block;
+    blocks[current].used = marker.used;
+    //Nothing starts at the free offset, so no older allocation is taken for the latest one.
+    last = marker.used;
+}
+
+size_t BumpArena::capacity() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < blocks.size(); i++) total += blocks[i].size;
+    return total;
+}
+
+size_t BumpArena::usage() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i <= current && i < blocks.size(); i++) total += blocks[i].used;
+    return total;
+}
+
+BumpArena& threadArena()
+{
+    thread_local BumpArena arena;
+    return arena;
+}
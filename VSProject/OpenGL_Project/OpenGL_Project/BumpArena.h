@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//Linear allocator: allocating bumps an offset in the current block, freeing single allocations does nothing.
+//rewind drops everything allocated since a mark at once, the blocks are kept for the next round,
+//so after the first few rounds it stops asking the system for memory at all.
+//Not thread safe, meant to be owned by one thread (see threadArena).
+class BumpArena
+{
+public:
+    static const size_t Alignment = 16;
+
+    explicit BumpArena(size_t blockSize = 1 << 20);
+    ~BumpArena();
+
+    BumpArena(const BumpArena&) = delete;
+    BumpArena& operator=(const BumpArena&) = delete;
+
+    //nullptr when out of memory. Allocations bigger than the block size get a block of their own.
+    void* allocate(size_t size);
+    //Grows in place when p is the latest allocation and there is room, moves it otherwise.
+    void* reallocate(void* p, size_t oldSize, size_t newSize);
+
+    struct Marker
+    {
+        size_t block;
+        size_t used;
+    };
+
+    Marker mark() const { return { current, blocks.empty() ? 0 : blocks[current].used }; }
+    //Frees everything allocated after marker was taken. Marks are rewound in reverse order.
+    void rewind(Marker marker);
+    void reset() { rewind({ 0, 0 }); }
+
+    //Bytes reserved from the system, and the most ever handed out at once.
+    size_t capacity() const;
+    size_t peakUsage() const { return peak; }
+
+private:
+    struct Block
+    {
+        unsigned char* allocation;
+        unsigned char* memory;      //allocation aligned up.
+        size_t size;
+        size_t used;
+    };
+
+    size_t usage() const;
+
+    std::vector<Block> blocks;
+    size_t current = 0;
+    size_t blockSize;
+    size_t last = 0;        //Offset of the latest allocation in the current block, for reallocate.
+    size_t peak = 0;
+};
+
+//The calling thread's arena.
+BumpArena& threadArena();
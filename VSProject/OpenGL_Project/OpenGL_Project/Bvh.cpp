@@ -0,0 +1,488 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include "Parallel.h"
+
+namespace
+{
+    //Binary tree made by the SAH build, collapsed into Bvh4Node afterwards.
+    //count > 0 is a leaf over primitives [first, first + count).
+    struct BuildNode
+    {
+        Aabb bounds;
+        int left, right;
+        int first, count;
+    };
+
+    struct BuildTask
+    {
+        int node;
+        int first, count;
+        int depth;
+    };
+
+    const int BinCount = 16;
+
+    //Ranges below this are built by a single thread.
+    const int ParallelThreshold = 4096;
+
+    //Below this depth ranges are split at the object median instead of by SAH. A skewed SAH split can peel off
+    //just a few primitives per level, median splits halve the range so the tree stays within Bvh::MaxDepth
+    //(2^31 primitives take 29 more halvings to get down to MaxLeafSize).
+    const int MaxSahDepth = Bvh::MaxDepth - 32;
+
+    Aabb emptyBox()
+    {
+        Aabb box;
+        box.min = glm::vec3(FLT_MAX);
+        box.max = glm::vec3(-FLT_MAX);
+        return box;
+    }
+
+    void grow(Aabb& box, const Aabb& other)
+    {
+        box.min = glm::min(box.min, other.min);
+        box.max = glm::max(box.max, other.max);
+    }
+
+    float surfaceArea(const Aabb& box)
+    {
+        glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    struct Builder
+    {
+        const Aabb* bounds;
+        std::vector<glm::vec3> centroids;
+        int* primitives;
+
+        //Binned SAH split of a range at depth, returns false when the range should become a leaf.
+        bool split(int first, int count, int depth, int& middle) const
+        {
+            //Leaves are tested as one 4 wide packet, so up to MaxLeafSize primitives cost the same as one.
+            if (count <= Bvh::MaxLeafSize) return false;
+
+            Aabb centroidBounds = emptyBox();
+            for (int i = first; i < first + count; i++)
+            {
+                centroidBounds.min = glm::min(centroidBounds.min, centroids[primitives[i]]);
+                centroidBounds.max = glm::max(centroidBounds.max, centroids[primitives[i]]);
+            }
+
+            if (depth >= MaxSahDepth)
+            {
+                medianSplit(first, count, centroidBounds, middle);
+                return true;
+            }
+
+            float bestCost = FLT_MAX;
+            int bestAxis = -1;
+            int bestBin = 0;
+
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+                if (extent <= 0.0f) continue;
+
+                Aabb binBounds[BinCount];
+                int binCounts[BinCount] = {};
+                for (int b = 0; b < BinCount; b++) binBounds[b] = emptyBox();
+
+                float scale = BinCount / extent;
+                for (int i = first; i < first + count; i++)
+                {
+                    int bin = std::min(BinCount - 1, (int)((centroids[primitives[i]][axis] - centroidBounds.min[axis]) * scale));
+                    grow(binBounds[bin], bounds[primitives[i]]);
+                    binCounts[bin]++;
+                }
+
+                //Sweep from the right to get the cost of every split plane in one pass.
+                float rightArea[BinCount];
+                int rightCount[BinCount];
+                Aabb accumulated = emptyBox();
+                int accumulatedCount = 0;
+                for (int b = BinCount - 1; b > 0; b--)
+                {
+                    grow(accumulated, binBounds[b]);
+                    accumulatedCount += binCounts[b];
+                    rightArea[b] = surfaceArea(accumulated);
+                    rightCount[b] = accumulatedCount;
+                }
+
+                accumulated = emptyBox();
+                accumulatedCount = 0;
+                for (int b = 1; b < BinCount; b++)
+                {
+                    grow(accumulated, binBounds[b - 1]);
+                    accumulatedCount += binCounts[b - 1];
+                    if (accumulatedCount == 0 || rightCount[b] == 0) continue;
+
+                    float cost = surfaceArea(accumulated) * accumulatedCount + rightArea[b] * rightCount[b];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+
+            if (bestAxis >= 0)
+            {
+                float minimum = centroidBounds.min[bestAxis];
+                float scale = BinCount / (centroidBounds.max[bestAxis] - minimum);
+                const std::vector<glm::vec3>& c = centroids;
+
+                int* end = std::partition(primitives + first, primitives + first + count, [&](int primitive)
+                {
+                    return std::min(BinCount - 1, (int)((c[primitive][bestAxis] - minimum) * scale)) < bestBin;
+                });
+                middle = (int)(end - primitives);
+            }
+            else
+            {
+                //All centroids are the same point, any split is as good as another.
+                middle = first + count / 2;
+            }
+
+            if (middle == first || middle == first + count) middle = first + count / 2;
+            return true;
+        }
+
+        //Half the primitives on each side, ordered along the axis their centroids spread most on.
+        void medianSplit(int first, int count, const Aabb& centroidBounds, int& middle) const
+        {
+            glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+            const std::vector<glm::vec3>& c = centroids;
+
+            middle = first + count / 2;
+            std::nth_element(primitives + first, primitives + middle, primitives + first + count, [&](int a, int b)
+            {
+                return c[a][axis] < c[b][axis];
+            });
+        }
+
+        Aabb rangeBounds(int first, int count) const
+        {
+            Aabb box = emptyBox();
+            for (int i = first; i < first + count; i++) grow(box, bounds[primitives[i]]);
+            return box;
+        }
+
+        int buildSubtree(std::vector<BuildNode>& nodes, int first, int count, int depth) const
+        {
+            int index = (int)nodes.size();
+            BuildNode node;
+            node.bounds = rangeBounds(first, count);
+            node.left = node.right = -1;
+            node.first = first;
+            node.count = count;
+            nodes.push_back(node);
+
+            int middle;
+            if (split(first, count, depth, middle))
+            {
+                int left = buildSubtree(nodes, first, middle - first, depth + 1);
+                int right = buildSubtree(nodes, middle, first + count - middle, depth + 1);
+                nodes[index].left = left;
+                nodes[index].right = right;
+                nodes[index].count = 0;
+            }
+
+            return index;
+        }
+
+        //Split the top of the tree on the calling thread until the ranges are small enough to hand out as tasks,
+        //or until taskDepth levels are split.
+        int buildTop(std::vector<BuildNode>& nodes, std::vector<BuildTask>& tasks, int first, int count, int depth, int taskDepth) const
+        {
+            int index = (int)nodes.size();
+            BuildNode node;
+            node.bounds = rangeBounds(first, count);
+            node.left = node.right = -1;
+            node.first = first;
+            node.count = count;
+            nodes.push_back(node);
+
+            int middle;
+            if (count <= ParallelThreshold || depth == taskDepth || !split(first, count, depth, middle))
+            {
+                BuildTask task = { index, first, count, depth };
+                tasks.push_back(task);
+                return index;
+            }
+
+            int left = buildTop(nodes, tasks, first, middle - first, depth + 1, taskDepth);
+            int right = buildTop(nodes, tasks, middle, first + count - middle, depth + 1, taskDepth);
+            nodes[index].left = left;
+            nodes[index].right = right;
+            nodes[index].count = 0;
+            return index;
+        }
+    };
+
+    void setSlot(Bvh4Node& node, int slot, const Aabb& box, int child)
+    {
+        node.minX[slot] = box.min.x;
+        node.minY[slot] = box.min.y;
+        node.minZ[slot] = box.min.z;
+        node.maxX[slot] = box.max.x;
+        node.maxY[slot] = box.max.y;
+        node.maxZ[slot] = box.max.z;
+        node.child[slot] = child;
+    }
+
+    Aabb slotBounds(const Bvh4Node& node, int slot)
+    {
+        Aabb box;
+        box.min = glm::vec3(node.minX[slot], node.minY[slot], node.minZ[slot]);
+        box.max = glm::vec3(node.maxX[slot], node.maxY[slot], node.maxZ[slot]);
+        return box;
+    }
+
+    //Turn the binary tree into 4 wide nodes by repeatedly opening the child with the biggest surface area.
+    int flatten(const std::vector<BuildNode>& tree, int treeIndex, std::vector<Bvh4Node>& nodes, std::vector<BvhLeaf>& leaves)
+    {
+        int children[4] = { tree[treeIndex].left, tree[treeIndex].right };
+        int childCount = 2;
+
+        while (childCount < 4)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for (int i = 0; i < childCount; i++)
+            {
+                const BuildNode& child = tree[children[i]];
+                if (child.count == 0 && surfaceArea(child.bounds) > largestArea)
+                {
+                    largest = i;
+                    largestArea = surfaceArea(child.bounds);
+                }
+            }
+
+            if (largest < 0) break;
+
+            int opened = children[largest];
+            children[largest] = tree[opened].left;
+            children[childCount++] = tree[opened].right;
+        }
+
+        int index = (int)nodes.size();
+        nodes.push_back(Bvh4Node());
+
+        Bvh4Node node;
+        for (int slot = 0; slot < 4; slot++)
+        {
+            if (slot >= childCount)
+            {
+                setSlot(node, slot, emptyBox(), Bvh::EmptySlot);
+                continue;
+            }
+
+            const BuildNode& child = tree[children[slot]];
+            if (child.count > 0)
+            {
+                BvhLeaf leaf = { child.first, child.count };
+                leaves.push_back(leaf);
+                setSlot(node, slot, child.bounds, ~((int)leaves.size() - 1));
+            }
+            else
+            {
+                setSlot(node, slot, child.bounds, flatten(tree, children[slot], nodes, leaves));
+            }
+        }
+
+        nodes[index] = node;
+        return index;
+    }
+}
+
+void Bvh::build(const Aabb* bounds, int count)
+{
+    nodes.clear();
+    leaves.clear();
+    primitives.resize(count);
+    if (count <= 0) return;
+
+    Builder builder;
+    builder.bounds = bounds;
+    builder.primitives = primitives.data();
+    builder.centroids.resize(count);
+
+    parallelFor(count, 16384, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            primitives[i] = i;
+            builder.centroids[i] = (bounds[i].min + bounds[i].max) * 0.5f;
+        }
+    });
+
+    //Top levels on this thread, then one independent subtree per task.
+    int taskDepth = 2;
+    while ((1 << taskDepth) < workerCount() * 4) taskDepth++;
+
+    std::vector<BuildNode> tree;
+    std::vector<BuildTask> tasks;
+    builder.buildTop(tree, tasks, 0, count, 0, taskDepth);
+
+    std::vector<std::vector<BuildNode> > subtrees(tasks.size());
+    parallelFor((int)tasks.size(), 1, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            builder.buildSubtree(subtrees[i], tasks[i].first, tasks[i].count, tasks[i].depth);
+        }
+    });
+
+    //Stitch the subtrees in, their root replaces the task's placeholder node.
+    for (size_t i = 0; i < tasks.size(); i++)
+    {
+        const std::vector<BuildNode>& subtree = subtrees[i];
+        int offset = (int)tree.size() - 1;
+
+        for (size_t j = 0; j < subtree.size(); j++)
+        {
+            BuildNode node = subtree[j];
+            if (node.count == 0)
+            {
+                node.left = node.left == 0 ? tasks[i].node : node.left + offset;
+                node.right = node.right == 0 ? tasks[i].node : node.right + offset;
+            }
+
+            if (j == 0) tree[tasks[i].node] = node;
+            else tree.push_back(node);
+        }
+    }
+
+    if (tree[0].count > 0)
+    {
+        //Tiny input, the root is a leaf.
+        Bvh4Node root;
+        BvhLeaf leaf = { 0, count };
+        leaves.push_back(leaf);
+        setSlot(root, 0, tree[0].bounds, ~0);
+        for (int slot = 1; slot < 4; slot++) setSlot(root, slot, emptyBox(), EmptySlot);
+        nodes.push_back(root);
+    }
+    else
+    {
+        flatten(tree, 0, nodes, leaves);
+    }
+}
+
+void Bvh::refit(const Aabb* bounds)
+{
+    //Children are always stored after their parent, so walking backwards updates bottom up.
+    for (int i = (int)nodes.size() - 1; i >= 0; i--)
+    {
+        Bvh4Node& node = nodes[i];
+
+        for (int slot = 0; slot < 4; slot++)
+        {
+            int child = node.child[slot];
+            if (child == EmptySlot) continue;
+
+            Aabb box = emptyBox();
+            if (child < 0)
+            {
+                const BvhLeaf& leaf = leaves[~child];
+                for (int p = leaf.first; p < leaf.first + leaf.count; p++) grow(box, bounds[primitives[p]]);
+            }
+            else
+            {
+                for (int childSlot = 0; childSlot < 4; childSlot++) grow(box, slotBounds(nodes[child], childSlot));
+            }
+
+            setSlot(node, slot, box, child);
+        }
+    }
+}
+
+void MeshBvh::build(const glm::vec3* meshPositions, const unsigned int* meshIndices, int meshTriangleCount)
+{
+    positions = meshPositions;
+    indices = meshIndices;
+    triangleCount = meshTriangleCount;
+
+    std::vector<Aabb> bounds;
+    computeBounds(bounds);
+    bvh.build(bounds.data(), triangleCount);
+    loadLeafTriangles();
+}
+
+void MeshBvh::refit()
+{
+    std::vector<Aabb> bounds;
+    computeBounds(bounds);
+    bvh.refit(bounds.data());
+    loadLeafTriangles();
+}
+
+bool MeshBvh::intersect(const glm::vec3& orig, const glm::vec3& dir, MeshHit& hit) const
+{
+    return bvh.closestHit(orig, dir, hit.distance, [&](int leaf, float& distance)
+    {
+        int lane = intersectRayTrianglePacket(orig, dir, leafTriangles[leaf], distance, hit.baryPosition);
+        if (lane < 0) return false;
+
+        hit.triangle = bvh.primitive(bvh.leaf(leaf).first + lane);
+        return true;
+    });
+}
+
+bool MeshBvh::occluded(const glm::vec3& orig, const glm::vec3& dir, float maxDistance) const
+{
+    return bvh.anyHit(orig, dir, maxDistance, [&](int leaf, float distance)
+    {
+        glm::vec2 baryPosition;
+        return intersectRayTrianglePacket(orig, dir, leafTriangles[leaf], distance, baryPosition) >= 0;
+    });
+}
+
+void MeshBvh::computeBounds(std::vector<Aabb>& bounds) const
+{
+    bounds.resize(triangleCount);
+
+    parallelFor(triangleCount, 16384, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const glm::vec3& a = positions[indices[i * 3]];
+            const glm::vec3& b = positions[indices[i * 3 + 1]];
+            const glm::vec3& c = positions[indices[i * 3 + 2]];
+
+            bounds[i].min = glm::min(a, glm::min(b, c));
+            bounds[i].max = glm::max(a, glm::max(b, c));
+        }
+    });
+}
+
+void MeshBvh::loadLeafTriangles()
+{
+    leafTriangles.resize(bvh.leafCount());
+
+    //Copy each leaf's triangles into one packet so the leaf test is a single SIMD call.
+    parallelFor(bvh.leafCount(), 4096, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const BvhLeaf& leaf = bvh.leaf(i);
+
+            unsigned int leafIndices[Bvh::MaxLeafSize * 3];
+            for (int j = 0; j < leaf.count; j++)
+            {
+                int triangle = bvh.primitive(leaf.first + j);
+                leafIndices[j * 3] = indices[triangle * 3];
+                leafIndices[j * 3 + 1] = indices[triangle * 3 + 1];
+                leafIndices[j * 3 + 2] = indices[triangle * 3 + 2];
+            }
+
+            loadTrianglePacket(leafTriangles[i], positions, leafIndices, 0, leaf.count);
+        }
+    });
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <climits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RayPacket.h"
+#include "Simd.h"
+
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+//Four children per node with their bounds stored as SoA, so one node is tested with a single Float4 slab test.
+struct Bvh4Node
+{
+    float minX[4], minY[4], minZ[4];
+    float maxX[4], maxY[4], maxZ[4];
+
+    //>= 0 is an inner node, < 0 is leaf ~child, EmptySlot is unused.
+    int child[4];
+};
+
+struct BvhLeaf
+{
+    int first;
+    int count;
+};
+
+//SAH built bounding volume hierarchy over arbitrary boxes (triangles, instances, ...).
+//The binary build tree is collapsed into 4 wide nodes stored depth first in one array.
+class Bvh
+{
+public:
+    static const int EmptySlot = INT_MIN;
+    static const int MaxLeafSize = 4;
+    static const int StackSize = 256;
+
+    //Deepest leaf the build makes. Traversal pops one node and pushes up to four per level, so this bounds the stack.
+    static const int MaxDepth = 80;
+    static_assert(MaxDepth * 3 < StackSize, "Traversal stack can overflow at MaxDepth.");
+
+    //Build over count boxes, big inputs split their subtrees over the parallelFor threads.
+    void build(const Aabb* bounds, int count);
+
+    //Recompute node bounds for moved primitives, the tree topology stays the same.
+    void refit(const Aabb* bounds);
+
+    //Closest hit, leafFunction(leaf, distance) tests the primitives of a leaf and shrinks distance on a hit.
+    template<typename LeafFunction>
+    bool closestHit(const glm::vec3& orig, const glm::vec3& dir, float& distance, LeafFunction leafFunction) const;
+
+    //Any hit, stops as soon as leafFunction(leaf, maxDistance) returns true.
+    template<typename LeafFunction>
+    bool anyHit(const glm::vec3& orig, const glm::vec3& dir, float maxDistance, LeafFunction leafFunction) const;
+
+    const Bvh4Node& node(int index) const { return nodes[index]; }
+    const BvhLeaf& leaf(int index) const { return leaves[index]; }
+    int leafCount() const { return (int)leaves.size(); }
+    int nodeCount() const { return (int)nodes.size(); }
+
+    //Original primitive index for a slot inside a leaf range.
+    int primitive(int slot) const { return primitives[slot]; }
+
+private:
+    std::vector<Bvh4Node> nodes;
+    std::vector<BvhLeaf> leaves;
+    std::vector<int> primitives;
+
+    //Slab test of one ray against the four children, returns a hit mask and the entry distances.
+    int intersectNode(const Bvh4Node& node, const Float4 origin[3], const Float4 inverseDir[3], float maxDistance, float nearDistance[4]) const;
+};
+
+//BVH over an indexed triangle mesh with packet tests at the leaves.
+//The mesh arrays are referenced, not copied, and must stay alive while the BVH is used.
+struct MeshHit
+{
+    int triangle;
+    float distance;
+    glm::vec2 baryPosition;
+};
+
+class MeshBvh
+{
+public:
+    void build(const glm::vec3* positions, const unsigned int* indices, int triangleCount);
+
+    //Call after the referenced positions changed.
+    void refit();
+
+    //hit.distance is the maximum search distance on input.
+    bool intersect(const glm::vec3& orig, const glm::vec3& dir, MeshHit& hit) const;
+    bool occluded(const glm::vec3& orig, const glm::vec3& dir, float maxDistance) const;
+
+    const Bvh& hierarchy() const { return bvh; }
+
+private:
+    const glm::vec3* positions = nullptr;
+    const unsigned int* indices = nullptr;
+    int triangleCount = 0;
+
+    Bvh bvh;
+    std::vector<TrianglePacket4> leafTriangles;
+
+    void computeBounds(std::vector<Aabb>& bounds) const;
+    void loadLeafTriangles();
+};
+
+inline int Bvh::intersectNode(const Bvh4Node& node, const Float4 origin[3], const Float4 inverseDir[3], float maxDistance, float nearDistance[4]) const
+{
+    Float4 t0x = (Float4::load(node.minX) - origin[0]) * inverseDir[0];
+    Float4 t1x = (Float4::load(node.maxX) - origin[0]) * inverseDir[0];
+    Float4 t0y = (Float4::load(node.minY) - origin[1]) * inverseDir[1];
+    Float4 t1y = (Float4::load(node.maxY) - origin[1]) * inverseDir[1];
+    Float4 t0z = (Float4::load(node.minZ) - origin[2]) * inverseDir[2];
+    Float4 t1z = (Float4::load(node.maxZ) - origin[2]) * inverseDir[2];
+
+    Float4 tNear = vmax(vmax(vmin(t0x, t1x), vmin(t0y, t1y)), vmax(vmin(t0z, t1z), Float4(0.0f)));
+    Float4 tFar = vmin(vmin(vmax(t0x, t1x), vmax(t0y, t1y)), vmin(vmax(t0z, t1z), Float4(maxDistance)));
+
+    tNear.store(nearDistance);
+    return vmovemask(tNear <= tFar);
+}
+
+template<typename LeafFunction>
+bool Bvh::closestHit(const glm::vec3& orig, const glm::vec3& dir, float& distance, LeafFunction leafFunction) const
+{
+    if (nodes.empty()) return false;
+
+    Float4 origin[3] = { Float4(orig.x), Float4(orig.y), Float4(orig.z) };
+    Float4 inverseDir[3] = { Float4(1.0f / dir.x), Float4(1.0f / dir.y), Float4(1.0f / dir.z) };
+
+    //Entries remember their entry distance so subtrees behind a closer hit are skipped when popped.
+    struct Entry
+    {
+        int child;
+        float nearDistance;
+    };
+
+    Entry stack[StackSize];
+    int stackSize = 0;
+    stack[stackSize++] = { 0, 0.0f };
+    bool hit = false;
+
+    while (stackSize > 0)
+    {
+        Entry entry = stack[--stackSize];
+        if (entry.nearDistance > distance) continue;
+
+        if (entry.child < 0)
+        {
+            if (leafFunction(~entry.child, distance)) hit = true;
+            continue;
+        }
+
+        const Bvh4Node& node = nodes[entry.child];
+
+        float nearDistance[4];
+        int mask = intersectNode(node, origin, inverseDir, distance, nearDistance);
+
+        //Push hit children far to near so the nearest one is visited first.
+        int order[4];
+        int hitCount = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (!(mask & (1 << i)) || node.child[i] == EmptySlot) continue;
+
+            int j = hitCount++;
+            while (j > 0 && nearDistance[order[j - 1]] < nearDistance[i])
+            {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = i;
+        }
+
+        for (int i = 0; i < hitCount; i++)
+        {
+            stack[stackSize++] = { node.child[order[i]], nearDistance[order[i]] };
+        }
+    }
+
+    return hit;
+}
+
+template<typename LeafFunction>
+bool Bvh::anyHit(const glm::vec3& orig, const glm::vec3& dir, float maxDistance, LeafFunction leafFunction) const
+{
+    if (nodes.empty()) return false;
+
+    Float4 origin[3] = { Float4(orig.x), Float4(orig.y), Float4(orig.z) };
+    Float4 inverseDir[3] = { Float4(1.0f / dir.x), Float4(1.0f / dir.y), Float4(1.0f / dir.z) };
+
+    int stack[StackSize];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        const Bvh4Node& node = nodes[stack[--stackSize]];
+
+        float nearDistance[4];
+        int mask = intersectNode(node, origin, inverseDir, maxDistance, nearDistance);
+
+        for (int i = 0; i < 4; i++)
+        {
+            if (!(mask & (1 << i)) || node.child[i] == EmptySlot) continue;
+
+            int child = node.child[i];
+            if (child >= 0)
+            {
+                stack[stackSize++] = child;
+            }
+            else if (leafFunction(~child, maxDistance))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
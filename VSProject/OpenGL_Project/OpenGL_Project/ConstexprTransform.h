@@ -0,0 +1,215 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+//Compile time versions of glm::translate, scale, rotate, ortho and perspective.
+//glm only marks its constructors constexpr when SIMD intrinsics are off, and picking scalar code at compile time
+//and SIMD at run time needs std::is_constant_evaluated (C++20), so these live on a plain scalar matrix instead.
+//Results follow glm's defaults (column major, right handed, -1..1 depth) and convert with toMat4 for run time use.
+//Translate, scale and ortho round the same as glm. Rotate and perspective use series for sin, cos and sqrt instead
+//of libm, so they are only within a few float ulps of glm (see ConstexprTransformTests.cpp).
+
+struct ConstVec3
+{
+    float x, y, z;
+};
+
+//Column major like glm::mat4, m[column * 4 + row].
+struct ConstMat4
+{
+    float m[16];
+
+    constexpr float at(int column, int row) const { return m[column * 4 + row]; }
+};
+
+//Fixed size float table that constexpr functions can fill in and return (std::array isn't writable in C++14 constexpr).
+template<int N>
+struct ConstFloatArray
+{
+    float values[N];
+
+    static const int Count = N;
+};
+
+namespace constexpr_detail
+{
+    constexpr double Pi = 3.14159265358979323846;
+
+    //Wrap to [-pi, pi] so the series below converge quickly.
+    constexpr double wrapAngle(double x)
+    {
+        double turns = x / (2.0 * Pi);
+        long long n = (long long)(turns + (turns >= 0.0 ? 0.5 : -0.5));
+        return x - (double)n * 2.0 * Pi;
+    }
+
+    constexpr double sin(double x)
+    {
+        x = wrapAngle(x);
+        double term = x, sum = x;
+        for (int i = 1; i < 14; i++)
+        {
+            term *= -x * x / ((2.0 * i) * (2.0 * i + 1.0));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr double cos(double x)
+    {
+        x = wrapAngle(x);
+        double term = 1.0, sum = 1.0;
+        for (int i = 1; i < 14; i++)
+        {
+            term *= -x * x / ((2.0 * i - 1.0) * (2.0 * i));
+            sum += term;
+        }
+        return sum;
+    }
+
+    constexpr double sqrt(double x)
+    {
+        if (x <= 0.0) return 0.0;
+
+        double r = x > 1.0 ? x : 1.0;
+        for (int i = 0; i < 64; i++)
+        {
+            double next = 0.5 * (r + x / r);
+            if (next == r) break;
+            r = next;
+        }
+        return r;
+    }
+}
+
+constexpr ConstMat4 constIdentity()
+{
+    return ConstMat4{ { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f } };
+}
+
+constexpr ConstMat4 constMultiply(const ConstMat4& a, const ConstMat4& b)
+{
+    ConstMat4 result = {};
+    for (int column = 0; column < 4; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; k++) sum += a.at(k, row) * b.at(column, k);
+            result.m[column * 4 + row] = sum;
+        }
+    }
+    return result;
+}
+
+//glm::translate(m, v)
+constexpr ConstMat4 constTranslate(const ConstMat4& m, const ConstVec3& v)
+{
+    ConstMat4 result = m;
+    for (int row = 0; row < 4; row++)
+    {
+        result.m[12 + row] = m.at(0, row) * v.x + m.at(1, row) * v.y + m.at(2, row) * v.z + m.at(3, row);
+    }
+    return result;
+}
+
+//glm::scale(m, v)
+constexpr ConstMat4 constScale(const ConstMat4& m, const ConstVec3& v)
+{
+    ConstMat4 result = m;
+    for (int row = 0; row < 4; row++)
+    {
+        result.m[row] = m.at(0, row) * v.x;
+        result.m[4 + row] = m.at(1, row) * v.y;
+        result.m[8 + row] = m.at(2, row) * v.z;
+    }
+    return result;
+}
+
+//glm::rotate(m, angle, axis), angle in radians.
+constexpr ConstMat4 constRotate(const ConstMat4& m, float angle, const ConstVec3& axis)
+{
+    float c = (float)constexpr_detail::cos(angle);
+    float s = (float)constexpr_detail::sin(angle);
+
+    double length = constexpr_detail::sqrt((double)axis.x * axis.x + (double)axis.y * axis.y + (double)axis.z * axis.z);
+    float a[3] = { (float)(axis.x / length), (float)(axis.y / length), (float)(axis.z / length) };
+    float t[3] = { (1.0f - c) * a[0], (1.0f - c) * a[1], (1.0f - c) * a[2] };
+
+    float r[3][3] =
+    {
+        { c + t[0] * a[0], t[0] * a[1] + s * a[2], t[0] * a[2] - s * a[1] },
+        { t[1] * a[0] - s * a[2], c + t[1] * a[1], t[1] * a[2] + s * a[0] },
+        { t[2] * a[0] + s * a[1], t[2] * a[1] - s * a[0], c + t[2] * a[2] }
+    };
+
+    ConstMat4 result = m;
+    for (int column = 0; column < 3; column++)
+    {
+        for (int row = 0; row < 4; row++)
+        {
+            result.m[column * 4 + row] = m.at(0, row) * r[column][0] + m.at(1, row) * r[column][1] + m.at(2, row) * r[column][2];
+        }
+    }
+    return result;
+}
+
+//glm::ortho(left, right, bottom, top, zNear, zFar)
+constexpr ConstMat4 constOrtho(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    ConstMat4 result = constIdentity();
+    result.m[0] = 2.0f / (right - left);
+    result.m[5] = 2.0f / (top - bottom);
+    result.m[10] = -2.0f / (zFar - zNear);
+    result.m[12] = -(right + left) / (right - left);
+    result.m[13] = -(top + bottom) / (top - bottom);
+    result.m[14] = -(zFar + zNear) / (zFar - zNear);
+    return result;
+}
+
+//glm::perspective(fovy, aspect, zNear, zFar), fovy in radians.
+constexpr ConstMat4 constPerspective(float fovy, float aspect, float zNear, float zFar)
+{
+    float tanHalfFovy = (float)(constexpr_detail::sin(fovy / 2.0) / constexpr_detail::cos(fovy / 2.0));
+
+    ConstMat4 result = {};
+    result.m[0] = 1.0f / (aspect * tanHalfFovy);
+    result.m[5] = 1.0f / tanHalfFovy;
+    result.m[10] = -(zFar + zNear) / (zFar - zNear);
+    result.m[11] = -1.0f;
+    result.m[14] = -(2.0f * zFar * zNear) / (zFar - zNear);
+    return result;
+}
+
+constexpr float constRadians(float degrees)
+{
+    return degrees * (float)(constexpr_detail::Pi / 180.0);
+}
+
+//Transforms the first 3 floats of every vertex as a point, everything else in the vertex is copied.
+template<int N>
+constexpr ConstFloatArray<N> constTransformPositions(const ConstFloatArray<N>& vertices, int floatsPerVertex, const ConstMat4& m)
+{
+    ConstFloatArray<N> result = vertices;
+    for (int v = 0; v + 3 <= N; v += floatsPerVertex)
+    {
+        float x = vertices.values[v], y = vertices.values[v + 1], z = vertices.values[v + 2];
+        float w = m.at(0, 3) * x + m.at(1, 3) * y + m.at(2, 3) * z + m.at(3, 3);
+        for (int row = 0; row < 3; row++)
+        {
+            result.values[v + row] = (m.at(0, row) * x + m.at(1, row) * y + m.at(2, row) * z + m.at(3, row)) / w;
+        }
+    }
+    return result;
+}
+
+//Run time copy into glm, which uses its SIMD paths from here on.
+inline glm::mat4 toMat4(const ConstMat4& matrix)
+{
+    glm::mat4 result;
+    for (int column = 0; column < 4; column++)
+    {
+        result[column] = glm::vec4(matrix.m[column * 4], matrix.m[column * 4 + 1], matrix.m[column * 4 + 2], matrix.m[column * 4 + 3]);
+    }
+    return result;
+}
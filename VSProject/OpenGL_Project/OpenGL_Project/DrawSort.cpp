@@ -0,0 +1,166 @@
+#include "DrawSort.h"
+
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Parallel.h"
+#include "SceneComponents.h"
+
+namespace
+{
+    const int RadixBits = 8;
+    const int Buckets = 1 << RadixBits;
+
+    //Packets per block of a sort pass, below this a single block runs inline.
+    const int BlockSize = 64 * 1024;
+
+    uint64_t field(uint32_t value, int bits, int shift)
+    {
+        return (uint64_t)(value & ((1u << bits) - 1)) << shift;
+    }
+}
+
+uint64_t makeSortKey(uint32_t layer, uint32_t program, uint32_t material, uint32_t vao, uint32_t depth)
+{
+    const int depthShift = 0;
+    const int vaoShift = depthShift + SortKeyDepthBits;
+    const int materialShift = vaoShift + SortKeyVaoBits;
+    const int programShift = materialShift + SortKeyMaterialBits;
+    const int layerShift = programShift + SortKeyProgramBits;
+
+    return field(layer, SortKeyLayerBits, layerShift) | field(program, SortKeyProgramBits, programShift) |
+        field(material, SortKeyMaterialBits, materialShift) | field(vao, SortKeyVaoBits, vaoShift) | field(depth, SortKeyDepthBits, depthShift);
+}
+
+uint32_t quantizeSortDepth(float depth, float zNear, float zFar)
+{
+    float t = (depth - zNear) / (zFar - zNear);
+    t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+    return (uint32_t)(t * ((1 << SortKeyDepthBits) - 1) + 0.5f);
+}
+
+void sortDrawPackets(DrawPacket* packets, DrawPacket* scratch, int count)
+{
+    if (count <= 1) return;
+
+    //Bits that differ somewhere, a pass over a byte that never changes would just copy.
+    uint64_t differing = 0;
+    for (int i = 1; i < count; i++) differing |= packets[i].key ^ packets[0].key;
+
+    int blocks = (count + BlockSize - 1) / BlockSize;
+    std::vector<uint32_t> offsets((size_t)blocks * Buckets);
+
+    DrawPacket* source = packets;
+    DrawPacket* target = scratch;
+    for (int shift = 0; shift < 64; shift += RadixBits)
+    {
+        if (((differing >> shift) & (Buckets - 1)) == 0) continue;
+
+        parallelFor(blocks, 1, [&](int begin, int end)
+        {
+            for (int block = begin; block < end; block++)
+            {
+                uint32_t* histogram = &offsets[(size_t)block * Buckets];
+                std::memset(histogram, 0, Buckets * sizeof(uint32_t));
+
+                int last = (block + 1) * BlockSize < count ? (block + 1) * BlockSize : count;
+                for (int i = block * BlockSize; i < last; i++) histogram[(source[i].key >> shift) & (Buckets - 1)]++;
+            }
+        });
+
+        //Bucket major, block minor: every block writes its part of a bucket after the blocks before it, keeping the sort stable.
+        uint32_t running = 0;
+        for (int bucket = 0; bucket < Buckets; bucket++)
+        {
+            for (int block = 0; block < blocks; block++)
+            {
+                uint32_t& offset = offsets[(size_t)block * Buckets + bucket];
+                uint32_t n = offset;
+                offset = running;
+                running += n;
+            }
+        }
+
+        parallelFor(blocks, 1, [&](int begin, int end)
+        {
+            for (int block = begin; block < end; block++)
+            {
+                uint32_t* offset = &offsets[(size_t)block * Buckets];
+
+                int last = (block + 1) * BlockSize < count ? (block + 1) * BlockSize : count;
+                for (int i = block * BlockSize; i < last; i++) target[offset[(source[i].key >> shift) & (Buckets - 1)]++] = source[i];
+            }
+        });
+
+        DrawPacket* swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != packets) std::memcpy(packets, source, (size_t)count * sizeof(DrawPacket));
+}
+
+void DrawQueue::clear()
+{
+    items.clear();
+    packets.clear();
+}
+
+void DrawQueue::add(uint64_t key, const Renderable* renderable, const glm::mat4* world)
+{
+    packets.push_back({ key, (uint32_t)items.size() });
+    items.push_back({ renderable, world });
+}
+
+uint32_t DrawQueue::material(const GLuint textures[2])
+{
+    uint64_t pair = (uint64_t)textures[0] << 32 | textures[1];
+    return materials.emplace(pair, (uint32_t)materials.size()).first->second;
+}
+
+RenderStats DrawQueue::submit(CommandBuffer& commands)
+{
+    scratch.resize(packets.size());
+    sortDrawPackets(packets.data(), scratch.data(), (int)packets.size());
+
+    RenderStats stats;
+    GLuint program = 0;
+    GLuint vao = 0;
+    GLuint textures[2] = { 0, 0 };
+
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        const Renderable& renderable = *items[packets[i].item].renderable;
+
+        if (renderable.program != program)
+        {
+            program = renderable.program;
+            commands.useProgram(program);
+            stats.programChanges++;
+        }
+
+        commands.setUniformMat4(renderable.modelLocation, glm::value_ptr(*items[packets[i].item].world));
+
+        for (int unit = 0; unit < 2; unit++)
+        {
+            if (renderable.textures[unit] == 0 || renderable.textures[unit] == textures[unit]) continue;
+            textures[unit] = renderable.textures[unit];
+            commands.bindTexture(unit, textures[unit]);
+            stats.textureChanges++;
+        }
+
+        if (renderable.vao != vao)
+        {
+            vao = renderable.vao;
+            commands.bindVertexArray(vao);
+            stats.vaoChanges++;
+        }
+
+        commands.drawElements(GL_TRIANGLES, renderable.indexCount, GL_UNSIGNED_INT, 0);
+        stats.draws++;
+    }
+
+    if (vao != 0) commands.bindVertexArray(0);
+    return stats;
+}
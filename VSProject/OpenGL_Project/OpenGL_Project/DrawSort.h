@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "RenderCommands.h"
+
+struct Renderable;
+
+//64 bit draw sort keys, most significant first:
+//layer (4) | program (12) | material (16) | vao (16) | depth (16)
+//so sorted draws come grouped by layer, then program, then textures, then mesh, near to far inside a group.
+//Ids wider than their field are masked, that only costs sort quality, submission compares the real GL state.
+const int SortKeyLayerBits = 4;
+const int SortKeyProgramBits = 12;
+const int SortKeyMaterialBits = 16;
+const int SortKeyVaoBits = 16;
+const int SortKeyDepthBits = 16;
+
+uint64_t makeSortKey(uint32_t layer, uint32_t program, uint32_t material, uint32_t vao, uint32_t depth);
+
+//Depth in [zNear, zFar] to the 16 bit depth field, near is 0.
+uint32_t quantizeSortDepth(float depth, float zNear, float zFar);
+
+struct DrawPacket
+{
+    uint64_t key;
+    uint32_t item;          //Index into the queue's items.
+};
+
+//Stable LSD radix sort on key, 8 bits per pass. Passes where every key has the same byte are skipped and
+//big inputs split every pass into blocks that are counted and scattered on the parallelFor threads.
+//scratch needs room for count packets.
+void sortDrawPackets(DrawPacket* packets, DrawPacket* scratch, int count);
+
+//State changes and draws emitted by the last submit.
+struct RenderStats
+{
+    int draws = 0;
+    int programChanges = 0;
+    int textureChanges = 0;
+    int vaoChanges = 0;
+
+    int stateChanges() const { return programChanges + textureChanges + vaoChanges; }
+};
+
+//Per frame list of draws, its buffers are reused between frames.
+class DrawQueue
+{
+public:
+    void clear();
+
+    void add(uint64_t key, const Renderable* renderable, const glm::mat4* world);
+
+    //Dense index of a texture pair (units 0 and 1) for the key's material field. GL names can be anything, so
+    //masking them would merge unrelated pairs. Indices are handed out on first use and kept across frames.
+    uint32_t material(const GLuint textures[2]);
+
+    //Sorts by key and records the draws, binding every program, texture and VAO only when it changes.
+    RenderStats submit(CommandBuffer& commands);
+
+    int size() const { return (int)packets.size(); }
+
+private:
+    struct DrawItem
+    {
+        const Renderable* renderable;
+        const glm::mat4* world;
+    };
+
+    std::vector<DrawItem> items;
+    std::vector<DrawPacket> packets;
+    std::vector<DrawPacket> scratch;
+    std::unordered_map<uint64_t, uint32_t> materials;
+};
@@ -0,0 +1,243 @@
+#include "Ecs.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+namespace
+{
+    const int ColumnAlignment = 16;
+
+    struct ComponentRegistry
+    {
+        std::mutex mutex;
+        std::vector<int> sizes;
+    };
+
+    ComponentRegistry& registry()
+    {
+        static ComponentRegistry instance;
+        return instance;
+    }
+
+    int alignUp(int value, int alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+const int EcsWorld::ChunkBytes;
+
+int ecs_detail::registerComponent(int size)
+{
+    ComponentRegistry& components = registry();
+    std::lock_guard<std::mutex> lock(components.mutex);
+
+    //Masks have one bit per type, a type past them would index past the archetype arrays.
+    if ((int)components.sizes.size() == MaxComponentTypes)
+    {
+        std::fprintf(stderr, "ECS: more than %d component types registered\n", MaxComponentTypes);
+        std::abort();
+    }
+
+    components.sizes.push_back(size);
+    return (int)components.sizes.size() - 1;
+}
+
+int ecs_detail::componentSize(int id)
+{
+    ComponentRegistry& components = registry();
+    std::lock_guard<std::mutex> lock(components.mutex);
+    return components.sizes[id];
+}
+
+EcsWorld::EcsWorld()
+{
+    //Archetype 0 holds entities without components.
+    findArchetype(0);
+}
+
+int EcsWorld::findArchetype(ComponentMask mask)
+{
+    std::unordered_map<ComponentMask, int>::iterator found = archetypeLookup.find(mask);
+    if (found != archetypeLookup.end()) return found->second;
+
+    Archetype archetype;
+    archetype.mask = mask;
+
+    int rowBytes = (int)sizeof(Entity);
+    for (int id = 0; id < MaxComponentTypes; id++)
+    {
+        archetype.offsets[id] = -1;
+        archetype.sizes[id] = 0;
+        if (!(mask & ((ComponentMask)1 << id))) continue;
+
+        archetype.components.push_back(id);
+        archetype.sizes[id] = ecs_detail::componentSize(id);
+        rowBytes += archetype.sizes[id];
+    }
+
+    //Leave room for aligning every array, then lay the arrays out one after the other.
+    int padding = ColumnAlignment * ((int)archetype.components.size() + 1);
+    archetype.capacity = (ChunkBytes - padding) / rowBytes;
+    if (archetype.capacity < 1) archetype.capacity = 1;
+
+    int offset = 0;
+    for (size_t i = 0; i < archetype.components.size(); i++)
+    {
+        int id = archetype.components[i];
+        archetype.offsets[id] = offset;
+        offset = alignUp(offset + archetype.sizes[id] * archetype.capacity, ColumnAlignment);
+    }
+    archetype.entityOffset = offset;
+
+    int index = (int)archetypes.size();
+    archetypes.push_back(std::move(archetype));
+    archetypeLookup[mask] = index;
+    return index;
+}
+
+void* EcsWorld::component(const EntityRecord& record, int id) const
+{
+    const Archetype& archetype = archetypes[record.archetype];
+    return archetype.column(record.chunk, id) + (size_t)record.row * archetype.sizes[id];
+}
+
+Entity EcsWorld::allocateEntity(ComponentMask mask)
+{
+    uint32_t index;
+    if (!freeIndices.empty())
+    {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else
+    {
+        index = (uint32_t)records.size();
+        records.push_back({ 0, -1, 0, 0 });
+    }
+
+    insertRow(index, findArchetype(mask));
+    liveCount++;
+    return { index, records[index].generation };
+}
+
+Entity EcsWorld::create()
+{
+    return allocateEntity(0);
+}
+
+void EcsWorld::insertRow(uint32_t index, int archetypeIndex)
+{
+    Archetype& archetype = archetypes[archetypeIndex];
+
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity)
+    {
+        int bytes = archetype.entityOffset + archetype.capacity * (int)sizeof(Entity);
+        EcsChunk chunk;
+        chunk.data.reset(new unsigned char[bytes]);
+        archetype.chunks.push_back(std::move(chunk));
+    }
+
+    int chunk = (int)archetype.chunks.size() - 1;
+    int row = archetype.chunks[chunk].count++;
+    archetype.entities(chunk)[row] = { index, records[index].generation };
+
+    EntityRecord& record = records[index];
+    record.archetype = archetypeIndex;
+    record.chunk = chunk;
+    record.row = row;
+}
+
+void EcsWorld::removeRow(int archetypeIndex, int chunk, int row)
+{
+    Archetype& archetype = archetypes[archetypeIndex];
+
+    //Fill the hole with the very last entity of the archetype, so chunks stay dense.
+    int lastChunk = (int)archetype.chunks.size() - 1;
+    int lastRow = archetype.chunks[lastChunk].count - 1;
+
+    if (chunk != lastChunk || row != lastRow)
+    {
+        for (size_t i = 0; i < archetype.components.size(); i++)
+        {
+            int id = archetype.components[i];
+            int size = archetype.sizes[id];
+            std::memcpy(archetype.column(chunk, id) + (size_t)row * size, archetype.column(lastChunk, id) + (size_t)lastRow * size, size);
+        }
+
+        Entity moved = archetype.entities(lastChunk)[lastRow];
+        archetype.entities(chunk)[row] = moved;
+        records[moved.index].chunk = chunk;
+        records[moved.index].row = row;
+    }
+
+    if (--archetype.chunks[lastChunk].count == 0) archetype.chunks.pop_back();
+}
+
+void EcsWorld::moveEntity(uint32_t index, ComponentMask mask)
+{
+    EntityRecord old = records[index];
+    int target = findArchetype(mask);
+    insertRow(index, target);
+
+    const Archetype& from = archetypes[old.archetype];
+    const Archetype& to = archetypes[target];
+    for (size_t i = 0; i < to.components.size(); i++)
+    {
+        int id = to.components[i];
+        if (from.offsets[id] < 0) continue;
+        std::memcpy(component(records[index], id), component(old, id), to.sizes[id]);
+    }
+
+    removeRow(old.archetype, old.chunk, old.row);
+}
+
+bool EcsWorld::alive(Entity entity) const
+{
+    return entity.index < records.size() && records[entity.index].generation == entity.generation && records[entity.index].archetype >= 0;
+}
+
+void EcsWorld::destroy(Entity entity)
+{
+    if (!alive(entity)) return;
+
+    EntityRecord& record = records[entity.index];
+    removeRow(record.archetype, record.chunk, record.row);
+
+    record.archetype = -1;
+    record.generation++;
+    freeIndices.push_back(entity.index);
+    liveCount--;
+}
+
+void SystemSchedule::add(ComponentMask reads, ComponentMask writes, const std::function<void(EcsWorld&)>& system)
+{
+    //A system goes one phase after the last system it conflicts with (write/write or read/write on a component).
+    int phase = 0;
+    for (size_t p = 0; p < phases.size(); p++)
+    {
+        for (size_t i = 0; i < phases[p].size(); i++)
+        {
+            const System& other = systems[phases[p][i]];
+            bool conflict = (writes & (other.reads | other.writes)) || (reads & other.writes);
+            if (conflict) phase = (int)p + 1;
+        }
+    }
+
+    systems.push_back({ reads, writes, system });
+    if (phase == (int)phases.size()) phases.push_back(std::vector<int>());
+    phases[phase].push_back((int)systems.size() - 1);
+}
+
+void SystemSchedule::run(EcsWorld& world)
+{
+    for (size_t p = 0; p < phases.size(); p++)
+    {
+        const std::vector<int>& phase = phases[p];
+        parallelFor((int)phase.size(), 1, [&](int begin, int end)
+        {
+            for (int i = begin; i < end; i++) systems[phase[i]].run(world);
+        });
+    }
+}
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Parallel.h"
+
+//Archetype based entity component system.
+//Entities with the same set of components share an archetype, which stores them in fixed size chunks with one
+//array per component (SoA), so a query walks plain arrays chunk after chunk.
+//Components are moved around with memcpy and have to be trivially copyable.
+
+typedef uint64_t ComponentMask;
+//One mask bit per component type, registering more types than this aborts.
+const int MaxComponentTypes = 64;
+
+//Index into the entity table plus the generation it was created in, stale handles stop being alive().
+struct Entity
+{
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const Entity& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const Entity& other) const { return !(*this == other); }
+};
+
+const Entity NullEntity = { 0xffffffffu, 0 };
+
+namespace ecs_detail
+{
+    int registerComponent(int size);
+    int componentSize(int id);
+
+    template<typename T>
+    struct ComponentType
+    {
+        static int id()
+        {
+            static const int value = registerComponent((int)sizeof(T));
+            return value;
+        }
+    };
+}
+
+template<typename T>
+int componentId()
+{
+    static_assert(std::is_trivially_copyable<T>::value, "Components are moved with memcpy.");
+    static_assert(alignof(T) <= 16, "Component arrays are only 16 byte aligned.");
+    return ecs_detail::ComponentType<T>::id();
+}
+
+template<typename... C>
+ComponentMask componentMask()
+{
+    ComponentMask mask = 0;
+    int expand[] = { 0, (mask |= (ComponentMask)1 << componentId<C>(), 0)... };
+    (void)expand;
+    return mask;
+}
+
+struct EcsChunk
+{
+    std::unique_ptr<unsigned char[]> data;
+    int count = 0;
+};
+
+struct Archetype
+{
+    ComponentMask mask = 0;
+    std::vector<int> components;
+    int capacity = 0;                       //Entities per chunk.
+    int entityOffset = 0;
+    int offsets[MaxComponentTypes];         //Start of every component array inside a chunk, -1 if not present.
+    int sizes[MaxComponentTypes];
+    std::vector<EcsChunk> chunks;           //All full except the last one.
+
+    unsigned char* column(int chunk, int component) const { return chunks[chunk].data.get() + offsets[component]; }
+    Entity* entities(int chunk) const { return (Entity*)(chunks[chunk].data.get() + entityOffset); }
+};
+
+class EcsWorld
+{
+public:
+    static const int ChunkBytes = 16 * 1024;
+
+    EcsWorld();
+
+    Entity create();
+
+    template<typename... C>
+    Entity create(const C&... components);
+
+    void destroy(Entity entity);
+    bool alive(Entity entity) const;
+
+    //add/remove move the entity to another archetype, don't call them (or create/destroy) from inside a query.
+    template<typename T>
+    void add(Entity entity, const T& component);
+
+    template<typename T>
+    void remove(Entity entity);
+
+    //nullptr if the entity is dead or has no T.
+    template<typename T>
+    T* get(Entity entity);
+
+    //function(count, entities, C* arrays...) for every chunk that has all of C.
+    template<typename... C, typename Function>
+    void forEachChunk(Function function);
+
+    //function(entity, C&...) for every entity that has all of C.
+    template<typename... C, typename Function>
+    void forEach(Function function);
+
+    //Same as forEachChunk, with the chunks spread over the parallelFor threads.
+    template<typename... C, typename Function>
+    void parallelForEachChunk(Function function);
+
+    int entityCount() const { return liveCount; }
+    int archetypeCount() const { return (int)archetypes.size(); }
+
+private:
+    struct EntityRecord
+    {
+        uint32_t generation;
+        int archetype;
+        int chunk;
+        int row;
+    };
+
+    int findArchetype(ComponentMask mask);
+    Entity allocateEntity(ComponentMask mask);
+    void insertRow(uint32_t index, int archetype);
+    void removeRow(int archetype, int chunk, int row);
+    void moveEntity(uint32_t index, ComponentMask mask);
+    void* component(const EntityRecord& record, int id) const;
+
+    std::vector<Archetype> archetypes;
+    std::unordered_map<ComponentMask, int> archetypeLookup;
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> freeIndices;
+    int liveCount = 0;
+};
+
+//Systems declare which components they read and write. Systems that don't conflict run at the same time,
+//conflicting ones keep the order they were added in.
+class SystemSchedule
+{
+public:
+    void add(ComponentMask reads, ComponentMask writes, const std::function<void(EcsWorld&)>& system);
+
+    void run(EcsWorld& world);
+
+    int phaseCount() const { return (int)phases.size(); }
+
+private:
+    struct System
+    {
+        ComponentMask reads;
+        ComponentMask writes;
+        std::function<void(EcsWorld&)> run;
+    };
+
+    std::vector<System> systems;
+    std::vector<std::vector<int>> phases;
+};
+
+template<typename... C>
+Entity EcsWorld::create(const C&... components)
+{
+    Entity entity = allocateEntity(componentMask<C...>());
+    const EntityRecord& record = records[entity.index];
+
+    int expand[] = { 0, (std::memcpy(component(record, componentId<C>()), &components, sizeof(C)), 0)... };
+    (void)expand;
+    return entity;
+}
+
+template<typename T>
+void EcsWorld::add(Entity entity, const T& value)
+{
+    if (!alive(entity)) return;
+
+    int id = componentId<T>();
+    ComponentMask mask = archetypes[records[entity.index].archetype].mask;
+    if (!(mask & ((ComponentMask)1 << id))) moveEntity(entity.index, mask | ((ComponentMask)1 << id));
+
+    std::memcpy(component(records[entity.index], id), &value, sizeof(T));
+}
+
+template<typename T>
+void EcsWorld::remove(Entity entity)
+{
+    if (!alive(entity)) return;
+
+    ComponentMask bit = (ComponentMask)1 << componentId<T>();
+    ComponentMask mask = archetypes[records[entity.index].archetype].mask;
+    if (mask & bit) moveEntity(entity.index, mask & ~bit);
+}
+
+template<typename T>
+T* EcsWorld::get(Entity entity)
+{
+    if (!alive(entity)) return nullptr;
+
+    const EntityRecord& record = records[entity.index];
+    int id = componentId<T>();
+    if (archetypes[record.archetype].offsets[id] < 0) return nullptr;
+    return (T*)component(record, id);
+}
+
+template<typename... C, typename Function>
+void EcsWorld::forEachChunk(Function function)
+{
+    ComponentMask mask = componentMask<C...>();
+    for (size_t a = 0; a < archetypes.size(); a++)
+    {
+        const Archetype& archetype = archetypes[a];
+        if ((archetype.mask & mask) != mask) continue;
+
+        for (int chunk = 0; chunk < (int)archetype.chunks.size(); chunk++)
+        {
+            function(archetype.chunks[chunk].count, archetype.entities(chunk), (C*)archetype.column(chunk, componentId<C>())...);
+        }
+    }
+}
+
+template<typename... C, typename Function>
+void EcsWorld::forEach(Function function)
+{
+    forEachChunk<C...>([&](int count, const Entity* entities, C*... arrays)
+    {
+        for (int i = 0; i < count; i++) function(entities[i], arrays[i]...);
+    });
+}
+
+template<typename... C, typename Function>
+void EcsWorld::parallelForEachChunk(Function function)
+{
+    ComponentMask mask = componentMask<C...>();
+
+    struct ChunkRef
+    {
+        const Archetype* archetype;
+        int chunk;
+    };
+
+    std::vector<ChunkRef> matches;
+    for (size_t a = 0; a < archetypes.size(); a++)
+    {
+        if ((archetypes[a].mask & mask) != mask) continue;
+        for (int chunk = 0; chunk < (int)archetypes[a].chunks.size(); chunk++) matches.push_back({ &archetypes[a], chunk });
+    }
+
+    parallelFor((int)matches.size(), 1, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            const Archetype& archetype = *matches[i].archetype;
+            int chunk = matches[i].chunk;
+            function(archetype.chunks[chunk].count, archetype.entities(chunk), (C*)archetype.column(chunk, componentId<C>())...);
+        }
+    });
+}
@@ -0,0 +1,222 @@
+#include "ImageInfo.h"
+
+#include "Parallel.h"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <climits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int FilesPerChunk = 64;
+
+    //Headers, and a JPEG's markers up to its frame header, are nearly always within the first few KB. Reading
+    //that much is cheaper than mapping a small file, only when it isn't enough is the whole file mapped.
+    const int HeadBytes = 4096;
+
+    //Read only view of a whole file, empty when it can't be opened or mapped.
+    //Pages are only read from disk when touched, and read ahead is turned off so touching the header reads just that.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const char* path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const unsigned char* data() const { return view; }
+        uint64_t size() const { return length; }
+
+    private:
+        const unsigned char* view = nullptr;
+        uint64_t length = 0;
+#ifdef _WIN32
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+#endif
+    };
+
+#ifdef _WIN32
+    MappedFile::MappedFile(const char* path)
+    {
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) return;
+
+        view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (view != nullptr) length = (uint64_t)fileSize.QuadPart;
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (view != nullptr) UnmapViewOfFile(view);
+        if (mapping != nullptr) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    }
+#else
+    MappedFile::MappedFile(const char* path)
+    {
+        //Opening a FIFO for reading blocks until a writer shows up, unless it's non-blocking.
+        int fd = open(path, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) return;
+
+        struct stat status;
+        if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0)
+        {
+            void* p = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED)
+            {
+                madvise(p, (size_t)status.st_size, MADV_RANDOM);
+                view = (const unsigned char*)p;
+                length = (uint64_t)status.st_size;
+            }
+        }
+
+        //The mapping stays valid without the descriptor.
+        close(fd);
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (view != nullptr) munmap((void*)view, (size_t)length);
+    }
+#endif
+
+    //Reads up to HeadBytes from the start of the file into head, -1 when it can't be opened or read or isn't a
+    //regular file.
+    int readHead(const char* path, unsigned char* head)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return -1;
+
+        DWORD length = 0;
+        BOOL read = ReadFile(file, head, HeadBytes, &length, nullptr);
+        CloseHandle(file);
+        return read ? (int)length : -1;
+#else
+        //Non-blocking, so a FIFO among the paths can't hang the scan, it's dropped by the check below.
+        int fd = open(path, O_RDONLY | O_NONBLOCK);
+        if (fd < 0) return -1;
+
+        struct stat status;
+        ssize_t length = -1;
+        if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode)) length = read(fd, head, HeadBytes);
+        close(fd);
+        return (int)length;
+#endif
+    }
+
+    ImageInfo readInfo(const unsigned char* data, uint64_t size)
+    {
+        ImageInfo info = { 0, 0, 0 };
+
+        //Headers are at the start, so a file too big for stb_image's int length is cut.
+        int length = size < (uint64_t)INT_MAX ? (int)size : INT_MAX;
+        int x, y, channels;
+        if (data != nullptr && length > 0 && stbi_info_from_memory(data, length, &x, &y, &channels))
+        {
+            info.width = (uint32_t)x;
+            info.height = (uint32_t)y;
+            info.channels = (uint8_t)channels;
+        }
+        return info;
+    }
+}
+
+std::vector<ImageInfo> scanImageInfo(const std::vector<std::string>& paths)
+{
+    std::vector<ImageInfo> infos(paths.size());
+
+    parallelFor((int)paths.size(), FilesPerChunk, [&](int begin, int end)
+    {
+        unsigned char head[HeadBytes];
+        for (int i = begin; i < end; i++)
+        {
+            int length = readHead(paths[i].c_str(), head);
+            infos[i] = readInfo(head, length > 0 ? (uint64_t)length : 0);
+
+            //Files whose header reaches past the head (a JPEG with a big EXIF block) are mapped whole.
+            if (infos[i].channels == 0 && length == HeadBytes)
+            {
+                MappedFile file(paths[i].c_str());
+                infos[i] = readInfo(file.data(), file.size());
+            }
+        }
+    });
+
+    return infos;
+}
+
+std::vector<ImageInfo> scanImageDirectory(const std::string& directory, std::vector<std::string>& names)
+{
+    names.clear();
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &found);
+    if (search != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (!(found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(found.cFileName);
+        } while (FindNextFileA(search, &found));
+        FindClose(search);
+    }
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (dir != nullptr)
+    {
+        //Symbolic links and entries of unknown type are kept, readHead skips the ones that aren't regular files.
+        for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir))
+        {
+            if (entry->d_type == DT_REG || entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN) names.push_back(entry->d_name);
+        }
+        closedir(dir);
+    }
+#endif
+
+    std::sort(names.begin(), names.end());
+
+    std::vector<std::string> paths(names.size());
+    for (size_t i = 0; i < names.size(); i++) paths[i] = directory + "/" + names[i];
+
+    return scanImageInfo(paths);
+}
+
+std::vector<ImageInfo> scanPackImageInfo(const std::string& packPath, const std::vector<PackRange>& ranges)
+{
+    std::vector<ImageInfo> infos(ranges.size());
+    MappedFile pack(packPath.c_str());
+
+    parallelFor((int)ranges.size(), FilesPerChunk, [&](int begin, int end)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            //Ranges reaching past the end of the pack are cut, ones starting past it are empty.
+            uint64_t offset = ranges[i].offset < pack.size() ? ranges[i].offset : pack.size();
+            uint64_t size = ranges[i].size < pack.size() - offset ? ranges[i].size : pack.size() - offset;
+            infos[i] = readInfo(pack.data() != nullptr ? pack.data() + offset : nullptr, size);
+        }
+    });
+
+    return infos;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Size and channel count of many image files at once, read from their headers without decoding anything.
+//Only the first few KB of a file are read (the whole file is mapped when its header reaches further),
+//and files are scanned in parallel (parallelFor).
+
+struct ImageInfo
+{
+    uint32_t width;
+    uint32_t height;
+    uint8_t channels;   //0 when the file is missing or not an image stb_image reads.
+};
+
+//One entry per path, in the same order.
+std::vector<ImageInfo> scanImageInfo(const std::vector<std::string>& paths);
+
+//Every file directly inside directory (not subdirectories, FIFOs or devices), sorted by name. Their names (without the directory) are put in names.
+std::vector<ImageInfo> scanImageDirectory(const std::string& directory, std::vector<std::string>& names);
+
+//Images stored inside one pack file, at the given byte ranges. The pack is mapped once for all of them.
+struct PackRange
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+std::vector<ImageInfo> scanPackImageInfo(const std::string& packPath, const std::vector<PackRange>& ranges);
@@ -0,0 +1,347 @@
+#include "JobSystem.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <thread>
+
+struct Job
+{
+    JobFunction function;
+    JobCounter* counter;
+};
+
+namespace
+{
+    //Chase-Lev deque (Le, Pop, Cohen, Zappa Nardelli, "Correct and efficient work-stealing for weak memory models").
+    //Fixed capacity, push returns false when full and the caller falls back to the shared queue.
+    class WorkStealingDeque
+    {
+    public:
+        static const int64_t Capacity = 4096;
+
+        WorkStealingDeque() : buffer(new std::atomic<Job*>[Capacity])
+        {
+        }
+
+        //Owner only.
+        bool push(Job* job)
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= Capacity) return false;
+
+            buffer[b & (Capacity - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        //Owner only, newest job first.
+        Job* pop()
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+
+            if (t > b)
+            {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = buffer[b & (Capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b)
+            {
+                //Last job, race the thieves for it.
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        //Any thread, oldest job first.
+        Job* steal()
+        {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) return nullptr;
+
+            Job* job = buffer[t & (Capacity - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr;
+            return job;
+        }
+
+    private:
+        std::atomic<int64_t> top{ 0 };
+        std::atomic<int64_t> bottom{ 0 };
+        std::unique_ptr<std::atomic<Job*>[]> buffer;
+    };
+
+    struct Scheduler
+    {
+        std::vector<std::unique_ptr<WorkStealingDeque>> deques;     //[0] is the main thread.
+        std::vector<std::thread> threads;
+        std::atomic<bool> running{ false };
+
+        //Jobs pushed from threads without a deque, or when a deque is full.
+        std::mutex sharedMutex;
+        std::deque<Job*> shared;
+
+        std::mutex mainMutex;
+        std::vector<Job*> mainThreadJobs;
+
+        //Queued but not yet picked up, used to decide when to split work and when to sleep.
+        std::atomic<int> queued{ 0 };
+        std::mutex sleepMutex;
+        std::condition_variable wake;
+        std::atomic<int> sleeping{ 0 };
+    };
+
+    Scheduler scheduler;
+
+    //Index of this thread's deque, -1 for threads that aren't part of the job system.
+    thread_local int threadIndex = -1;
+    thread_local uint32_t stealSeed = 0;
+
+    void finishJob(JobCounter* counter);
+
+    void queueJob(Job* job)
+    {
+        scheduler.queued++;
+        if (threadIndex < 0 || !scheduler.deques[threadIndex]->push(job))
+        {
+            std::lock_guard<std::mutex> lock(scheduler.sharedMutex);
+            scheduler.shared.push_back(job);
+        }
+
+        if (scheduler.sleeping.load() > 0) scheduler.wake.notify_one();
+    }
+
+    void runJob(Job* job)
+    {
+        job->function();
+        JobCounter* counter = job->counter;
+        delete job;
+        finishJob(counter);
+    }
+
+    void finishJob(JobCounter* counter)
+    {
+        if (!counter) return;
+
+        //Decrement under the lock: waitForCounter takes it once more before returning, so the counter
+        //can't go out of scope while we still touch it. Reaching zero releases the jobs waiting for it.
+        std::vector<Job*> released;
+        {
+            std::lock_guard<std::mutex> lock(counter->mutex);
+            if (--counter->value == 0) released.swap(counter->waiting);
+        }
+        for (size_t i = 0; i < released.size(); i++) queueJob(released[i]);
+    }
+
+    Job* findJob()
+    {
+        Job* job = nullptr;
+        if (threadIndex >= 0) job = scheduler.deques[threadIndex]->pop();
+
+        if (!job)
+        {
+            std::lock_guard<std::mutex> lock(scheduler.sharedMutex);
+            if (!scheduler.shared.empty())
+            {
+                job = scheduler.shared.front();
+                scheduler.shared.pop_front();
+            }
+        }
+
+        //Steal from a random victim, then everyone else in order.
+        int count = (int)scheduler.deques.size();
+        if (!job && count > 0)
+        {
+            stealSeed = stealSeed * 1664525u + 1013904223u;
+            int first = (int)((stealSeed >> 16) % (uint32_t)count);
+            for (int i = 0; i < count && !job; i++)
+            {
+                int victim = (first + i) % count;
+                if (victim != threadIndex) job = scheduler.deques[victim]->steal();
+            }
+        }
+
+        if (job) scheduler.queued--;
+        return job;
+    }
+
+    bool runMainThreadJob()
+    {
+        Job* job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(scheduler.mainMutex);
+            if (!scheduler.mainThreadJobs.empty())
+            {
+                job = scheduler.mainThreadJobs.front();
+                scheduler.mainThreadJobs.erase(scheduler.mainThreadJobs.begin());
+            }
+        }
+
+        if (job) runJob(job);
+        return job != nullptr;
+    }
+
+    void workerLoop(int index)
+    {
+        threadIndex = index;
+        stealSeed = (uint32_t)index * 2654435761u;
+
+        while (scheduler.running.load())
+        {
+            Job* job = findJob();
+            if (job)
+            {
+                runJob(job);
+                continue;
+            }
+
+            //Nothing to do: sleep until a job is queued. The timeout covers a wake up sent just before we slept.
+            std::unique_lock<std::mutex> lock(scheduler.sleepMutex);
+            scheduler.sleeping++;
+            if (scheduler.queued.load() == 0 && scheduler.running.load())
+            {
+                scheduler.wake.wait_for(lock, std::chrono::milliseconds(1));
+            }
+            scheduler.sleeping--;
+        }
+    }
+
+    void runRange(int begin, int end, int grainSize, const std::function<void(int, int)>& body, JobCounter& counter)
+    {
+        while (begin < end)
+        {
+            //Somebody is idle, hand them the upper half of what's left. The split stays on a multiple of grainSize,
+            //so the chunks body sees are the same as a serial parallelFor's however the range got divided.
+            if (end - begin >= 2 * grainSize && scheduler.queued.load(std::memory_order_relaxed) < jobThreadCount() - 1)
+            {
+                int middle = begin + (end - begin) / grainSize / 2 * grainSize;
+                int splitEnd = end;
+                scheduleJob([middle, splitEnd, grainSize, &body, &counter]()
+                {
+                    runRange(middle, splitEnd, grainSize, body, counter);
+                }, &counter);
+                end = middle;
+            }
+
+            int stop = end - begin > grainSize ? begin + grainSize : end;
+            body(begin, stop);
+            begin = stop;
+        }
+    }
+}
+
+void startJobSystem(int workers)
+{
+    if (scheduler.running.load()) return;
+
+    if (workers <= 0)
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        workers = cores > 1 ? cores - 1 : 0;
+    }
+
+    scheduler.deques.clear();
+    for (int i = 0; i <= workers; i++) scheduler.deques.emplace_back(new WorkStealingDeque());
+
+    threadIndex = 0;
+    scheduler.running = true;
+    for (int i = 1; i <= workers; i++) scheduler.threads.emplace_back(workerLoop, i);
+}
+
+void stopJobSystem()
+{
+    if (!scheduler.running.load()) return;
+
+    scheduler.running = false;
+    scheduler.wake.notify_all();
+    for (size_t i = 0; i < scheduler.threads.size(); i++) scheduler.threads[i].join();
+
+    scheduler.threads.clear();
+    scheduler.deques.clear();
+    threadIndex = -1;
+}
+
+bool jobSystemRunning()
+{
+    return scheduler.running.load();
+}
+
+int jobThreadCount()
+{
+    return (int)scheduler.deques.size();
+}
+
+bool isMainThread()
+{
+    return threadIndex == 0;
+}
+
+void scheduleJob(const JobFunction& function, JobCounter* counter, JobCounter* dependency)
+{
+    if (counter) counter->value++;
+
+    Job* job = new Job{ function, counter };
+
+    if (dependency)
+    {
+        //Checked under the counter's lock, finishJob takes the waiting list under the same lock after reaching zero.
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (dependency->value.load() > 0)
+        {
+            dependency->waiting.push_back(job);
+            return;
+        }
+    }
+
+    queueJob(job);
+}
+
+void scheduleMainThreadJob(const JobFunction& function, JobCounter* counter)
+{
+    if (counter) counter->value++;
+
+    std::lock_guard<std::mutex> lock(scheduler.mainMutex);
+    scheduler.mainThreadJobs.push_back(new Job{ function, counter });
+}
+
+void runMainThreadJobs()
+{
+    while (runMainThreadJob())
+    {
+    }
+}
+
+void waitForCounter(JobCounter& counter)
+{
+    while (counter.value.load() > 0)
+    {
+        if (isMainThread() && runMainThreadJob()) continue;
+
+        Job* job = findJob();
+        if (job) runJob(job);
+        else std::this_thread::yield();
+    }
+
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void jobParallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& body)
+{
+    if (count <= 0) return;
+    if (grainSize < 1) grainSize = 1;
+
+    JobCounter counter;
+    runRange(0, count, grainSize, body, counter);
+    waitForCounter(counter);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+//Work stealing job scheduler.
+//Every worker (and the main thread) owns a Chase-Lev deque: it pushes and pops jobs at the bottom, idle threads
+//steal from the top of someone else's. Jobs run to completion (no fibers), waiting threads run other jobs meanwhile.
+
+struct Job;
+
+//Counts unfinished jobs. Jobs can be made to wait for a counter to reach zero before they are queued.
+struct JobCounter
+{
+    std::atomic<int> value{ 0 };
+
+    std::mutex mutex;
+    std::vector<Job*> waiting;
+};
+
+typedef std::function<void()> JobFunction;
+
+//workers = threads besides the calling thread, which becomes the main thread. 0 = one per remaining core.
+void startJobSystem(int workers = 0);
+void stopJobSystem();
+bool jobSystemRunning();
+
+//Threads executing jobs, including the main thread.
+int jobThreadCount();
+bool isMainThread();
+
+//counter (optional) is incremented now and decremented when the job has run.
+//If dependency is given the job is only queued once that counter has reached zero.
+void scheduleJob(const JobFunction& function, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+
+//For work GLFW only allows on the main thread (window, input and event calls). Runs in runMainThreadJobs or while
+//the main thread waits. Not for GL calls: once the RenderThread runs the context is current on it, not on the main
+//thread, so GL work has to be recorded into its command buffers.
+void scheduleMainThreadJob(const JobFunction& function, JobCounter* counter = nullptr);
+void runMainThreadJobs();
+
+//Runs other jobs until counter reaches zero.
+void waitForCounter(JobCounter& counter);
+
+//body(begin, end) over [0, count). The range starts as one piece and is split in half whenever some thread
+//is out of work. Splits fall on multiples of grainSize and body gets grainSize items at a time (the last chunk
+//less), so every chunk starts at a multiple of grainSize.
+void jobParallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& body);
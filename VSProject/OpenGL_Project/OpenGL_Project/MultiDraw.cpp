@@ -0,0 +1,257 @@
+#include "MultiDraw.h"
+
+#include <GLFW/glfw3.h>
+
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+namespace
+{
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+}
+
+bool loadMultiDrawIndirect()
+{
+    multiDrawElementsIndirect = nullptr;
+
+    //baseInstance is only read once ARB_base_instance is there, before that the field had to be 0.
+    if (glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance"))
+    {
+        multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)glfwGetProcAddress("glMultiDrawElementsIndirect");
+    }
+
+    return multiDrawElementsIndirect != nullptr;
+}
+
+bool multiDrawIndirectSupported()
+{
+    return multiDrawElementsIndirect != nullptr;
+}
+
+void recordAllocationMoves(CommandBuffer& commands, GLuint buffer, GLuint scratch, const std::vector<AllocationMove>& moves, uint32_t unitSize)
+{
+    for (size_t i = 0; i < moves.size(); i++)
+    {
+        uint32_t from = moves[i].from * unitSize;
+        uint32_t to = moves[i].to * unitSize;
+        uint32_t size = moves[i].size * unitSize;
+        uint32_t distance = from - to;
+
+        bool direct = distance >= size || distance >= MoveScratchBytes;
+        uint32_t piece = direct ? distance : MoveScratchBytes;
+        for (uint32_t done = 0; done < size; done += piece)
+        {
+            uint32_t bytes = size - done < piece ? size - done : piece;
+            if (direct)
+            {
+                commands.copyBuffer(buffer, buffer, from + done, to + done, bytes);
+            }
+            else
+            {
+                commands.copyBuffer(buffer, scratch, from + done, 0, bytes);
+                commands.copyBuffer(scratch, buffer, 0, to + done, bytes);
+            }
+        }
+    }
+}
+
+void MeshBuffers::create(const PackedVertexLayout& layout, int vertexCapacity, int indexCapacity)
+{
+    vertexLayout = layout;
+    vertexSpace.reset((uint32_t)vertexCapacity);
+    indexSpace.reset((uint32_t)indexCapacity);
+
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexCapacity * layout.stride, nullptr, GL_STATIC_DRAW);
+
+    //Bound outside a VAO so no VAO picks it up by accident.
+    glBindVertexArray(0);
+    glGenBuffers(1, &indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &scratchBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, scratchBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, MoveScratchBytes, nullptr, GL_STREAM_COPY);
+}
+
+void MeshBuffers::destroy()
+{
+    glDeleteBuffers(1, &vertexBuffer);
+    glDeleteBuffers(1, &indexBuffer);
+    glDeleteBuffers(1, &scratchBuffer);
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    scratchBuffer = 0;
+    vertexSpace.reset(0);
+    indexSpace.reset(0);
+}
+
+MeshHandle MeshBuffers::addMesh(const void* vertices, int vertexCount, const GLuint* indices, int indexCount)
+{
+    MeshHandle mesh = { vertexSpace.allocate((uint32_t)vertexCount), indexSpace.allocate((uint32_t)indexCount) };
+    if (mesh.vertices == NullAllocation || mesh.indices == NullAllocation)
+    {
+        vertexSpace.release(mesh.vertices);
+        indexSpace.release(mesh.indices);
+        return NullMesh;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)vertexSpace.offset(mesh.vertices) * vertexLayout.stride, (GLsizeiptr)vertexCount * vertexLayout.stride, vertices);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)indexSpace.offset(mesh.indices) * sizeof(GLuint), (GLsizeiptr)indexCount * sizeof(GLuint), indices);
+
+    return mesh;
+}
+
+void MeshBuffers::releaseMesh(MeshHandle mesh)
+{
+    vertexSpace.release(mesh.vertices);
+    indexSpace.release(mesh.indices);
+}
+
+bool MeshBuffers::valid(MeshHandle mesh) const
+{
+    return vertexSpace.valid(mesh.vertices) && indexSpace.valid(mesh.indices);
+}
+
+MeshRange MeshBuffers::range(MeshHandle mesh) const
+{
+    MeshRange range;
+    range.baseVertex = (GLint)vertexSpace.offset(mesh.vertices);
+    range.firstIndex = indexSpace.offset(mesh.indices);
+    range.indexCount = (GLsizei)indexSpace.size(mesh.indices);
+    return range;
+}
+
+uint32_t MeshBuffers::defragment(CommandBuffer& commands, uint32_t maxBytes)
+{
+    uint32_t stride = (uint32_t)vertexLayout.stride;
+    uint32_t moved = 0;
+
+    moves.clear();
+    moved += vertexSpace.defragment(maxBytes / stride, moves) * stride;
+    recordAllocationMoves(commands, vertexBuffer, scratchBuffer, moves, stride);
+
+    moves.clear();
+    moved += indexSpace.defragment(maxBytes / sizeof(GLuint), moves) * (uint32_t)sizeof(GLuint);
+    recordAllocationMoves(commands, indexBuffer, scratchBuffer, moves, (uint32_t)sizeof(GLuint));
+
+    return moved;
+}
+
+void MeshBuffers::bindToVertexArray() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    applyVertexLayout(vertexLayout);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+}
+
+void IndirectBatch::create(const MeshBuffers& meshes, int draws)
+{
+    maxDraws = draws;
+    writing = 0;
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    meshes.bindToVertexArray();
+
+    glGenBuffers(1, &instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)draws * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+
+    //A mat4 attribute takes four consecutive locations, one column each.
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(InstanceModelLocation + column);
+        glVertexAttribDivisor(InstanceModelLocation + column, 1);
+    }
+    pointInstanceAttribute(0);
+
+    glBindVertexArray(0);
+
+    if (multiDrawIndirectSupported())
+    {
+        glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)draws * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+}
+
+void IndirectBatch::destroy()
+{
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &instanceBuffer);
+    if (indirectBuffer != 0) glDeleteBuffers(1, &indirectBuffer);
+    vao = 0;
+    instanceBuffer = 0;
+    indirectBuffer = 0;
+}
+
+void IndirectBatch::begin(int drawCount)
+{
+    if (drawCount > maxDraws) drawCount = maxDraws;
+    frames[writing].draws.resize(drawCount);
+    frames[writing].models.resize(drawCount);
+}
+
+void IndirectBatch::record(CommandBuffer& commands)
+{
+    commands.drawIndirectBatch(this, writing);
+    writing ^= 1;
+}
+
+void IndirectBatch::pointInstanceAttribute(GLuint firstInstance) const
+{
+    //The instance buffer must be bound to GL_ARRAY_BUFFER.
+    size_t base = (size_t)firstInstance * sizeof(glm::mat4);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(InstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(base + column * sizeof(glm::vec4)));
+    }
+}
+
+void IndirectBatch::draw(int frame) const
+{
+    const Frame& f = frames[frame];
+    GLsizei count = (GLsizei)f.draws.size();
+    if (count == 0) return;
+
+    glBindVertexArray(vao);
+
+    //Orphan and refill, the driver hands out fresh memory instead of waiting for last frame's draws.
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxDraws * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)count * sizeof(glm::mat4), f.models.data());
+
+    if (multiDrawElementsIndirect != nullptr && indirectBuffer != 0)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, (GLsizeiptr)maxDraws * sizeof(DrawElementsIndirectCommand), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, (GLsizeiptr)count * sizeof(DrawElementsIndirectCommand), f.draws.data());
+
+        multiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, count, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    else
+    {
+        //No base instance before GL 4.2, so the matrix attribute is moved to each draw's entry instead.
+        for (GLsizei i = 0; i < count; i++)
+        {
+            const DrawElementsIndirectCommand& d = f.draws[i];
+            pointInstanceAttribute(d.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, (void*)((size_t)d.firstIndex * sizeof(GLuint)), d.instanceCount, d.baseVertex);
+        }
+        pointInstanceAttribute(0);
+    }
+
+    glBindVertexArray(0);
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "RenderCommands.h"
+#include "TlsfAllocator.h"
+#include "VertexPacking.h"
+
+//Many meshes in shared vertex/index buffers, drawn with one glMultiDrawElementsIndirect per batch.
+//The per draw model matrix is an instanced attribute (locations 3 to 6) picked by the command's baseInstance.
+//Without ARB_multi_draw_indirect + ARB_base_instance the batch loops glDrawElementsBaseVertex instead,
+//moving the instance attribute to every draw's matrix.
+
+//Layout glMultiDrawElementsIndirect reads.
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+const GLuint InstanceModelLocation = 3;
+
+//Looks up glMultiDrawElementsIndirect, the context has to be current. True when the indirect path is available.
+bool loadMultiDrawIndirect();
+bool multiDrawIndirectSupported();
+
+//Where a mesh lives inside the MeshBuffers.
+struct MeshRange
+{
+    GLint baseVertex;
+    GLuint firstIndex;
+    GLsizei indexCount;
+};
+
+//A mesh inside the MeshBuffers, stays valid across defragment until releaseMesh.
+struct MeshHandle
+{
+    AllocationHandle vertices;
+    AllocationHandle indices;
+};
+
+const MeshHandle NullMesh = { NullAllocation, NullAllocation };
+
+//Size of the staging buffer for moves that overlap their old place by more than a little.
+const uint32_t MoveScratchBytes = 64 * 1024;
+
+//Records the copies for allocator moves of unitSize bytes per unit. Copies within a buffer must not
+//overlap, so a move that does is copied front to back in pieces no longer than the distance moved,
+//or through scratch (MoveScratchBytes long) when that distance is short and would mean lots of tiny copies.
+void recordAllocationMoves(CommandBuffer& commands, GLuint buffer, GLuint scratch, const std::vector<AllocationMove>& moves, uint32_t unitSize);
+
+//One vertex buffer and one index buffer shared by every mesh of a vertex layout. Space inside them is handed
+//out by a TlsfAllocator each (in vertices and in indices), so meshes can come and go, and defragment packs
+//them back together a few at a time.
+class MeshBuffers
+{
+public:
+    void create(const PackedVertexLayout& layout, int vertexCapacity, int indexCapacity);
+    void destroy();
+
+    //GL thread. Copies vertexCount packed vertices and their indices (relative to the mesh) into the buffers.
+    //NullMesh when the mesh doesn't fit.
+    MeshHandle addMesh(const void* vertices, int vertexCount, const GLuint* indices, int indexCount);
+    void releaseMesh(MeshHandle mesh);
+
+    bool valid(MeshHandle mesh) const;
+    //Current place of the mesh, changes when defragment moves it.
+    MeshRange range(MeshHandle mesh) const;
+
+    //Moves meshes down into the holes released meshes left, at most about maxBytes per buffer.
+    //The copies are recorded into commands, so this has to run before the frame's draws are recorded.
+    //Returns the bytes moved, 0 once both buffers are packed.
+    uint32_t defragment(CommandBuffer& commands, uint32_t maxBytes);
+
+    //Binds both buffers and sets up the vertex attributes on the bound VAO.
+    void bindToVertexArray() const;
+
+    const PackedVertexLayout& layout() const { return vertexLayout; }
+    int meshCount() const { return vertexSpace.allocationCount(); }
+
+private:
+    PackedVertexLayout vertexLayout;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    GLuint scratchBuffer = 0;
+    TlsfAllocator vertexSpace;
+    TlsfAllocator indexSpace;
+    std::vector<AllocationMove> moves;
+};
+
+//Draw list of one MeshBuffers, double buffered like the RenderThread's command buffers:
+//one frame is filled while the render thread draws the other.
+class IndirectBatch
+{
+public:
+    //GL thread, after loadMultiDrawIndirect. Room for maxDraws draws per frame.
+    void create(const MeshBuffers& meshes, int maxDraws);
+    void destroy();
+
+    //Recording thread: sizes the next frame's arrays to drawCount (clamped to maxDraws).
+    //Until record, workers may fill disjoint ranges of draws() and models().
+    void begin(int drawCount);
+    DrawElementsIndirectCommand* draws() { return frames[writing].draws.data(); }
+    glm::mat4* models() { return frames[writing].models.data(); }
+    int drawCount() const { return (int)frames[writing].draws.size(); }
+
+    //Appends the batch to the commands and switches to the other frame's arrays.
+    void record(CommandBuffer& commands);
+
+    //Render thread, through replayCommands: uploads the frame's draws and matrices and draws them.
+    void draw(int frame) const;
+
+private:
+    struct Frame
+    {
+        std::vector<DrawElementsIndirectCommand> draws;
+        std::vector<glm::mat4> models;
+    };
+
+    void pointInstanceAttribute(GLuint firstInstance) const;
+
+    Frame frames[2];
+    int writing = 0;
+    int maxDraws = 0;
+    GLuint vao = 0;
+    GLuint indirectBuffer = 0;
+    GLuint instanceBuffer = 0;
+};
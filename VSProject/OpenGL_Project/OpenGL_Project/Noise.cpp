@@ -0,0 +1,414 @@
+#include "Noise.h"
+
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace
+{
+    //Lane versions of the helpers in glm/detail/_noise.hpp.
+    template<typename T>
+    SIMD_INLINE T fract(T x)
+    {
+        return x - vfloor(x);
+    }
+
+    template<typename T>
+    SIMD_INLINE T mod289(T x)
+    {
+        return x - vfloor(x * T(1.0f / 289.0f)) * T(289.0f);
+    }
+
+    //glm::mod(x, 289), perlin2D and simplex2D use this one instead of mod289.
+    template<typename T>
+    SIMD_INLINE T mod289Divide(T x)
+    {
+        return x - T(289.0f) * vfloor(x / T(289.0f));
+    }
+
+    template<typename T>
+    SIMD_INLINE T permute(T x)
+    {
+        return mod289((x * T(34.0f) + T(1.0f)) * x);
+    }
+
+    template<typename T>
+    SIMD_INLINE T taylorInvSqrt(T r)
+    {
+        return T(1.79284291400159f) - T(0.85373472095314f) * r;
+    }
+
+    template<typename T>
+    SIMD_INLINE T fade(T t)
+    {
+        return (t * t * t) * (t * (t * T(6.0f) - T(15.0f)) + T(10.0f));
+    }
+
+    //glm::step(edge, x)
+    template<typename T>
+    SIMD_INLINE T step(T edge, T x)
+    {
+        return vselect(x < edge, T(0.0f), T(1.0f));
+    }
+
+    template<typename T>
+    SIMD_INLINE T lerp(T a, T b, T t)
+    {
+        return a * (T(1.0f) - t) + b * t;
+    }
+
+    template<typename T>
+    SIMD_INLINE T perlinGradient2D(T hash, T x, T y)
+    {
+        T gx = T(2.0f) * fract(hash / T(41.0f)) - T(1.0f);
+        T gy = vabs(gx) - T(0.5f);
+        gx = gx - vfloor(gx + T(0.5f));
+
+        return taylorInvSqrt(gx * gx + gy * gy) * (gx * x + gy * y);
+    }
+
+    template<typename T>
+    T perlin2D(T x, T y)
+    {
+        T ix0 = vfloor(x);
+        T iy0 = vfloor(y);
+        T fx0 = x - ix0;
+        T fy0 = y - iy0;
+        T fx1 = fx0 - T(1.0f);
+        T fy1 = fy0 - T(1.0f);
+        T ix1 = mod289Divide(ix0 + T(1.0f));
+        T iy1 = mod289Divide(iy0 + T(1.0f));
+        ix0 = mod289Divide(ix0);
+        iy0 = mod289Divide(iy0);
+
+        T px0 = permute(ix0);
+        T px1 = permute(ix1);
+
+        T n00 = perlinGradient2D(permute(px0 + iy0), fx0, fy0);
+        T n10 = perlinGradient2D(permute(px1 + iy0), fx1, fy0);
+        T n01 = perlinGradient2D(permute(px0 + iy1), fx0, fy1);
+        T n11 = perlinGradient2D(permute(px1 + iy1), fx1, fy1);
+
+        T fadeX = fade(fx0);
+        T fadeY = fade(fy0);
+        return T(2.3f) * lerp(lerp(n00, n10, fadeX), lerp(n01, n11, fadeX), fadeY);
+    }
+
+    template<typename T>
+    SIMD_INLINE T perlinGradient3D(T hash, T x, T y, T z)
+    {
+        T gx = hash * T(1.0f / 7.0f);
+        T gy = fract(vfloor(gx) * T(1.0f / 7.0f)) - T(0.5f);
+        gx = fract(gx);
+        T gz = T(0.5f) - vabs(gx) - vabs(gy);
+        T sz = step(gz, T(0.0f));
+        gx = gx - sz * (step(T(0.0f), gx) - T(0.5f));
+        gy = gy - sz * (step(T(0.0f), gy) - T(0.5f));
+
+        return taylorInvSqrt(gx * gx + gy * gy + gz * gz) * (gx * x + gy * y + gz * z);
+    }
+
+    template<typename T>
+    T perlin3D(T x, T y, T z)
+    {
+        T ix0 = vfloor(x);
+        T iy0 = vfloor(y);
+        T iz0 = vfloor(z);
+        T ix1 = mod289(ix0 + T(1.0f));
+        T iy1 = mod289(iy0 + T(1.0f));
+        T iz1 = mod289(iz0 + T(1.0f));
+        T fx0 = x - ix0;
+        T fy0 = y - iy0;
+        T fz0 = z - iz0;
+        T fx1 = fx0 - T(1.0f);
+        T fy1 = fy0 - T(1.0f);
+        T fz1 = fz0 - T(1.0f);
+        ix0 = mod289(ix0);
+        iy0 = mod289(iy0);
+        iz0 = mod289(iz0);
+
+        T px0 = permute(ix0);
+        T px1 = permute(ix1);
+        T p00 = permute(px0 + iy0);
+        T p10 = permute(px1 + iy0);
+        T p01 = permute(px0 + iy1);
+        T p11 = permute(px1 + iy1);
+
+        T n000 = perlinGradient3D(permute(p00 + iz0), fx0, fy0, fz0);
+        T n100 = perlinGradient3D(permute(p10 + iz0), fx1, fy0, fz0);
+        T n010 = perlinGradient3D(permute(p01 + iz0), fx0, fy1, fz0);
+        T n110 = perlinGradient3D(permute(p11 + iz0), fx1, fy1, fz0);
+        T n001 = perlinGradient3D(permute(p00 + iz1), fx0, fy0, fz1);
+        T n101 = perlinGradient3D(permute(p10 + iz1), fx1, fy0, fz1);
+        T n011 = perlinGradient3D(permute(p01 + iz1), fx0, fy1, fz1);
+        T n111 = perlinGradient3D(permute(p11 + iz1), fx1, fy1, fz1);
+
+        T fadeX = fade(fx0);
+        T fadeY = fade(fy0);
+        T fadeZ = fade(fz0);
+        T n00 = lerp(n000, n001, fadeZ);
+        T n10 = lerp(n100, n101, fadeZ);
+        T n01 = lerp(n010, n011, fadeZ);
+        T n11 = lerp(n110, n111, fadeZ);
+        T n0 = lerp(n00, n01, fadeY);
+        T n1 = lerp(n10, n11, fadeY);
+        return T(2.2f) * lerp(n0, n1, fadeX);
+    }
+
+    template<typename T>
+    SIMD_INLINE T simplexCorner2D(T hash, T x, T y)
+    {
+        //Gradients: 41 points uniformly over a line, mapped onto a diamond.
+        T m = vmax(T(0.5f) - (x * x + y * y), T(0.0f));
+        m = m * m;
+        m = m * m;
+
+        T gx = T(2.0f) * fract(hash * T(0.024390243902439f)) - T(1.0f);
+        T h = vabs(gx) - T(0.5f);
+        T a0 = gx - vfloor(gx + T(0.5f));
+
+        m = m * taylorInvSqrt(a0 * a0 + h * h);
+        return m * (a0 * x + h * y);
+    }
+
+    template<typename T>
+    T simplex2D(T x, T y)
+    {
+        const float C0 = 0.211324865405187f;
+        const float C1 = 0.366025403784439f;
+        const float C2 = -0.577350269189626f;
+
+        //First corner, skewed with glm's dot products: far from the origin (x + y) * C1 rounds differently.
+        T s = x * T(C1) + y * T(C1);
+        T ix = vfloor(x + s);
+        T iy = vfloor(y + s);
+        T t = ix * T(C0) + iy * T(C0);
+        T x0 = x - ix + t;
+        T y0 = y - iy + t;
+
+        //Other corners.
+        T i1x = vselect(x0 > y0, T(1.0f), T(0.0f));
+        T i1y = T(1.0f) - i1x;
+        T x1 = x0 + T(C0) - i1x;
+        T y1 = y0 + T(C0) - i1y;
+        T x2 = x0 + T(C2);
+        T y2 = y0 + T(C2);
+
+        ix = mod289Divide(ix);
+        iy = mod289Divide(iy);
+        T p0 = permute(permute(iy) + ix);
+        T p1 = permute(permute(iy + i1y) + ix + i1x);
+        T p2 = permute(permute(iy + T(1.0f)) + ix + T(1.0f));
+
+        return T(130.0f) * (simplexCorner2D(p0, x0, y0) + simplexCorner2D(p1, x1, y1) + simplexCorner2D(p2, x2, y2));
+    }
+
+    template<typename T>
+    SIMD_INLINE T simplexCorner3D(T hash, T x, T y, T z)
+    {
+        //Gradients: 7x7 points over a square, mapped onto an octahedron.
+        const float n = 0.142857142857f;
+        T nsX(n * 2.0f);
+        T nsY(n * 0.5f - 1.0f);
+        T nsZ(n);
+
+        T j = hash - T(49.0f) * vfloor(hash * nsZ * nsZ);
+        T gridX = vfloor(j * nsZ);
+        T gridY = vfloor(j - T(7.0f) * gridX);
+
+        T gx = gridX * nsX + nsY;
+        T gy = gridY * nsX + nsY;
+        T h = T(1.0f) - vabs(gx) - vabs(gy);
+
+        T sh = -step(h, T(0.0f));
+        gx = gx + (vfloor(gx) * T(2.0f) + T(1.0f)) * sh;
+        gy = gy + (vfloor(gy) * T(2.0f) + T(1.0f)) * sh;
+
+        T norm = taylorInvSqrt(gx * gx + gy * gy + h * h);
+
+        T m = vmax(T(0.6f) - (x * x + y * y + z * z), T(0.0f));
+        m = m * m;
+        return m * m * norm * (gx * x + gy * y + h * z);
+    }
+
+    template<typename T>
+    T simplex3D(T x, T y, T z)
+    {
+        const float Cx = 1.0f / 6.0f;
+        const float Cy = 1.0f / 3.0f;
+
+        //First corner, skewed with glm's dot products as in simplex2D.
+        T s = x * T(Cy) + y * T(Cy) + z * T(Cy);
+        T ix = vfloor(x + s);
+        T iy = vfloor(y + s);
+        T iz = vfloor(z + s);
+        T t = ix * T(Cx) + iy * T(Cx) + iz * T(Cx);
+        T x0 = x - ix + t;
+        T y0 = y - iy + t;
+        T z0 = z - iz + t;
+
+        //Other corners.
+        T gx = step(y0, x0);
+        T gy = step(z0, y0);
+        T gz = step(x0, z0);
+        T lx = T(1.0f) - gx;
+        T ly = T(1.0f) - gy;
+        T lz = T(1.0f) - gz;
+        T i1x = vmin(gx, lz);
+        T i1y = vmin(gy, lx);
+        T i1z = vmin(gz, ly);
+        T i2x = vmax(gx, lz);
+        T i2y = vmax(gy, lx);
+        T i2z = vmax(gz, ly);
+
+        T x1 = x0 - i1x + T(Cx);
+        T y1 = y0 - i1y + T(Cx);
+        T z1 = z0 - i1z + T(Cx);
+        T x2 = x0 - i2x + T(Cy);
+        T y2 = y0 - i2y + T(Cy);
+        T z2 = z0 - i2z + T(Cy);
+        T x3 = x0 - T(0.5f);
+        T y3 = y0 - T(0.5f);
+        T z3 = z0 - T(0.5f);
+
+        ix = mod289(ix);
+        iy = mod289(iy);
+        iz = mod289(iz);
+        T one(1.0f);
+        T p0 = permute(permute(permute(iz) + iy) + ix);
+        T p1 = permute(permute(permute(iz + i1z) + iy + i1y) + ix + i1x);
+        T p2 = permute(permute(permute(iz + i2z) + iy + i2y) + ix + i2x);
+        T p3 = permute(permute(permute(iz + one) + iy + one) + ix + one);
+
+        return T(42.0f) * (simplexCorner3D(p0, x0, y0, z0) + simplexCorner3D(p1, x1, y1, z1)
+            + simplexCorner3D(p2, x2, y2, z2) + simplexCorner3D(p3, x3, y3, z3));
+    }
+
+    template<typename T>
+    SIMD_INLINE T noise2D(NoiseType type, T x, T y)
+    {
+        return type == NoisePerlin ? perlin2D(x, y) : simplex2D(x, y);
+    }
+
+    template<typename T>
+    SIMD_INLINE T noise3D(NoiseType type, T x, T y, T z)
+    {
+        return type == NoisePerlin ? perlin3D(x, y, z) : simplex3D(x, y, z);
+    }
+
+    //Octave accumulation, the result is divided by the summed amplitude so fBm stays in the single octave range.
+    template<typename T>
+    T fractal2D(const NoiseSettings& settings, T x, T y)
+    {
+        if (settings.fractal == FractalNone) return noise2D(settings.type, x, y);
+
+        T sum(0.0f);
+        float amplitude = 1.0f;
+        float frequency = 1.0f;
+        float totalAmplitude = 0.0f;
+
+        for (int octave = 0; octave < settings.octaves; octave++)
+        {
+            T n = noise2D(settings.type, x * T(frequency), y * T(frequency));
+            if (settings.fractal == FractalRidged)
+            {
+                n = T(1.0f) - vabs(n);
+                n = n * n;
+            }
+
+            sum = sum + n * T(amplitude);
+            totalAmplitude += amplitude;
+            amplitude *= settings.gain;
+            frequency *= settings.lacunarity;
+        }
+
+        return totalAmplitude > 0.0f ? sum * T(1.0f / totalAmplitude) : sum;
+    }
+
+    template<typename T>
+    T fractal3D(const NoiseSettings& settings, T x, T y, T z)
+    {
+        if (settings.fractal == FractalNone) return noise3D(settings.type, x, y, z);
+
+        T sum(0.0f);
+        float amplitude = 1.0f;
+        float frequency = 1.0f;
+        float totalAmplitude = 0.0f;
+
+        for (int octave = 0; octave < settings.octaves; octave++)
+        {
+            T n = noise3D(settings.type, x * T(frequency), y * T(frequency), z * T(frequency));
+            if (settings.fractal == FractalRidged)
+            {
+                n = T(1.0f) - vabs(n);
+                n = n * n;
+            }
+
+            sum = sum + n * T(amplitude);
+            totalAmplitude += amplitude;
+            amplitude *= settings.gain;
+            frequency *= settings.lacunarity;
+        }
+
+        return totalAmplitude > 0.0f ? sum * T(1.0f / totalAmplitude) : sum;
+    }
+
+    //One row of samples, Float8 lanes across x with a partial store for the tail.
+    void fillRow(float* output, int width, float y, float z, bool is3D, const NoiseSettings& settings)
+    {
+        static const float laneOffsets[8] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+        Float8 lanes = Float8::load(laneOffsets);
+        Float8 sampleY(settings.offset.y + y * settings.scale);
+        Float8 sampleZ(settings.offset.z + z * settings.scale);
+
+        for (int x = 0; x < width; x += 8)
+        {
+            Float8 sampleX = Float8(settings.offset.x) + (Float8((float)x) + lanes) * Float8(settings.scale);
+            Float8 value = is3D ? fractal3D(settings, sampleX, sampleY, sampleZ) : fractal2D(settings, sampleX, sampleY);
+
+            if (x + 8 <= width)
+            {
+                value.store(output + x);
+            }
+            else
+            {
+                float tail[8];
+                value.store(tail);
+                for (int i = 0; x + i < width; i++) output[x + i] = tail[i];
+            }
+        }
+    }
+
+    void fillRows(float* output, int width, int height, int depth, bool is3D, const NoiseSettings& settings)
+    {
+        int rows = height * depth;
+        int grainSize = 65536 / (width > 0 ? width : 1);
+
+        parallelFor(rows, grainSize > 0 ? grainSize : 1, [&](int begin, int end)
+        {
+            for (int row = begin; row < end; row++)
+            {
+                fillRow(output + (size_t)row * width, width, (float)(row % height), (float)(row / height), is3D, settings);
+            }
+        });
+    }
+}
+
+void fillNoise2D(float* output, int width, int height, const NoiseSettings& settings)
+{
+    fillRows(output, width, height, 1, false, settings);
+}
+
+void fillNoise3D(float* output, int width, int height, int depth, const NoiseSettings& settings)
+{
+    fillRows(output, width, height, depth, true, settings);
+}
+
+float sampleNoise2D(const glm::vec2& position, const NoiseSettings& settings)
+{
+    return fractal2D(settings, position.x, position.y);
+}
+
+float sampleNoise3D(const glm::vec3& position, const NoiseSettings& settings)
+{
+    return fractal3D(settings, position.x, position.y, position.z);
+}
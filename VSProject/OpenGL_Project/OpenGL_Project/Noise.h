@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+//Bulk versions of glm::perlin / glm::simplex that fill whole grids.
+//Every lane evaluates the same formulas as glm/gtc/noise.inl, so a single octave matches glm within float rounding.
+
+enum NoiseType
+{
+    NoisePerlin,
+    NoiseSimplex
+};
+
+enum FractalType
+{
+    FractalNone,
+    FractalFbm,
+    FractalRidged
+};
+
+struct NoiseSettings
+{
+    NoiseType type = NoisePerlin;
+    FractalType fractal = FractalNone;
+
+    //Octave count, frequency multiplier and amplitude multiplier for fBm/ridged.
+    int octaves = 1;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+
+    //Sample position of cell (x, y, z) is offset + (x, y, z) * scale.
+    glm::vec3 offset = glm::vec3(0.0f);
+    float scale = 1.0f;
+};
+
+//Fill width * height floats row by row with 2D noise, rows are split over the parallelFor threads.
+void fillNoise2D(float* output, int width, int height, const NoiseSettings& settings);
+
+//Fill width * height * depth floats (x fastest, then y, then z) with 3D noise.
+void fillNoise3D(float* output, int width, int height, int depth, const NoiseSettings& settings);
+
+//Single sample with the same settings, runs the scalar version of the lane code.
+float sampleNoise2D(const glm::vec2& position, const NoiseSettings& settings);
+float sampleNoise3D(const glm::vec3& position, const NoiseSettings& settings);
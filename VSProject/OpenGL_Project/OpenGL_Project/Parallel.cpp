@@ -0,0 +1,62 @@
+#include "Parallel.h"
+
+#include "JobSystem.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+int workerCount()
+{
+    if (jobSystemRunning()) return jobThreadCount();
+
+    static const int count = std::thread::hardware_concurrency() > 0 ? (int)std::thread::hardware_concurrency() : 1;
+    return count;
+}
+
+void parallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& body)
+{
+    if (count <= 0) return;
+    if (grainSize < 1) grainSize = 1;
+
+    //With the job system up, chunks become stealable jobs and nested calls help instead of spawning threads.
+    if (jobSystemRunning())
+    {
+        jobParallelFor(count, grainSize, body);
+        return;
+    }
+
+    int chunks = (count + grainSize - 1) / grainSize;
+    int threads = chunks < workerCount() ? chunks : workerCount();
+
+    if (threads <= 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    //Every thread keeps grabbing the next chunk until none are left.
+    std::atomic<int> nextChunk(0);
+    auto worker = [&]()
+    {
+        for (int chunk = nextChunk++; chunk < chunks; chunk = nextChunk++)
+        {
+            int begin = chunk * grainSize;
+            int end = begin + grainSize < count ? begin + grainSize : count;
+            body(begin, end);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.emplace_back(worker);
+    }
+
+    worker();
+
+    for (size_t i = 0; i < pool.size(); i++)
+    {
+        pool[i].join();
+    }
+}
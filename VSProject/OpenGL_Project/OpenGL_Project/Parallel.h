@@ -0,0 +1,11 @@
+#pragma once
+
+#include <functional>
+
+//Number of threads parallelFor spreads work over (including the calling thread).
+int workerCount();
+
+//Split [0, count) into chunks of grainSize and run body(begin, end) on them from several threads.
+//Returns when every chunk is done. Small counts just run inline.
+//Goes through the job system (jobParallelFor) once startJobSystem has been called, otherwise starts its own threads.
+void parallelFor(int count, int grainSize, const std::function<void(int begin, int end)>& body);
@@ -0,0 +1,311 @@
+#include "Random.h"
+
+#include <cmath>
+
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace
+{
+    const uint32_t PhiloxM0 = 0xD2511F53;
+    const uint32_t PhiloxM1 = 0xCD9E8D57;
+    const uint32_t PhiloxW0 = 0x9E3779B9;
+    const uint32_t PhiloxW1 = 0xBB67AE85;
+    const int PhiloxRounds = 10;
+
+    const float TwoPi = 6.28318530717958647692f;
+
+    //Words are consumed in chunks of this size by the batch functions.
+    const int ChunkWords = 256;
+
+    //The block of word block * 4 of a stream: counter = (block low, block high, stream, 0).
+    void philox(uint64_t block, uint32_t stream, const uint32_t key[2], uint32_t output[4])
+    {
+        const uint32_t counter[4] = { (uint32_t)block, (uint32_t)(block >> 32), stream, 0 };
+        philox4x32(counter, key, output);
+    }
+
+#ifdef SIMD_SSE2
+    //32x32 -> 64 bit multiply of four lanes, SSE2 only has the even lane version so do it twice.
+    SIMD_INLINE void mulHiLo(__m128i a, __m128i multiplier, __m128i& lo, __m128i& hi)
+    {
+        __m128i even = _mm_mul_epu32(a, multiplier);
+        __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), multiplier);
+        __m128i evenMask = _mm_set_epi32(0, -1, 0, -1);
+
+        lo = _mm_or_si128(_mm_and_si128(even, evenMask), _mm_slli_epi64(odd, 32));
+        hi = _mm_or_si128(_mm_srli_epi64(even, 32), _mm_andnot_si128(evenMask, odd));
+    }
+
+    //Four consecutive blocks at once, one block per lane, written out in sequence order.
+    void philox4(uint64_t block, uint32_t stream, const uint32_t key[2], uint32_t output[16])
+    {
+        __m128i x0 = _mm_setr_epi32((int)(uint32_t)block, (int)(uint32_t)(block + 1), (int)(uint32_t)(block + 2), (int)(uint32_t)(block + 3));
+        __m128i x1 = _mm_setr_epi32((int)(uint32_t)(block >> 32), (int)(uint32_t)((block + 1) >> 32), (int)(uint32_t)((block + 2) >> 32), (int)(uint32_t)((block + 3) >> 32));
+        __m128i x2 = _mm_set1_epi32((int)stream);
+        __m128i x3 = _mm_setzero_si128();
+        __m128i m0 = _mm_set1_epi32((int)PhiloxM0);
+        __m128i m1 = _mm_set1_epi32((int)PhiloxM1);
+        uint32_t k0 = key[0];
+        uint32_t k1 = key[1];
+
+        for (int round = 0; round < PhiloxRounds; round++)
+        {
+            __m128i lo0, hi0, lo1, hi1;
+            mulHiLo(x0, m0, lo0, hi0);
+            mulHiLo(x2, m1, lo1, hi1);
+
+            x0 = _mm_xor_si128(_mm_xor_si128(hi1, x1), _mm_set1_epi32((int)k0));
+            x2 = _mm_xor_si128(_mm_xor_si128(hi0, x3), _mm_set1_epi32((int)k1));
+            x1 = lo1;
+            x3 = lo0;
+
+            k0 += PhiloxW0;
+            k1 += PhiloxW1;
+        }
+
+        __m128 r0 = _mm_castsi128_ps(x0);
+        __m128 r1 = _mm_castsi128_ps(x1);
+        __m128 r2 = _mm_castsi128_ps(x2);
+        __m128 r3 = _mm_castsi128_ps(x3);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        _mm_storeu_si128((__m128i*)output, _mm_castps_si128(r0));
+        _mm_storeu_si128((__m128i*)(output + 4), _mm_castps_si128(r1));
+        _mm_storeu_si128((__m128i*)(output + 8), _mm_castps_si128(r2));
+        _mm_storeu_si128((__m128i*)(output + 12), _mm_castps_si128(r3));
+    }
+#else
+    void philox4(uint64_t block, uint32_t stream, const uint32_t key[2], uint32_t output[16])
+    {
+        for (int i = 0; i < 4; i++) philox(block + i, stream, key, output + i * 4);
+    }
+#endif
+
+    //[0, 1) from the top 24 bits.
+    SIMD_INLINE float toUnit(uint32_t bits)
+    {
+        return (float)(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    //(0, 1], safe to take the log of.
+    SIMD_INLINE float toUnitOpen(uint32_t bits)
+    {
+        return (float)((bits >> 8) + 1) * (1.0f / 16777216.0f);
+    }
+
+    SIMD_INLINE glm::vec3 sphereDirection(uint32_t a, uint32_t b)
+    {
+        float z = toUnit(a) * 2.0f - 1.0f;
+        float angle = toUnit(b) * TwoPi;
+        float r = std::sqrt(std::fmax(0.0f, 1.0f - z * z));
+        return glm::vec3(r * std::cos(angle), r * std::sin(angle), z);
+    }
+}
+
+void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t output[4])
+{
+    uint32_t x0 = counter[0];
+    uint32_t x1 = counter[1];
+    uint32_t x2 = counter[2];
+    uint32_t x3 = counter[3];
+    uint32_t k0 = key[0];
+    uint32_t k1 = key[1];
+
+    for (int round = 0; round < PhiloxRounds; round++)
+    {
+        uint64_t product0 = (uint64_t)PhiloxM0 * x0;
+        uint64_t product1 = (uint64_t)PhiloxM1 * x2;
+
+        uint32_t y0 = (uint32_t)(product1 >> 32) ^ x1 ^ k0;
+        uint32_t y2 = (uint32_t)(product0 >> 32) ^ x3 ^ k1;
+        x1 = (uint32_t)product1;
+        x3 = (uint32_t)product0;
+        x0 = y0;
+        x2 = y2;
+
+        k0 += PhiloxW0;
+        k1 += PhiloxW1;
+    }
+
+    output[0] = x0;
+    output[1] = x1;
+    output[2] = x2;
+    output[3] = x3;
+}
+
+RandomStream::RandomStream(uint64_t seed, uint32_t streamIndex)
+{
+    key[0] = (uint32_t)seed;
+    key[1] = (uint32_t)(seed >> 32);
+    stream = streamIndex;
+    word = 0;
+    bufferBlock = ~(uint64_t)0;
+}
+
+void RandomStream::seek(uint64_t position)
+{
+    word = position;
+}
+
+uint32_t RandomStream::nextUInt()
+{
+    uint64_t block = word >> 2;
+    if (block != bufferBlock)
+    {
+        philox(block, stream, key, buffer);
+        bufferBlock = block;
+    }
+
+    return buffer[word++ & 3];
+}
+
+void RandomStream::fillWords(uint32_t* output, int count)
+{
+    int i = 0;
+
+    //Finish the current block one word at a time, then whole groups of four blocks.
+    while (i < count && (word & 3) != 0) output[i++] = nextUInt();
+
+    while (count - i >= 16)
+    {
+        philox4(word >> 2, stream, key, output + i);
+        word += 16;
+        i += 16;
+    }
+
+    while (i < count) output[i++] = nextUInt();
+}
+
+float RandomStream::linearRand(float min, float max)
+{
+    return min + (max - min) * toUnit(nextUInt());
+}
+
+glm::vec2 RandomStream::linearRand(const glm::vec2& min, const glm::vec2& max)
+{
+    float x = linearRand(min.x, max.x);
+    float y = linearRand(min.y, max.y);
+    return glm::vec2(x, y);
+}
+
+glm::vec3 RandomStream::linearRand(const glm::vec3& min, const glm::vec3& max)
+{
+    float x = linearRand(min.x, max.x);
+    float y = linearRand(min.y, max.y);
+    float z = linearRand(min.z, max.z);
+    return glm::vec3(x, y, z);
+}
+
+float RandomStream::gaussRand(float mean, float deviation)
+{
+    //Box-Muller, only the cosine half is used so every call takes exactly two words.
+    float u1 = toUnitOpen(nextUInt());
+    float u2 = toUnit(nextUInt());
+    return mean + deviation * std::sqrt(-2.0f * std::log(u1)) * std::cos(TwoPi * u2);
+}
+
+glm::vec2 RandomStream::circularRand(float radius)
+{
+    float angle = toUnit(nextUInt()) * TwoPi;
+    return glm::vec2(std::cos(angle), std::sin(angle)) * radius;
+}
+
+glm::vec3 RandomStream::sphericalRand(float radius)
+{
+    uint32_t a = nextUInt();
+    uint32_t b = nextUInt();
+    return sphereDirection(a, b) * radius;
+}
+
+glm::vec2 RandomStream::diskRand(float radius)
+{
+    float r = std::sqrt(toUnit(nextUInt()));
+    return circularRand(radius * r);
+}
+
+glm::vec3 RandomStream::ballRand(float radius)
+{
+    float r = std::cbrt(toUnit(nextUInt()));
+    return sphericalRand(radius * r);
+}
+
+void RandomStream::linearRand(float* output, int count, float min, float max)
+{
+    uint32_t words[ChunkWords];
+    float range = max - min;
+
+    for (int first = 0; first < count; first += ChunkWords)
+    {
+        int n = count - first < ChunkWords ? count - first : ChunkWords;
+        fillWords(words, n);
+
+        for (int i = 0; i < n; i++) output[first + i] = min + range * toUnit(words[i]);
+    }
+}
+
+void RandomStream::gaussRand(float* output, int count, float mean, float deviation)
+{
+    uint32_t words[ChunkWords];
+
+    //Both Box-Muller outputs are used here, so an odd count still takes an even number of words.
+    for (int first = 0; first < count; first += ChunkWords)
+    {
+        int n = count - first < ChunkWords ? count - first : ChunkWords;
+        int pairs = (n + 1) / 2;
+        fillWords(words, pairs * 2);
+
+        for (int i = 0; i < pairs; i++)
+        {
+            float r = deviation * std::sqrt(-2.0f * std::log(toUnitOpen(words[i * 2])));
+            float angle = TwoPi * toUnit(words[i * 2 + 1]);
+
+            output[first + i * 2] = mean + r * std::cos(angle);
+            if (i * 2 + 1 < n) output[first + i * 2 + 1] = mean + r * std::sin(angle);
+        }
+    }
+}
+
+void RandomStream::sphericalRand(glm::vec3* output, int count, float radius)
+{
+    uint32_t words[ChunkWords];
+
+    for (int first = 0; first < count; first += ChunkWords / 2)
+    {
+        int n = count - first < ChunkWords / 2 ? count - first : ChunkWords / 2;
+        fillWords(words, n * 2);
+
+        for (int i = 0; i < n; i++) output[first + i] = sphereDirection(words[i * 2], words[i * 2 + 1]) * radius;
+    }
+}
+
+void fillLinearRand(float* output, int count, uint64_t seed, uint32_t stream, float min, float max)
+{
+    parallelFor(count, 65536, [&](int begin, int end)
+    {
+        RandomStream random(seed, stream);
+        random.seek(begin);
+        random.linearRand(output + begin, end - begin, min, max);
+    });
+}
+
+void fillGaussRand(float* output, int count, uint64_t seed, uint32_t stream, float mean, float deviation)
+{
+    //The grain size is even, so every chunk starts on a Box-Muller pair.
+    parallelFor(count, 65536, [&](int begin, int end)
+    {
+        RandomStream random(seed, stream);
+        random.seek(begin);
+        random.gaussRand(output + begin, end - begin, mean, deviation);
+    });
+}
+
+void fillSphericalRand(glm::vec3* output, int count, uint64_t seed, uint32_t stream, float radius)
+{
+    parallelFor(count, 32768, [&](int begin, int end)
+    {
+        RandomStream random(seed, stream);
+        random.seek((uint64_t)begin * 2);
+        random.sphericalRand(output + begin, end - begin, radius);
+    });
+}
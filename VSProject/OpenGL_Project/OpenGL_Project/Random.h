@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+//Counter based replacement for glm/gtc/random.hpp (which uses std::rand).
+//Values come from Philox4x32-10: word n of a stream is a pure function of (seed, stream, n),
+//so any thread can jump straight to its part of the sequence and results never depend on the thread count.
+class RandomStream
+{
+public:
+    RandomStream(uint64_t seed = 0, uint32_t stream = 0);
+
+    //Jump to the given 32 bit word of the sequence.
+    void seek(uint64_t word);
+    uint64_t position() const { return word; }
+
+    uint32_t nextUInt();
+
+    //Same meaning as the glm functions with the same name.
+    float linearRand(float min, float max);
+    glm::vec2 linearRand(const glm::vec2& min, const glm::vec2& max);
+    glm::vec3 linearRand(const glm::vec3& min, const glm::vec3& max);
+    float gaussRand(float mean, float deviation);
+    glm::vec2 circularRand(float radius);
+    glm::vec3 sphericalRand(float radius);
+    glm::vec2 diskRand(float radius);
+    glm::vec3 ballRand(float radius);
+
+    //Batch versions, these use one word per float (two per sphere sample) and generate 16 words per SIMD step.
+    void linearRand(float* output, int count, float min, float max);
+    void gaussRand(float* output, int count, float mean, float deviation);
+    void sphericalRand(glm::vec3* output, int count, float radius);
+
+private:
+    uint32_t key[2];
+    uint32_t stream;
+    uint64_t word;
+
+    //Last generated block, bufferBlock is its counter.
+    uint32_t buffer[4];
+    uint64_t bufferBlock;
+
+    void fillWords(uint32_t* output, int count);
+};
+
+//One Philox4x32-10 block, the same as Random123's philox4x32 with 10 rounds. RandomStream's word n is word n % 4
+//of the block with counter (n / 4 low 32 bits, n / 4 high 32 bits, stream, 0) and key (seed low, seed high).
+void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t output[4]);
+
+//Parallel deterministic fills, each worker seeks to its own chunk of stream.
+//The output is identical for any number of threads.
+void fillLinearRand(float* output, int count, uint64_t seed, uint32_t stream, float min, float max);
+void fillGaussRand(float* output, int count, uint64_t seed, uint32_t stream, float mean, float deviation);
+void fillSphericalRand(glm::vec3* output, int count, uint64_t seed, uint32_t stream, float radius);
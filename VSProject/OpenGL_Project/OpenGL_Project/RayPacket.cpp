@@ -0,0 +1,260 @@
+#include "RayPacket.h"
+
+namespace
+{
+    //Moller-Trumbore on whole lanes, same math as glm::intersectRayTriangle but branch free.
+    template<typename T>
+    auto mollerTrumbore(T ox, T oy, T oz, T dx, T dy, T dz,
+        T v0x, T v0y, T v0z, T e1x, T e1y, T e1z, T e2x, T e2y, T e2z,
+        T maxDistance, T& distance, T& u, T& v) -> decltype(T(0.0f) < T(0.0f))
+    {
+        T zero(0.0f);
+        T one(1.0f);
+
+        //p = cross(dir, edge2)
+        T px = dy * e2z - dz * e2y;
+        T py = dz * e2x - dx * e2z;
+        T pz = dx * e2y - dy * e2x;
+
+        //If the determinant is zero the ray lies in the plane of the triangle (or the lane is padding).
+        T det = e1x * px + e1y * py + e1z * pz;
+        T invDet = one / det;
+
+        //Distance from vert0 to ray origin.
+        T sx = ox - v0x;
+        T sy = oy - v0y;
+        T sz = oz - v0z;
+
+        u = (sx * px + sy * py + sz * pz) * invDet;
+
+        //q = cross(dist, edge1)
+        T qx = sy * e1z - sz * e1y;
+        T qy = sz * e1x - sx * e1z;
+        T qz = sx * e1y - sy * e1x;
+
+        v = (dx * qx + dy * qy + dz * qz) * invDet;
+        distance = (e2x * qx + e2y * qy + e2z * qz) * invDet;
+
+        return (det != zero) & (u >= zero) & (v >= zero) & (u + v <= one) & (distance > zero) & (distance < maxDistance);
+    }
+
+    template<typename T>
+    void loadRays(RayPacket<T>& packet, const glm::vec3* origins, const glm::vec3* directions, int count)
+    {
+        float lanes[6][T::Width];
+
+        for (int i = 0; i < T::Width; i++)
+        {
+            glm::vec3 origin = i < count ? origins[i] : glm::vec3(0.0f);
+            glm::vec3 direction = i < count ? directions[i] : glm::vec3(0.0f);
+
+            lanes[0][i] = origin.x;
+            lanes[1][i] = origin.y;
+            lanes[2][i] = origin.z;
+            lanes[3][i] = direction.x;
+            lanes[4][i] = direction.y;
+            lanes[5][i] = direction.z;
+        }
+
+        packet.originX = T::load(lanes[0]);
+        packet.originY = T::load(lanes[1]);
+        packet.originZ = T::load(lanes[2]);
+        packet.directionX = T::load(lanes[3]);
+        packet.directionY = T::load(lanes[4]);
+        packet.directionZ = T::load(lanes[5]);
+    }
+
+    template<typename T>
+    void loadTriangles(TrianglePacket<T>& packet, const glm::vec3* positions, const unsigned int* indices, int firstTriangle, int count)
+    {
+        float lanes[9][T::Width];
+
+        for (int i = 0; i < T::Width; i++)
+        {
+            glm::vec3 vert0(0.0f), edge1(0.0f), edge2(0.0f);
+
+            if (i < count)
+            {
+                const unsigned int* triangle = indices + (firstTriangle + i) * 3;
+                vert0 = positions[triangle[0]];
+                edge1 = positions[triangle[1]] - vert0;
+                edge2 = positions[triangle[2]] - vert0;
+            }
+
+            lanes[0][i] = vert0.x;
+            lanes[1][i] = vert0.y;
+            lanes[2][i] = vert0.z;
+            lanes[3][i] = edge1.x;
+            lanes[4][i] = edge1.y;
+            lanes[5][i] = edge1.z;
+            lanes[6][i] = edge2.x;
+            lanes[7][i] = edge2.y;
+            lanes[8][i] = edge2.z;
+        }
+
+        packet.vertexX = T::load(lanes[0]);
+        packet.vertexY = T::load(lanes[1]);
+        packet.vertexZ = T::load(lanes[2]);
+        packet.edge1X = T::load(lanes[3]);
+        packet.edge1Y = T::load(lanes[4]);
+        packet.edge1Z = T::load(lanes[5]);
+        packet.edge2X = T::load(lanes[6]);
+        packet.edge2Y = T::load(lanes[7]);
+        packet.edge2Z = T::load(lanes[8]);
+    }
+
+    template<typename T>
+    int raysTriangle(const RayPacket<T>& rays, const glm::vec3& vert0, const glm::vec3& vert1, const glm::vec3& vert2, RayHitPacket<T>& hits)
+    {
+        glm::vec3 edge1 = vert1 - vert0;
+        glm::vec3 edge2 = vert2 - vert0;
+
+        T distance, u, v;
+        auto mask = mollerTrumbore<T>(rays.originX, rays.originY, rays.originZ,
+            rays.directionX, rays.directionY, rays.directionZ,
+            T(vert0.x), T(vert0.y), T(vert0.z),
+            T(edge1.x), T(edge1.y), T(edge1.z),
+            T(edge2.x), T(edge2.y), T(edge2.z),
+            hits.distance, distance, u, v);
+
+        hits.distance = vselect(mask, distance, hits.distance);
+        hits.u = vselect(mask, u, hits.u);
+        hits.v = vselect(mask, v, hits.v);
+
+        return vmovemask(mask);
+    }
+
+    template<typename T>
+    int rayTriangles(const glm::vec3& orig, const glm::vec3& dir, const TrianglePacket<T>& triangles, float& distance, glm::vec2& baryPosition)
+    {
+        T laneDistance, u, v;
+        auto mask = mollerTrumbore<T>(T(orig.x), T(orig.y), T(orig.z),
+            T(dir.x), T(dir.y), T(dir.z),
+            triangles.vertexX, triangles.vertexY, triangles.vertexZ,
+            triangles.edge1X, triangles.edge1Y, triangles.edge1Z,
+            triangles.edge2X, triangles.edge2Y, triangles.edge2Z,
+            T(distance), laneDistance, u, v);
+
+        int bits = vmovemask(mask);
+        if (bits == 0) return -1;
+
+        float distances[T::Width], us[T::Width], vs[T::Width];
+        laneDistance.store(distances);
+        u.store(us);
+        v.store(vs);
+
+        //Few lanes hit in practice, so pick the closest one with a scalar scan.
+        int closest = -1;
+        for (int i = 0; i < T::Width; i++)
+        {
+            if ((bits & (1 << i)) && distances[i] < distance)
+            {
+                closest = i;
+                distance = distances[i];
+            }
+        }
+
+        baryPosition = glm::vec2(us[closest], vs[closest]);
+        return closest;
+    }
+
+    template<typename T>
+    int raysSphere(const RayPacket<T>& rays, const glm::vec3& center, float radius, RayHitPacket<T>& hits)
+    {
+        T zero(0.0f);
+
+        T lx = T(center.x) - rays.originX;
+        T ly = T(center.y) - rays.originY;
+        T lz = T(center.z) - rays.originZ;
+
+        //Closest approach along the ray and squared distance from the center at that point.
+        T tca = lx * rays.directionX + ly * rays.directionY + lz * rays.directionZ;
+        T d2 = lx * lx + ly * ly + lz * lz - tca * tca;
+        T radius2(radius * radius);
+
+        T thc = vsqrt(vmax(radius2 - d2, zero));
+        T nearDistance = tca - thc;
+        T farDistance = tca + thc;
+
+        //When the origin is inside the sphere the far intersection is the visible one.
+        T distance = vselect(nearDistance > zero, nearDistance, farDistance);
+
+        //Padding lanes have a zero direction, which would otherwise hit any sphere around their zero origin.
+        T length2 = rays.directionX * rays.directionX + rays.directionY * rays.directionY + rays.directionZ * rays.directionZ;
+
+        auto mask = (length2 > zero) & (d2 <= radius2) & (distance > zero) & (distance < hits.distance);
+
+        hits.distance = vselect(mask, distance, hits.distance);
+        hits.u = vselect(mask, zero, hits.u);
+        hits.v = vselect(mask, zero, hits.v);
+
+        return vmovemask(mask);
+    }
+}
+
+void loadRayPacket(RayPacket4& packet, const glm::vec3* origins, const glm::vec3* directions, int count)
+{
+    loadRays(packet, origins, directions, count);
+}
+
+void loadRayPacket(RayPacket8& packet, const glm::vec3* origins, const glm::vec3* directions, int count)
+{
+    loadRays(packet, origins, directions, count);
+}
+
+void loadTrianglePacket(TrianglePacket4& packet, const glm::vec3* positions, const unsigned int* indices, int firstTriangle, int count)
+{
+    loadTriangles(packet, positions, indices, firstTriangle, count);
+}
+
+void loadTrianglePacket(TrianglePacket8& packet, const glm::vec3* positions, const unsigned int* indices, int firstTriangle, int count)
+{
+    loadTriangles(packet, positions, indices, firstTriangle, count);
+}
+
+int intersectRayPacketTriangle(const RayPacket4& rays, const glm::vec3& vert0, const glm::vec3& vert1, const glm::vec3& vert2, RayHitPacket4& hits)
+{
+    return raysTriangle(rays, vert0, vert1, vert2, hits);
+}
+
+int intersectRayPacketTriangle(const RayPacket8& rays, const glm::vec3& vert0, const glm::vec3& vert1, const glm::vec3& vert2, RayHitPacket8& hits)
+{
+    return raysTriangle(rays, vert0, vert1, vert2, hits);
+}
+
+int intersectRayTrianglePacket(const glm::vec3& orig, const glm::vec3& dir, const TrianglePacket4& triangles, float& distance, glm::vec2& baryPosition)
+{
+    return rayTriangles(orig, dir, triangles, distance, baryPosition);
+}
+
+int intersectRayTrianglePacket(const glm::vec3& orig, const glm::vec3& dir, const TrianglePacket8& triangles, float& distance, glm::vec2& baryPosition)
+{
+    return rayTriangles(orig, dir, triangles, distance, baryPosition);
+}
+
+int intersectRayPacketSphere(const RayPacket4& rays, const glm::vec3& center, float radius, RayHitPacket4& hits)
+{
+    return raysSphere(rays, center, radius, hits);
+}
+
+int intersectRayPacketSphere(const RayPacket8& rays, const glm::vec3& center, float radius, RayHitPacket8& hits)
+{
+    return raysSphere(rays, center, radius, hits);
+}
+
+int intersectRayMesh(const glm::vec3& orig, const glm::vec3& dir, const glm::vec3* positions, const unsigned int* indices, int triangleCount, float& distance, glm::vec2& baryPosition)
+{
+    int closest = -1;
+    TrianglePacket8 packet;
+
+    for (int first = 0; first < triangleCount; first += 8)
+    {
+        int count = triangleCount - first < 8 ? triangleCount - first : 8;
+        loadTrianglePacket(packet, positions, indices, first, count);
+
+        int lane = intersectRayTrianglePacket(orig, dir, packet, distance, baryPosition);
+        if (lane >= 0) closest = first + lane;
+    }
+
+    return closest;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Simd.h"
+
+//Batched versions of glm::intersectRayTriangle / glm::intersectRaySphere.
+//Rays and triangles are stored as structure-of-arrays so every lane runs the same Moller-Trumbore test.
+//Unlike glm, a hit also needs a distance in (0, maxDistance), which is what picking wants.
+
+template<typename T>
+struct RayPacket
+{
+    T originX, originY, originZ;
+    T directionX, directionY, directionZ;
+};
+
+template<typename T>
+struct TrianglePacket
+{
+    //First vertex and the two edges leaving it, precomputed once per packet.
+    T vertexX, vertexY, vertexZ;
+    T edge1X, edge1Y, edge1Z;
+    T edge2X, edge2Y, edge2Z;
+};
+
+template<typename T>
+struct RayHitPacket
+{
+    //Set distance to the maximum search distance before the first test, only closer hits overwrite a lane.
+    T distance;
+    T u, v;
+};
+
+typedef RayPacket<Float4> RayPacket4;
+typedef RayPacket<Float8> RayPacket8;
+typedef TrianglePacket<Float4> TrianglePacket4;
+typedef TrianglePacket<Float8> TrianglePacket8;
+typedef RayHitPacket<Float4> RayHitPacket4;
+typedef RayHitPacket<Float8> RayHitPacket8;
+
+//Fill a packet from count rays, unused lanes get a zero direction so they never hit.
+void loadRayPacket(RayPacket4& packet, const glm::vec3* origins, const glm::vec3* directions, int count);
+void loadRayPacket(RayPacket8& packet, const glm::vec3* origins, const glm::vec3* directions, int count);
+
+//Fill a packet with count indexed triangles starting at firstTriangle, unused lanes become degenerate.
+void loadTrianglePacket(TrianglePacket4& packet, const glm::vec3* positions, const unsigned int* indices, int firstTriangle, int count);
+void loadTrianglePacket(TrianglePacket8& packet, const glm::vec3* positions, const unsigned int* indices, int firstTriangle, int count);
+
+//Many rays against one triangle. Returns a bitmask of the lanes whose hit was updated.
+int intersectRayPacketTriangle(const RayPacket4& rays, const glm::vec3& vert0, const glm::vec3& vert1, const glm::vec3& vert2, RayHitPacket4& hits);
+int intersectRayPacketTriangle(const RayPacket8& rays, const glm::vec3& vert0, const glm::vec3& vert1, const glm::vec3& vert2, RayHitPacket8& hits);
+
+//One ray against many triangles. Returns the lane of the closest hit below distance (and updates it), or -1.
+int intersectRayTrianglePacket(const glm::vec3& orig, const glm::vec3& dir, const TrianglePacket4& triangles, float& distance, glm::vec2& baryPosition);
+int intersectRayTrianglePacket(const glm::vec3& orig, const glm::vec3& dir, const TrianglePacket8& triangles, float& distance, glm::vec2& baryPosition);
+
+//Many rays against one sphere, direction must be normalized. Returns a bitmask of the lanes whose hit was updated.
+int intersectRayPacketSphere(const RayPacket4& rays, const glm::vec3& center, float radius, RayHitPacket4& hits);
+int intersectRayPacketSphere(const RayPacket8& rays, const glm::vec3& center, float radius, RayHitPacket8& hits);
+
+//Closest hit of one ray against an indexed triangle mesh, 8 triangles at a time.
+//Returns the triangle index or -1, distance is the maximum distance on input.
+int intersectRayMesh(const glm::vec3& orig, const glm::vec3& dir, const glm::vec3* positions, const unsigned int* indices, int triangleCount, float& distance, glm::vec2& baryPosition);
@@ -0,0 +1,223 @@
+#include "RenderCommands.h"
+
+#include <cstring>
+
+#include "MultiDraw.h"
+
+template<typename T>
+T& CommandBuffer::append(RenderCommandType type)
+{
+    static_assert(alignof(T) <= 8, "Commands start on 8 byte boundaries.");
+
+    //Padded so the next command (which may hold a pointer) stays aligned.
+    const size_t size = (sizeof(T) + 7) & ~(size_t)7;
+
+    //Grow by doubling, steady state frames reuse the same memory.
+    if (used + size > arena.size()) arena.resize(arena.size() * 2 > used + size ? arena.size() * 2 : used + size + 4096);
+
+    T& command = *(T*)(arena.data() + used);
+    command.header.type = type;
+    command.header.size = (uint16_t)size;
+    used += size;
+    return command;
+}
+
+void CommandBuffer::clear(float r, float g, float b, float a, GLbitfield mask)
+{
+    ClearCommand& command = append<ClearCommand>(CommandClear);
+    command.color[0] = r;
+    command.color[1] = g;
+    command.color[2] = b;
+    command.color[3] = a;
+    command.mask = mask;
+}
+
+void CommandBuffer::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    ViewportCommand& command = append<ViewportCommand>(CommandViewport);
+    command.x = x;
+    command.y = y;
+    command.width = width;
+    command.height = height;
+}
+
+void CommandBuffer::useProgram(GLuint program)
+{
+    append<UseProgramCommand>(CommandUseProgram).program = program;
+}
+
+void CommandBuffer::bindTexture(GLuint unit, GLuint texture)
+{
+    BindTextureCommand& command = append<BindTextureCommand>(CommandBindTexture);
+    command.unit = unit;
+    command.texture = texture;
+}
+
+void CommandBuffer::bindVertexArray(GLuint vao)
+{
+    append<BindVertexArrayCommand>(CommandBindVertexArray).vao = vao;
+}
+
+void CommandBuffer::setUniformInt(GLint location, GLint value)
+{
+    SetUniformIntCommand& command = append<SetUniformIntCommand>(CommandSetUniformInt);
+    command.location = location;
+    command.value = value;
+}
+
+void CommandBuffer::setUniformMat4(GLint location, const float* value)
+{
+    SetUniformMat4Command& command = append<SetUniformMat4Command>(CommandSetUniformMat4);
+    command.location = location;
+    std::memcpy(command.value, value, sizeof(command.value));
+}
+
+void CommandBuffer::drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset)
+{
+    DrawElementsCommand& command = append<DrawElementsCommand>(CommandDrawElements);
+    command.mode = mode;
+    command.count = count;
+    command.type = type;
+    command.offset = offset;
+}
+
+void CommandBuffer::drawIndirectBatch(const IndirectBatch* batch, int frame)
+{
+    DrawIndirectBatchCommand& command = append<DrawIndirectBatchCommand>(CommandDrawIndirectBatch);
+    command.frame = frame;
+    command.batch = batch;
+}
+
+void CommandBuffer::copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size)
+{
+    CopyBufferCommand& command = append<CopyBufferCommand>(CommandCopyBuffer);
+    command.source = source;
+    command.target = target;
+    command.sourceOffset = sourceOffset;
+    command.targetOffset = targetOffset;
+    command.size = size;
+}
+
+void GlRenderBackend::clear(const float* color, GLbitfield mask)
+{
+    glClearColor(color[0], color[1], color[2], color[3]);
+    glClear(mask);
+}
+
+void GlRenderBackend::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    glViewport(x, y, width, height);
+}
+
+void GlRenderBackend::useProgram(GLuint program)
+{
+    glUseProgram(program);
+}
+
+void GlRenderBackend::bindTexture(GLuint unit, GLuint texture)
+{
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GlRenderBackend::bindVertexArray(GLuint vao)
+{
+    glBindVertexArray(vao);
+}
+
+void GlRenderBackend::setUniformInt(GLint location, GLint value)
+{
+    glUniform1i(location, value);
+}
+
+void GlRenderBackend::setUniformMat4(GLint location, const float* value)
+{
+    glUniformMatrix4fv(location, 1, GL_FALSE, value);
+}
+
+void GlRenderBackend::drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset)
+{
+    glDrawElements(mode, count, type, (void*)(size_t)offset);
+}
+
+void GlRenderBackend::drawIndirectBatch(const IndirectBatch& batch, int frame)
+{
+    batch.draw(frame);
+}
+
+void GlRenderBackend::copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size)
+{
+    glBindBuffer(GL_COPY_READ_BUFFER, source);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, sourceOffset, targetOffset, size);
+}
+
+void replayCommands(const CommandBuffer& commands, RenderBackend& backend)
+{
+    const unsigned char* p = commands.data();
+    const unsigned char* end = p + commands.size();
+
+    while (p < end)
+    {
+        const CommandHeader& header = *(const CommandHeader*)p;
+        switch (header.type)
+        {
+        case CommandClear:
+        {
+            const ClearCommand& c = *(const ClearCommand*)p;
+            backend.clear(c.color, c.mask);
+            break;
+        }
+        case CommandViewport:
+        {
+            const ViewportCommand& c = *(const ViewportCommand*)p;
+            backend.viewport(c.x, c.y, c.width, c.height);
+            break;
+        }
+        case CommandUseProgram:
+            backend.useProgram(((const UseProgramCommand*)p)->program);
+            break;
+        case CommandBindTexture:
+        {
+            const BindTextureCommand& c = *(const BindTextureCommand*)p;
+            backend.bindTexture(c.unit, c.texture);
+            break;
+        }
+        case CommandBindVertexArray:
+            backend.bindVertexArray(((const BindVertexArrayCommand*)p)->vao);
+            break;
+        case CommandSetUniformInt:
+        {
+            const SetUniformIntCommand& c = *(const SetUniformIntCommand*)p;
+            backend.setUniformInt(c.location, c.value);
+            break;
+        }
+        case CommandSetUniformMat4:
+        {
+            const SetUniformMat4Command& c = *(const SetUniformMat4Command*)p;
+            backend.setUniformMat4(c.location, c.value);
+            break;
+        }
+        case CommandDrawElements:
+        {
+            const DrawElementsCommand& c = *(const DrawElementsCommand*)p;
+            backend.drawElements(c.mode, c.count, c.type, c.offset);
+            break;
+        }
+        case CommandDrawIndirectBatch:
+        {
+            const DrawIndirectBatchCommand& c = *(const DrawIndirectBatchCommand*)p;
+            backend.drawIndirectBatch(*c.batch, c.frame);
+            break;
+        }
+        case CommandCopyBuffer:
+        {
+            const CopyBufferCommand& c = *(const CopyBufferCommand*)p;
+            backend.copyBuffer(c.source, c.target, c.sourceOffset, c.targetOffset, c.size);
+            break;
+        }
+        }
+
+        p += header.size;
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+class IndirectBatch;
+
+//Render commands are small POD structs written back to back into one byte arena, so recording a frame
+//doesn't allocate once the arena has grown to its working size. Any thread can record, replayCommands
+//turns them into calls on a RenderBackend (real GL, or a mock that just records what it was asked to do).
+
+enum RenderCommandType : uint16_t
+{
+    CommandClear,
+    CommandViewport,
+    CommandUseProgram,
+    CommandBindTexture,
+    CommandBindVertexArray,
+    CommandSetUniformInt,
+    CommandSetUniformMat4,
+    CommandDrawElements,
+    CommandDrawIndirectBatch,
+    CommandCopyBuffer
+};
+
+struct CommandHeader
+{
+    RenderCommandType type;
+    uint16_t size;          //Whole command including the header, rounded up to 8 bytes.
+};
+
+struct ClearCommand { CommandHeader header; float color[4]; GLbitfield mask; };
+struct ViewportCommand { CommandHeader header; GLint x, y; GLsizei width, height; };
+struct UseProgramCommand { CommandHeader header; GLuint program; };
+struct BindTextureCommand { CommandHeader header; GLuint unit; GLuint texture; };
+struct BindVertexArrayCommand { CommandHeader header; GLuint vao; };
+struct SetUniformIntCommand { CommandHeader header; GLint location; GLint value; };
+struct SetUniformMat4Command { CommandHeader header; GLint location; float value[16]; };
+struct DrawElementsCommand { CommandHeader header; GLenum mode; GLsizei count; GLenum type; GLuint offset; };
+struct DrawIndirectBatchCommand { CommandHeader header; int frame; const IndirectBatch* batch; };
+struct CopyBufferCommand { CommandHeader header; GLuint source; GLuint target; GLuint sourceOffset; GLuint targetOffset; GLuint size; };
+
+class CommandBuffer
+{
+public:
+    //Forget the recorded commands, the arena keeps its memory.
+    void reset() { used = 0; }
+
+    void clear(float r, float g, float b, float a, GLbitfield mask);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void useProgram(GLuint program);
+    void bindTexture(GLuint unit, GLuint texture);
+    void bindVertexArray(GLuint vao);
+    void setUniformInt(GLint location, GLint value);
+    void setUniformMat4(GLint location, const float* value);
+    void drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset);
+    void drawIndirectBatch(const IndirectBatch* batch, int frame);
+    void copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size);
+
+    const unsigned char* data() const { return arena.data(); }
+    size_t size() const { return used; }
+    size_t capacity() const { return arena.size(); }
+
+private:
+    template<typename T>
+    T& append(RenderCommandType type);
+
+    std::vector<unsigned char> arena;
+    size_t used = 0;
+};
+
+//What replayCommands calls, one function per command.
+class RenderBackend
+{
+public:
+    virtual ~RenderBackend() {}
+
+    virtual void clear(const float* color, GLbitfield mask) = 0;
+    virtual void viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+    virtual void useProgram(GLuint program) = 0;
+    virtual void bindTexture(GLuint unit, GLuint texture) = 0;
+    virtual void bindVertexArray(GLuint vao) = 0;
+    virtual void setUniformInt(GLint location, GLint value) = 0;
+    virtual void setUniformMat4(GLint location, const float* value) = 0;
+    virtual void drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset) = 0;
+    virtual void drawIndirectBatch(const IndirectBatch& batch, int frame) = 0;
+    virtual void copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size) = 0;
+};
+
+//Straight to GL, the calling thread needs the context.
+class GlRenderBackend : public RenderBackend
+{
+public:
+    void clear(const float* color, GLbitfield mask) override;
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+    void useProgram(GLuint program) override;
+    void bindTexture(GLuint unit, GLuint texture) override;
+    void bindVertexArray(GLuint vao) override;
+    void setUniformInt(GLint location, GLint value) override;
+    void setUniformMat4(GLint location, const float* value) override;
+    void drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset) override;
+    void drawIndirectBatch(const IndirectBatch& batch, int frame) override;
+    void copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size) override;
+};
+
+void replayCommands(const CommandBuffer& commands, RenderBackend& backend);
@@ -0,0 +1,71 @@
+#include "RenderThread.h"
+
+#include <GLFW/glfw3.h>
+
+void RenderThread::start(GLFWwindow* renderWindow)
+{
+    window = renderWindow;
+    stopping = false;
+    submitted = -1;
+    recording = 0;
+    thread = std::thread(&RenderThread::run, this);
+}
+
+void RenderThread::stop()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return submitted < 0; });
+        stopping = true;
+    }
+    changed.notify_all();
+    thread.join();
+
+    glfwMakeContextCurrent(window);
+}
+
+CommandBuffer& RenderThread::beginFrame()
+{
+    //Never the submitted buffer, submitFrame switched us over to the other one.
+    buffers[recording].reset();
+    return buffers[recording];
+}
+
+void RenderThread::submitFrame()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return submitted < 0; });
+        submitted = recording;
+        recording ^= 1;
+    }
+    changed.notify_all();
+}
+
+void RenderThread::run()
+{
+    glfwMakeContextCurrent(window);
+    GlRenderBackend backend;
+
+    for (;;)
+    {
+        int frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this]() { return submitted >= 0 || stopping; });
+            if (submitted < 0) break;
+            frame = submitted;
+        }
+
+        replayCommands(buffers[frame], backend);
+        glfwSwapBuffers(window);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            submitted = -1;
+        }
+        changed.notify_all();
+    }
+
+    glfwMakeContextCurrent(NULL);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "RenderCommands.h"
+
+struct GLFWwindow;
+
+//Thread that owns the GL context, replays the recorded frames and swaps buffers.
+//Two command buffers: while the render thread replays frame N the simulation records frame N + 1 into the other.
+class RenderThread
+{
+public:
+    //The window's context must not be current on the calling thread anymore (glfwMakeContextCurrent(NULL)).
+    void start(GLFWwindow* window);
+
+    //Finishes the submitted frame and hands the context back to the calling thread.
+    void stop();
+
+    //Buffer for the next frame, already reset.
+    CommandBuffer& beginFrame();
+
+    //Waits until the previous frame has been replayed, then hands this one over.
+    void submitFrame();
+
+private:
+    void run();
+
+    GLFWwindow* window = nullptr;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    CommandBuffer buffers[2];
+    int recording = 0;
+    int submitted = -1;         //Buffer waiting for or being replayed, -1 when the render thread is idle.
+    bool stopping = false;
+};
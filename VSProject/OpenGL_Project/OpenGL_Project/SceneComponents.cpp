@@ -0,0 +1,129 @@
+#include "SceneComponents.h"
+
+#include "Parallel.h"
+
+Transform makeTransform(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    Transform transform;
+    transform.translation = translation;
+    transform.rotation = rotation;
+    transform.scale = scale;
+    transform.world = glm::mat4(1.0f);
+    return transform;
+}
+
+void updateTransforms(EcsWorld& world)
+{
+    world.parallelForEachChunk<Transform>([](int count, const Entity*, Transform* transforms)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            Transform& t = transforms[i];
+            glm::mat4 m = glm::mat4_cast(t.rotation);
+            m[0] *= t.scale.x;
+            m[1] *= t.scale.y;
+            m[2] *= t.scale.z;
+            m[3] = glm::vec4(t.translation, 1.0f);
+            t.world = m;
+        }
+    });
+}
+
+void updateBounds(EcsWorld& world)
+{
+    world.parallelForEachChunk<Transform, Bounds>([](int count, const Entity*, Transform* transforms, Bounds* bounds)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            //Arvo's method: center moves with the matrix, extents grow by |rotation scale|.
+            const glm::mat4& m = transforms[i].world;
+            glm::vec3 center = (bounds[i].local.min + bounds[i].local.max) * 0.5f;
+            glm::vec3 extent = (bounds[i].local.max - bounds[i].local.min) * 0.5f;
+
+            glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+            glm::vec3 worldExtent = glm::abs(glm::vec3(m[0])) * extent.x + glm::abs(glm::vec3(m[1])) * extent.y + glm::abs(glm::vec3(m[2])) * extent.z;
+
+            bounds[i].world.min = worldCenter - worldExtent;
+            bounds[i].world.max = worldCenter + worldExtent;
+        }
+    });
+}
+
+void drawRenderables(EcsWorld& world)
+{
+    DrawQueue queue;
+    CommandBuffer commands;
+    recordRenderables(world, queue, commands);
+
+    GlRenderBackend backend;
+    replayCommands(commands, backend);
+}
+
+RenderStats recordRenderables(EcsWorld& world, DrawQueue& queue, CommandBuffer& commands)
+{
+    queue.clear();
+
+    world.forEachChunk<Renderable, Transform>([&](int count, const Entity*, Renderable* renderables, Transform* transforms)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            const Renderable& renderable = renderables[i];
+            uint32_t material = queue.material(renderable.textures);
+            uint32_t depth = quantizeSortDepth(transforms[i].world[3].z, -1.0f, 1.0f);
+
+            queue.add(makeSortKey(0, renderable.program, material, renderable.vao, depth), &renderable, &transforms[i].world);
+        }
+    });
+
+    return queue.submit(commands);
+}
+
+int recordBatchedMeshes(EcsWorld& world, const MeshBuffers& meshes, IndirectBatch& batch, CommandBuffer& commands)
+{
+    struct ChunkDraws
+    {
+        int first;
+        int count;
+        const BatchedMesh* batched;
+        const Transform* transforms;
+    };
+
+    //Chunk offsets first, then every chunk writes its own slice of the draw list.
+    std::vector<ChunkDraws> chunks;
+    int total = 0;
+    world.forEachChunk<BatchedMesh, Transform>([&](int count, const Entity*, BatchedMesh* batched, Transform* transforms)
+    {
+        chunks.push_back({ total, count, batched, transforms });
+        total += count;
+    });
+
+    batch.begin(total);
+    total = batch.drawCount();
+
+    DrawElementsIndirectCommand* draws = batch.draws();
+    glm::mat4* models = batch.models();
+    parallelFor((int)chunks.size(), 1, [&](int begin, int end)
+    {
+        for (int c = begin; c < end; c++)
+        {
+            const ChunkDraws& chunk = chunks[c];
+            for (int i = 0; i < chunk.count && chunk.first + i < total; i++)
+            {
+                MeshRange range = meshes.range(chunk.batched[i].mesh);
+                int index = chunk.first + i;
+
+                draws[index] = { (GLuint)range.indexCount, 1, range.firstIndex, range.baseVertex, (GLuint)index };
+                models[index] = chunk.transforms[i].world;
+            }
+        }
+    });
+
+    batch.record(commands);
+    return total;
+}
+
+void addSceneSystems(SystemSchedule& schedule)
+{
+    schedule.add(0, componentMask<Transform>(), updateTransforms);
+    schedule.add(componentMask<Transform>(), componentMask<Bounds>(), updateBounds);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Bvh.h"
+#include "DrawSort.h"
+#include "Ecs.h"
+#include "MultiDraw.h"
+#include "RenderCommands.h"
+
+//Components that feed the draw path.
+
+struct Transform
+{
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+    glm::mat4 world;        //Written by updateTransforms.
+};
+
+struct Bounds
+{
+    Aabb local;
+    Aabb world;             //Written by updateBounds.
+};
+
+//Everything needed for one indexed draw.
+struct Renderable
+{
+    GLuint vao;
+    GLuint program;
+    GLint modelLocation;    //Location of the program's "model" uniform.
+    GLuint textures[2];     //Bound to texture units 0 and 1, 0 = none.
+    GLsizei indexCount;
+};
+
+//Mesh inside a MeshBuffers, drawn through an IndirectBatch instead of its own draw call.
+struct BatchedMesh
+{
+    MeshHandle mesh;
+};
+
+Transform makeTransform(const glm::vec3& translation = glm::vec3(0.0f),
+    const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+//Transform: world = translate * rotate * scale.
+void updateTransforms(EcsWorld& world);
+
+//Transform (read), Bounds: world box around the transformed local box.
+void updateBounds(EcsWorld& world);
+
+//Renderable + Transform: draws every entity, the transform goes into the program's "model" uniform.
+void drawRenderables(EcsWorld& world);
+
+//Same as drawRenderables, recorded for the render thread instead of calling GL. Draws go through the queue
+//sorted by program, textures, VAO and depth (world z, clip space for now), so each is bound once per run.
+RenderStats recordRenderables(EcsWorld& world, DrawQueue& queue, CommandBuffer& commands);
+
+//BatchedMesh + Transform: fills the batch's next frame on the parallelFor threads and records it as one draw.
+//Program and textures are whatever the commands bound before. Returns the number of meshes in the batch.
+//Ranges are looked up in meshes every frame, so run MeshBuffers::defragment before this, not after.
+int recordBatchedMeshes(EcsWorld& world, const MeshBuffers& meshes, IndirectBatch& batch, CommandBuffer& commands);
+
+//Adds updateTransforms and updateBounds to a schedule with their read/write sets.
+void addSceneSystems(SystemSchedule& schedule);
@@ -0,0 +1,254 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "Parallel.h"
+
+const int SceneGraph::NoParent;
+
+namespace
+{
+    //Subtrees bigger than this are opened up so their children can run on different threads.
+    const int SplitSize = 4096;
+
+    struct SubtreeRange
+    {
+        int first;
+        int count;
+    };
+
+    glm::mat4 localMatrix(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        glm::mat4 m = glm::mat4_cast(rotation);
+        m[0] *= scale.x;
+        m[1] *= scale.y;
+        m[2] *= scale.z;
+        m[3] = glm::vec4(translation, 1.0f);
+        return m;
+    }
+}
+
+int SceneGraph::addNode(int parent, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    int handle = (int)slots.size();
+    int slot = (int)parents.size();
+    int parentSlot = parent == NoParent ? NoParent : slots[parent];
+
+    //Appending keeps parents before children, but only keeps subtree ranges when the parent's range ends at the
+    //back, otherwise update() sorts again. Every ancestor's range ends there too then, and grows by one.
+    bool keepsOrder = parent == NoParent || (!unsorted && parentSlot + subtreeSizes[parentSlot] == slot);
+
+    slots.push_back(slot);
+    handles.push_back(handle);
+    parents.push_back(parentSlot);
+    subtreeSizes.push_back(1);
+    translations.push_back(translation);
+    rotations.push_back(rotation);
+    scales.push_back(scale);
+    worlds.push_back(glm::mat4(1.0f));
+    dirty.push_back(0);
+    markDirty(slot);
+
+    if (!keepsOrder) unsorted = true;
+    else if (!unsorted)
+    {
+        for (int ancestor = parentSlot; ancestor != NoParent; ancestor = parents[ancestor]) subtreeSizes[ancestor]++;
+    }
+    return handle;
+}
+
+int SceneGraph::parent(int node) const
+{
+    int slot = parents[slots[node]];
+    return slot == NoParent ? NoParent : handles[slot];
+}
+
+bool SceneGraph::setParent(int node, int parent)
+{
+    int slot = slots[node];
+    int parentSlot = parent == NoParent ? NoParent : slots[parent];
+
+    //Walks the parent chain rather than the subtree range, which is stale until the next sort.
+    for (int ancestor = parentSlot; ancestor != NoParent; ancestor = parents[ancestor])
+    {
+        if (ancestor == slot) return false;
+    }
+
+    parents[slot] = parentSlot;
+    markDirty(slot);
+    unsorted = true;
+    return true;
+}
+
+void SceneGraph::setTranslation(int node, const glm::vec3& translation)
+{
+    translations[slots[node]] = translation;
+    markDirty(slots[node]);
+}
+
+void SceneGraph::setRotation(int node, const glm::quat& rotation)
+{
+    rotations[slots[node]] = rotation;
+    markDirty(slots[node]);
+}
+
+void SceneGraph::setScale(int node, const glm::vec3& scale)
+{
+    scales[slots[node]] = scale;
+    markDirty(slots[node]);
+}
+
+void SceneGraph::markDirty(int slot)
+{
+    if (dirty[slot]) return;
+    dirty[slot] = 1;
+    dirtySlots.push_back(slot);
+}
+
+void SceneGraph::sortNodes()
+{
+    int count = nodeCount();
+
+    //Children lists in slot order, so siblings keep their relative order.
+    std::vector<int> firstChild(count, -1), nextSibling(count, -1), lastChild(count, -1);
+    for (int slot = 0; slot < count; slot++)
+    {
+        int parent = parents[slot];
+        if (parent == NoParent) continue;
+        if (lastChild[parent] < 0) firstChild[parent] = slot;
+        else nextSibling[lastChild[parent]] = slot;
+        lastChild[parent] = slot;
+    }
+
+    std::vector<int> order;
+    order.reserve(count);
+    std::vector<int> stack;
+    for (int root = 0; root < count; root++)
+    {
+        if (parents[root] != NoParent) continue;
+
+        stack.push_back(root);
+        while (!stack.empty())
+        {
+            int slot = stack.back();
+            stack.pop_back();
+            order.push_back(slot);
+
+            //Push children in reverse so the first child is visited first.
+            int children = (int)stack.size();
+            for (int child = firstChild[slot]; child >= 0; child = nextSibling[child]) stack.push_back(child);
+            std::reverse(stack.begin() + children, stack.end());
+        }
+    }
+
+    std::vector<int> newSlot(count);
+    for (int i = 0; i < count; i++) newSlot[order[i]] = i;
+
+    std::vector<int> sortedParents(count), sortedHandles(count);
+    std::vector<glm::vec3> sortedTranslations(count), sortedScales(count);
+    std::vector<glm::quat> sortedRotations(count);
+    std::vector<glm::mat4> sortedWorlds(count);
+    std::vector<uint8_t> sortedDirty(count);
+    for (int i = 0; i < count; i++)
+    {
+        int old = order[i];
+        sortedParents[i] = parents[old] == NoParent ? NoParent : newSlot[parents[old]];
+        sortedHandles[i] = handles[old];
+        sortedTranslations[i] = translations[old];
+        sortedRotations[i] = rotations[old];
+        sortedScales[i] = scales[old];
+        sortedWorlds[i] = worlds[old];
+        sortedDirty[i] = dirty[old];
+        slots[handles[old]] = i;
+    }
+
+    parents.swap(sortedParents);
+    handles.swap(sortedHandles);
+    translations.swap(sortedTranslations);
+    rotations.swap(sortedRotations);
+    scales.swap(sortedScales);
+    worlds.swap(sortedWorlds);
+    dirty.swap(sortedDirty);
+
+    //Children come after their parent, so walking backwards sums every subtree.
+    std::fill(subtreeSizes.begin(), subtreeSizes.end(), 1);
+    for (int slot = count - 1; slot >= 0; slot--)
+    {
+        if (parents[slot] != NoParent) subtreeSizes[parents[slot]] += subtreeSizes[slot];
+    }
+
+    for (size_t i = 0; i < dirtySlots.size(); i++) dirtySlots[i] = newSlot[dirtySlots[i]];
+    unsorted = false;
+}
+
+void SceneGraph::update()
+{
+    if (unsorted) sortNodes();
+    if (dirtySlots.empty())
+    {
+        lastUpdated = 0;
+        return;
+    }
+
+    //Keep only the dirty nodes that aren't inside another dirty subtree, their ranges don't overlap.
+    std::sort(dirtySlots.begin(), dirtySlots.end());
+    std::vector<SubtreeRange> ranges;
+    int coveredEnd = 0;
+    for (size_t i = 0; i < dirtySlots.size(); i++)
+    {
+        int slot = dirtySlots[i];
+        dirty[slot] = 0;
+        if (slot < coveredEnd) continue;
+
+        ranges.push_back({ slot, subtreeSizes[slot] });
+        coveredEnd = slot + subtreeSizes[slot];
+    }
+    dirtySlots.clear();
+
+    //Big subtrees: compute the top node here and hand its child subtrees out as separate ranges.
+    std::vector<SubtreeRange> work;
+    int updated = 0;
+    while (!ranges.empty())
+    {
+        SubtreeRange range = ranges.back();
+        ranges.pop_back();
+
+        if (range.count <= SplitSize)
+        {
+            work.push_back(range);
+            continue;
+        }
+
+        int slot = range.first;
+        glm::mat4 local = localMatrix(translations[slot], rotations[slot], scales[slot]);
+        worlds[slot] = parents[slot] == NoParent ? local : worlds[parents[slot]] * local;
+        updated++;
+
+        for (int child = slot + 1; child < range.first + range.count; child += subtreeSizes[child])
+        {
+            ranges.push_back({ child, subtreeSizes[child] });
+        }
+    }
+
+    std::atomic<int> total(updated);
+    parallelFor((int)work.size(), 1, [&](int begin, int end)
+    {
+        int nodes = 0;
+        for (int i = begin; i < end; i++)
+        {
+            //The range's own parent is clean (otherwise it would be inside a dirty range) and everything else
+            //in the range comes after its parent, so one forward walk is enough.
+            int last = work[i].first + work[i].count;
+            for (int slot = work[i].first; slot < last; slot++)
+            {
+                glm::mat4 local = localMatrix(translations[slot], rotations[slot], scales[slot]);
+                worlds[slot] = parents[slot] == NoParent ? local : worlds[parents[slot]] * local;
+            }
+            nodes += work[i].count;
+        }
+        total += nodes;
+    });
+
+    lastUpdated = total;
+}
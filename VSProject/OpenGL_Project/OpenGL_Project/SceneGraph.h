@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+//Transform hierarchy stored as flat arrays instead of a pointer tree.
+//Nodes are kept in depth first order: a parent always comes before its children and every subtree is one
+//contiguous range [slot, slot + subtreeSize), so a moved node only recomputes its own range.
+//Node handles stay valid while the arrays are reordered underneath them.
+//Moving nodes costs update() the size of the moved subtrees. Changing the hierarchy (reparenting, or adding a node
+//anywhere but at the end of the last subtree) reorders all nodes once on the next update().
+class SceneGraph
+{
+public:
+    static const int NoParent = -1;
+
+    //Returns the handle of the new node, parent is a handle or NoParent.
+    //Adding roots, or adding a tree depth first, keeps the order and needs no reordering.
+    int addNode(int parent, const glm::vec3& translation = glm::vec3(0.0f),
+        const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+    void setTranslation(int node, const glm::vec3& translation);
+    void setRotation(int node, const glm::quat& rotation);
+    void setScale(int node, const glm::vec3& scale);
+
+    const glm::vec3& translation(int node) const { return translations[slots[node]]; }
+    const glm::quat& rotation(int node) const { return rotations[slots[node]]; }
+    const glm::vec3& scale(int node) const { return scales[slots[node]]; }
+    int parent(int node) const;
+
+    //Moves node and its subtree under parent (a handle or NoParent). Fails when parent is inside that subtree.
+    bool setParent(int node, int parent);
+
+    //Recompute world matrices of the dirty subtrees, independent subtrees are spread over the parallelFor threads.
+    void update();
+
+    //Valid after update().
+    const glm::mat4& world(int node) const { return worlds[slots[node]]; }
+
+    int nodeCount() const { return (int)parents.size(); }
+
+    //Nodes recomputed by the last update().
+    int updatedCount() const { return lastUpdated; }
+
+private:
+    void markDirty(int slot);
+    void sortNodes();
+
+    //Per slot, in depth first order (once sorted).
+    std::vector<int> parents;
+    std::vector<int> subtreeSizes;
+    std::vector<int> handles;
+    std::vector<glm::vec3> translations;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> worlds;
+    std::vector<uint8_t> dirty;
+
+    //Per handle.
+    std::vector<int> slots;
+
+    std::vector<int> dirtySlots;
+    bool unsorted = false;
+    int lastUpdated = 0;
+};
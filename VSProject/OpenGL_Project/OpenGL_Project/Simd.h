@@ -0,0 +1,261 @@
+#pragma once
+
+#include <cmath>
+
+//Small lane types so batch kernels can be written once and run as scalar, 4 or 8 wide.
+//SSE2 is always there on x64, AVX only when the compiler is told to target it (/arch:AVX).
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define SIMD_AVX 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#define SIMD_INLINE __forceinline
+#else
+#define SIMD_INLINE inline __attribute__((always_inline))
+#endif
+
+//Scalar versions, so the same template kernel can also run on plain floats.
+SIMD_INLINE float vmin(float a, float b) { return a < b ? a : b; }
+SIMD_INLINE float vmax(float a, float b) { return a > b ? a : b; }
+SIMD_INLINE float vabs(float a) { return std::fabs(a); }
+SIMD_INLINE float vfloor(float a) { return std::floor(a); }
+SIMD_INLINE float vsqrt(float a) { return std::sqrt(a); }
+SIMD_INLINE float vselect(bool mask, float a, float b) { return mask ? a : b; }
+SIMD_INLINE bool vany(bool mask) { return mask; }
+SIMD_INLINE int vmovemask(bool mask) { return mask ? 1 : 0; }
+
+#ifdef SIMD_SSE2
+
+struct Mask4
+{
+    __m128 v;
+
+    Mask4() {}
+    Mask4(__m128 value) : v(value) {}
+};
+
+SIMD_INLINE Mask4 operator&(Mask4 a, Mask4 b) { return _mm_and_ps(a.v, b.v); }
+SIMD_INLINE Mask4 operator|(Mask4 a, Mask4 b) { return _mm_or_ps(a.v, b.v); }
+SIMD_INLINE Mask4 operator!(Mask4 a) { return _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))); }
+SIMD_INLINE bool vany(Mask4 a) { return _mm_movemask_ps(a.v) != 0; }
+SIMD_INLINE int vmovemask(Mask4 a) { return _mm_movemask_ps(a.v); }
+
+struct Float4
+{
+    static const int Width = 4;
+
+    __m128 v;
+
+    Float4() {}
+    Float4(__m128 value) : v(value) {}
+    Float4(float value) : v(_mm_set1_ps(value)) {}
+    Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+    static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+
+SIMD_INLINE Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+SIMD_INLINE Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+SIMD_INLINE Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+SIMD_INLINE Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+SIMD_INLINE Float4 operator-(Float4 a) { return _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)); }
+SIMD_INLINE Mask4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+SIMD_INLINE Mask4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+SIMD_INLINE Mask4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+SIMD_INLINE Mask4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+SIMD_INLINE Mask4 operator!=(Float4 a, Float4 b) { return _mm_cmpneq_ps(a.v, b.v); }
+SIMD_INLINE Float4 vmin(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+SIMD_INLINE Float4 vmax(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+SIMD_INLINE Float4 vabs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+SIMD_INLINE Float4 vsqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+SIMD_INLINE Float4 vselect(Mask4 mask, Float4 a, Float4 b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+
+SIMD_INLINE Float4 vfloor(Float4 a)
+{
+    //SSE2 has no floor, so truncate and step down where truncation rounded up (negative inputs).
+    //Only valid inside the int32 range, which is plenty for noise lattices and packing.
+    __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    __m128 tooBig = _mm_cmpgt_ps(truncated, a.v);
+    return _mm_sub_ps(truncated, _mm_and_ps(tooBig, _mm_set1_ps(1.0f)));
+}
+
+#else
+
+struct Mask4
+{
+    bool v[4];
+};
+
+SIMD_INLINE Mask4 operator&(Mask4 a, Mask4 b) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] && b.v[i]; return r; }
+SIMD_INLINE Mask4 operator|(Mask4 a, Mask4 b) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] || b.v[i]; return r; }
+SIMD_INLINE Mask4 operator!(Mask4 a) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = !a.v[i]; return r; }
+SIMD_INLINE int vmovemask(Mask4 a) { int m = 0; for (int i = 0; i < 4; i++) m |= a.v[i] ? 1 << i : 0; return m; }
+SIMD_INLINE bool vany(Mask4 a) { return vmovemask(a) != 0; }
+
+struct Float4
+{
+    static const int Width = 4;
+
+    float v[4];
+
+    Float4() {}
+    Float4(float value) { for (int i = 0; i < 4; i++) v[i] = value; }
+    Float4(float a, float b, float c, float d) { v[0] = a; v[1] = b; v[2] = c; v[3] = d; }
+
+    static Float4 load(const float* p) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+    void store(float* p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+};
+
+#define SIMD_FLOAT4_BINARY(op) \
+    SIMD_INLINE Float4 operator op(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] op b.v[i]; return r; }
+#define SIMD_FLOAT4_COMPARE(op) \
+    SIMD_INLINE Mask4 operator op(Float4 a, Float4 b) { Mask4 r; for (int i = 0; i < 4; i++) r.v[i] = a.v[i] op b.v[i]; return r; }
+#define SIMD_FLOAT4_FUNCTION(name) \
+    SIMD_INLINE Float4 name(Float4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = name(a.v[i]); return r; }
+
+SIMD_FLOAT4_BINARY(+)
+SIMD_FLOAT4_BINARY(-)
+SIMD_FLOAT4_BINARY(*)
+SIMD_FLOAT4_BINARY(/)
+SIMD_FLOAT4_COMPARE(<)
+SIMD_FLOAT4_COMPARE(<=)
+SIMD_FLOAT4_COMPARE(>)
+SIMD_FLOAT4_COMPARE(>=)
+SIMD_FLOAT4_COMPARE(!=)
+SIMD_FLOAT4_FUNCTION(vabs)
+SIMD_FLOAT4_FUNCTION(vfloor)
+SIMD_FLOAT4_FUNCTION(vsqrt)
+
+SIMD_INLINE Float4 operator-(Float4 a) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = -a.v[i]; return r; }
+SIMD_INLINE Float4 vmin(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = vmin(a.v[i], b.v[i]); return r; }
+SIMD_INLINE Float4 vmax(Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = vmax(a.v[i], b.v[i]); return r; }
+SIMD_INLINE Float4 vselect(Mask4 mask, Float4 a, Float4 b) { Float4 r; for (int i = 0; i < 4; i++) r.v[i] = mask.v[i] ? a.v[i] : b.v[i]; return r; }
+
+#undef SIMD_FLOAT4_BINARY
+#undef SIMD_FLOAT4_COMPARE
+#undef SIMD_FLOAT4_FUNCTION
+
+#endif
+
+#ifdef SIMD_AVX
+
+struct Mask8
+{
+    __m256 v;
+
+    Mask8() {}
+    Mask8(__m256 value) : v(value) {}
+};
+
+SIMD_INLINE Mask8 operator&(Mask8 a, Mask8 b) { return _mm256_and_ps(a.v, b.v); }
+SIMD_INLINE Mask8 operator|(Mask8 a, Mask8 b) { return _mm256_or_ps(a.v, b.v); }
+SIMD_INLINE Mask8 operator!(Mask8 a) { return _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))); }
+SIMD_INLINE bool vany(Mask8 a) { return _mm256_movemask_ps(a.v) != 0; }
+SIMD_INLINE int vmovemask(Mask8 a) { return _mm256_movemask_ps(a.v); }
+
+struct Float8
+{
+    static const int Width = 8;
+
+    __m256 v;
+
+    Float8() {}
+    Float8(__m256 value) : v(value) {}
+    Float8(float value) : v(_mm256_set1_ps(value)) {}
+
+    static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, v); }
+};
+
+SIMD_INLINE Float8 operator+(Float8 a, Float8 b) { return _mm256_add_ps(a.v, b.v); }
+SIMD_INLINE Float8 operator-(Float8 a, Float8 b) { return _mm256_sub_ps(a.v, b.v); }
+SIMD_INLINE Float8 operator*(Float8 a, Float8 b) { return _mm256_mul_ps(a.v, b.v); }
+SIMD_INLINE Float8 operator/(Float8 a, Float8 b) { return _mm256_div_ps(a.v, b.v); }
+SIMD_INLINE Float8 operator-(Float8 a) { return _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)); }
+SIMD_INLINE Mask8 operator<(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); }
+SIMD_INLINE Mask8 operator<=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ); }
+SIMD_INLINE Mask8 operator>(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); }
+SIMD_INLINE Mask8 operator>=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ); }
+SIMD_INLINE Mask8 operator!=(Float8 a, Float8 b) { return _mm256_cmp_ps(a.v, b.v, _CMP_NEQ_UQ); }
+SIMD_INLINE Float8 vmin(Float8 a, Float8 b) { return _mm256_min_ps(a.v, b.v); }
+SIMD_INLINE Float8 vmax(Float8 a, Float8 b) { return _mm256_max_ps(a.v, b.v); }
+SIMD_INLINE Float8 vabs(Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+SIMD_INLINE Float8 vsqrt(Float8 a) { return _mm256_sqrt_ps(a.v); }
+SIMD_INLINE Float8 vfloor(Float8 a) { return _mm256_floor_ps(a.v); }
+SIMD_INLINE Float8 vselect(Mask8 mask, Float8 a, Float8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+
+#else
+
+//Without AVX an 8 wide lane is just two 4 wide lanes back to back.
+struct Mask8
+{
+    Mask4 lo, hi;
+};
+
+SIMD_INLINE Mask8 operator&(Mask8 a, Mask8 b) { Mask8 r; r.lo = a.lo & b.lo; r.hi = a.hi & b.hi; return r; }
+SIMD_INLINE Mask8 operator|(Mask8 a, Mask8 b) { Mask8 r; r.lo = a.lo | b.lo; r.hi = a.hi | b.hi; return r; }
+SIMD_INLINE Mask8 operator!(Mask8 a) { Mask8 r; r.lo = !a.lo; r.hi = !a.hi; return r; }
+SIMD_INLINE int vmovemask(Mask8 a) { return vmovemask(a.lo) | (vmovemask(a.hi) << 4); }
+SIMD_INLINE bool vany(Mask8 a) { return vmovemask(a) != 0; }
+
+struct Float8
+{
+    static const int Width = 8;
+
+    Float4 lo, hi;
+
+    Float8() {}
+    Float8(float value) : lo(value), hi(value) {}
+    Float8(Float4 low, Float4 high) : lo(low), hi(high) {}
+
+    static Float8 load(const float* p) { return Float8(Float4::load(p), Float4::load(p + 4)); }
+    void store(float* p) const { lo.store(p); hi.store(p + 4); }
+};
+
+#define SIMD_FLOAT8_BINARY(op) \
+    SIMD_INLINE Float8 operator op(Float8 a, Float8 b) { return Float8(a.lo op b.lo, a.hi op b.hi); }
+#define SIMD_FLOAT8_COMPARE(op) \
+    SIMD_INLINE Mask8 operator op(Float8 a, Float8 b) { Mask8 r; r.lo = a.lo op b.lo; r.hi = a.hi op b.hi; return r; }
+
+SIMD_FLOAT8_BINARY(+)
+SIMD_FLOAT8_BINARY(-)
+SIMD_FLOAT8_BINARY(*)
+SIMD_FLOAT8_BINARY(/)
+SIMD_FLOAT8_COMPARE(<)
+SIMD_FLOAT8_COMPARE(<=)
+SIMD_FLOAT8_COMPARE(>)
+SIMD_FLOAT8_COMPARE(>=)
+SIMD_FLOAT8_COMPARE(!=)
+
+SIMD_INLINE Float8 operator-(Float8 a) { return Float8(-a.lo, -a.hi); }
+SIMD_INLINE Float8 vmin(Float8 a, Float8 b) { return Float8(vmin(a.lo, b.lo), vmin(a.hi, b.hi)); }
+SIMD_INLINE Float8 vmax(Float8 a, Float8 b) { return Float8(vmax(a.lo, b.lo), vmax(a.hi, b.hi)); }
+SIMD_INLINE Float8 vabs(Float8 a) { return Float8(vabs(a.lo), vabs(a.hi)); }
+SIMD_INLINE Float8 vsqrt(Float8 a) { return Float8(vsqrt(a.lo), vsqrt(a.hi)); }
+SIMD_INLINE Float8 vfloor(Float8 a) { return Float8(vfloor(a.lo), vfloor(a.hi)); }
+SIMD_INLINE Float8 vselect(Mask8 mask, Float8 a, Float8 b) { return Float8(vselect(mask.lo, a.lo, b.lo), vselect(mask.hi, a.hi, b.hi)); }
+
+#undef SIMD_FLOAT8_BINARY
+#undef SIMD_FLOAT8_COMPARE
+
+#endif
+
+//Helpers shared by every lane type.
+template<typename T>
+SIMD_INLINE T vclamp(T x, T lo, T hi)
+{
+    return vmin(vmax(x, lo), hi);
+}
+
+template<typename T>
+SIMD_INLINE T vmix(T a, T b, T t)
+{
+    return a + (b - a) * t;
+}
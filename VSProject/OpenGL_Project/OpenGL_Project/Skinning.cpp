@@ -0,0 +1,267 @@
+#include "Skinning.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace
+{
+    const int Lanes = Float4::Width;
+    const int ChunkVertices = 1024;
+
+    SIMD_INLINE float boneElement(const BoneMatrix& bone, int e) { return bone.m[e]; }
+    SIMD_INLINE float boneElement(const BoneDualQuat& bone, int e) { return bone.q[e]; }
+
+    //Every lane reads a different bone, so bone data is gathered element by element.
+    struct LaneGather
+    {
+        const uint16_t* indices;
+        const float* weights;
+
+        Float4 weight(int influence) const
+        {
+            return Float4(weights[influence], weights[4 + influence], weights[8 + influence], weights[12 + influence]);
+        }
+
+        template<typename Bone>
+        Float4 element(const Bone* bones, int influence, int e) const
+        {
+            return Float4(boneElement(bones[indices[influence]], e), boneElement(bones[indices[4 + influence]], e),
+                boneElement(bones[indices[8 + influence]], e), boneElement(bones[indices[12 + influence]], e));
+        }
+    };
+
+    void linearBlend(const LaneGather& gather, const BoneMatrix* bones, Float4& x, Float4& y, Float4& z)
+    {
+        Float4 m[12];
+        for (int e = 0; e < 12; e++) m[e] = Float4(0.0f);
+
+        for (int influence = 0; influence < 4; influence++)
+        {
+            Float4 w = gather.weight(influence);
+            for (int e = 0; e < 12; e++) m[e] = m[e] + w * gather.element(bones, influence, e);
+        }
+
+        Float4 px = x, py = y, pz = z;
+        x = m[0] * px + m[1] * py + m[2] * pz + m[3];
+        y = m[4] * px + m[5] * py + m[6] * pz + m[7];
+        z = m[8] * px + m[9] * py + m[10] * pz + m[11];
+    }
+
+    void dualQuaternionBlend(const LaneGather& gather, const BoneDualQuat* bones, Float4& x, Float4& y, Float4& z)
+    {
+        Float4 q[8];
+        for (int e = 0; e < 8; e++) q[e] = Float4(0.0f);
+
+        Float4 firstX = gather.element(bones, 0, 0);
+        Float4 firstY = gather.element(bones, 0, 1);
+        Float4 firstZ = gather.element(bones, 0, 2);
+        Float4 firstW = gather.element(bones, 0, 3);
+
+        for (int influence = 0; influence < 4; influence++)
+        {
+            Float4 bone[8];
+            for (int e = 0; e < 8; e++) bone[e] = gather.element(bones, influence, e);
+
+            //Blend in the same hemisphere as the first bone, otherwise the rotation takes the long way round.
+            Float4 hemisphere = firstX * bone[0] + firstY * bone[1] + firstZ * bone[2] + firstW * bone[3];
+            Float4 w = gather.weight(influence);
+            w = vselect(hemisphere < Float4(0.0f), -w, w);
+
+            for (int e = 0; e < 8; e++) q[e] = q[e] + w * bone[e];
+        }
+
+        Float4 inverseLength = Float4(1.0f) / vsqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+        for (int e = 0; e < 8; e++) q[e] = q[e] * inverseLength;
+
+        Float4 rx = q[0], ry = q[1], rz = q[2], rw = q[3];
+        Float4 dx = q[4], dy = q[5], dz = q[6], dw = q[7];
+
+        //Rotation: p + 2 * cross(r, cross(r, p) + rw * p).
+        Float4 cx = ry * z - rz * y + rw * x;
+        Float4 cy = rz * x - rx * z + rw * y;
+        Float4 cz = rx * y - ry * x + rw * z;
+        Float4 two(2.0f);
+        Float4 px = x + two * (ry * cz - rz * cy);
+        Float4 py = y + two * (rz * cx - rx * cz);
+        Float4 pz = z + two * (rx * cy - ry * cx);
+
+        //Translation: 2 * (rw * d - dw * r + cross(r, d)).
+        x = px + two * (rw * dx - dw * rx + ry * dz - rz * dy);
+        y = py + two * (rw * dy - dw * ry + rz * dx - rx * dz);
+        z = pz + two * (rw * dz - dw * rz + rx * dy - ry * dx);
+    }
+
+    //Writes count skinned positions as x, y, z to output.
+    void skinBatch(const SkinningJob& job, const uint16_t* indices, const float* weights, const float* positions[3], float* output, int count)
+    {
+        LaneGather gather = { indices, weights };
+
+        Float4 x = Float4::load(positions[0]);
+        Float4 y = Float4::load(positions[1]);
+        Float4 z = Float4::load(positions[2]);
+
+        if (job.method == SkinDualQuaternion) dualQuaternionBlend(gather, job.dualQuats, x, y, z);
+        else linearBlend(gather, job.matrices, x, y, z);
+
+        float skinned[3][Lanes];
+        x.store(skinned[0]);
+        y.store(skinned[1]);
+        z.store(skinned[2]);
+
+        for (int lane = 0; lane < count; lane++)
+        {
+            output[lane * 3] = skinned[0][lane];
+            output[lane * 3 + 1] = skinned[1][lane];
+            output[lane * 3 + 2] = skinned[2][lane];
+        }
+    }
+
+    //Skinned positions of vertices [first, first + count), count <= ChunkVertices, as x, y, z floats.
+    void skinPositions(const SkinningJob& job, int first, int count, float* output)
+    {
+        const SkinnedMesh& mesh = *job.mesh;
+        int end = first + count;
+
+        int v = first;
+        for (; v + Lanes <= end; v += Lanes)
+        {
+            const float* positions[3] = { &mesh.positionX[v], &mesh.positionY[v], &mesh.positionZ[v] };
+            skinBatch(job, &mesh.boneIndices[v * 4], &mesh.boneWeights[v * 4], positions, output + (v - first) * 3, Lanes);
+        }
+
+        if (v < end)
+        {
+            //Pad the last batch with copies of its first vertex, only the real lanes are written back.
+            uint16_t indices[Lanes * 4];
+            float weights[Lanes * 4];
+            float padded[3][Lanes];
+
+            for (int lane = 0; lane < Lanes; lane++)
+            {
+                int source = v + lane < end ? v + lane : v;
+                for (int k = 0; k < 4; k++)
+                {
+                    indices[lane * 4 + k] = mesh.boneIndices[source * 4 + k];
+                    weights[lane * 4 + k] = mesh.boneWeights[source * 4 + k];
+                }
+                padded[0][lane] = mesh.positionX[source];
+                padded[1][lane] = mesh.positionY[source];
+                padded[2][lane] = mesh.positionZ[source];
+            }
+
+            const float* positions[3] = { padded[0], padded[1], padded[2] };
+            skinBatch(job, indices, weights, positions, output + (v - first) * 3, end - v);
+        }
+    }
+}
+
+bool makeSkinnedMesh(const float* vertices, int vertexCount, int floatsPerVertex, const VertexAttributeSource* sources, int sourceCount,
+    int positionSource, const uint16_t* boneIndices, const float* boneWeights, SkinnedMesh& mesh)
+{
+    mesh = SkinnedMesh();
+    const VertexAttributeSource& position = sources[positionSource];
+    if (position.components != 3 || (position.format != VertexHalf && position.format != VertexFloat)) return false;
+
+    mesh.vertexCount = vertexCount;
+    mesh.positionX.resize(vertexCount);
+    mesh.positionY.resize(vertexCount);
+    mesh.positionZ.resize(vertexCount);
+    for (int v = 0; v < vertexCount; v++)
+    {
+        const float* p = vertices + (size_t)v * floatsPerVertex + position.offset;
+        mesh.positionX[v] = p[0];
+        mesh.positionY[v] = p[1];
+        mesh.positionZ[v] = p[2];
+    }
+    mesh.boneIndices.assign(boneIndices, boneIndices + (size_t)vertexCount * 4);
+    mesh.boneWeights.assign(boneWeights, boneWeights + (size_t)vertexCount * 4);
+
+    mesh.layout = makePackedLayout(sources, sourceCount);
+    mesh.positionAttribute = positionSource;
+    mesh.packedVertices.resize((size_t)vertexCount * mesh.layout.stride);
+    return packVertices(vertices, vertexCount, floatsPerVertex, sources, sourceCount, mesh.layout, mesh.packedVertices.data());
+}
+
+void makeBoneMatrices(const glm::mat4* skinMatrices, int count, BoneMatrix* output)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const glm::mat4& m = skinMatrices[i];
+        for (int row = 0; row < 3; row++)
+        {
+            for (int column = 0; column < 4; column++) output[i].m[row * 4 + column] = m[column][row];
+        }
+    }
+}
+
+void makeBoneDualQuats(const glm::mat4* skinMatrices, int count, BoneDualQuat* output)
+{
+    for (int i = 0; i < count; i++)
+    {
+        glm::quat real = glm::normalize(glm::quat_cast(glm::mat3(skinMatrices[i])));
+        glm::vec3 translation = glm::vec3(skinMatrices[i][3]);
+        glm::quat dual = (glm::quat(0.0f, translation.x, translation.y, translation.z) * real) * 0.5f;
+
+        float* q = output[i].q;
+        q[0] = real.x; q[1] = real.y; q[2] = real.z; q[3] = real.w;
+        q[4] = dual.x; q[5] = dual.y; q[6] = dual.z; q[7] = dual.w;
+    }
+}
+
+void skinVertices(const SkinningJob& job, int first, int count)
+{
+    const SkinnedMesh& mesh = *job.mesh;
+    const PackedVertexAttribute& position = mesh.layout.attributes[mesh.positionAttribute];
+    int stride = mesh.layout.stride;
+    unsigned char* output = (unsigned char*)job.output;
+
+    //Everything but positions is packed already, copy the bind pose and overwrite the positions.
+    std::memcpy(output + (size_t)first * stride, &mesh.packedVertices[(size_t)first * stride], (size_t)count * stride);
+
+    float skinned[ChunkVertices * 3];
+    uint16_t halves[ChunkVertices * 3];
+    for (int chunk = first; chunk < first + count; chunk += ChunkVertices)
+    {
+        int n = std::min(ChunkVertices, first + count - chunk);
+        skinPositions(job, chunk, n, skinned);
+
+        unsigned char* vertex = output + (size_t)chunk * stride + position.offset;
+        if (position.type == GL_HALF_FLOAT)
+        {
+            packHalfBulk(skinned, halves, n * 3);
+            for (int v = 0; v < n; v++) std::memcpy(vertex + (size_t)v * stride, halves + v * 3, 3 * sizeof(uint16_t));
+        }
+        else
+        {
+            for (int v = 0; v < n; v++) std::memcpy(vertex + (size_t)v * stride, skinned + v * 3, 3 * sizeof(float));
+        }
+    }
+}
+
+void skinMeshes(const SkinningJob* jobs, int jobCount)
+{
+    //Chunk prefix sums so one flat parallelFor covers every mesh, big or small.
+    std::vector<int> firstChunk(jobCount + 1, 0);
+    for (int i = 0; i < jobCount; i++)
+    {
+        int chunks = (jobs[i].mesh->vertexCount + ChunkVertices - 1) / ChunkVertices;
+        firstChunk[i + 1] = firstChunk[i] + chunks;
+    }
+
+    parallelFor(firstChunk[jobCount], 1, [&](int begin, int end)
+    {
+        for (int chunk = begin; chunk < end; chunk++)
+        {
+            int job = (int)(std::upper_bound(firstChunk.begin(), firstChunk.end(), chunk) - firstChunk.begin()) - 1;
+            int first = (chunk - firstChunk[job]) * ChunkVertices;
+            int count = std::min(ChunkVertices, jobs[job].mesh->vertexCount - first);
+
+            skinVertices(jobs[job], first, count);
+        }
+    });
+}
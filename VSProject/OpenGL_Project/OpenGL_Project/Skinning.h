@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VertexPacking.h"
+
+//CPU skinning with up to 4 bone influences per vertex.
+//Output is packed in the mesh's vertex layout (e.g. the half/unorm one of createSquare), only positions change.
+
+enum SkinningMethod
+{
+    SkinLinearBlend,
+    SkinDualQuaternion
+};
+
+//Bind pose, positions are SoA so four vertices load into one Float4 per axis.
+struct SkinnedMesh
+{
+    int vertexCount = 0;
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<uint16_t> boneIndices;  //4 per vertex.
+    std::vector<float> boneWeights;     //4 per vertex, summing to 1 (unused slots 0).
+
+    PackedVertexLayout layout;
+    int positionAttribute = 0;          //Index into layout.attributes, VertexHalf or VertexFloat.
+    std::vector<unsigned char> packedVertices;  //vertexCount * layout.stride, copied to the output as is.
+};
+
+//Builds a mesh from interleaved float vertices like packVertices takes, sources[positionSource] being the
+//3 component position. Fails when positions aren't VertexHalf or VertexFloat.
+bool makeSkinnedMesh(const float* vertices, int vertexCount, int floatsPerVertex, const VertexAttributeSource* sources, int sourceCount,
+    int positionSource, const uint16_t* boneIndices, const float* boneWeights, SkinnedMesh& mesh);
+
+//Affine skin matrix (bone world * inverse bind), rows of a 3x4 matrix.
+struct BoneMatrix
+{
+    float m[12];
+};
+
+//Unit dual quaternion, real part then dual part, both stored x, y, z, w.
+struct BoneDualQuat
+{
+    float q[8];
+};
+
+void makeBoneMatrices(const glm::mat4* skinMatrices, int count, BoneMatrix* output);
+
+//Matrices must be rigid (rotation + translation), scale is not representable as a dual quaternion.
+void makeBoneDualQuats(const glm::mat4* skinMatrices, int count, BoneDualQuat* output);
+
+struct SkinningJob
+{
+    const SkinnedMesh* mesh;
+    SkinningMethod method;
+    const BoneMatrix* matrices;         //Used for SkinLinearBlend.
+    const BoneDualQuat* dualQuats;      //Used for SkinDualQuaternion.
+    void* output;                       //mesh->vertexCount * mesh->layout.stride bytes, e.g. a mapped GL_STREAM_DRAW buffer.
+};
+
+//Skin vertices [first, first + count) of one job, four at a time.
+void skinVertices(const SkinningJob& job, int first, int count);
+
+//Skin every job, the vertices of all meshes are split into chunks and spread over the parallelFor threads.
+void skinMeshes(const SkinningJob* jobs, int jobCount);
@@ -0,0 +1,325 @@
+#include "TlsfAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+const int TlsfAllocator::SecondLevelBits;
+const int TlsfAllocator::SecondLevelCount;
+const int TlsfAllocator::FirstLevelCount;
+
+namespace
+{
+    //Index of the highest / lowest set bit, value must not be 0.
+    int highestBit(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse(&index, value);
+        return (int)index;
+#else
+        return 31 - __builtin_clz(value);
+#endif
+    }
+
+    int lowestBit(uint32_t value)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (int)index;
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    //List a block of this size belongs to. Below SecondLevelCount every size gets its own list.
+    void mapping(uint32_t size, int& firstLevel, int& secondLevel)
+    {
+        if (size < (uint32_t)TlsfAllocator::SecondLevelCount)
+        {
+            firstLevel = 0;
+            secondLevel = (int)size;
+            return;
+        }
+
+        int top = highestBit(size);
+        firstLevel = top - TlsfAllocator::SecondLevelBits + 1;
+        secondLevel = (int)(size >> (top - TlsfAllocator::SecondLevelBits)) ^ TlsfAllocator::SecondLevelCount;
+    }
+}
+
+TlsfAllocator::TlsfAllocator(uint32_t capacity)
+{
+    reset(capacity);
+}
+
+void TlsfAllocator::reset(uint32_t capacity)
+{
+    //Records are kept but retired, so handles from before the reset stay invalid.
+    unusedBlocks.clear();
+    for (int i = (int)blocks.size() - 1; i >= 0; i--) recycleBlock(i);
+
+    firstLevelBitmap = 0;
+    for (int i = 0; i < FirstLevelCount; i++)
+    {
+        secondLevelBitmap[i] = 0;
+        for (int j = 0; j < SecondLevelCount; j++) freeLists[i][j] = -1;
+    }
+
+    totalSize = capacity;
+    usedSize = 0;
+    liveAllocations = 0;
+    firstBlock = -1;
+
+    if (capacity == 0) return;
+
+    int block = newBlock();
+    blocks[block].offset = 0;
+    blocks[block].size = capacity;
+    blocks[block].prevPhysical = -1;
+    blocks[block].nextPhysical = -1;
+    blocks[block].free = true;
+    insertFree(block);
+    firstBlock = block;
+}
+
+AllocationHandle TlsfAllocator::allocate(uint32_t size)
+{
+    if (size == 0 || size > totalSize) return NullAllocation;
+
+    int block = findFree(size);
+    if (block < 0) return NullAllocation;
+    removeFree(block);
+
+    //Split off the rest, it goes back into the free lists.
+    if (blocks[block].size > size)
+    {
+        int rest = newBlock();
+        Block& b = blocks[block];
+        Block& r = blocks[rest];
+
+        r.offset = b.offset + size;
+        r.size = b.size - size;
+        r.prevPhysical = block;
+        r.nextPhysical = b.nextPhysical;
+        r.free = true;
+        if (b.nextPhysical >= 0) blocks[b.nextPhysical].prevPhysical = rest;
+
+        b.nextPhysical = rest;
+        b.size = size;
+        insertFree(rest);
+    }
+
+    blocks[block].free = false;
+    usedSize += size;
+    liveAllocations++;
+    return { (uint32_t)block, blocks[block].generation };
+}
+
+void TlsfAllocator::release(AllocationHandle handle)
+{
+    if (!valid(handle)) return;
+
+    int block = (int)handle.index;
+    blocks[block].free = true;
+    blocks[block].generation++;
+    usedSize -= blocks[block].size;
+    liveAllocations--;
+
+    //Free blocks never touch, merge with both neighbours.
+    int next = blocks[block].nextPhysical;
+    if (next >= 0 && blocks[next].free)
+    {
+        removeFree(next);
+        mergeNext(block);
+    }
+
+    int prev = blocks[block].prevPhysical;
+    if (prev >= 0 && blocks[prev].free)
+    {
+        removeFree(prev);
+        mergeNext(prev);
+        block = prev;
+    }
+
+    insertFree(block);
+}
+
+bool TlsfAllocator::valid(AllocationHandle handle) const
+{
+    return handle.index < blocks.size() && !blocks[handle.index].free && blocks[handle.index].generation == handle.generation;
+}
+
+uint32_t TlsfAllocator::defragment(uint32_t maxUnits, std::vector<AllocationMove>& moves)
+{
+    uint32_t moved = 0;
+
+    int block = firstBlock;
+    while (block >= 0)
+    {
+        int used = blocks[block].nextPhysical;
+        if (!blocks[block].free || used < 0)
+        {
+            block = used;
+            continue;
+        }
+
+        //A free block is always followed by a used one, slide that down and the hole moves up behind it.
+        uint32_t size = blocks[used].size;
+        if (moved > 0 && moved + size > maxUnits) break;
+
+        uint32_t from = blocks[used].offset;
+        uint32_t to = blocks[block].offset;
+        moves.push_back({ { (uint32_t)used, blocks[used].generation }, from, to, size });
+        moved += size;
+
+        int prev = blocks[block].prevPhysical;
+        int next = blocks[used].nextPhysical;
+
+        blocks[used].prevPhysical = prev;
+        blocks[used].nextPhysical = block;
+        blocks[used].offset = to;
+        if (prev >= 0) blocks[prev].nextPhysical = used;
+        else firstBlock = used;
+
+        blocks[block].prevPhysical = used;
+        blocks[block].nextPhysical = next;
+        blocks[block].offset = to + size;
+        if (next >= 0) blocks[next].prevPhysical = block;
+
+        if (next >= 0 && blocks[next].free)
+        {
+            removeFree(block);
+            removeFree(next);
+            mergeNext(block);
+            insertFree(block);
+        }
+    }
+
+    return moved;
+}
+
+uint32_t TlsfAllocator::largestFreeBlock() const
+{
+    if (firstLevelBitmap == 0) return 0;
+
+    int firstLevel = highestBit(firstLevelBitmap);
+    int secondLevel = highestBit(secondLevelBitmap[firstLevel]);
+
+    //Sizes inside the top list differ, look at all of them.
+    uint32_t largest = 0;
+    for (int block = freeLists[firstLevel][secondLevel]; block >= 0; block = blocks[block].nextFree)
+    {
+        if (blocks[block].size > largest) largest = blocks[block].size;
+    }
+    return largest;
+}
+
+bool TlsfAllocator::compact() const
+{
+    bool hole = false;
+    for (int block = firstBlock; block >= 0; block = blocks[block].nextPhysical)
+    {
+        if (blocks[block].free) hole = true;
+        else if (hole) return false;
+    }
+    return true;
+}
+
+int TlsfAllocator::newBlock()
+{
+    if (!unusedBlocks.empty())
+    {
+        int block = unusedBlocks.back();
+        unusedBlocks.pop_back();
+        return block;
+    }
+
+    Block block = {};
+    blocks.push_back(block);
+    return (int)blocks.size() - 1;
+}
+
+void TlsfAllocator::recycleBlock(int block)
+{
+    blocks[block].free = true;
+    blocks[block].generation++;
+    unusedBlocks.push_back(block);
+}
+
+void TlsfAllocator::insertFree(int block)
+{
+    int firstLevel, secondLevel;
+    mapping(blocks[block].size, firstLevel, secondLevel);
+
+    int head = freeLists[firstLevel][secondLevel];
+    blocks[block].prevFree = -1;
+    blocks[block].nextFree = head;
+    if (head >= 0) blocks[head].prevFree = block;
+    freeLists[firstLevel][secondLevel] = block;
+
+    firstLevelBitmap |= 1u << firstLevel;
+    secondLevelBitmap[firstLevel] |= 1u << secondLevel;
+}
+
+void TlsfAllocator::removeFree(int block)
+{
+    int firstLevel, secondLevel;
+    mapping(blocks[block].size, firstLevel, secondLevel);
+
+    int prev = blocks[block].prevFree;
+    int next = blocks[block].nextFree;
+    if (next >= 0) blocks[next].prevFree = prev;
+    if (prev >= 0)
+    {
+        blocks[prev].nextFree = next;
+        return;
+    }
+
+    freeLists[firstLevel][secondLevel] = next;
+    if (next < 0)
+    {
+        secondLevelBitmap[firstLevel] &= ~(1u << secondLevel);
+        if (secondLevelBitmap[firstLevel] == 0) firstLevelBitmap &= ~(1u << firstLevel);
+    }
+}
+
+int TlsfAllocator::findFree(uint32_t size) const
+{
+    //Round up to the next list boundary so every block in the list found is big enough.
+    uint64_t rounded = size;
+    if (size >= (uint32_t)SecondLevelCount) rounded += (1ull << (highestBit(size) - SecondLevelBits)) - 1;
+
+    int firstLevel, secondLevel;
+    if (rounded <= 0xffffffffull)
+    {
+        mapping((uint32_t)rounded, firstLevel, secondLevel);
+
+        uint32_t secondMap = secondLevelBitmap[firstLevel] & (~0u << secondLevel);
+        uint32_t firstMap = firstLevel + 1 < 32 ? firstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+        if (secondMap != 0) return freeLists[firstLevel][lowestBit(secondMap)];
+        if (firstMap != 0)
+        {
+            firstLevel = lowestBit(firstMap);
+            return freeLists[firstLevel][lowestBit(secondLevelBitmap[firstLevel])];
+        }
+    }
+
+    //Nothing in the bigger lists, a block in size's own list may still fit (a freed mesh of the same size).
+    mapping(size, firstLevel, secondLevel);
+    for (int block = freeLists[firstLevel][secondLevel]; block >= 0; block = blocks[block].nextFree)
+    {
+        if (blocks[block].size >= size) return block;
+    }
+    return -1;
+}
+
+void TlsfAllocator::mergeNext(int block)
+{
+    int next = blocks[block].nextPhysical;
+    blocks[block].size += blocks[next].size;
+    blocks[block].nextPhysical = blocks[next].nextPhysical;
+    if (blocks[next].nextPhysical >= 0) blocks[blocks[next].nextPhysical].prevPhysical = block;
+    recycleBlock(next);
+}
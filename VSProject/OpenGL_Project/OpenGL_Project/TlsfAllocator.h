@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+//Two level segregated fit allocator over a range of abstract units (bytes, vertices, indices...).
+//Only bookkeeping, the memory itself lives somewhere else (a GL buffer), so it runs and can be tested without GL.
+//Allocation and release are O(1): free blocks sit in lists bucketed by size (first level = power of two,
+//second level = 16 linear steps inside it) with a bitmap per level to find the first non-empty list.
+
+struct AllocationHandle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    bool operator==(const AllocationHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const AllocationHandle& other) const { return !(*this == other); }
+};
+
+const AllocationHandle NullAllocation = { 0xffffffffu, 0 };
+
+//An allocation defragment moved, the data has to be copied from from to to (size units, ranges may overlap).
+struct AllocationMove
+{
+    AllocationHandle handle;
+    uint32_t from;
+    uint32_t to;
+    uint32_t size;
+};
+
+class TlsfAllocator
+{
+public:
+    explicit TlsfAllocator(uint32_t capacity = 0);
+
+    //Drops every allocation, all handles become invalid.
+    void reset(uint32_t capacity);
+
+    //NullAllocation when size is 0 or no free block is big enough.
+    AllocationHandle allocate(uint32_t size);
+    void release(AllocationHandle handle);
+
+    bool valid(AllocationHandle handle) const;
+    //Offsets change when defragment moves the allocation, sizes never do.
+    uint32_t offset(AllocationHandle handle) const { return blocks[handle.index].offset; }
+    uint32_t size(AllocationHandle handle) const { return blocks[handle.index].size; }
+
+    //Slides allocations down into the free space in front of them, at most maxUnits per call (but always at
+    //least one allocation when there is a hole) so the copies can be spread over several frames.
+    //Appends the moves to moves, offsets are already updated when it returns. Returns the units moved.
+    uint32_t defragment(uint32_t maxUnits, std::vector<AllocationMove>& moves);
+
+    uint32_t capacity() const { return totalSize; }
+    uint32_t usedSpace() const { return usedSize; }
+    int allocationCount() const { return liveAllocations; }
+    uint32_t largestFreeBlock() const;
+    //True when every allocation is packed at the start.
+    bool compact() const;
+
+    static const int SecondLevelBits = 4;
+    static const int SecondLevelCount = 1 << SecondLevelBits;
+    static const int FirstLevelCount = 32 - SecondLevelBits + 1;
+
+private:
+    struct Block
+    {
+        uint32_t offset;
+        uint32_t size;
+        int prevPhysical;       //Neighbours in address order, -1 at the ends.
+        int nextPhysical;
+        int prevFree;           //Neighbours in the free list, only used while free.
+        int nextFree;
+        uint32_t generation;
+        bool free;
+    };
+
+    int newBlock();
+    void recycleBlock(int block);
+
+    void insertFree(int block);
+    void removeFree(int block);
+    int findFree(uint32_t size) const;
+
+    //Merges block with its free physical successor, the successor's record is recycled.
+    void mergeNext(int block);
+
+    std::vector<Block> blocks;
+    std::vector<int> unusedBlocks;
+    int firstBlock = -1;
+
+    uint32_t firstLevelBitmap = 0;
+    uint32_t secondLevelBitmap[FirstLevelCount];
+    int freeLists[FirstLevelCount][SecondLevelCount];
+
+    uint32_t totalSize = 0;
+    uint32_t usedSize = 0;
+    int liveAllocations = 0;
+};
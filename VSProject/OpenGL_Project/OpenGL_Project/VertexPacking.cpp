@@ -0,0 +1,301 @@
+#include "VertexPacking.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "Simd.h"
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define VERTEX_PACKING_F16C 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    //Vertices are converted in chunks so the temporary arrays stay on the stack.
+    const int ChunkVertices = 256;
+    const int MaxComponents = 4;
+
+    struct FormatInfo
+    {
+        GLenum type;
+        GLboolean normalized;
+        int componentBytes;
+    };
+
+    FormatInfo formatInfo(VertexFormat format)
+    {
+        switch (format)
+        {
+        case VertexHalf: return { GL_HALF_FLOAT, GL_FALSE, 2 };
+        case VertexUnorm8: return { GL_UNSIGNED_BYTE, GL_TRUE, 1 };
+        case VertexUnorm16: return { GL_UNSIGNED_SHORT, GL_TRUE, 2 };
+        case VertexSnorm16: return { GL_SHORT, GL_TRUE, 2 };
+        case VertexOctahedral: return { GL_SHORT, GL_TRUE, 2 };
+        default: return { GL_FLOAT, GL_FALSE, 4 };
+        }
+    }
+
+    //Round to nearest even float -> half, handles denormals, infinity and NaN.
+    uint16_t floatToHalf(float value)
+    {
+        uint32_t x;
+        std::memcpy(&x, &value, sizeof(x));
+
+        uint32_t sign = x & 0x80000000u;
+        x ^= sign;
+
+        uint16_t result;
+        if (x >= (127u + 16u) << 23)
+        {
+            result = x > 0x7f800000u ? 0x7e00 : 0x7c00;
+        }
+        else if (x < 113u << 23)
+        {
+            //Let the float adder do the denormal rounding.
+            const uint32_t denormalMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+            float denormalMagic;
+            std::memcpy(&denormalMagic, &denormalMagicBits, sizeof(denormalMagic));
+
+            float f;
+            std::memcpy(&f, &x, sizeof(f));
+            f += denormalMagic;
+
+            uint32_t bits;
+            std::memcpy(&bits, &f, sizeof(bits));
+            result = (uint16_t)(bits - denormalMagicBits);
+        }
+        else
+        {
+            uint32_t mantissaOdd = (x >> 13) & 1;
+            x += ((uint32_t)(15 - 127) << 23) + 0xfff;
+            x += mantissaOdd;
+            result = (uint16_t)(x >> 13);
+        }
+
+        return (uint16_t)(result | (sign >> 16));
+    }
+
+    //clamp(value, lo, hi) * scale rounded to the nearest integer, four values per step.
+    void quantizeBulk(const float* input, int32_t* output, int count, float lo, float hi, float scale)
+    {
+        int i = 0;
+#ifdef SIMD_SSE2
+        __m128 low = _mm_set1_ps(lo);
+        __m128 high = _mm_set1_ps(hi);
+        __m128 factor = _mm_set1_ps(scale);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i), low), high);
+            _mm_storeu_si128((__m128i*)(output + i), _mm_cvtps_epi32(_mm_mul_ps(value, factor)));
+        }
+#endif
+        for (; i < count; i++)
+        {
+            float value = input[i] < lo ? lo : (input[i] > hi ? hi : input[i]);
+            output[i] = (int32_t)std::lrint(value * scale);
+        }
+    }
+
+    //Project onto the octahedron, then fold the lower half over the diagonals. For float or Float4 lanes.
+    template<typename T>
+    SIMD_INLINE void octahedral(T& x, T& y, T z)
+    {
+        T zero(0.0f);
+        T one(1.0f);
+
+        T length = vabs(x) + vabs(y) + vabs(z);
+        T inverse = vselect(length > zero, one / length, zero);
+        x = x * inverse;
+        y = y * inverse;
+
+        T foldedX = (one - vabs(y)) * vselect(x >= zero, one, -one);
+        T foldedY = (one - vabs(x)) * vselect(y >= zero, one, -one);
+        auto lower = z < zero;
+        x = vselect(lower, foldedX, x);
+        y = vselect(lower, foldedY, y);
+    }
+
+    void writeComponents(const void* packed, int componentBytes, int components, int vertexCount, unsigned char* output, int stride)
+    {
+        const unsigned char* source = (const unsigned char*)packed;
+        int bytes = componentBytes * components;
+
+        for (int v = 0; v < vertexCount; v++)
+        {
+            std::memcpy(output + (size_t)v * stride, source + v * bytes, bytes);
+        }
+    }
+}
+
+void packHalfBulk(const float* input, uint16_t* output, int count)
+{
+    int i = 0;
+#ifdef VERTEX_PACKING_F16C
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(input + i), _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128((__m128i*)(output + i), half);
+    }
+#endif
+    for (; i < count; i++) output[i] = floatToHalf(input[i]);
+}
+
+void packUnorm8Bulk(const float* input, uint8_t* output, int count)
+{
+    int32_t quantized[ChunkVertices * MaxComponents];
+    for (int first = 0; first < count; first += ChunkVertices * MaxComponents)
+    {
+        int n = count - first < ChunkVertices * MaxComponents ? count - first : ChunkVertices * MaxComponents;
+        quantizeBulk(input + first, quantized, n, 0.0f, 1.0f, 255.0f);
+        for (int i = 0; i < n; i++) output[first + i] = (uint8_t)quantized[i];
+    }
+}
+
+void packUnorm16Bulk(const float* input, uint16_t* output, int count)
+{
+    int32_t quantized[ChunkVertices * MaxComponents];
+    for (int first = 0; first < count; first += ChunkVertices * MaxComponents)
+    {
+        int n = count - first < ChunkVertices * MaxComponents ? count - first : ChunkVertices * MaxComponents;
+        quantizeBulk(input + first, quantized, n, 0.0f, 1.0f, 65535.0f);
+        for (int i = 0; i < n; i++) output[first + i] = (uint16_t)quantized[i];
+    }
+}
+
+void packSnorm16Bulk(const float* input, int16_t* output, int count)
+{
+    int32_t quantized[ChunkVertices * MaxComponents];
+    for (int first = 0; first < count; first += ChunkVertices * MaxComponents)
+    {
+        int n = count - first < ChunkVertices * MaxComponents ? count - first : ChunkVertices * MaxComponents;
+        quantizeBulk(input + first, quantized, n, -1.0f, 1.0f, 32767.0f);
+        for (int i = 0; i < n; i++) output[first + i] = (int16_t)quantized[i];
+    }
+}
+
+void encodeOctahedralBulk(const float* normals, float* output, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        //xyz triples to one lane per normal.
+        const float* n = normals + i * 3;
+        Float4 x(n[0], n[3], n[6], n[9]);
+        Float4 y(n[1], n[4], n[7], n[10]);
+        Float4 z(n[2], n[5], n[8], n[11]);
+        octahedral(x, y, z);
+
+        float xs[4], ys[4];
+        x.store(xs);
+        y.store(ys);
+        for (int lane = 0; lane < 4; lane++)
+        {
+            output[(i + lane) * 2] = xs[lane];
+            output[(i + lane) * 2 + 1] = ys[lane];
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        float x = normals[i * 3];
+        float y = normals[i * 3 + 1];
+        octahedral(x, y, normals[i * 3 + 2]);
+        output[i * 2] = x;
+        output[i * 2 + 1] = y;
+    }
+}
+
+PackedVertexLayout makePackedLayout(const VertexAttributeSource* sources, int sourceCount)
+{
+    PackedVertexLayout layout;
+    int offset = 0;
+
+    for (int i = 0; i < sourceCount; i++)
+    {
+        FormatInfo info = formatInfo(sources[i].format);
+
+        PackedVertexAttribute attribute;
+        attribute.location = sources[i].location;
+        attribute.size = sources[i].format == VertexOctahedral ? 2 : sources[i].components;
+        attribute.type = info.type;
+        attribute.normalized = info.normalized;
+        attribute.offset = offset;
+        layout.attributes.push_back(attribute);
+
+        int bytes = attribute.size * info.componentBytes;
+        offset += (bytes + 3) & ~3;
+    }
+
+    layout.stride = offset;
+    return layout;
+}
+
+bool packVertices(const float* vertices, int vertexCount, int floatsPerVertex,
+    const VertexAttributeSource* sources, int sourceCount, const PackedVertexLayout& layout, void* output)
+{
+    //The chunk arrays below hold MaxComponents per vertex.
+    for (int a = 0; a < sourceCount; a++)
+    {
+        int components = sources[a].components;
+        if (components < 1 || components > MaxComponents || (sources[a].format == VertexOctahedral && components != 3)) return false;
+    }
+
+    unsigned char* bytes = (unsigned char*)output;
+    std::memset(bytes, 0, (size_t)vertexCount * layout.stride);
+
+    float gathered[ChunkVertices * MaxComponents];
+    float octahedral[ChunkVertices * 2];
+    unsigned char packed[ChunkVertices * MaxComponents * 4];
+
+    for (int a = 0; a < sourceCount; a++)
+    {
+        const VertexAttributeSource& source = sources[a];
+        const PackedVertexAttribute& attribute = layout.attributes[a];
+        int componentBytes = formatInfo(source.format).componentBytes;
+
+        for (int first = 0; first < vertexCount; first += ChunkVertices)
+        {
+            int n = vertexCount - first < ChunkVertices ? vertexCount - first : ChunkVertices;
+
+            //Gather this attribute into a flat array so the converters can run straight through it.
+            for (int v = 0; v < n; v++)
+            {
+                const float* vertex = vertices + (size_t)(first + v) * floatsPerVertex + source.offset;
+                for (int c = 0; c < source.components; c++) gathered[v * source.components + c] = vertex[c];
+            }
+
+            const float* values = gathered;
+            int valueCount = n * source.components;
+            if (source.format == VertexOctahedral)
+            {
+                encodeOctahedralBulk(gathered, octahedral, n);
+                values = octahedral;
+                valueCount = n * 2;
+            }
+
+            switch (source.format)
+            {
+            case VertexHalf: packHalfBulk(values, (uint16_t*)packed, valueCount); break;
+            case VertexUnorm8: packUnorm8Bulk(values, (uint8_t*)packed, valueCount); break;
+            case VertexUnorm16: packUnorm16Bulk(values, (uint16_t*)packed, valueCount); break;
+            case VertexSnorm16:
+            case VertexOctahedral: packSnorm16Bulk(values, (int16_t*)packed, valueCount); break;
+            default: std::memcpy(packed, values, valueCount * sizeof(float)); break;
+            }
+
+            writeComponents(packed, componentBytes, attribute.size, n, bytes + (size_t)first * layout.stride + attribute.offset, layout.stride);
+        }
+    }
+    return true;
+}
+
+void applyVertexLayout(const PackedVertexLayout& layout)
+{
+    for (size_t i = 0; i < layout.attributes.size(); i++)
+    {
+        const PackedVertexAttribute& attribute = layout.attributes[i];
+        glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, layout.stride, (void*)(size_t)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+//Compresses interleaved float vertices (like the ones in createSquare) into smaller GPU formats
+//and generates the matching glVertexAttribPointer calls.
+enum VertexFormat
+{
+    VertexFloat,        //32 bit float per component, unchanged.
+    VertexHalf,         //16 bit float per component.
+    VertexUnorm8,       //[0, 1] to 8 bit, for colors.
+    VertexUnorm16,      //[0, 1] to 16 bit, for texture coordinates that don't wrap past 1.
+    VertexSnorm16,      //[-1, 1] to 16 bit.
+    VertexOctahedral    //Unit normal (3 components in) to 2 x snorm16 e, decode in the shader with
+                        //n = vec3(e, 1 - |e.x| - |e.y|), if n.z < 0 then n.xy = (1 - |n.yx|) * sign(n.xy), normalize(n).
+};
+
+//One attribute of the float source vertex.
+struct VertexAttributeSource
+{
+    GLuint location;
+    int components;
+    int offset;         //In floats from the start of the source vertex.
+    VertexFormat format;
+};
+
+struct PackedVertexAttribute
+{
+    GLuint location;
+    GLint size;
+    GLenum type;
+    GLboolean normalized;
+    int offset;         //In bytes from the start of the packed vertex.
+};
+
+struct PackedVertexLayout
+{
+    std::vector<PackedVertexAttribute> attributes;
+    int stride;
+};
+
+//Byte layout for the given attributes, every attribute starts on a 4 byte boundary.
+PackedVertexLayout makePackedLayout(const VertexAttributeSource* sources, int sourceCount);
+
+//Convert vertexCount source vertices of floatsPerVertex floats into output (vertexCount * layout.stride bytes).
+//Fails, writing nothing, when a source has more than 4 components (or an octahedral one not 3).
+bool packVertices(const float* vertices, int vertexCount, int floatsPerVertex,
+    const VertexAttributeSource* sources, int sourceCount, const PackedVertexLayout& layout, void* output);
+
+//glVertexAttribPointer + glEnableVertexAttribArray for every attribute, the VBO must be bound.
+void applyVertexLayout(const PackedVertexLayout& layout);
+
+//Bulk converters used by packVertices. The quantizers and the octahedral mapping run 4 values at a time (SSE2 where
+//available), halves 8 at a time where the compiler targets F16C and one at a time otherwise.
+void packHalfBulk(const float* input, uint16_t* output, int count);
+void packUnorm8Bulk(const float* input, uint8_t* output, int count);
+void packUnorm16Bulk(const float* input, uint16_t* output, int count);
+void packSnorm16Bulk(const float* input, int16_t* output, int count);
+
+//count normals (xyz) into count * 2 octahedral coordinates in [-1, 1].
+void encodeOctahedralBulk(const float* normals, float* output, int count);
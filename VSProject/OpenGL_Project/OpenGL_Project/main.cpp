@@ -1,5 +1,7 @@
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -11,18 +13,57 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "BumpArena.h"
+#include "ConstexprTransform.h"
+#include "ImageInfo.h"
+#include "JobSystem.h"
+#include "Parallel.h"
+#include "RenderThread.h"
+#include "SceneComponents.h"
+#include "VertexPacking.h"
+
 
 void processInput(GLFWwindow* window);
 int init(GLFWwindow* &window);
 
-void createTriangle(GLuint &vao, int &size);
-void createSquare(GLuint &vao, unsigned int& ebo, unsigned int& texture1, unsigned int& texture2, int &size);
+void createTriangle(GLuint &vao, GLuint &vbo, int &size);
+void createSquare(MeshBuffers& meshes, MeshHandle& square, unsigned int& texture1, unsigned int& texture2);
 void createShaders(); 
 void createProgram(GLuint& program, const char* vertex, const char* fragment);
 
 void loadFile(const char* filename, char*& output);
+void stbiParallelFor(void*, int count, stbi_parallel_task* task, void* taskData);
+bool loadImageInto(const char* filename, unsigned char* pixels, int width, int height);
 
 GLuint simpleProgram;
+GLuint batchedProgram;
+
+//Unit square, scaled to half size at compile time.
+constexpr ConstFloatArray<32> squareVertices = constTransformPositions(ConstFloatArray<32>
+{ {
+    //Positions          //Colors           //Texture coords
+     1.0f,  1.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 1.0f,
+     1.0f, -1.0f, 0.0f,   0.0f, 1.0f, 0.0f,   1.0f, 0.0f,
+    -1.0f, -1.0f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f,
+    -1.0f,  1.0f, 0.0f,   1.0f, 1.0f, 0.0f,   0.0f, 1.0f
+} }, 8, constScale(constIdentity(), { 0.5f, 0.5f, 1.0f }));
+static_assert(squareVertices.values[0] == 0.5f && squareVertices.values[17] == -0.5f && squareVertices.values[3] == 1.0f, "square scaled at compile time");
+
+//Half positions, unorm8 colors and unorm16 texture coordinates (16 bytes instead of 32 per vertex).
+const VertexAttributeSource meshAttributes[] =
+{
+    { 0, 3, 0, VertexHalf },
+    { 1, 3, 3, VertexUnorm8 },
+    { 2, 2, 6, VertexUnorm16 }
+};
+
+//Shared mesh storage and the most meshes drawn through the batch per frame.
+const int MeshVertexCapacity = 64 * 1024;
+const int MeshIndexCapacity = 192 * 1024;
+const int MaxBatchedDraws = 16 * 1024;
+
+//Bytes per buffer defragmentation may copy in one frame.
+const uint32_t DefragmentBytesPerFrame = 256 * 1024;
 
 int main()
 {
@@ -30,48 +71,102 @@ int main()
     int resultInit = init(window);
     if (resultInit != 0) return resultInit;
 
-    GLuint VAO;
-    unsigned int EBO;
+    //The main thread joins the workers whenever it waits, the GL setup below stays on it.
+    startJobSystem();
+
+    //Big JPEGs decode their restart intervals, IDCT and color conversion on the workers too.
+    //With a single worker that would only add the bookkeeping of splitting them up.
+    if (workerCount() > 1) stbi_set_parallel_for(stbiParallelFor, nullptr);
+    //GL's first row is the bottom one, and filtering premultiplied colors keeps dark fringes off transparent edges.
+    //The decoders do both while writing the rows, so neither costs another pass.
+    stbi_set_flip_vertically_on_load(true);
+    stbi_set_premultiply_on_load(true);
+
+    //Static meshes share one vertex and one index buffer and are drawn with a single multi draw.
+    if (!loadMultiDrawIndirect()) std::cout << "No multi draw indirect, batches fall back to one draw per mesh" << std::endl;
+
+    MeshBuffers meshes;
+    meshes.create(makePackedLayout(meshAttributes, 3), MeshVertexCapacity, MeshIndexCapacity);
+
+    MeshHandle square;
     unsigned int texture1;
     unsigned int texture2;
-    int triangleSize;
-    createSquare(VAO, EBO, texture1, texture2, triangleSize);
+    createSquare(meshes, square, texture1, texture2);
     createShaders();
 
+    IndirectBatch batch;
+    batch.create(meshes, MaxBatchedDraws);
+
+    //The square as an entity, the draw loop below renders whatever entities have a BatchedMesh or a Renderable.
+    EcsWorld world;
+    world.create(BatchedMesh{ square }, makeTransform());
+
+    SystemSchedule systems;
+    addSceneSystems(systems);
+
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     //Create viewport.
     glViewport(0, 0, 1280, 720);
 
+    GLint texture1Location = glGetUniformLocation(batchedProgram, "texture1");
+    GLint texture2Location = glGetUniformLocation(batchedProgram, "texture2");
+
+    //From here on GL belongs to the render thread, the loop below only records commands for it.
+    glfwMakeContextCurrent(NULL);
+    RenderThread renderThread;
+    renderThread.start(window);
+
+    DrawQueue drawQueue;
+    int frame = 0;
+
     //Render loop.
     while (!glfwWindowShouldClose(window))
     {
         //Input
         processInput(window);
 
+        //Simulation, overlaps with the render thread replaying the previous frame.
+        systems.run(world);
+
         //Rendering
-        glClearColor(0.5f, 0.2f, 0.9f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+        CommandBuffer& commands = renderThread.beginFrame();
+
+        //Copies first, the draws below already use the new places.
+        meshes.defragment(commands, DefragmentBytesPerFrame);
 
-        glUseProgram(simpleProgram);
+        commands.clear(0.5f, 0.2f, 0.9f, 1.0f, GL_COLOR_BUFFER_BIT);
 
-        glUniform1i(glGetUniformLocation(simpleProgram, "texture1"), 0);
-        glUniform1i(glGetUniformLocation(simpleProgram, "texture2"), 1);
+        commands.useProgram(batchedProgram);
+        commands.setUniformInt(texture1Location, 0);
+        commands.setUniformInt(texture2Location, 1);
+        commands.bindTexture(0, texture1);
+        commands.bindTexture(1, texture2);
+        int batchedDraws = recordBatchedMeshes(world, meshes, batch, commands);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture1);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, texture2);
+        RenderStats stats = recordRenderables(world, drawQueue, commands);
+        renderThread.submitFrame();
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        //Draw and state change counts in the title, refreshed every couple of seconds.
+        if (frame++ % 120 == 0)
+        {
+            std::string title = "OpenGL_Proj - " + std::to_string(batchedDraws) + " batched + " + std::to_string(stats.draws) + " draws, " + std::to_string(stats.stateChanges()) + " state changes";
+            glfwSetWindowTitle(window, title.c_str());
+        }
 
         //Polling
-        glfwSwapBuffers(window);
         glfwPollEvents();
+
+        //Jobs queued for the main thread (window and input calls), GL only goes through the command buffers.
+        runMainThreadJobs();
     }
 
+    renderThread.stop();
+    stopJobSystem();
+
+    batch.destroy();
+    meshes.destroy();
+
     //Close window.
     glfwTerminate();
 
@@ -113,7 +208,7 @@ int init(GLFWwindow*& window)
     return 0;
 }
 
-void createTriangle(GLuint &vao, int &size)
+void createTriangle(GLuint &vao, GLuint &vbo, int &size)
 {
     float vertices[] = 
     {
@@ -125,9 +220,8 @@ void createTriangle(GLuint &vao, int &size)
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
 
-    GLuint VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
@@ -137,97 +231,105 @@ void createTriangle(GLuint &vao, int &size)
     size = sizeof(vertices);
 }
 
-void createSquare(GLuint& vao, unsigned int& ebo, unsigned int& texture1, unsigned int& texture2, int& size)
+void createSquare(MeshBuffers& meshes, MeshHandle& square, unsigned int& texture1, unsigned int& texture2)
 {
-    float vertices[] = 
-    {
-        //Positions          //Colors           //Texture coords
-         0.5f,  0.5f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f, 1.0f,
-         0.5f, -0.5f, 0.0f,   0.0f, 1.0f, 0.0f,   1.0f, 0.0f,
-        -0.5f, -0.5f, 0.0f,   0.0f, 0.0f, 1.0f,   0.0f, 0.0f,
-        -0.5f,  0.5f, 0.0f,   1.0f, 1.0f, 0.0f,   0.0f, 1.0f
-    };
-    unsigned int indices[] = 
+    const float* vertices = squareVertices.values;
+    GLuint indices[] = 
     {
         0, 1, 3,
         1, 2, 3
     };
 
-    glGenTextures(1, &texture1); 
-    glGenTextures(1, &texture2); 
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture1);
-
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, texture2);
-
-    //Texture filtering.
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    //Create texture 1.
-    int width, height, nrChannels;
-    unsigned char *data1 = stbi_load("sprites/container.jpg", &width, &height, &nrChannels, 0);
-
-    if (data1)
+    glGenTextures(1, &texture1);
+    glGenTextures(1, &texture2);
+
+    //Both images are decoded by jobs straight into mapped pixel unpack buffers, RGB expanded to RGBA on the way,
+    //so GL uploads from the buffers without another copy. Mapping and uploads stay on the main thread.
+    const char* files[2] = { "sprites/container.jpg", "sprites/awesomeface.png" };
+    unsigned int textures[2] = { texture1, texture2 };
+    GLint internalFormats[2] = { GL_RGB, GL_RGBA };
+    int widths[2] = {};
+    int heights[2] = {};
+    GLuint unpackBuffers[2];
+    unsigned char* pixels[2] = { nullptr, nullptr };
+    bool loaded[2] = { false, false };
+
+    //Sizes come from the headers alone, scanned in parallel.
+    std::vector<ImageInfo> infos = scanImageInfo({ files[0], files[1] });
+
+    glGenBuffers(2, unpackBuffers);
+    for (int i = 0; i < 2; i++)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data1);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        if (infos[i].channels == 0) continue;
+        widths[i] = (int)infos[i].width;
+        heights[i] = (int)infos[i].height;
+
+        GLsizeiptr size = (GLsizeiptr)widths[i] * heights[i] * 4;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffers[i]);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        pixels[i] = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
     }
-    else
+
+    JobCounter decoded;
+    for (int i = 0; i < 2; i++)
     {
-        std::cout << "Failed to load texture" << std::endl;
+        if (pixels[i] == nullptr) continue;
+        scheduleJob([&, i]() { loaded[i] = loadImageInto(files[i], pixels[i], widths[i], heights[i]); }, &decoded);
     }
+    waitForCounter(decoded);
 
-    //Create texture 2.
-    unsigned char* data2 = stbi_load("sprites/awesomeface.png", &width, &height, &nrChannels, 0);
-
-    if (data2)
+    for (int i = 0; i < 2; i++)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data2);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+
+        //Texture filtering.
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        //Unmapping fails when the buffer's memory got lost meanwhile, its contents are undefined then.
+        bool intact = false;
+        if (pixels[i] != nullptr)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, unpackBuffers[i]);
+            intact = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+        }
+
+        if (loaded[i] && intact)
+        {
+            //With a pixel unpack buffer bound the data pointer is an offset into it.
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[i], widths[i], heights[i], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        else
+        {
+            std::cout << "Failed to load texture " << files[i] << std::endl;
+        }
     }
 
-    //Free data from storage.
-    stbi_image_free(data1);
-    stbi_image_free(data2);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glDeleteBuffers(2, unpackBuffers);
 
     //Create square.
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    glGenBuffers(1, &ebo);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    GLuint VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    //Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    //Color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+    const PackedVertexLayout& layout = meshes.layout();
 
-    //Texture coordinates attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    const int vertexCount = squareVertices.Count / 8;
+    std::vector<unsigned char> packedVertices(vertexCount * layout.stride);
+    packVertices(vertices, vertexCount, 8, meshAttributes, 3, layout, packedVertices.data());
 
-    size = sizeof(vertices);
+    square = meshes.addMesh(packedVertices.data(), vertexCount, indices, 6);
+    if (!meshes.valid(square))
+    {
+        std::cout << "Mesh buffers full" << std::endl;
+    }
 }
 
 void createShaders()
 {
     createProgram(simpleProgram, "shaders/SimpleVertex.shader", "shaders/SimpleFragment.shader");
+    createProgram(batchedProgram, "shaders/BatchedVertex.shader", "shaders/SimpleFragment.shader");
 }
 
 void createProgram(GLuint& programID, const char* vertex, const char* fragment)
@@ -316,4 +418,33 @@ void loadFile(const char* filename, char*& output)
         //If it failed just set it to null.
         output = NULL;
     }
-}
\ No newline at end of file
+}
+
+//Hands stb_image's parallel loops to parallelFor, one item (an interval or band of rows) at a time.
+void stbiParallelFor(void*, int count, stbi_parallel_task* task, void* taskData)
+{
+    parallelFor(count, 1, [=](int begin, int end) { task(taskData, begin, end); });
+}
+
+//Decodes an image as RGBA into pixels (width * height, tightly packed).
+//The pixels go straight to the caller, so all stb_image allocates meanwhile is scratch: it comes out of the
+//thread's arena and is dropped in one go afterwards. Decodes nest when the thread runs other jobs while
+//stb_image waits for its parallel loops, every one rewinds only to its own mark.
+bool loadImageInto(const char* filename, unsigned char* pixels, int width, int height)
+{
+    BumpArena& arena = threadArena();
+    BumpArena::Marker start = arena.mark();
+
+    stbi_allocator allocator;
+    allocator.alloc = [](void* user, size_t size) { return ((BumpArena*)user)->allocate(size); };
+    allocator.realloc = [](void* user, void* p, size_t oldSize, size_t newSize) { return ((BumpArena*)user)->reallocate(p, oldSize, newSize); };
+    allocator.free = [](void*, void*) {};
+    allocator.user = &arena;
+
+    const stbi_allocator* previous = stbi_set_allocator_thread(&allocator);
+    bool loaded = stbi_load_into(filename, pixels, width * 4, width, height, nullptr, nullptr, nullptr, 4) != 0;
+    stbi_set_allocator_thread(previous);
+
+    arena.rewind(start);
+    return loaded;
+}
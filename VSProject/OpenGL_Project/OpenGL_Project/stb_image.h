@@ -14,6 +14,7 @@
 
    You can #define STBI_ASSERT(x) before the #include to avoid using assert.h.
    And #define STBI_MALLOC, STBI_REALLOC, and STBI_FREE to avoid using malloc,realloc,free
+   (or see stbi_set_allocator_thread to pick an allocator at run-time)
 
 
    QUICK NOTES:
@@ -257,15 +258,17 @@ RECENT REVISION HISTORY:
 //
 // SIMD support
 //
-// The JPEG decoder will try to automatically use SIMD kernels on x86 when
-// supported by the compiler. For ARM Neon support, you must explicitly
-// request it.
+// The JPEG decoder and the PNG unfilter step will try to automatically use
+// SIMD kernels on x86 when supported by the compiler. For ARM Neon support,
+// you must explicitly request it.
 //
 // (The old do-it-yourself SIMD API is no longer supported in the current
 // code.)
 //
 // On x86, SSE2 will automatically be used when available based on a run-time
-// test; if not, the generic C versions are used as a fall-back. On ARM targets,
+// test; if not, the generic C versions are used as a fall-back. The JPEG IDCT,
+// h2v2 upsampling and YCbCr->RGB conversion also have AVX2 versions that are
+// picked the same way (define STBI_NO_AVX2 to leave them out). On ARM targets,
 // the typical path is to have separate builds for NEON and non-NEON devices
 // (at least this is true for iOS and Android). Therefore, the NEON support is
 // toggled by a build flag: define STBI_NEON to get NEON loops.
@@ -276,6 +279,72 @@ RECENT REVISION HISTORY:
 //
 // ===========================================================================
 //
+// Decoding into your own memory
+//
+// stbi_load_into() and friends decode into a buffer you provide, such as a
+// mapped pixel unpack buffer, instead of one stb_image allocates:
+//
+//    stbi_load_into(filename, out, out_stride, out_x, out_y, &x, &y, &n, 4);
+//
+// out holds out_y rows of out_x pixels, out_stride bytes apart (at least
+// out_x*desired_channels). desired_channels is required here; asking for 4
+// from an RGB file expands it to RGBA with alpha 255 while writing. The image
+// lands in the top-left x*y pixels and the rest of the buffer is untouched;
+// an image bigger than out_x*out_y fails. They return 1 on success and 0 on
+// failure, after which the buffer contents are undefined. The vertical flip
+// and premultiply settings are honoured.
+//
+// JPEG, 8-bit non-interlaced PNG without tRNS and paletted PNG write their
+// rows straight into out. The other formats still decode into a temporary
+// image first, which is then copied in.
+//
+// The same decoders also convert to desired_channels, flip and premultiply
+// each row as they write it, in stbi_load too. For the other formats those
+// are extra passes over the decoded image.
+//
+// ===========================================================================
+//
+// Decoding in bands and regions
+//
+// stbi_load_bands() and friends hand the image to a callback a band of rows
+// at a time instead of returning it whole, so the pixels of a huge image
+// never have to be in memory at once, and each band can be uploaded (say
+// with glTexSubImage2D) before the next one is decoded:
+//
+//    int band(void *user, stbi_uc const *pixels, int stride, int y, int rows);
+//    stbi_load_bands(filename, 64, band, user, &x, &y, &n, 4);
+//
+// pixels holds rows rows of x pixels, stride bytes apart, which are rows y to
+// y+rows-1 of the image stbi_load would return; the flip and premultiply
+// settings are honoured. Bands come in file order, which is bottom-up when
+// flipping. The memory is reused for the next band. Returning 0 from the
+// callback stops decoding and the call fails; otherwise they return 1 on
+// success and 0 on failure.
+//
+// JPEG and the PNGs that write finished rows (see above) convert straight
+// into a band buffer. They still hold what they decode from: the JPEG
+// component planes, the inflated PNG data. Other formats decode the whole
+// image and hand that over in bands.
+//
+// stbi_load_region() and friends return just the rectangle of region_w by
+// region_h pixels at region_x,region_y of the image stbi_load would return.
+// *x and *y get the size of the part of it that is inside the image. JPEG
+// skips the IDCT of the blocks away from the rectangle and stops reading
+// after its last row if it can; PNG stops after the last row.
+//
+// ===========================================================================
+//
+// Parallel decoding
+//
+// stb_image never starts threads of its own, but an application that has a
+// thread pool can lend it with stbi_set_parallel_for(). The JPEG decoder then
+// decodes the restart intervals of baseline scans on separate workers, and
+// runs the IDCT and the upsampling/color conversion over bands of rows in
+// parallel. The output is identical to the serial decode. Huffman decoding of
+// a scan without restart markers has to stay serial, so such files gain less.
+//
+// ===========================================================================
+//
 // HDR image support   (disable by defining STBI_NO_HDR)
 //
 // stb_image supports loading HDR images in general, and currently the Radiance
@@ -433,6 +502,35 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
 #endif
 
+// decode into out (out_y rows of out_x pixels, out_stride bytes apart); return 1 on success
+STBIDEF int stbi_load_into_from_memory   (stbi_uc           const *buffer, int len   , stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk  , void *user, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_into               (char const *filename, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_into_from_file     (FILE *f,              stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
+// hand the image to band a band of band_rows rows at a time; return 1 on success
+typedef int stbi_band_callback(void *user, stbi_uc const *pixels, int stride, int y, int rows);
+
+STBIDEF int stbi_load_bands_from_memory   (stbi_uc           const *buffer, int len   , int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_bands_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF int stbi_load_bands               (char const *filename, int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF int stbi_load_bands_from_file     (FILE *f,              int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
+// decode just a rectangle of the image; *x, *y get the size of its part inside the image
+STBIDEF stbi_uc *stbi_load_region_from_memory   (stbi_uc           const *buffer, int len   , int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_region_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *channels_in_file, int desired_channels);
+
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_region               (char const *filename, int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *channels_in_file, int desired_channels);
+STBIDEF stbi_uc *stbi_load_region_from_file     (FILE *f,              int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
+
 #ifdef STBI_WINDOWS_UTF8
 STBIDEF int stbi_convert_wchar_to_utf8(char *buffer, size_t bufferlen, const wchar_t* input);
 #endif
@@ -517,12 +615,38 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// multiply the color channels of 8-bit images with alpha by their alpha, the form that
+// filters and blends (with ONE, ONE_MINUS_SRC_ALPHA) without fringes
+STBIDEF void stbi_set_premultiply_on_load(int flag_true_if_should_premultiply);
+
 // as above, but only applies to images loaded on the thread that calls the function
 // this function is only available if your compiler supports thread-local variables;
 // calling it will fail to link if your compiler doesn't
 STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpremultiply);
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
+STBIDEF void stbi_set_premultiply_on_load_thread(int flag_true_if_should_premultiply);
+
+// lend stb_image a thread pool (see "Parallel decoding" above). parallel_for must call
+// task(task_data, begin, end) on disjoint ranges that together cover [0,count), from any
+// threads, and return once all of them have returned. NULL decodes serially again.
+typedef void stbi_parallel_task(void *task_data, int begin, int end);
+typedef void stbi_parallel_for(void *user, int count, stbi_parallel_task *task, void *task_data);
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *parallel_for, void *user);
+
+// allocator for everything stb_image allocates and frees on the calling thread, including the
+// images it returns, instead of STBI_MALLOC & co. user is passed back to every call, free gets
+// NULL too, realloc is told the old size. set it around a decode and restore the one this
+// returns afterwards (NULL is STBI_MALLOC & co), e.g. to decode out of an arena that is reset
+// once the image has been used. only available with thread-local variables, like the above
+typedef struct
+{
+   void *(*alloc)  (void *user, size_t size);
+   void *(*realloc)(void *user, void *p, size_t old_size, size_t new_size);
+   void  (*free)   (void *user, void *p);
+   void *user;
+} stbi_allocator;
+STBIDEF stbi_allocator const *stbi_set_allocator_thread(stbi_allocator const *allocator);
 
 // ZLIB client - used by PNG, available for other purposes
 
@@ -750,7 +874,7 @@ static int stbi__cpuid3(void)
 
 #define STBI_SIMD_ALIGN(type, name) __declspec(align(16)) type name
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    int info3 = stbi__cpuid3();
@@ -761,7 +885,7 @@ static int stbi__sse2_available(void)
 #else // assume GCC-style if not VC++
 #define STBI_SIMD_ALIGN(type, name) type name __attribute__((aligned(16)))
 
-#if !defined(STBI_NO_JPEG) && defined(STBI_SSE2)
+#if (!defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)) && defined(STBI_SSE2)
 static int stbi__sse2_available(void)
 {
    // If we're even attempting to compile this on GCC/Clang, that means
@@ -774,6 +898,35 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 kernels for the JPEG decoder, built next to the SSE2 ones and chosen at run-time.
+// GCC and Clang compile them per function, so the rest of the file needs no -mavx2.
+#if defined(STBI_SSE2) && !defined(STBI_NO_AVX2) && !defined(STBI_NO_JPEG) && \
+    (defined(__AVX2__) || (defined(_MSC_VER) && _MSC_VER >= 1800) || defined(__clang__) || \
+     (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define STBI_AVX2
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#define STBI__AVX2_TARGET
+static int stbi__avx2_available(void)
+{
+   int info[4];
+   __cpuid(info,1);
+   // the OS has to save the ymm registers too (OSXSAVE, then XCR0 bits 1 and 2)
+   if (((info[2] >> 27) & 1) == 0 || (_xgetbv(0) & 6) != 6)
+      return 0;
+   __cpuidex(info,7,0);
+   return ((info[1] >> 5) & 1) != 0;
+}
+#else
+#define STBI__AVX2_TARGET __attribute__((target("avx2")))
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -817,6 +970,22 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   // how the 8-bit interface wants rows laid out; stbi__result_info says if the loader did it
+   int flip, premultiply;
+
+   // caller's buffer for stbi_load_into, NULL otherwise
+   stbi_uc *into;
+   int into_stride, into_x, into_y;
+
+   // stbi_load_bands: finished rows go through band_buffer to band instead of into an image
+   stbi_band_callback *band;
+   void *band_user;
+   int band_rows, band_stride;
+   stbi_uc *band_buffer;
+
+   // stbi_load_region: the part of the image that is wanted, in output coordinates; loaders may skip the rest
+   int roi_x0, roi_y0, roi_x1, roi_y1;
 } stbi__context;
 
 
@@ -830,6 +999,11 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->callback_already_read = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   s->flip = s->premultiply = 0;
+   s->into = NULL;
+   s->band = NULL;
+   s->roi_x0 = s->roi_y0 = 0;
+   s->roi_x1 = s->roi_y1 = 0x7fffffff;
 }
 
 // initialize a callback-based context
@@ -843,6 +1017,11 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
    s->img_buffer = s->img_buffer_original = s->buffer_start;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
+   s->flip = s->premultiply = 0;
+   s->into = NULL;
+   s->band = NULL;
+   s->roi_x0 = s->roi_y0 = 0;
+   s->roi_x1 = s->roi_y1 = 0x7fffffff;
 }
 
 #ifndef STBI_NO_STDIO
@@ -903,6 +1082,7 @@ typedef struct
    int bits_per_channel;
    int num_channels;
    int channel_order;
+   int flipped, premultiplied; // the loader already honoured stbi__context flip / premultiply
 } stbi__result_info;
 
 #ifndef STBI_NO_JPEG
@@ -982,9 +1162,43 @@ static int stbi__err(const char *str)
 }
 #endif
 
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL stbi_allocator const *stbi__allocator;
+
+STBIDEF stbi_allocator const *stbi_set_allocator_thread(stbi_allocator const *allocator)
+{
+   stbi_allocator const *previous = stbi__allocator;
+   stbi__allocator = allocator;
+   return previous;
+}
+#endif
+
 static void *stbi__malloc(size_t size)
 {
-    return STBI_MALLOC(size);
+#ifdef STBI_THREAD_LOCAL
+   if (stbi__allocator) return stbi__allocator->alloc(stbi__allocator->user, size);
+#endif
+   return STBI_MALLOC(size);
+}
+
+static void *stbi__realloc_sized(void *p, size_t oldsz, size_t newsz)
+{
+#ifdef STBI_THREAD_LOCAL
+   if (stbi__allocator) {
+      if (p == NULL) return stbi__allocator->alloc(stbi__allocator->user, newsz);
+      return stbi__allocator->realloc(stbi__allocator->user, p, oldsz, newsz);
+   }
+#endif
+   STBI_NOTUSED(oldsz);
+   return STBI_REALLOC_SIZED(p, oldsz, newsz);
+}
+
+static void stbi__free(void *p)
+{
+#ifdef STBI_THREAD_LOCAL
+   if (stbi__allocator) { stbi__allocator->free(stbi__allocator->user, p); return; }
+#endif
+   STBI_FREE(p);
 }
 
 // stb_image uses ints pervasively, including for offset calculations.
@@ -1100,7 +1314,7 @@ static int stbi__mul2shorts_valid(int a, int b)
 
 STBIDEF void stbi_image_free(void *retval_from_stbi_load)
 {
-   STBI_FREE(retval_from_stbi_load);
+   stbi__free(retval_from_stbi_load);
 }
 
 #ifndef STBI_NO_LINEAR
@@ -1134,6 +1348,140 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+static int stbi__premultiply_on_load_global = 0;
+
+STBIDEF void stbi_set_premultiply_on_load(int flag_true_if_should_premultiply)
+{
+   stbi__premultiply_on_load_global = flag_true_if_should_premultiply;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__premultiply_on_load  stbi__premultiply_on_load_global
+#else
+static STBI_THREAD_LOCAL int stbi__premultiply_on_load_local, stbi__premultiply_on_load_set;
+
+STBIDEF void stbi_set_premultiply_on_load_thread(int flag_true_if_should_premultiply)
+{
+   stbi__premultiply_on_load_local = flag_true_if_should_premultiply;
+   stbi__premultiply_on_load_set = 1;
+}
+
+#define stbi__premultiply_on_load  (stbi__premultiply_on_load_set       \
+                                     ? stbi__premultiply_on_load_local  \
+                                     : stbi__premultiply_on_load_global)
+#endif // STBI_THREAD_LOCAL
+
+static stbi_parallel_for *stbi__parallel_for_func;
+static void *stbi__parallel_for_user;
+
+STBIDEF void stbi_set_parallel_for(stbi_parallel_for *parallel_for, void *user)
+{
+   stbi__parallel_for_func = parallel_for;
+   stbi__parallel_for_user = user;
+}
+
+#ifndef STBI_NO_JPEG
+// runs task over [0,count), through the application's parallel-for when there is one
+static void stbi__parallel_run(int count, stbi_parallel_task *task, void *task_data)
+{
+   if (stbi__parallel_for_func && count > 1) {
+      // tasks allocate with whatever allocator the thread running them has set, and whatever
+      // else this thread gets to run while it waits mustn't inherit the caller's
+#ifdef STBI_THREAD_LOCAL
+      stbi_allocator const *allocator = stbi_set_allocator_thread(NULL);
+#endif
+      stbi__parallel_for_func(stbi__parallel_for_user, count, task, task_data);
+#ifdef STBI_THREAD_LOCAL
+      stbi_set_allocator_thread(allocator);
+#endif
+   } else if (count > 0)
+      task(task_data, 0, count);
+}
+#endif
+
+// for loaders that write finished rows: where row 0 goes, in the stbi_load_into buffer or in
+// a new img_x*img_y*n image, and the distance to the next row (negative when flipping).
+// *image gets the start of that buffer. NULL if it can't be allocated or doesn't fit
+static stbi_uc *stbi__output_rows(stbi__context *s, int n, int flip, int *stride, stbi_uc **image)
+{
+   stbi_uc *base;
+   if (s->into) {
+      if (s->img_x > (stbi__uint32) s->into_x || s->img_y > (stbi__uint32) s->into_y)
+         return stbi__errpuc("too large", "Image larger than the output buffer");
+      base = s->into;
+      *stride = s->into_stride;
+   } else {
+      base = (stbi_uc *) stbi__malloc_mad3(n, s->img_x, s->img_y, 0);
+      if (base == NULL) return stbi__errpuc("outofmem", "Out of memory");
+      *stride = n * s->img_x;
+   }
+   *image = base;
+   if (flip) {
+      base += (ptrdiff_t) *stride * (s->img_y - 1);
+      *stride = -*stride;
+   }
+   return base;
+}
+
+#if !defined(STBI_NO_JPEG) || !defined(STBI_NO_PNG)
+// the image rows (in file order) a loader has to write: all of them, or for stbi_load_region
+// the whole bands from the first to the last one holding rows it wants
+static void stbi__roi_rows(stbi__context *s, stbi__uint32 *first, stbi__uint32 *last)
+{
+   stbi__uint32 y0 = (stbi__uint32) s->roi_y0, y1 = (stbi__uint32) s->roi_y1;
+   if (y1 > s->img_y) y1 = s->img_y;
+   if (y0 > y1) y0 = y1;
+   if (s->flip) {
+      stbi__uint32 t = s->img_y - y1;
+      y1 = s->img_y - y0;
+      y0 = t;
+   }
+   if (s->band) {
+      stbi__uint32 rows = (stbi__uint32) s->band_rows < s->img_y ? (stbi__uint32) s->band_rows : s->img_y;
+      y0 -= y0 % rows;
+      y1 = (y1 + rows-1) / rows * rows;
+      if (y1 > s->img_y) y1 = s->img_y;
+   }
+   *first = y0;
+   *last = y1;
+}
+
+// stbi_load_bands: loaders that write finished rows with n channels put them in a buffer of
+// band_rows rows, handed to the callback whenever it is full. NULL if it can't be allocated
+static stbi_uc *stbi__band_start(stbi__context *s, int n)
+{
+   if ((stbi__uint32) s->band_rows > s->img_y) s->band_rows = s->img_y;
+   s->band_stride = n * s->img_x;
+   s->band_buffer = (stbi_uc *) stbi__malloc_mad3(n, s->img_x, s->band_rows, 0);
+   if (s->band_buffer == NULL) return stbi__errpuc("outofmem", "Out of memory");
+   return s->band_buffer;
+}
+
+// where image row j (in file order) goes in the band buffer; when flipping, the rows of a band are too
+static stbi_uc *stbi__band_row(stbi__context *s, stbi__uint32 j)
+{
+   stbi__uint32 first = j - j % s->band_rows;
+   stbi__uint32 rows = s->img_y - first < (stbi__uint32) s->band_rows ? s->img_y - first : (stbi__uint32) s->band_rows;
+   stbi__uint32 k = s->flip ? first + rows-1 - j : j - first;
+   return s->band_buffer + (size_t) s->band_stride * k;
+}
+
+// call once row j is written: hands its band over if that completes it and any of its rows
+// are wanted. 0 if the callback stopped decoding
+static int stbi__band_row_done(stbi__context *s, stbi__uint32 j)
+{
+   stbi__uint32 first = j - j % s->band_rows;
+   int rows, y;
+   if (j+1 != s->img_y && (j+1) % s->band_rows != 0) return 1;
+   rows = (int) (j+1 - first);
+   y = s->flip ? (int) (s->img_y - (j+1)) : (int) first;
+   if (y >= s->roi_y1 || y + rows <= s->roi_y0) return 1;
+   if (!s->band(s->band_user, s->band_buffer, s->band_stride, y, rows))
+      return stbi__err("stopped", "Band callback stopped decoding");
+   return 1;
+}
+#endif
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1199,7 +1547,7 @@ static stbi_uc *stbi__convert_16_to_8(stbi__uint16 *orig, int w, int h, int chan
    for (i = 0; i < img_len; ++i)
       reduced[i] = (stbi_uc)((orig[i] >> 8) & 0xFF); // top half of each byte is sufficient approx of 16->8 bit scaling
 
-   STBI_FREE(orig);
+   stbi__free(orig);
    return reduced;
 }
 
@@ -1215,7 +1563,7 @@ static stbi__uint16 *stbi__convert_8_to_16(stbi_uc *orig, int w, int h, int chan
    for (i = 0; i < img_len; ++i)
       enlarged[i] = (stbi__uint16)((orig[i] << 8) + orig[i]); // replicate to high and low byte, maps 0->0, 255->0xffff
 
-   STBI_FREE(orig);
+   stbi__free(orig);
    return enlarged;
 }
 
@@ -1243,6 +1591,25 @@ static void stbi__vertical_flip(void *image, int w, int h, int bytes_per_pixel)
    }
 }
 
+// multiplies the color channels of count pixels with n channels by their alpha, if they have any
+static void stbi__premultiply_row(stbi_uc *p, int n, stbi__uint32 count)
+{
+   stbi__uint32 i;
+   if (n == 2) {
+      for (i=0; i < count; ++i, p += 2) {
+         unsigned int t = p[0]*p[1] + 128;
+         p[0] = (stbi_uc) ((t + (t >> 8)) >> 8);
+      }
+   } else if (n == 4) {
+      for (i=0; i < count; ++i, p += 4) {
+         unsigned int a = p[3], r = p[0]*a + 128, g = p[1]*a + 128, b = p[2]*a + 128;
+         p[0] = (stbi_uc) ((r + (r >> 8)) >> 8);
+         p[1] = (stbi_uc) ((g + (g >> 8)) >> 8);
+         p[2] = (stbi_uc) ((b + (b >> 8)) >> 8);
+      }
+   }
+}
+
 #ifndef STBI_NO_GIF
 static void stbi__vertical_flip_slices(void *image, int w, int h, int z, int bytes_per_pixel)
 {
@@ -1260,7 +1627,11 @@ static void stbi__vertical_flip_slices(void *image, int w, int h, int z, int byt
 static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
-   void *result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
+   void *result;
+
+   s->flip = stbi__vertically_flip_on_load;
+   s->premultiply = stbi__premultiply_on_load;
+   result = stbi__load_main(s, x, y, comp, req_comp, &ri, 8);
 
    if (result == NULL)
       return NULL;
@@ -1275,10 +1646,13 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
 
    // @TODO: move stbi__convert_format to here
 
-   if (stbi__vertically_flip_on_load) {
+   // extra passes for the loaders that didn't flip and premultiply while writing rows
+   if (s->flip && !ri.flipped) {
       int channels = req_comp ? req_comp : *comp;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
    }
+   if (s->premultiply && !ri.premultiplied)
+      stbi__premultiply_row((stbi_uc *) result, req_comp ? req_comp : *comp, (stbi__uint32) *x * *y);
 
    return (unsigned char *) result;
 }
@@ -1310,6 +1684,168 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
    return (stbi__uint16 *) result;
 }
 
+static int stbi__load_into_main(stbi__context *s, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__result_info ri;
+   void *result;
+   int w, h, n;
+
+   if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   if (out == NULL || out_x < 0 || out_y < 0 || out_stride / req_comp < out_x)
+      return stbi__err("bad output", "Output buffer too small for its size");
+
+   s->into = out;
+   s->into_stride = out_stride;
+   s->into_x = out_x;
+   s->into_y = out_y;
+   s->flip = stbi__vertically_flip_on_load;
+   s->premultiply = stbi__premultiply_on_load;
+   result = stbi__load_main(s, &w, &h, &n, req_comp, &ri, 8);
+   if (result == NULL)
+      return 0;
+
+   // formats that didn't decode straight into out are copied over, flipping and
+   // premultiplying on the way if they didn't
+   if (result != out) {
+      stbi_uc *row0, *image;
+      int stride, j;
+      if (ri.bits_per_channel != 8) {
+         result = stbi__convert_16_to_8((stbi__uint16 *) result, w, h, req_comp);
+         if (result == NULL) return 0;
+      }
+      s->img_x = w;
+      s->img_y = h;
+      row0 = stbi__output_rows(s, req_comp, s->flip && !ri.flipped, &stride, &image);
+      if (row0) {
+         for (j=0; j < h; ++j) {
+            stbi_uc *dest = row0 + (ptrdiff_t) stride * j;
+            memcpy(dest, (stbi_uc *) result + (size_t) w * req_comp * j, (size_t) w * req_comp);
+            if (s->premultiply && !ri.premultiplied)
+               stbi__premultiply_row(dest, req_comp, w);
+         }
+      }
+      stbi__free(result);
+      if (!row0) return 0;
+   }
+
+   if (x) *x = w;
+   if (y) *y = h;
+   if (comp) *comp = n;
+   return 1;
+}
+
+static int stbi__load_bands_main(stbi__context *s, int band_rows, stbi_band_callback *band, void *user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__result_info ri;
+   void *result;
+   int w, h, n;
+
+   if (req_comp < 0 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   if (band == NULL || band_rows < 1) return stbi__err("bad band", "No band callback or band size");
+
+   s->band = band;
+   s->band_user = user;
+   s->band_rows = band_rows;
+   s->band_buffer = NULL;
+   s->flip = stbi__vertically_flip_on_load;
+   s->premultiply = stbi__premultiply_on_load;
+   result = stbi__load_main(s, &w, &h, &n, req_comp, &ri, 8);
+   if (result == NULL)
+      return 0;
+
+   // formats that don't decode in bands hand over bands of the whole image
+   if (result != s->band_buffer) {
+      int channels = req_comp ? req_comp : n, j;
+      size_t stride = (size_t) w * channels;
+      if (ri.bits_per_channel != 8) {
+         result = stbi__convert_16_to_8((stbi__uint16 *) result, w, h, channels);
+         if (result == NULL) return 0;
+      }
+      if (s->flip && !ri.flipped)
+         stbi__vertical_flip(result, w, h, channels);
+      if (s->premultiply && !ri.premultiplied)
+         stbi__premultiply_row((stbi_uc *) result, channels, (stbi__uint32) w * h);
+      s->img_x = w;
+      s->img_y = h;
+      for (j=0; j < h; j += band_rows) {
+         int rows = h - j < band_rows ? h - j : band_rows;
+         if (j >= s->roi_y1 || j + rows <= s->roi_y0) continue;
+         if (!band(user, (stbi_uc *) result + stride * j, (int) stride, j, rows)) {
+            stbi__free(result);
+            return stbi__err("stopped", "Band callback stopped decoding");
+         }
+      }
+   }
+   stbi__free(result);
+
+   if (x) *x = w;
+   if (y) *y = h;
+   if (comp) *comp = n;
+   return 1;
+}
+
+// stbi_load_region copies the wanted part of the bands out
+typedef struct
+{
+   stbi__context *s;
+   stbi_uc *image;
+   int x0, y0, x1, y1; // the part of the region inside the image, once the first band is in
+   int outofmem;
+} stbi__region;
+
+static int stbi__region_band(void *user, stbi_uc const *pixels, int stride, int y, int rows)
+{
+   stbi__region *r = (stbi__region *) user;
+   stbi__context *s = r->s;
+   int n = stride / (int) s->img_x; // the rows of a band are packed
+   int j, first, last;
+   size_t bytes;
+
+   if (r->image == NULL) {
+      r->x0 = s->roi_x0;
+      r->y0 = s->roi_y0;
+      r->x1 = s->roi_x1 < (int) s->img_x ? s->roi_x1 : (int) s->img_x;
+      r->y1 = s->roi_y1 < (int) s->img_y ? s->roi_y1 : (int) s->img_y;
+      if (r->x0 >= r->x1) return 1; // no column of it is inside the image
+      r->image = (stbi_uc *) stbi__malloc_mad3(r->x1 - r->x0, r->y1 - r->y0, n, 0);
+      if (r->image == NULL) {
+         r->outofmem = 1;
+         return 0;
+      }
+   }
+
+   bytes = (size_t) (r->x1 - r->x0) * n;
+   first = y > r->y0 ? y : r->y0;
+   last = y + rows < r->y1 ? y + rows : r->y1;
+   for (j=first; j < last; ++j)
+      memcpy(r->image + bytes * (j - r->y0), pixels + (size_t) stride * (j - y) + (size_t) r->x0 * n, bytes);
+   return 1;
+}
+
+static stbi_uc *stbi__load_region_main(stbi__context *s, int rx, int ry, int rw, int rh, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__region r;
+
+   if (rx < 0 || ry < 0 || rw < 1 || rh < 1) return stbi__errpuc("bad region", "Empty or negative region");
+
+   s->roi_x0 = rx;
+   s->roi_y0 = ry;
+   s->roi_x1 = rw > 0x7fffffff - rx ? 0x7fffffff : rx + rw;
+   s->roi_y1 = rh > 0x7fffffff - ry ? 0x7fffffff : ry + rh;
+   r.s = s;
+   r.image = NULL;
+   r.outofmem = 0;
+   if (!stbi__load_bands_main(s, 16, stbi__region_band, &r, NULL, NULL, comp, req_comp)) {
+      stbi__free(r.image);
+      return r.outofmem ? stbi__errpuc("outofmem", "Out of memory") : NULL;
+   }
+   if (r.image == NULL) return stbi__errpuc("bad region", "Region outside the image");
+
+   if (x) *x = r.x1 - r.x0;
+   if (y) *y = r.y1 - r.y0;
+   return r.image;
+}
+
 #if !defined(STBI_NO_HDR) && !defined(STBI_NO_LINEAR)
 static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, int req_comp)
 {
@@ -1399,6 +1935,75 @@ STBIDEF stbi__uint16 *stbi_load_from_file_16(FILE *f, int *x, int *y, int *comp,
    return result;
 }
 
+STBIDEF int stbi_load_into(char const *filename, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_load_into_from_file(f,out,out_stride,out_x,out_y,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_into_from_file(FILE *f, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *comp, int req_comp)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_into_main(&s,out,out_stride,out_x,out_y,x,y,comp,req_comp);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+
+STBIDEF int stbi_load_bands(char const *filename, int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   int result;
+   if (!f) return stbi__err("can't fopen", "Unable to open file");
+   result = stbi_load_bands_from_file(f,band_rows,band,band_user,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF int stbi_load_bands_from_file(FILE *f, int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *comp, int req_comp)
+{
+   int result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_bands_main(&s,band_rows,band,band_user,x,y,comp,req_comp);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+
+STBIDEF stbi_uc *stbi_load_region(char const *filename, int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *comp, int req_comp)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   stbi_uc *result;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   result = stbi_load_region_from_file(f,region_x,region_y,region_w,region_h,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
+STBIDEF stbi_uc *stbi_load_region_from_file(FILE *f, int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *comp, int req_comp)
+{
+   stbi_uc *result;
+   stbi__context s;
+   stbi__start_file(&s,f);
+   result = stbi__load_region_main(&s,region_x,region_y,region_w,region_h,x,y,comp,req_comp);
+   if (result) {
+      // need to 'unget' all the characters in the IO buffer
+      fseek(f, - (int) (s.img_buffer_end - s.img_buffer), SEEK_CUR);
+   }
+   return result;
+}
+
 STBIDEF stbi_us *stbi_load_16(char const *filename, int *x, int *y, int *comp, int req_comp)
 {
    FILE *f = stbi__fopen(filename, "rb");
@@ -1440,6 +2045,48 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF int stbi_load_into_from_memory(stbi_uc const *buffer, int len, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_into_main(&s,out,out_stride,out_x,out_y,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_into_from_callbacks(stbi_io_callbacks const *clbk, void *user, stbi_uc *out, int out_stride, int out_x, int out_y, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_into_main(&s,out,out_stride,out_x,out_y,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_bands_from_memory(stbi_uc const *buffer, int len, int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_bands_main(&s,band_rows,band,band_user,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_bands_from_callbacks(stbi_io_callbacks const *clbk, void *user, int band_rows, stbi_band_callback *band, void *band_user, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_bands_main(&s,band_rows,band,band_user,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_region_from_memory(stbi_uc const *buffer, int len, int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   return stbi__load_region_main(&s,region_x,region_y,region_w,region_h,x,y,comp,req_comp);
+}
+
+STBIDEF stbi_uc *stbi_load_region_from_callbacks(stbi_io_callbacks const *clbk, void *user, int region_x, int region_y, int region_w, int region_h, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   return stbi__load_region_main(&s,region_x,region_y,region_w,region_h,x,y,comp,req_comp);
+}
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
 {
@@ -1665,6 +2312,9 @@ static void stbi__skip(stbi__context *s, int n)
 #else
 static int stbi__getn(stbi__context *s, stbi_uc *buffer, int n)
 {
+   // nothing to read, and buffer may be NULL then (a zero length first IDAT)
+   if (n == 0) return 1;
+
    if (s->io.read) {
       int blen = (int) (s->img_buffer_end - s->img_buffer);
       if (blen < n) {
@@ -1752,9 +2402,40 @@ static stbi_uc stbi__compute_y(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM)
 // nothing
 #else
+// converts x pixels from img_n to req_comp components; src and dest don't overlap
+static int stbi__convert_row(unsigned char *dest, unsigned char const *src, int img_n, int req_comp, unsigned int x)
+{
+   int i;
+
+   #define STBI__COMBO(a,b)  ((a)*8+(b))
+   #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (STBI__COMBO(img_n, req_comp)) {
+      case STBI__COMBO(1,1): case STBI__COMBO(2,2): case STBI__COMBO(3,3): case STBI__COMBO(4,4):
+         memcpy(dest, src, (size_t) x * img_n);
+         break;
+      STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
+      STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
+      STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
+      STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
+      STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
+      STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
+      STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
+      STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
+      default: STBI_ASSERT(0); return stbi__err("unsupported", "Unsupported format conversion");
+   }
+   #undef STBI__CASE
+   return 1;
+}
+
 static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-   int i,j;
+   int j;
    unsigned char *good;
 
    if (req_comp == img_n) return data;
@@ -1762,37 +2443,19 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
 
    good = (unsigned char *) stbi__malloc_mad3(req_comp, x, y, 0);
    if (good == NULL) {
-      STBI_FREE(data);
+      stbi__free(data);
       return stbi__errpuc("outofmem", "Out of memory");
    }
 
    for (j=0; j < (int) y; ++j) {
-      unsigned char *src  = data + j * x * img_n   ;
-      unsigned char *dest = good + j * x * req_comp;
-
-      #define STBI__COMBO(a,b)  ((a)*8+(b))
-      #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (STBI__COMBO(img_n, req_comp)) {
-         STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
-         STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
-         STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
-         STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
-         STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
-         STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
-         STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
-         STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
+      if (!stbi__convert_row(good + j * x * req_comp, data + j * x * img_n, img_n, req_comp, x)) {
+         stbi__free(data);
+         stbi__free(good);
+         return NULL;
       }
-      #undef STBI__CASE
    }
 
-   STBI_FREE(data);
+   stbi__free(data);
    return good;
 }
 #endif
@@ -1819,7 +2482,7 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
 
    good = (stbi__uint16 *) stbi__malloc(req_comp * x * y * 2);
    if (good == NULL) {
-      STBI_FREE(data);
+      stbi__free(data);
       return (stbi__uint16 *) stbi__errpuc("outofmem", "Out of memory");
    }
 
@@ -1844,12 +2507,12 @@ static stbi__uint16 *stbi__convert_format16(stbi__uint16 *data, int img_n, int r
          STBI__CASE(4,1) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]);                   } break;
          STBI__CASE(4,2) { dest[0]=stbi__compute_y_16(src[0],src[1],src[2]); dest[1] = src[3]; } break;
          STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                       } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return (stbi__uint16*) stbi__errpuc("unsupported", "Unsupported format conversion");
+         default: STBI_ASSERT(0); stbi__free(data); stbi__free(good); return (stbi__uint16*) stbi__errpuc("unsupported", "Unsupported format conversion");
       }
       #undef STBI__CASE
    }
 
-   STBI_FREE(data);
+   stbi__free(data);
    return good;
 }
 #endif
@@ -1861,7 +2524,7 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
    float *output;
    if (!data) return NULL;
    output = (float *) stbi__malloc_mad4(x, y, comp, sizeof(float), 0);
-   if (output == NULL) { STBI_FREE(data); return stbi__errpf("outofmem", "Out of memory"); }
+   if (output == NULL) { stbi__free(data); return stbi__errpf("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
    for (i=0; i < x*y; ++i) {
@@ -1874,7 +2537,7 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp)
          output[i*comp + n] = data[i*comp + n]/255.0f;
       }
    }
-   STBI_FREE(data);
+   stbi__free(data);
    return output;
 }
 #endif
@@ -1887,7 +2550,7 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
    stbi_uc *output;
    if (!data) return NULL;
    output = (stbi_uc *) stbi__malloc_mad3(x, y, comp, 0);
-   if (output == NULL) { STBI_FREE(data); return stbi__errpuc("outofmem", "Out of memory"); }
+   if (output == NULL) { stbi__free(data); return stbi__errpuc("outofmem", "Out of memory"); }
    // compute number of non-alpha components
    if (comp & 1) n = comp; else n = comp-1;
    for (i=0; i < x*y; ++i) {
@@ -1904,7 +2567,7 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
          output[i*comp + k] = (stbi_uc) stbi__float2int(z);
       }
    }
-   STBI_FREE(data);
+   stbi__free(data);
    return output;
 }
 #endif
@@ -1974,6 +2637,7 @@ typedef struct
       stbi_uc *linebuf;
       short   *coeff;   // progressive only
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
+      int      roi_x0, roi_x1, roi_y0, roi_y1; // blocks that need the IDCT
    } img_comp[4];
 
    stbi__uint32   code_buffer; // jpeg entropy-coded buffer
@@ -1994,8 +2658,14 @@ typedef struct
    int scan_n, order[4];
    int restart_interval, todo;
 
+// stbi_load_region: MCUs that need the IDCT, and whether decoding stopped after the last of them
+   int roi_mcu_x0, roi_mcu_x1, roi_mcu_y0, roi_mcu_y1;
+   int roi_done;
+
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
+   // optional: two horizontally adjacent blocks at once, dequantizing first if dequant isn't NULL
+   void (*idct_block2_kernel)(stbi_uc *out, int out_stride, short *a, short *b, stbi__uint16 *dequant);
    void (*YCbCr_to_RGB_kernel)(stbi_uc *out, const stbi_uc *y, const stbi_uc *pcb, const stbi_uc *pcr, int count, int step);
    stbi_uc *(*resample_row_hv_2_kernel)(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs);
 } stbi__jpeg;
@@ -2704,6 +3374,203 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// the sse2 IDCT above on two blocks at once, one per 128-bit lane, so it's
+// bit-identical to the generic C version as well. a and b are the blocks
+// that go to out and out+8; when dequant is given they are dequantized on load.
+static STBI__AVX2_TARGET void stbi__idct2_avx2(stbi_uc *out, int out_stride, short *a, short *b, stbi__uint16 *dequant)
+{
+   __m256i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m256i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##lo = _mm256_unpacklo_epi16((x),(y)); \
+      __m256i c0##hi = _mm256_unpackhi_epi16((x),(y)); \
+      __m256i out0##_l = _mm256_madd_epi16(c0##lo, c0); \
+      __m256i out0##_h = _mm256_madd_epi16(c0##hi, c0); \
+      __m256i out1##_l = _mm256_madd_epi16(c0##lo, c1); \
+      __m256i out1##_h = _mm256_madd_epi16(c0##hi, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out##_l = _mm256_srai_epi32(_mm256_unpacklo_epi16(_mm256_setzero_si256(), (in)), 4); \
+      __m256i out##_h = _mm256_srai_epi32(_mm256_unpackhi_epi16(_mm256_setzero_si256(), (in)), 4)
+
+   // wide add
+   #define dct_wadd(out, a, b) \
+      __m256i out##_l = _mm256_add_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_add_epi32(a##_h, b##_h)
+
+   // wide sub
+   #define dct_wsub(out, a, b) \
+      __m256i out##_l = _mm256_sub_epi32(a##_l, b##_l); \
+      __m256i out##_h = _mm256_sub_epi32(a##_h, b##_h)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased_l = _mm256_add_epi32(a##_l, bias); \
+         __m256i abiased_h = _mm256_add_epi32(a##_h, bias); \
+         dct_wadd(sum, abiased, b); \
+         dct_wsub(dif, abiased, b); \
+         out0 = _mm256_packs_epi32(_mm256_srai_epi32(sum_l, s), _mm256_srai_epi32(sum_h, s)); \
+         out1 = _mm256_packs_epi32(_mm256_srai_epi32(dif_l, s), _mm256_srai_epi32(dif_h, s)); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi8(a, b); \
+      b = _mm256_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm256_unpacklo_epi16(a, b); \
+      b = _mm256_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m256i sum04 = _mm256_add_epi16(row0, row4); \
+         __m256i dif04 = _mm256_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m256i sum17 = _mm256_add_epi16(row1, row7); \
+         __m256i sum35 = _mm256_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   // row i of a in the low lane, row i of b in the high lane
+   #define dct_load(i) \
+      _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_load_si128((const __m128i *) (a + i*8))), \
+                              _mm_load_si128((const __m128i *) (b + i*8)), 1)
+
+   // row i, dequantized
+   #define dct_load_dq(i) \
+      _mm256_mullo_epi16(dct_load(i), _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *) (dequant + i*8))), \
+                                                              _mm_loadu_si128((const __m128i *) (dequant + i*8)), 1))
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   if (dequant) {
+      row0 = dct_load_dq(0); row1 = dct_load_dq(1); row2 = dct_load_dq(2); row3 = dct_load_dq(3);
+      row4 = dct_load_dq(4); row5 = dct_load_dq(5); row6 = dct_load_dq(6); row7 = dct_load_dq(7);
+   } else {
+      row0 = dct_load(0); row1 = dct_load(1); row2 = dct_load(2); row3 = dct_load(3);
+      row4 = dct_load(4); row5 = dct_load(5); row6 = dct_load(6); row7 = dct_load(7);
+   }
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose pass 1
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      // transpose pass 2
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      // transpose pass 3
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack
+      __m256i p0 = _mm256_packus_epi16(row0, row1); // a0a1a2a3...a7b0b1b2b3...b7, per lane
+      __m256i p1 = _mm256_packus_epi16(row2, row3);
+      __m256i p2 = _mm256_packus_epi16(row4, row5);
+      __m256i p3 = _mm256_packus_epi16(row6, row7);
+
+      // 8bit 8x8 transpose pass 1
+      dct_interleave8(p0, p2); // a0e0a1e1...
+      dct_interleave8(p1, p3); // c0g0c1g1...
+
+      // transpose pass 2
+      dct_interleave8(p0, p1); // a0c0e0g0...
+      dct_interleave8(p2, p3); // b0d0f0h0...
+
+      // transpose pass 3
+      dct_interleave8(p0, p2); // a0b0c0d0...
+      dct_interleave8(p1, p3); // a4b4c4d4...
+
+      // put each row of a next to the same row of b, then store two rows at a time
+      p0 = _mm256_permute4x64_epi64(p0, 0xd8);
+      p1 = _mm256_permute4x64_epi64(p1, 0xd8);
+      p2 = _mm256_permute4x64_epi64(p2, 0xd8);
+      p3 = _mm256_permute4x64_epi64(p3, 0xd8);
+      _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p0)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p0, 1)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p2)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p2, 1)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p1)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p1, 1)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_castsi256_si128(p3)); out += out_stride;
+      _mm_storeu_si128((__m128i *) out, _mm256_extracti128_si256(p3, 1));
+   }
+
+   // no sse/avx transition penalty for the sse2 code that runs next
+   _mm256_zeroupper();
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+#undef dct_load
+#undef dct_load_dq
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2946,67 +3813,230 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// decodes the baseline MCUs [mcu,end) of the current scan. components that have coefficient
+// storage (parallel decoding) keep the dequantized blocks for stbi__jpeg_finish to transform.
+// with a two-block IDCT, a block with a right neighbour in the same call waits for it.
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int mcu, int end)
+{
+   STBI_SIMD_ALIGN(short, block[128]);
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      int ha = z->img_comp[n].ha;
+      // non-interleaved data, we just need to process one block at a time,
+      // in trivial scanline order
+      // number of blocks to do just depends on how many actual "pixels" this
+      // component has, independent of interleaved MCU blocking and such
+      int w = (z->img_comp[n].x+7) >> 3;
+      int x0 = z->img_comp[n].roi_x0, x1 = z->img_comp[n].roi_x1;
+      int y0 = z->img_comp[n].roi_y0, y1 = z->img_comp[n].roi_y1;
+      int i = mcu % w, j = mcu / w, pending = 0;
+      for (; mcu < end; ++mcu) {
+         short *data = z->img_comp[n].coeff ? z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w) : block + 64*pending;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         if (!z->img_comp[n].coeff && i >= x0 && i < x1 && j >= y0 && j < y1) {
+            stbi_uc *out = z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8;
+            if (pending) {
+               z->idct_block2_kernel(out-8, z->img_comp[n].w2, block, block+64, NULL);
+               pending = 0;
+            } else if (z->idct_block2_kernel && i+1 < x1 && mcu+1 < end) {
+               pending = 1;
+            } else {
+               z->idct_block_kernel(out, z->img_comp[n].w2, data);
+            }
+         }
+         if (++i == w) { i = 0; ++j; }
+      }
+   } else { // interleaved
+      int i = mcu % z->img_mcu_x, j = mcu / z->img_mcu_x;
+      for (; mcu < end; ++mcu) {
+         int k,x,y;
+         int wanted = i >= z->roi_mcu_x0 && i < z->roi_mcu_x1 && j >= z->roi_mcu_y0 && j < z->roi_mcu_y1;
+         // scan an interleaved mcu... process scan_n components in order
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            int ha = z->img_comp[n].ha;
+            // scan out an mcu's worth of this component; that's just determined
+            // by the basic H and V specified for the component
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = i*z->img_comp[n].h + x;
+                  int y2 = j*z->img_comp[n].v + y;
+                  short *data = z->img_comp[n].coeff ? z->img_comp[n].coeff + 64 * (x2 + y2 * z->img_comp[n].coeff_w) : block + 64*(x & 1);
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  if (!z->img_comp[n].coeff && wanted) {
+                     stbi_uc *out = z->img_comp[n].data+z->img_comp[n].w2*y2*8+x2*8;
+                     if (z->idct_block2_kernel && (x & 1))
+                        z->idct_block2_kernel(out-8, z->img_comp[n].w2, block, block+64, NULL);
+                     else if (!z->idct_block2_kernel || x+1 == z->img_comp[n].h)
+                        z->idct_block_kernel(out, z->img_comp[n].w2, data);
+                  }
+               }
+            }
+         }
+         if (++i == z->img_mcu_x) { i = 0; ++j; }
+      }
+   }
+   return 1;
+}
+
+// restart intervals of a baseline scan, decoded in parallel
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *data;          // entropy-coded data of the scan
+   int *start;             // where each interval's data starts, with one more entry for the end
+   int mcus;               // MCUs in the scan
+   signed char *status;    // per interval: 1 ended in a restart marker, 0 didn't, -1 failed
+   const char **error;     // failure reason of the intervals that failed
+} stbi__jpeg_intervals;
+
+static void stbi__jpeg_decode_intervals(void *task_data, int begin, int end)
+{
+   stbi__jpeg_intervals *t = (stbi__jpeg_intervals *) task_data;
+   // every worker needs its own bit buffer and dc predictions, the tables are copied along
+   stbi__jpeg *z = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   stbi__context s;
+   int k;
+   if (z) memcpy(z, t->z, sizeof(stbi__jpeg));
+   for (k=begin; k < end; ++k) {
+      int mcu = k * t->z->restart_interval;
+      int last = t->mcus - mcu < t->z->restart_interval ? t->mcus : mcu + t->z->restart_interval;
+      if (!z) {
+         t->status[k] = -1;
+         t->error[k] = "outofmem";
+         continue;
+      }
+      stbi__start_mem(&s, t->data + t->start[k], t->start[k+1] - t->start[k]);
+      z->s = &s;
+      stbi__jpeg_reset(z);
+      if (!stbi__jpeg_decode_mcus(z, mcu, last)) {
+         t->status[k] = -1;
+         t->error[k] = stbi_failure_reason();
+         continue;
+      }
+      // the interval's data ends with its restart marker, if it has one
+      if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+      t->status[k] = STBI__RESTART(z->marker) ? 1 : 0;
+   }
+   if (z) stbi__free(z);
+}
+
+// reads the whole scan up to the marker that ends it (left in z->marker) and decodes its
+// restart intervals in parallel. returns -1 without having read anything if it can't.
+static int stbi__jpeg_parse_intervals_parallel(stbi__jpeg *z, int mcus)
+{
+   stbi__jpeg_intervals t;
+   int count = (mcus + z->restart_interval - 1) / z->restart_interval;
+   int intervals = 1, len = 0, cap = 65536, k, result = 1;
+
+   t.z = z;
+   t.mcus = mcus;
+   t.data = (stbi_uc *) stbi__malloc(cap);
+   t.start = (int *) stbi__malloc_mad2(count + 1, sizeof(int), 0);
+   t.status = (signed char *) stbi__malloc(count);
+   t.error = (const char **) stbi__malloc_mad2(count, sizeof(const char *), 0);
+   if (!t.data || !t.start || !t.status || !t.error) {
+      stbi__free(t.data); stbi__free(t.start); stbi__free(t.status); stbi__free(t.error);
+      return -1;
+   }
+
+   // copy the scan, keeping byte stuffing and markers as they are so every interval
+   // decodes exactly as it would in place
+   t.start[0] = 0;
+   while (!stbi__at_eof(z->s)) {
+      stbi_uc b = stbi__get8(z->s), c = 0;
+      if (b == 0xff) {
+         c = stbi__get8(z->s);
+         while (c == 0xff) c = stbi__get8(z->s); // consume fill bytes
+      }
+      if (len + 2 > cap) {
+         stbi_uc *p = (stbi_uc *) stbi__realloc_sized(t.data, cap, cap*2);
+         if (p == NULL) { result = stbi__err("outofmem", "Out of memory"); break; }
+         t.data = p;
+         cap *= 2;
+      }
+      t.data[len++] = b;
+      if (b == 0xff) {
+         t.data[len++] = c;
+         if (c != 0 && !STBI__RESTART(c)) {
+            z->marker = c;
+            break;
+         }
+         // extra restart markers don't start intervals, the serial decoder doesn't get to them either
+         if (c != 0 && intervals < count) t.start[intervals++] = len;
+      }
+   }
+   t.start[intervals] = len;
+
+   if (result) {
+      stbi__parallel_run(intervals, stbi__jpeg_decode_intervals, &t);
+      // report what the serial decoder would have: the first failure, up to the first
+      // interval that didn't end in a restart marker
+      for (k=0; k < intervals; ++k) {
+         if (t.status[k] < 0) {
+#ifndef STBI_NO_FAILURE_STRINGS
+            stbi__g_failure_reason = t.error[k];
+#endif
+            result = 0;
+            break;
+         }
+         if (t.status[k] == 0) break;
+      }
+   }
+
+   stbi__free(t.data); stbi__free(t.start); stbi__free(t.status); stbi__free(t.error);
+   return result;
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
    if (!z->progressive) {
-      if (z->scan_n == 1) {
-         int i,j;
-         STBI_SIMD_ALIGN(short, data[64]);
-         int n = z->order[0];
-         // non-interleaved data, we just need to process one block at a time,
-         // in trivial scanline order
-         // number of blocks to do just depends on how many actual "pixels" this
-         // component has, independent of interleaved MCU blocking and such
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               int ha = z->img_comp[n].ha;
-               if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-               // every data block is an MCU, so countdown the restart interval
-               if (--z->todo <= 0) {
-                  if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  // if it's NOT a restart, then just bail, so we get corrupt data
-                  // rather than no data
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
-               }
+      int n = z->order[0];
+      int mcus = z->scan_n == 1 ? ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3) : z->img_mcu_x * z->img_mcu_y;
+      int interval = z->restart_interval ? z->restart_interval : mcus;
+      int mcu;
+      if (stbi__parallel_for_func) {
+         if (interval < mcus) {
+            int r = stbi__jpeg_parse_intervals_parallel(z, mcus);
+            if (r >= 0) return r;
+         } else if (!z->s->band) {
+            // one long interval: keep the coefficients so stbi__jpeg_finish can run the IDCT in parallel
+            // (not when decoding in bands, they take more memory than the pixels)
+            int k;
+            for (k=0; k < z->scan_n; ++k) {
+               n = z->order[k];
+               if (z->img_comp[n].raw_coeff) continue;
+               z->img_comp[n].coeff_w = z->img_comp[n].w2 / 8;
+               z->img_comp[n].coeff_h = z->img_comp[n].h2 / 8;
+               z->img_comp[n].raw_coeff = stbi__malloc_mad3(z->img_comp[n].w2, z->img_comp[n].h2, sizeof(short), 15);
+               // without the memory, the component is just transformed right away
+               if (z->img_comp[n].raw_coeff)
+                  z->img_comp[n].coeff = (short*) (((size_t) z->img_comp[n].raw_coeff + 15) & ~15);
             }
          }
-         return 1;
-      } else { // interleaved
-         int i,j,k,x,y;
-         STBI_SIMD_ALIGN(short, data[64]);
-         for (j=0; j < z->img_mcu_y; ++j) {
-            for (i=0; i < z->img_mcu_x; ++i) {
-               // scan an interleaved mcu... process scan_n components in order
-               for (k=0; k < z->scan_n; ++k) {
-                  int n = z->order[k];
-                  // scan out an mcu's worth of this component; that's just determined
-                  // by the basic H and V specified for the component
-                  for (y=0; y < z->img_comp[n].v; ++y) {
-                     for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
-                        int ha = z->img_comp[n].ha;
-                        if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
-                     }
-                  }
-               }
-               // after all interleaved components, that's an interleaved MCU,
-               // so now count down the restart interval
-               if (--z->todo <= 0) {
-                  if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
-                  if (!STBI__RESTART(z->marker)) return 1;
-                  stbi__jpeg_reset(z);
-               }
-            }
+      }
+      // stbi_load_region: a scan with every component can stop after the last MCU row wanted
+      if (z->scan_n == z->s->img_n) {
+         int limit = z->scan_n == 1 ? z->img_comp[n].roi_y1 * ((z->img_comp[n].x+7) >> 3) : z->roi_mcu_y1 * z->img_mcu_x;
+         if (limit < mcus) {
+            mcus = limit;
+            z->roi_done = 1;
+         }
+      }
+      for (mcu=0; mcu < mcus; mcu += interval) {
+         int end = mcus - mcu < interval ? mcus : mcu + interval;
+         if (!stbi__jpeg_decode_mcus(z, mcu, end)) return 0;
+         // a full restart interval is followed by a restart marker
+         if (z->restart_interval && end - mcu == interval) {
+            if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
+            // if it's NOT a restart, then just bail, so we get corrupt data
+            // rather than no data
+            if (!STBI__RESTART(z->marker)) return 1;
+            stbi__jpeg_reset(z);
          }
-         return 1;
       }
+      return 1;
    } else {
       if (z->scan_n == 1) {
          int i,j;
@@ -3077,21 +4107,49 @@ static void stbi__jpeg_dequantize(short *data, stbi__uint16 *dequant)
       data[i] *= dequant[i];
 }
 
-static void stbi__jpeg_finish(stbi__jpeg *z)
+typedef struct
 {
-   if (z->progressive) {
-      // dequantize and idct the data
-      int i,j,n;
-      for (n=0; n < z->s->img_n; ++n) {
-         int w = (z->img_comp[n].x+7) >> 3;
-         int h = (z->img_comp[n].y+7) >> 3;
-         for (j=0; j < h; ++j) {
-            for (i=0; i < w; ++i) {
-               short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
-               stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
-            }
+   stbi__jpeg *z;
+   int n;
+} stbi__jpeg_component_rows;
+
+static void stbi__jpeg_finish_rows(void *task_data, int begin, int end)
+{
+   stbi__jpeg_component_rows *t = (stbi__jpeg_component_rows *) task_data;
+   stbi__jpeg *z = t->z;
+   int n = t->n;
+   int x0 = z->img_comp[n].roi_x0, x1 = z->img_comp[n].roi_x1;
+   int i,j;
+   if (begin < z->img_comp[n].roi_y0) begin = z->img_comp[n].roi_y0;
+   if (end > z->img_comp[n].roi_y1) end = z->img_comp[n].roi_y1;
+   for (j=begin; j < end; ++j) {
+      for (i=x0; i < x1; ++i) {
+         short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
+         stbi_uc *out = z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8;
+         // baseline blocks were dequantized while decoding
+         if (z->idct_block2_kernel && i+1 < x1) {
+            // the next block of the row follows in memory, and the two-block IDCT dequantizes as it loads
+            z->idct_block2_kernel(out, z->img_comp[n].w2, data, data+64, z->progressive ? z->dequant[z->img_comp[n].tq] : NULL);
+            ++i;
+            continue;
          }
+         if (z->progressive)
+            stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
+         z->idct_block_kernel(out, z->img_comp[n].w2, data);
+      }
+   }
+}
+
+// dequantize and idct the components that kept coefficients, one block row per task
+static void stbi__jpeg_finish(stbi__jpeg *z)
+{
+   int n;
+   for (n=0; n < z->s->img_n; ++n) {
+      if (z->img_comp[n].coeff) {
+         stbi__jpeg_component_rows t;
+         t.z = z;
+         t.n = n;
+         stbi__parallel_run((z->img_comp[n].y+7) >> 3, stbi__jpeg_finish_rows, &t);
       }
    }
 }
@@ -3244,17 +4302,17 @@ static int stbi__free_jpeg_components(stbi__jpeg *z, int ncomp, int why)
    int i;
    for (i=0; i < ncomp; ++i) {
       if (z->img_comp[i].raw_data) {
-         STBI_FREE(z->img_comp[i].raw_data);
+         stbi__free(z->img_comp[i].raw_data);
          z->img_comp[i].raw_data = NULL;
          z->img_comp[i].data = NULL;
       }
       if (z->img_comp[i].raw_coeff) {
-         STBI_FREE(z->img_comp[i].raw_coeff);
+         stbi__free(z->img_comp[i].raw_coeff);
          z->img_comp[i].raw_coeff = 0;
          z->img_comp[i].coeff = 0;
       }
       if (z->img_comp[i].linebuf) {
-         STBI_FREE(z->img_comp[i].linebuf);
+         stbi__free(z->img_comp[i].linebuf);
          z->img_comp[i].linebuf = NULL;
       }
    }
@@ -3409,6 +4467,32 @@ static stbi_uc stbi__skip_jpeg_junk_at_end(stbi__jpeg *j)
 }
 
 // decode image to YCbCr format
+// the MCUs, and the blocks of each component, that stbi_load_region needs (all of them
+// otherwise), with an MCU around them for upsampling
+static void stbi__jpeg_roi(stbi__jpeg *z)
+{
+   stbi__uint32 x0 = (stbi__uint32) z->s->roi_x0, x1 = (stbi__uint32) z->s->roi_x1, y0, y1;
+   int k;
+   if (x1 > z->s->img_x) x1 = z->s->img_x;
+   if (x0 > x1) x0 = x1;
+   stbi__roi_rows(z->s, &y0, &y1);
+   z->roi_mcu_x0 = (int) (x0 / z->img_mcu_w) - 1;
+   z->roi_mcu_y0 = (int) (y0 / z->img_mcu_h) - 1;
+   z->roi_mcu_x1 = (int) ((x1 + z->img_mcu_w-1) / z->img_mcu_w) + 1;
+   z->roi_mcu_y1 = (int) ((y1 + z->img_mcu_h-1) / z->img_mcu_h) + 1;
+   if (z->roi_mcu_x0 < 0) z->roi_mcu_x0 = 0;
+   if (z->roi_mcu_y0 < 0) z->roi_mcu_y0 = 0;
+   if (z->roi_mcu_x1 > z->img_mcu_x) z->roi_mcu_x1 = z->img_mcu_x;
+   if (z->roi_mcu_y1 > z->img_mcu_y) z->roi_mcu_y1 = z->img_mcu_y;
+   for (k=0; k < z->s->img_n; ++k) {
+      int w = (z->img_comp[k].x+7) >> 3, h = (z->img_comp[k].y+7) >> 3;
+      z->img_comp[k].roi_x0 = z->roi_mcu_x0 * z->img_comp[k].h;
+      z->img_comp[k].roi_y0 = z->roi_mcu_y0 * z->img_comp[k].v;
+      z->img_comp[k].roi_x1 = z->roi_mcu_x1 * z->img_comp[k].h < w ? z->roi_mcu_x1 * z->img_comp[k].h : w;
+      z->img_comp[k].roi_y1 = z->roi_mcu_y1 * z->img_comp[k].v < h ? z->roi_mcu_y1 * z->img_comp[k].v : h;
+   }
+}
+
 static int stbi__decode_jpeg_image(stbi__jpeg *j)
 {
    int m;
@@ -3418,11 +4502,13 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    }
    j->restart_interval = 0;
    if (!stbi__decode_jpeg_header(j, STBI__SCAN_load)) return 0;
+   stbi__jpeg_roi(j);
    m = stbi__get_marker(j);
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
          if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (j->roi_done) break;
          if (j->marker == STBI__MARKER_none ) {
          j->marker = stbi__skip_jpeg_junk_at_end(j);
             // if we reach eof without hitting a marker, stbi__get_marker() below will fail and we'll eventually return 0
@@ -3441,8 +4527,7 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
          m = stbi__get_marker(j);
       }
    }
-   if (j->progressive)
-      stbi__jpeg_finish(j);
+   stbi__jpeg_finish(j);
    return 1;
 }
 
@@ -3677,7 +4762,7 @@ static void stbi__YCbCr_to_RGB_row(stbi_uc *out, const stbi_uc *y, const stbi_uc
       out[0] = (stbi_uc)r;
       out[1] = (stbi_uc)g;
       out[2] = (stbi_uc)b;
-      out[3] = 255;
+      if (step == 4) out[3] = 255;
       out += step;
    }
 }
@@ -3787,40 +4872,177 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
          o.val[2] = vqrshrun_n_s16(bws, 4);
          o.val[3] = vdup_n_u8(255);
 
-         // store, interleaving r/g/b/a
-         vst4_u8(out, o);
-         out += 8*4;
+         // store, interleaving r/g/b/a
+         vst4_u8(out, o);
+         out += 8*4;
+      }
+   }
+#endif
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* stbi__float2fixed(1.40200f);
+      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[0] = (stbi_uc)r;
+      out[1] = (stbi_uc)g;
+      out[2] = (stbi_uc)b;
+      if (step == 4) out[3] = 255;
+      out += step;
+   }
+}
+#endif
+
+#ifdef STBI_AVX2
+// the sse2 loops above, 16 pixels at a time
+static STBI__AVX2_TARGET stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   // need to generate 2x2 samples for every one in input
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   // the last pixel in a row needs the boundary conditions below
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical filtering pass, 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i diff  = _mm256_sub_epi16(farw, nearw);
+      __m256i nears = _mm256_slli_epi16(nearw, 2);
+      __m256i curr  = _mm256_add_epi16(nears, diff); // current row
+
+      // "prev" and "next" are the current row shifted by one pixel, across the
+      // 128-bit lanes, with the pixels before and after this group put in.
+      __m256i prv0 = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(curr, curr, 0x08), 14);
+      __m256i nxt0 = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, curr, 0x81), curr, 2);
+      __m256i prev = _mm256_insert_epi16(prv0, t1, 0);
+      __m256i next = _mm256_insert_epi16(nxt0, 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal filter, polyphase:
+      // even pixels = 3*cur + prev = cur*4 + (prev - cur)
+      // odd  pixels = 3*cur + next = cur*4 + (next - cur)
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curs = _mm256_slli_epi16(curr, 2);
+      __m256i prvd = _mm256_sub_epi16(prev, curr);
+      __m256i nxtd = _mm256_sub_epi16(next, curr);
+      __m256i curb = _mm256_add_epi16(curs, bias);
+      __m256i even = _mm256_add_epi16(prvd, curb);
+      __m256i odd  = _mm256_add_epi16(nxtd, curb);
+
+      // interleave even and odd pixels, then undo scaling. the in-lane unpacks
+      // and pack leave output pixels 0..15 in the low lane and 16..31 in the high one
+      __m256i int0 = _mm256_unpacklo_epi16(even, odd);
+      __m256i int1 = _mm256_unpackhi_epi16(even, odd);
+      __m256i de0  = _mm256_srli_epi16(int0, 4);
+      __m256i de1  = _mm256_srli_epi16(int1, 4);
+      __m256i outv = _mm256_packus_epi16(de0, de1);
+      _mm256_storeu_si256((__m256i *) (out + i*2), outv);
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+   _mm256_zeroupper();
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+
+static STBI__AVX2_TARGET void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   // same arithmetic as the sse2 version, 16 pixels at a time; step == 3 and the
+   // leftovers go through that one
+   if (step == 4) {
+      __m256i signflip  = _mm256_set1_epi16(-0x8000);
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i y_bias = _mm256_set1_epi16(128);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+
+      for (; i+15 < count; i += 16) {
+         // load and unpack to short: y in the high byte over a 128 bias, cr/cb
+         // (-128) left-shifted by 8
+         __m256i y_bytes = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i)));
+         __m256i cr_bytes = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcr+i)));
+         __m256i cb_bytes = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcb+i)));
+         __m256i yw  = _mm256_or_si256(_mm256_slli_epi16(y_bytes, 8), y_bias);
+         __m256i crw = _mm256_xor_si256(_mm256_slli_epi16(cr_bytes, 8), signflip);
+         __m256i cbw = _mm256_xor_si256(_mm256_slli_epi16(cb_bytes, 8), signflip);
+
+         // color transform
+         __m256i yws = _mm256_srli_epi16(yw, 4);
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte, set up for transpose
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+
+         // transpose to interleave channels; per lane that's pixels 0..3 and 8..11
+         // in o0, 4..7 and 12..15 in o1
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         // store
+         _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+         _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+         out += 64;
       }
+      _mm256_zeroupper();
    }
-#endif
 
-   for (; i < count; ++i) {
-      int y_fixed = (y[i] << 20) + (1<<19); // rounding
-      int r,g,b;
-      int cr = pcr[i] - 128;
-      int cb = pcb[i] - 128;
-      r = y_fixed + cr* stbi__float2fixed(1.40200f);
-      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
-      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
-      r >>= 20;
-      g >>= 20;
-      b >>= 20;
-      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
-      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
-      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
-      out[0] = (stbi_uc)r;
-      out[1] = (stbi_uc)g;
-      out[2] = (stbi_uc)b;
-      out[3] = 255;
-      out += step;
-   }
+   if (i < count)
+      stbi__YCbCr_to_RGB_simd(out, y+i, pcb+i, pcr+i, count-i, step);
 }
-#endif
+#endif // STBI_AVX2
 
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
    j->idct_block_kernel = stbi__idct_block;
+   j->idct_block2_kernel = NULL;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_row;
    j->resample_row_hv_2_kernel = stbi__resample_row_hv_2;
 
@@ -3832,6 +5054,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block2_kernel = stbi__idct2_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3862,6 +5092,151 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+// resampling and color conversion of a band of output rows
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc *output;            // row output_y, rows are stride bytes apart
+   unsigned int output_y;
+   int stride, n, decode_n, is_rgb;
+   stbi__resample res_comp[4]; // at row 0
+   stbi_uc *linebuf;           // decode_n line buffers per band
+   int band_bytes, band_rows;
+} stbi__jpeg_convert;
+
+static void stbi__resample_next_row(stbi__resample *r, int y, int w2)
+{
+   if (++r->ystep >= r->vs) {
+      r->ystep = 0;
+      r->line0 = r->line1;
+      if (++r->ypos < y)
+         r->line1 += w2;
+   }
+}
+
+// resamples and color converts rows [first,last), with res_comp at row first
+static void stbi__jpeg_convert_range(stbi__jpeg_convert *c, stbi_uc *linebuf, stbi__resample *res_comp, unsigned int first, unsigned int last)
+{
+   stbi__jpeg *z = c->z;
+   int n = c->n, decode_n = c->decode_n, is_rgb = c->is_rgb;
+   stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
+   unsigned int i,j;
+   int k;
+
+   for (j=first; j < last; ++j) {
+      // the conversions never write past the end of a row: the next one may belong to
+      // another task, or be a row of the caller's buffer that was already written
+      stbi_uc *out = c->output + (ptrdiff_t) c->stride * (ptrdiff_t) (j - c->output_y);
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         int y_bot = r->ystep >= (r->vs >> 1);
+         coutput[k] = r->resample(linebuf + k * (z->s->img_x + 3),
+                                  y_bot ? r->line1 : r->line0,
+                                  y_bot ? r->line0 : r->line1,
+                                  r->w_lores, r->hs);
+         stbi__resample_next_row(r, z->img_comp[k].y, z->img_comp[k].w2);
+      }
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  if (n == 4) out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  if (n == 4) out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               if (n == 4) out[3] = 255;
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               if (n == 2) out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               if (n == 2) out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
+         }
+      }
+   }
+}
+
+static void stbi__jpeg_convert_rows(void *task_data, int begin, int end)
+{
+   stbi__jpeg_convert *c = (stbi__jpeg_convert *) task_data;
+   stbi__jpeg *z = c->z;
+   unsigned int first = begin * c->band_rows;
+   unsigned int last = (unsigned int) end * c->band_rows < z->s->img_y ? (unsigned int) end * c->band_rows : z->s->img_y;
+   stbi__resample res_comp[4];
+   unsigned int j;
+   int k;
+
+   // step the resamplers down to the first row
+   for (k=0; k < c->decode_n; ++k) {
+      res_comp[k] = c->res_comp[k];
+      for (j=0; j < first; ++j)
+         stbi__resample_next_row(&res_comp[k], z->img_comp[k].y, z->img_comp[k].w2);
+   }
+
+   // the line buffers of the first band are this task's alone
+   stbi__jpeg_convert_range(c, c->linebuf + (size_t) begin * c->band_bytes, res_comp, first, last);
+}
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3890,20 +5265,22 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // resample and color-convert
    {
       int k;
-      unsigned int i,j;
-      stbi_uc *output;
-      stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
-
-      stbi__resample res_comp[4];
+      stbi_uc *output, *image;
+      stbi__jpeg_convert c;
+      stbi__resample *res_comp = c.res_comp;
+      // up to 64 bands of at least 16 rows when converting in parallel
+      int bands = stbi__parallel_for_func && !z->s->band ? (z->s->img_y + 15) / 16 : 1;
+      if (bands > 64) bands = 64;
+
+      // allocate line buffers big enough for upsampling off the edges
+      // with upsample factor of 4
+      c.band_bytes = decode_n * (z->s->img_x + 3);
+      c.linebuf = (stbi_uc *) stbi__malloc_mad2(bands, c.band_bytes, 0);
+      if (!c.linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
 
       for (k=0; k < decode_n; ++k) {
          stbi__resample *r = &res_comp[k];
 
-         // allocate line buffer big enough for upsampling off the edges
-         // with upsample factor of 4
-         z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
-         if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
          r->hs      = z->img_h_max / z->img_comp[k].h;
          r->vs      = z->img_v_max / z->img_comp[k].v;
          r->ystep   = r->vs >> 1;
@@ -3918,110 +5295,48 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          else                               r->resample = stbi__resample_row_generic;
       }
 
-      // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
-
-      // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) { *out++ = y[i]; *out++ = 255; }
-            }
+      c.z = z;
+      c.n = n;
+      c.decode_n = decode_n;
+      c.is_rgb = is_rgb;
+
+      if (z->s->band) {
+         // a band at a time through the band buffer, from the first band that is wanted
+         stbi__uint32 first, last, j;
+         int ok;
+         image = stbi__band_start(z->s, n);
+         ok = image != NULL;
+         stbi__roi_rows(z->s, &first, &last);
+         for (k=0; k < decode_n; ++k)
+            for (j=0; j < first; ++j)
+               stbi__resample_next_row(&res_comp[k], z->img_comp[k].y, z->img_comp[k].w2);
+         c.stride = z->s->flip ? -z->s->band_stride : z->s->band_stride;
+         for (j=first; ok && j < last; j += z->s->band_rows) {
+            stbi__uint32 end = last - j < (stbi__uint32) z->s->band_rows ? last : j + z->s->band_rows;
+            c.output = stbi__band_row(z->s, j);
+            c.output_y = j;
+            stbi__jpeg_convert_range(&c, c.linebuf, res_comp, j, end);
+            ok = stbi__band_row_done(z->s, end-1);
          }
+         stbi__free(c.linebuf);
+         if (!ok) { stbi__free(image); stbi__cleanup_jpeg(z); return NULL; }
+      } else {
+         // can't error after this so, this is safe
+         output = stbi__output_rows(z->s, n, z->s->flip, &c.stride, &image);
+         if (!output) { stbi__free(c.linebuf); stbi__cleanup_jpeg(z); return NULL; }
+
+         // now go ahead and resample, in bands of rows that can run in parallel
+         c.output = output;
+         c.output_y = 0;
+         c.band_rows = (z->s->img_y + bands-1) / bands;
+         stbi__parallel_run(bands, stbi__jpeg_convert_rows, &c);
+         stbi__free(c.linebuf);
       }
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
       if (comp) *comp = z->s->img_n >= 3 ? 3 : 1; // report original components, not output
-      return output;
+      return image;
    }
 }
 
@@ -4031,11 +5346,12 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    stbi__jpeg* j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
    if (!j) return stbi__errpuc("outofmem", "Out of memory");
    memset(j, 0, sizeof(stbi__jpeg));
-   STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
-   STBI_FREE(j);
+   stbi__free(j);
+   ri->flipped = s->flip;
+   ri->premultiplied = 1; // alpha is always 255
    return result;
 }
 
@@ -4049,7 +5365,7 @@ static int stbi__jpeg_test(stbi__context *s)
    stbi__setup_jpeg(j);
    r = stbi__decode_jpeg_header(j, STBI__SCAN_type);
    stbi__rewind(s);
-   STBI_FREE(j);
+   stbi__free(j);
    return r;
 }
 
@@ -4073,7 +5389,7 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
    memset(j, 0, sizeof(stbi__jpeg));
    j->s = s;
    result = stbi__jpeg_info_raw(j, x, y, comp);
-   STBI_FREE(j);
+   stbi__free(j);
    return result;
 }
 #endif
@@ -4084,11 +5400,13 @@ static int stbi__jpeg_info(stbi__context *s, int *x, int *y, int *comp)
 //      - all output is written to a single output buffer (can malloc/realloc)
 //    performance
 //      - fast huffman
+//      - 64-bit bit buffer, refilled 8 bytes at a time in the fast loop
+//      - wide, overlap-safe match copies
 
 #ifndef STBI_NO_ZLIB
 
 // fast-way is faster to check than jpeg huffman, but slow way is slower
-#define STBI__ZFAST_BITS  9 // accelerate all cases in default tables
+#define STBI__ZFAST_BITS  10 // accelerate all cases in default tables, and most of the dynamic ones
 #define STBI__ZFAST_MASK  ((1 << STBI__ZFAST_BITS) - 1)
 #define STBI__ZNSYMS 288 // number of symbols in literal/length alphabet
 
@@ -4174,12 +5492,19 @@ static int stbi__zbuild_huffman(stbi__zhuffman *z, const stbi_uc *sizelist, int
 //    we require PNG read all the IDATs and combine them into a single
 //    memory buffer
 
+#ifdef _MSC_VER
+typedef unsigned __int64 stbi__zbits;
+#else
+typedef unsigned long long stbi__zbits;
+#endif
+
 typedef struct
 {
    stbi_uc *zbuffer, *zbuffer_end;
    int num_bits;
    int hit_zeof_once;
-   stbi__uint32 code_buffer;
+   int zeof_bytes; // zero bytes stbi__fill_bits put in code_buffer past the end
+   stbi__zbits code_buffer;
 
    char *zout;
    char *zout_start;
@@ -4199,34 +5524,38 @@ stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
    return stbi__zeof(z) ? 0 : *z->zbuffer++;
 }
 
+// stops at 56 bits or less, the fast loop's refill shifts by num_bits and needs it below 64
 static void stbi__fill_bits(stbi__zbuf *z)
 {
    do {
-      if (z->code_buffer >= (1U << z->num_bits)) {
+      if (z->code_buffer >= ((stbi__zbits) 1 << z->num_bits)) {
         z->zbuffer = z->zbuffer_end;  /* treat this as EOF so we fail. */
         return;
       }
-      z->code_buffer |= (unsigned int) stbi__zget8(z) << z->num_bits;
+      if (stbi__zeof(z)) ++z->zeof_bytes;
+      z->code_buffer |= (stbi__zbits) stbi__zget8(z) << z->num_bits;
       z->num_bits += 8;
-   } while (z->num_bits <= 24);
+   } while (z->num_bits <= 48);
 }
 
 stbi_inline static unsigned int stbi__zreceive(stbi__zbuf *z, int n)
 {
    unsigned int k;
    if (z->num_bits < n) stbi__fill_bits(z);
-   k = z->code_buffer & ((1 << n) - 1);
+   k = (unsigned int) (z->code_buffer & ((1 << n) - 1));
    z->code_buffer >>= n;
    z->num_bits -= n;
    return k;
 }
 
-static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
+// resolves a code the fast table doesn't from the next 16 bits of the stream, returns the symbol
+// and its code length in *size, or -1 for an invalid code
+static int stbi__zhuffman_slowcode(stbi__zhuffman *z, int bits, int *size)
 {
    int b,s,k;
    // not resolved by fast table, so compute it the slow way
    // use jpeg approach, which requires MSbits at top
-   k = stbi__bit_reverse(a->code_buffer, 16);
+   k = stbi__bit_reverse(bits, 16);
    for (s=STBI__ZFAST_BITS+1; ; ++s)
       if (k < z->maxcode[s])
          break;
@@ -4235,9 +5564,17 @@ static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
    b = (k >> (16-s)) - z->firstcode[s] + z->firstsymbol[s];
    if (b >= STBI__ZNSYMS) return -1; // some data was corrupt somewhere!
    if (z->size[b] != s) return -1;  // was originally an assert, but report failure instead.
+   *size = s;
+   return z->value[b];
+}
+
+static int stbi__zhuffman_decode_slowpath(stbi__zbuf *a, stbi__zhuffman *z)
+{
+   int s, v = stbi__zhuffman_slowcode(z, (int) (a->code_buffer & 0xffff), &s);
+   if (v < 0) return -1;
    a->code_buffer >>= s;
    a->num_bits -= s;
-   return z->value[b];
+   return v;
 }
 
 stbi_inline static int stbi__zhuffman_decode(stbi__zbuf *a, stbi__zhuffman *z)
@@ -4283,7 +5620,7 @@ static int stbi__zexpand(stbi__zbuf *z, char *zout, int n)  // need to make room
       if(limit > UINT_MAX / 2) return stbi__err("outofmem", "Out of memory");
       limit *= 2;
    }
-   q = (char *) STBI_REALLOC_SIZED(z->zout_start, old_limit, limit);
+   q = (char *) stbi__realloc_sized(z->zout_start, old_limit, limit);
    STBI_NOTUSED(old_limit);
    if (q == NULL) return stbi__err("outofmem", "Out of memory");
    z->zout_start = q;
@@ -4306,11 +5643,159 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// output room the fast loop keeps: the longest match plus what the wide copies write past its end
+#define STBI__ZFAST_OUT  (258 + 16)
+
+stbi_inline static stbi__zbits stbi__zload64(const stbi_uc *p)
+{
+#if defined(STBI__X86_TARGET) || defined(STBI__X64_TARGET) || defined(_M_ARM) || defined(_M_ARM64) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+   stbi__zbits v;
+   memcpy(&v, p, 8);
+   return v;
+#else
+   return (stbi__zbits) p[0]         | ((stbi__zbits) p[1] <<  8) |
+         ((stbi__zbits) p[2] << 16) | ((stbi__zbits) p[3] << 24) |
+         ((stbi__zbits) p[4] << 32) | ((stbi__zbits) p[5] << 40) |
+         ((stbi__zbits) p[6] << 48) | ((stbi__zbits) p[7] << 56);
+#endif
+}
+
+// decodes a huffman block while at least 8 input bytes and STBI__ZFAST_OUT bytes of output
+// room are left, so neither has to be checked per symbol. one refill covers the longest
+// length/distance pair, or up to three literals. returns 1 at the end of the block, 0 on
+// error, 2 when it runs out of room and the careful loop has to finish the block.
+static int stbi__parse_huffman_fast(stbi__zbuf *a)
+{
+   stbi_uc *zout = (stbi_uc *) a->zout;
+   stbi_uc *zout_start = (stbi_uc *) a->zout_start;
+   stbi_uc *zout_limit = (stbi_uc *) a->zout_end - STBI__ZFAST_OUT;
+   stbi_uc *in = a->zbuffer;
+   stbi_uc *in_limit = a->zbuffer_end - 8;
+   stbi__zbits bits = a->code_buffer;
+   int num_bits = a->num_bits;
+   int result = 2;
+
+   while (in <= in_limit && zout <= zout_limit) {
+      int b, s, z, len, dist, extra;
+      stbi_uc *p;
+
+      // load 8 bytes and keep the whole ones that fit, giving 56 to 63 bits. the part of the
+      // next byte that lands above num_bits is loaded again by the next refill, so it can stay
+      bits |= stbi__zload64(in) << num_bits;
+      in += (63 - num_bits) >> 3;
+      num_bits |= 56;
+
+      b = a->z_length.fast[bits & STBI__ZFAST_MASK];
+      if (b) {
+         s = b >> 9;
+         z = b & 511;
+      } else {
+         z = stbi__zhuffman_slowcode(&a->z_length, (int) (bits & 0xffff), &s);
+         if (z < 0) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      }
+      bits >>= s;
+      num_bits -= s;
+
+      if (z < 256) {
+         *zout++ = (stbi_uc) z;
+         // at least 41 bits are left, two more literals can come straight from the fast table
+         b = a->z_length.fast[bits & STBI__ZFAST_MASK];
+         if (b && (b & 511) < 256) {
+            s = b >> 9;
+            bits >>= s;
+            num_bits -= s;
+            *zout++ = (stbi_uc) b;
+            b = a->z_length.fast[bits & STBI__ZFAST_MASK];
+            if (b && (b & 511) < 256) {
+               s = b >> 9;
+               bits >>= s;
+               num_bits -= s;
+               *zout++ = (stbi_uc) b;
+            }
+         }
+         continue;
+      }
+      if (z == 256) {
+         result = 1;
+         break;
+      }
+      if (z >= 286) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+
+      // length code + 5 extra bits + distance code + 13 extra bits fit in the 56 bits refilled
+      z -= 257;
+      extra = stbi__zlength_extra[z];
+      len = stbi__zlength_base[z] + (int) (bits & ((1 << extra) - 1));
+      bits >>= extra;
+      num_bits -= extra;
+
+      b = a->z_distance.fast[bits & STBI__ZFAST_MASK];
+      if (b) {
+         s = b >> 9;
+         z = b & 511;
+      } else {
+         z = stbi__zhuffman_slowcode(&a->z_distance, (int) (bits & 0xffff), &s);
+      }
+      if (z < 0 || z >= 30) { result = stbi__err("bad huffman code","Corrupt PNG"); break; }
+      bits >>= s;
+      num_bits -= s;
+      extra = stbi__zdist_extra[z];
+      dist = stbi__zdist_base[z] + (int) (bits & ((1 << extra) - 1));
+      bits >>= extra;
+      num_bits -= extra;
+      if (zout - zout_start < dist) { result = stbi__err("bad dist","Corrupt PNG"); break; }
+
+      // every copy may write up to 15 bytes past the match, the room check above leaves space for that
+      p = zout - dist;
+      if (dist >= 16) {
+         stbi_uc *end = zout + len;
+         do {
+            memcpy(zout, p, 16);
+            zout += 16;
+            p += 16;
+         } while (zout < end);
+         zout = end;
+      } else if (dist == 1) { // run of one byte; common in images.
+         memset(zout, *p, len);
+         zout += len;
+      } else {
+         stbi_uc *end = zout + len;
+         if (dist < 8) {
+            // copy byte by byte until the pattern is 8 bytes long, after that the bytes a whole number
+            // of periods back (at least 8) are the same ones, and far enough for 8-byte copies
+            int k;
+            for (k=0; k < 8; ++k)
+               zout[k] = p[k];
+            zout += 8;
+            p = zout - ((8 + dist - 1) / dist) * dist;
+         }
+         while (zout < end) {
+            memcpy(zout, p, 8);
+            zout += 8;
+            p += 8;
+         }
+         zout = end;
+      }
+   }
+
+   a->zbuffer = in;
+   a->code_buffer = bits & (((stbi__zbits) 1 << num_bits) - 1);
+   a->num_bits = num_bits;
+   a->zout = (char *) zout;
+   return result;
+}
+
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      if (a->zbuffer_end - a->zbuffer >= 8 && a->zout_end - zout >= STBI__ZFAST_OUT) {
+         a->zout = zout;
+         z = stbi__parse_huffman_fast(a);
+         if (z != 2) return z;
+         zout = a->zout;
+      }
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4323,10 +5808,11 @@ static int stbi__parse_huffman_block(stbi__zbuf *a)
          int len,dist;
          if (z == 256) {
             a->zout = zout;
-            if (a->hit_zeof_once && a->num_bits < 16) {
+            if (a->num_bits < (a->hit_zeof_once ? 16 : 0) + a->zeof_bytes * 8) {
                // The first time we hit zeof, we inserted 16 extra zero bits into our bit
-               // buffer so the decoder can just do its speculative decoding. But if we
-               // actually consumed any of those bits (which is the case when num_bits < 16),
+               // buffer so the decoder can just do its speculative decoding, on top of the
+               // zero bytes stbi__fill_bits read past the end. But if we actually consumed
+               // any of those bits (which is the case when fewer than that are left),
                // the stream actually read past the end so it is malformed.
                return stbi__err("unexpected end","Corrupt PNG");
             }
@@ -4409,17 +5895,25 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
 static int stbi__parse_uncompressed_block(stbi__zbuf *a)
 {
    stbi_uc header[4];
-   int len,nlen,k;
+   int len,nlen,k,ahead;
+   // the padding bits added at eof are not in the input, and a stored block can't start inside them
+   if (a->hit_zeof_once) return stbi__err("zlib corrupt","Corrupt PNG");
    if (a->num_bits & 7)
       stbi__zreceive(a, a->num_bits & 7); // discard
    // drain the bit-packed data into header
    k = 0;
-   while (a->num_bits > 0) {
+   while (a->num_bits > 0 && k < 4) {
       header[k++] = (stbi_uc) (a->code_buffer & 255); // suppress MSVC run-time check
       a->code_buffer >>= 8;
       a->num_bits -= 8;
    }
    if (a->num_bits < 0) return stbi__err("zlib corrupt","Corrupt PNG");
+   // whole bytes the 64-bit buffer read ahead go back to the input, except the zeros read past the end
+   ahead = a->num_bits >> 3;
+   a->zbuffer -= ahead > a->zeof_bytes ? ahead - a->zeof_bytes : 0;
+   a->zeof_bytes = 0;
+   a->num_bits = 0;
+   a->code_buffer = 0;
    // now fill header the normal way
    while (k < 4)
       header[k++] = stbi__zget8(a);
@@ -4486,6 +5980,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    a->num_bits = 0;
    a->code_buffer = 0;
    a->hit_zeof_once = 0;
+   a->zeof_bytes = 0;
    do {
       final = stbi__zreceive(a,1);
       type = stbi__zreceive(a,2);
@@ -4528,7 +6023,7 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      STBI_FREE(a.zout_start);
+      stbi__free(a.zout_start);
       return NULL;
    }
 }
@@ -4549,7 +6044,7 @@ STBIDEF char *stbi_zlib_decode_malloc_guesssize_headerflag(const char *buffer, i
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      STBI_FREE(a.zout_start);
+      stbi__free(a.zout_start);
       return NULL;
    }
 }
@@ -4576,7 +6071,7 @@ STBIDEF char *stbi_zlib_decode_noheader_malloc(char const *buffer, int len, int
       if (outlen) *outlen = (int) (a.zout - a.zout_start);
       return a.zout_start;
    } else {
-      STBI_FREE(a.zout_start);
+      stbi__free(a.zout_start);
       return NULL;
    }
 }
@@ -4632,8 +6127,29 @@ typedef struct
    stbi__context *s;
    stbi_uc *idata, *expanded, *out;
    int depth;
+   stbi_uc *rows;    // row 0 of the final image when rows are written finished, NULL otherwise
+   int rows_stride;  // negative when flipping
+   int rows_n;       // channels
+   stbi_uc *image;   // the buffer those rows are in
 } stbi__png;
 
+// sets up writing finished rows with n channels: converted, flipped and premultiplied
+static int stbi__png_output_rows(stbi__png *z, int n)
+{
+   z->rows_n = n;
+   if (z->s->band)
+      z->rows = z->image = stbi__band_start(z->s, n);
+   else
+      z->rows = stbi__output_rows(z->s, n, z->s->flip, &z->rows_stride, &z->image);
+   return z->rows != NULL;
+}
+
+// where finished row j goes
+static stbi_uc *stbi__png_row(stbi__png *z, stbi__uint32 j)
+{
+   return z->s->band ? stbi__band_row(z->s, j) : z->rows + (ptrdiff_t) z->rows_stride * j;
+}
+
 
 enum {
    STBI__F_none=0,
@@ -4667,6 +6183,176 @@ static int stbi__paeth(int a, int b, int c)
    return t1;
 }
 
+#if defined(STBI_SSE2) || defined(STBI_NEON)
+// SIMD filter inverses for 8-bit images with 3 or 4 bytes per pixel (RGB/RGBA).
+// sub, avg and paeth depend on the pixel to the left, so these run one pixel
+// per iteration with all its channels in one register; up has no such
+// dependency and runs 16 bytes at a time for any pixel size. results are
+// bit-exact with the scalar loops in stbi__create_png_image_raw.
+#define STBI__PNG_SIMD
+
+static int stbi__png_simd_available(void)
+{
+#ifdef STBI_SSE2
+   return stbi__sse2_available();
+#else
+   return 1;
+#endif
+}
+
+// pixels are moved through 32-bit integers so that 3-byte pixels never
+// read or write past the end of the row
+stbi_inline static stbi__uint32 stbi__png_load_pixel(stbi_uc const *p, int bpp)
+{
+   stbi__uint32 v;
+   if (bpp == 4) {
+      memcpy(&v, p, 4);
+      return v;
+   }
+   return p[0] | (p[1] << 8) | ((stbi__uint32) p[2] << 16);
+}
+
+stbi_inline static void stbi__png_store_pixel(stbi_uc *p, stbi__uint32 v, int bpp)
+{
+   if (bpp == 4) {
+      memcpy(p, &v, 4);
+   } else {
+      p[0] = STBI__BYTECAST(v);
+      p[1] = STBI__BYTECAST(v >> 8);
+      p[2] = STBI__BYTECAST(v >> 16);
+   }
+}
+
+#ifdef STBI_SSE2
+stbi_inline static __m128i stbi__png_paeth_simd(__m128i a, __m128i b, __m128i c)
+{
+   // same branch-free formulation as stbi__paeth, on 16-bit lanes; only the
+   // first add and what follows depend on a, which keeps the per-pixel chain short
+   __m128i thresh = _mm_sub_epi16(_mm_add_epi16(c, _mm_add_epi16(c, c)), _mm_add_epi16(a, b));
+   __m128i lo = _mm_min_epi16(a, b);
+   __m128i hi = _mm_max_epi16(a, b);
+   __m128i use_c = _mm_cmpgt_epi16(hi, thresh);
+   __m128i t0 = _mm_or_si128(_mm_and_si128(use_c, c), _mm_andnot_si128(use_c, lo));
+   __m128i use_t0 = _mm_cmpgt_epi16(thresh, lo);
+   return _mm_or_si128(_mm_and_si128(use_t0, t0), _mm_andnot_si128(use_t0, hi));
+}
+#endif
+
+static int stbi__png_unfilter_up_simd(stbi_uc *cur, stbi_uc const *raw, stbi_uc const *prior, int nk)
+{
+   int k = 0;
+   for (; k + 16 <= nk; k += 16) {
+#ifdef STBI_SSE2
+      __m128i x = _mm_loadu_si128((__m128i const *) (raw + k));
+      __m128i b = _mm_loadu_si128((__m128i const *) (prior + k));
+      _mm_storeu_si128((__m128i *) (cur + k), _mm_add_epi8(x, b));
+#else
+      vst1q_u8(cur + k, vaddq_u8(vld1q_u8(raw + k), vld1q_u8(prior + k)));
+#endif
+   }
+   return k;
+}
+
+// one row of sub, avg or paeth; bpp is a constant at both call sites so the
+// pixel loads and stores inline to plain 3- or 4-byte moves
+stbi_inline static void stbi__png_unfilter_pixels_simd(int filter, stbi_uc *cur, stbi_uc const *raw, stbi_uc const *prior, int nk, int bpp)
+{
+   int k;
+#ifdef STBI_SSE2
+   __m128i zero = _mm_setzero_si128();
+   __m128i a = zero; // left pixel, 0 before the first one
+
+   if (filter == STBI__F_sub) {
+      for (k = 0; k < nk; k += bpp) {
+         __m128i x = _mm_cvtsi32_si128((int) stbi__png_load_pixel(raw + k, bpp));
+         a = _mm_add_epi8(x, a);
+         stbi__png_store_pixel(cur + k, (stbi__uint32) _mm_cvtsi128_si32(a), bpp);
+      }
+   } else if (filter == STBI__F_avg) {
+      __m128i one = _mm_set1_epi8(1);
+      for (k = 0; k < nk; k += bpp) {
+         __m128i x = _mm_cvtsi32_si128((int) stbi__png_load_pixel(raw + k, bpp));
+         __m128i b = _mm_cvtsi32_si128((int) stbi__png_load_pixel(prior + k, bpp));
+         // (a+b)>>1 is the rounded-up average minus the rounding bit
+         __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+         a = _mm_add_epi8(x, avg);
+         stbi__png_store_pixel(cur + k, (stbi__uint32) _mm_cvtsi128_si32(a), bpp);
+      }
+   } else {
+      // everything stays in 16-bit lanes, the add wraps with a mask instead of a pack/unpack
+      __m128i low = _mm_set1_epi16(0xff);
+      __m128i c = zero; // upper-left pixel
+      STBI_ASSERT(filter == STBI__F_paeth);
+      for (k = 0; k < nk; k += bpp) {
+         __m128i x = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int) stbi__png_load_pixel(raw + k, bpp)), zero);
+         __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int) stbi__png_load_pixel(prior + k, bpp)), zero);
+         a = _mm_and_si128(_mm_add_epi16(x, stbi__png_paeth_simd(a, b, c)), low);
+         c = b;
+         stbi__png_store_pixel(cur + k, (stbi__uint32) _mm_cvtsi128_si32(_mm_packus_epi16(a, zero)), bpp);
+      }
+   }
+#else
+   uint8x8_t a = vdup_n_u8(0); // left pixel, 0 before the first one
+
+   if (filter == STBI__F_sub) {
+      for (k = 0; k < nk; k += bpp) {
+         uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(stbi__png_load_pixel(raw + k, bpp)));
+         a = vadd_u8(x, a);
+         stbi__png_store_pixel(cur + k, vget_lane_u32(vreinterpret_u32_u8(a), 0), bpp);
+      }
+   } else if (filter == STBI__F_avg) {
+      for (k = 0; k < nk; k += bpp) {
+         uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(stbi__png_load_pixel(raw + k, bpp)));
+         uint8x8_t b = vreinterpret_u8_u32(vdup_n_u32(stbi__png_load_pixel(prior + k, bpp)));
+         a = vadd_u8(x, vhadd_u8(a, b)); // vhadd truncates, same as (a+b)>>1
+         stbi__png_store_pixel(cur + k, vget_lane_u32(vreinterpret_u32_u8(a), 0), bpp);
+      }
+   } else {
+      int16x8_t aw = vdupq_n_s16(0), cw = vdupq_n_s16(0);
+      STBI_ASSERT(filter == STBI__F_paeth);
+      for (k = 0; k < nk; k += bpp) {
+         uint8x8_t x = vreinterpret_u8_u32(vdup_n_u32(stbi__png_load_pixel(raw + k, bpp)));
+         int16x8_t bw = vreinterpretq_s16_u16(vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(stbi__png_load_pixel(prior + k, bpp)))));
+         // pa = |b-c|, pb = |a-c|, pc = |a+b-2c|, ties go to a, then b, matching stbi__paeth
+         int16x8_t bc = vsubq_s16(bw, cw);
+         int16x8_t ac = vsubq_s16(aw, cw);
+         uint16x8_t pa = vreinterpretq_u16_s16(vabsq_s16(bc));
+         uint16x8_t pb = vreinterpretq_u16_s16(vabsq_s16(ac));
+         uint16x8_t pc = vreinterpretq_u16_s16(vabsq_s16(vaddq_s16(bc, ac)));
+         uint16x8_t use_a = vandq_u16(vcleq_u16(pa, pb), vcleq_u16(pa, pc));
+         uint16x8_t use_b = vcleq_u16(pb, pc);
+         int16x8_t p = vbslq_s16(use_a, aw, vbslq_s16(use_b, bw, cw));
+         a = vadd_u8(x, vmovn_u16(vreinterpretq_u16_s16(p)));
+         aw = vreinterpretq_s16_u16(vmovl_u8(a));
+         cw = bw;
+         stbi__png_store_pixel(cur + k, vget_lane_u32(vreinterpret_u32_u8(a), 0), bpp);
+      }
+   }
+#endif
+}
+
+// returns 0 if the row has to go through the scalar loops instead
+static int stbi__png_unfilter_simd(int filter, stbi_uc *cur, stbi_uc const *raw, stbi_uc const *prior, int nk, int filter_bytes)
+{
+   if (filter == STBI__F_up) {
+      int k = stbi__png_unfilter_up_simd(cur, raw, prior, nk);
+      for (; k < nk; ++k)
+         cur[k] = STBI__BYTECAST(raw[k] + prior[k]);
+      return 1;
+   }
+   if (filter != STBI__F_sub && filter != STBI__F_avg && filter != STBI__F_paeth)
+      return 0;
+   if (filter_bytes == 4)
+      stbi__png_unfilter_pixels_simd(filter, cur, raw, prior, nk, 4);
+   else if (filter_bytes == 3)
+      stbi__png_unfilter_pixels_simd(filter, cur, raw, prior, nk, 3);
+   else
+      return 0;
+   return 1;
+}
+
+#endif // STBI_SSE2 || STBI_NEON
+
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
 // adds an extra all-255 alpha channel
@@ -4698,8 +6384,8 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int bytes = (depth == 16 ? 2 : 1);
    stbi__context *s = a->s;
    stbi__uint32 i,j,stride = x*out_n*bytes;
-   stbi__uint32 img_len, img_width_bytes;
-   stbi_uc *filter_buf;
+   stbi__uint32 img_len, img_width_bytes, first, last = y;
+   stbi_uc *filter_buf, *line = NULL;
    int all_ok = 1;
    int k;
    int img_n = s->img_n; // copy it into a local for later
@@ -4707,10 +6393,15 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int output_bytes = out_n*bytes;
    int filter_bytes = img_n*bytes;
    int width = x;
+#ifdef STBI__PNG_SIMD
+   int use_simd = stbi__png_simd_available();
+#endif
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-   if (!a->out) return stbi__err("outofmem", "Out of memory");
+   if (!a->rows) {
+      a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+      if (!a->out) return stbi__err("outofmem", "Out of memory");
+   }
 
    // note: error exits here don't need to clean up a->out individually,
    // stbi__do_png always does on error.
@@ -4728,17 +6419,25 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    filter_buf = (stbi_uc *) stbi__malloc_mad2(img_width_bytes, 2, 0);
    if (!filter_buf) return stbi__err("outofmem", "Out of memory");
 
+   // finished rows are written from a line of img_n 8-bit components, for stbi_load_region
+   // up to the last one it wants
+   if (a->rows) stbi__roi_rows(s, &first, &last);
+   if (a->rows && depth < 8) {
+      line = (stbi_uc *) stbi__malloc_mad2(x, img_n, 0);
+      if (!line) { stbi__free(filter_buf); return stbi__err("outofmem", "Out of memory"); }
+   }
+
    // Filtering for low-bit-depth images
    if (depth < 8) {
       filter_bytes = 1;
       width = img_width_bytes;
    }
 
-   for (j=0; j < y; ++j) {
+   for (j=0; j < last; ++j) {
       // cur/prior filter buffers alternate
       stbi_uc *cur = filter_buf + (j & 1)*img_width_bytes;
       stbi_uc *prior = filter_buf + (~j & 1)*img_width_bytes;
-      stbi_uc *dest = a->out + stride*j;
+      stbi_uc *dest = a->rows ? line : a->out + stride*j;
       int nk = width * filter_bytes;
       int filter = *raw++;
 
@@ -4752,6 +6451,11 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       if (j == 0) filter = first_row_filter[filter];
 
       // perform actual filtering
+#ifdef STBI__PNG_SIMD
+      if (use_simd && stbi__png_unfilter_simd(filter, cur, raw, prior, nk, filter_bytes)) {
+         // done
+      } else
+#endif
       switch (filter) {
       case STBI__F_none:
          memcpy(cur, raw, nk);
@@ -4817,9 +6521,9 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
          }
 
          // insert alpha=255 values if desired
-         if (img_n != out_n)
+         if (!a->rows && img_n != out_n)
             stbi__create_png_alpha_expand8(dest, dest, x, img_n);
-      } else if (depth == 8) {
+      } else if (depth == 8 && !a->rows) {
          if (img_n == out_n)
             memcpy(dest, cur, x*img_n);
          else
@@ -4850,9 +6554,22 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
             }
          }
       }
+
+      // or write the finished row
+      if (a->rows) {
+         stbi_uc *row = stbi__png_row(a, j);
+         stbi__convert_row(row, depth == 8 ? cur : line, img_n, a->rows_n, x);
+         if (s->premultiply)
+            stbi__premultiply_row(row, a->rows_n, x);
+         if (s->band && !stbi__band_row_done(s, j)) {
+            all_ok = 0;
+            break;
+         }
+      }
    }
 
-   STBI_FREE(filter_buf);
+   stbi__free(filter_buf);
+   if (line) stbi__free(line);
    if (!all_ok) return 0;
 
    return 1;
@@ -4882,7 +6599,7 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
       if (x && y) {
          stbi__uint32 img_len = ((((a->s->img_n * x * depth) + 7) >> 3) + 1) * y;
          if (!stbi__create_png_image_raw(a, image_data, image_data_len, out_n, x, y, depth, color)) {
-            STBI_FREE(final);
+            stbi__free(final);
             return 0;
          }
          for (j=0; j < y; ++j) {
@@ -4893,7 +6610,7 @@ static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint3
                       a->out + (j*x+i)*out_bytes, out_bytes);
             }
          }
-         STBI_FREE(a->out);
+         stbi__free(a->out);
          image_data += img_len;
          image_data_len -= img_len;
       }
@@ -4953,37 +6670,54 @@ static int stbi__compute_transparency16(stbi__png *z, stbi__uint16 tc[3], int ou
    return 1;
 }
 
-static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int pal_img_n)
+// expands the indices in a->out to finished rows with out_n channels
+static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int pal_img_n, int out_n)
 {
-   stbi__uint32 i, pixel_count = a->s->img_x * a->s->img_y;
-   stbi_uc *p, *temp_out, *orig = a->out;
-
-   p = (stbi_uc *) stbi__malloc_mad2(pixel_count, pal_img_n, 0);
-   if (p == NULL) return stbi__err("outofmem", "Out of memory");
-
-   // between here and free(out) below, exitting would leak
-   temp_out = p;
+   stbi__uint32 i, j, w = a->s->img_x, first, last;
+   stbi_uc *p, *orig = a->out;
+   stbi_uc table[256*4];
+   int k;
 
-   if (pal_img_n == 3) {
-      for (i=0; i < pixel_count; ++i) {
-         int n = orig[i]*4;
-         p[0] = palette[n  ];
-         p[1] = palette[n+1];
-         p[2] = palette[n+2];
-         p += 3;
-      }
-   } else {
-      for (i=0; i < pixel_count; ++i) {
-         int n = orig[i]*4;
-         p[0] = palette[n  ];
-         p[1] = palette[n+1];
-         p[2] = palette[n+2];
-         p[3] = palette[n+3];
-         p += 4;
+   // convert (and premultiply) the 256 entries once rather than every pixel
+   for (k=0; k < 256; ++k)
+      stbi__convert_row(table + k*out_n, palette + k*4, pal_img_n, out_n, 1);
+   if (a->s->premultiply)
+      stbi__premultiply_row(table, out_n, 256);
+
+   if (!stbi__png_output_rows(a, out_n)) return 0;
+   stbi__roi_rows(a->s, &first, &last);
+
+   for (j=0; j < last; ++j, orig += w) {
+      p = stbi__png_row(a, j);
+      switch (out_n) {
+         case 1:
+            for (i=0; i < w; ++i)
+               p[i] = table[orig[i]];
+            break;
+         case 2:
+            for (i=0; i < w; ++i, p += 2) {
+               stbi_uc *c = table + orig[i]*2;
+               p[0] = c[0];
+               p[1] = c[1];
+            }
+            break;
+         case 3:
+            for (i=0; i < w; ++i, p += 3) {
+               stbi_uc *c = table + orig[i]*3;
+               p[0] = c[0];
+               p[1] = c[1];
+               p[2] = c[2];
+            }
+            break;
+         default:
+            for (i=0; i < w; ++i, p += 4)
+               memcpy(p, table + orig[i]*4, 4);
+            break;
       }
+      if (a->s->band && !stbi__band_row_done(a->s, j)) return 0;
    }
-   STBI_FREE(a->out);
-   a->out = temp_out;
+   stbi__free(a->out);
+   a->out = NULL;
 
    STBI_NOTUSED(len);
 
@@ -5087,6 +6821,8 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
    z->expanded = NULL;
    z->idata = NULL;
    z->out = NULL;
+   z->rows = NULL;
+   z->image = NULL;
 
    if (!stbi__check_png_header(s)) return 0;
 
@@ -5188,7 +6924,7 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
                while (ioff + c.length > idata_limit)
                   idata_limit *= 2;
                STBI_NOTUSED(idata_limit_old);
-               p = (stbi_uc *) STBI_REALLOC_SIZED(z->idata, idata_limit_old, idata_limit); if (p == NULL) return stbi__err("outofmem", "Out of memory");
+               p = (stbi_uc *) stbi__realloc_sized(z->idata, idata_limit_old, idata_limit); if (p == NULL) return stbi__err("outofmem", "Out of memory");
                z->idata = p;
             }
             if (!stbi__getn(s, z->idata+ioff,c.length)) return stbi__err("outofdata","Corrupt PNG");
@@ -5201,17 +6937,34 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
-            // initial guess for decoded data size to avoid unnecessary reallocs
-            bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
-            raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+            // exact decoded data size, so the output buffer is allocated once and never reallocated
+            if (interlace) {
+               // every pass is its own image with its own filter bytes and row padding
+               static const int xorig[] = { 0,4,0,2,0,1,0 }, yorig[] = { 0,0,4,0,2,0,1 };
+               static const int xspc[]  = { 8,8,4,4,2,2,1 }, yspc[]  = { 8,8,8,4,4,2,2 };
+               int p;
+               raw_len = 0;
+               for (p=0; p < 7; ++p) {
+                  stbi__uint32 x = (s->img_x - xorig[p] + xspc[p]-1) / xspc[p];
+                  stbi__uint32 y = (s->img_y - yorig[p] + yspc[p]-1) / yspc[p];
+                  if (x && y) raw_len += ((s->img_n * x * z->depth + 7) >> 3) * y + y;
+               }
+            } else {
+               bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
+               raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+            }
             z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
             if (z->expanded == NULL) return 0; // zlib should set error
-            STBI_FREE(z->idata); z->idata = NULL;
+            stbi__free(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
+            // rows that need nothing but conversion come out finished, in the stbi_load_into buffer if there is one
+            if (!pal_img_n && !interlace && !has_trans && !is_iphone && z->depth <= 8)
+               if (!stbi__png_output_rows(z, req_comp ? req_comp : s->img_n)) return 0;
             if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
+            if (z->rows) s->img_out_n = z->rows_n;
             if (has_trans) {
                if (z->depth == 16) {
                   if (!stbi__compute_transparency16(z, tc16, s->img_out_n)) return 0;
@@ -5224,15 +6977,14 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (pal_img_n) {
                // pal_img_n == 3 or 4
                s->img_n = pal_img_n; // record the actual colors we had
-               s->img_out_n = pal_img_n;
-               if (req_comp >= 3) s->img_out_n = req_comp;
-               if (!stbi__expand_png_palette(z, palette, pal_len, s->img_out_n))
+               s->img_out_n = req_comp ? req_comp : pal_img_n;
+               if (!stbi__expand_png_palette(z, palette, pal_len, pal_img_n, s->img_out_n))
                   return 0;
             } else if (has_trans) {
                // non-paletted image with tRNS -> source image has (constant) alpha
                ++s->img_n;
             }
-            STBI_FREE(z->expanded); z->expanded = NULL;
+            stbi__free(z->expanded); z->expanded = NULL;
             // end of PNG chunk, read and skip CRC
             stbi__get32be(s);
             return 1;
@@ -5271,23 +7023,34 @@ static void *stbi__do_png(stbi__png *p, int *x, int *y, int *n, int req_comp, st
          ri->bits_per_channel = 16;
       else
          return stbi__errpuc("bad bits_per_channel", "PNG not supported: unsupported color depth");
-      result = p->out;
-      p->out = NULL;
-      if (req_comp && req_comp != p->s->img_out_n) {
-         if (ri->bits_per_channel == 8)
-            result = stbi__convert_format((unsigned char *) result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
-         else
-            result = stbi__convert_format16((stbi__uint16 *) result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
-         p->s->img_out_n = req_comp;
-         if (result == NULL) return result;
+      if (p->rows) {
+         // already converted, flipped and premultiplied
+         result = p->image;
+         p->image = NULL;
+         ri->flipped = p->s->flip;
+         ri->premultiplied = p->s->premultiply;
+      } else {
+         result = p->out;
+         p->out = NULL;
+         if (req_comp && req_comp != p->s->img_out_n) {
+            if (ri->bits_per_channel == 8)
+               result = stbi__convert_format((unsigned char *) result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
+            else
+               result = stbi__convert_format16((stbi__uint16 *) result, p->s->img_out_n, req_comp, p->s->img_x, p->s->img_y);
+            p->s->img_out_n = req_comp;
+            if (result == NULL) return result;
+         }
       }
       *x = p->s->img_x;
       *y = p->s->img_y;
       if (n) *n = p->s->img_n;
    }
-   STBI_FREE(p->out);      p->out      = NULL;
-   STBI_FREE(p->expanded); p->expanded = NULL;
-   STBI_FREE(p->idata);    p->idata    = NULL;
+   if (p->image != p->s->into)
+      stbi__free(p->image);
+   p->image = NULL;
+   stbi__free(p->out);      p->out      = NULL;
+   stbi__free(p->expanded); p->expanded = NULL;
+   stbi__free(p->idata);    p->idata    = NULL;
 
    return result;
 }
@@ -5598,7 +7361,7 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
    if (!out) return stbi__errpuc("outofmem", "Out of memory");
    if (info.bpp < 16) {
       int z=0;
-      if (psize == 0 || psize > 256) { STBI_FREE(out); return stbi__errpuc("invalid", "Corrupt BMP"); }
+      if (psize == 0 || psize > 256) { stbi__free(out); return stbi__errpuc("invalid", "Corrupt BMP"); }
       for (i=0; i < psize; ++i) {
          pal[i][2] = stbi__get8(s);
          pal[i][1] = stbi__get8(s);
@@ -5610,7 +7373,7 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
       if (info.bpp == 1) width = (s->img_x + 7) >> 3;
       else if (info.bpp == 4) width = (s->img_x + 1) >> 1;
       else if (info.bpp == 8) width = s->img_x;
-      else { STBI_FREE(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
+      else { stbi__free(out); return stbi__errpuc("bad bpp", "Corrupt BMP"); }
       pad = (-width)&3;
       if (info.bpp == 1) {
          for (j=0; j < (int) s->img_y; ++j) {
@@ -5667,13 +7430,13 @@ static void *stbi__bmp_load(stbi__context *s, int *x, int *y, int *comp, int req
             easy = 2;
       }
       if (!easy) {
-         if (!mr || !mg || !mb) { STBI_FREE(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
+         if (!mr || !mg || !mb) { stbi__free(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
          // right shift amt to put high bit in position #7
          rshift = stbi__high_bit(mr)-7; rcount = stbi__bitcount(mr);
          gshift = stbi__high_bit(mg)-7; gcount = stbi__bitcount(mg);
          bshift = stbi__high_bit(mb)-7; bcount = stbi__bitcount(mb);
          ashift = stbi__high_bit(ma)-7; acount = stbi__bitcount(ma);
-         if (rcount > 8 || gcount > 8 || bcount > 8 || acount > 8) { STBI_FREE(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
+         if (rcount > 8 || gcount > 8 || bcount > 8 || acount > 8) { stbi__free(out); return stbi__errpuc("bad masks", "Corrupt BMP"); }
       }
       for (j=0; j < (int) s->img_y; ++j) {
          if (easy) {
@@ -5941,7 +7704,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
       if ( tga_indexed)
       {
          if (tga_palette_len == 0) {  /* you have to have at least one entry! */
-            STBI_FREE(tga_data);
+            stbi__free(tga_data);
             return stbi__errpuc("bad palette", "Corrupt TGA");
          }
 
@@ -5950,7 +7713,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
          //   load the palette
          tga_palette = (unsigned char*)stbi__malloc_mad2(tga_palette_len, tga_comp, 0);
          if (!tga_palette) {
-            STBI_FREE(tga_data);
+            stbi__free(tga_data);
             return stbi__errpuc("outofmem", "Out of memory");
          }
          if (tga_rgb16) {
@@ -5961,8 +7724,8 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
                pal_entry += tga_comp;
             }
          } else if (!stbi__getn(s, tga_palette, tga_palette_len * tga_comp)) {
-               STBI_FREE(tga_data);
-               STBI_FREE(tga_palette);
+               stbi__free(tga_data);
+               stbi__free(tga_palette);
                return stbi__errpuc("bad palette", "Corrupt TGA");
          }
       }
@@ -6043,7 +7806,7 @@ static void *stbi__tga_load(stbi__context *s, int *x, int *y, int *comp, int req
       //   clear my palette, if I had one
       if ( tga_palette != NULL )
       {
-         STBI_FREE( tga_palette );
+         stbi__free( tga_palette );
       }
    }
 
@@ -6235,7 +7998,7 @@ static void *stbi__psd_load(stbi__context *s, int *x, int *y, int *comp, int req
          } else {
             // Read the RLE data.
             if (!stbi__psd_decode_rle(s, p, pixelCount)) {
-               STBI_FREE(out);
+               stbi__free(out);
                return stbi__errpuc("corrupt", "bad RLE data");
             }
          }
@@ -6527,7 +8290,7 @@ static void *stbi__pic_load(stbi__context *s,int *px,int *py,int *comp,int req_c
    memset(result, 0xff, x*y*4);
 
    if (!stbi__pic_load_core(s,x,y,comp, result)) {
-      STBI_FREE(result);
+      stbi__free(result);
       result=0;
    }
    *px = x;
@@ -6641,13 +8404,13 @@ static int stbi__gif_info_raw(stbi__context *s, int *x, int *y, int *comp)
    stbi__gif* g = (stbi__gif*) stbi__malloc(sizeof(stbi__gif));
    if (!g) return stbi__err("outofmem", "Out of memory");
    if (!stbi__gif_header(s, g, comp, 1)) {
-      STBI_FREE(g);
+      stbi__free(g);
       stbi__rewind( s );
       return 0;
    }
    if (x) *x = g->w;
    if (y) *y = g->h;
-   STBI_FREE(g);
+   stbi__free(g);
    return 1;
 }
 
@@ -6951,12 +8714,12 @@ static stbi_uc *stbi__gif_load_next(stbi__context *s, stbi__gif *g, int *comp, i
 
 static void *stbi__load_gif_main_outofmem(stbi__gif *g, stbi_uc *out, int **delays)
 {
-   STBI_FREE(g->out);
-   STBI_FREE(g->history);
-   STBI_FREE(g->background);
+   stbi__free(g->out);
+   stbi__free(g->history);
+   stbi__free(g->background);
 
-   if (out) STBI_FREE(out);
-   if (delays && *delays) STBI_FREE(*delays);
+   if (out) stbi__free(out);
+   if (delays && *delays) stbi__free(*delays);
    return stbi__errpuc("outofmem", "Out of memory");
 }
 
@@ -6991,7 +8754,7 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
             stride = g.w * g.h * 4;
 
             if (out) {
-               void *tmp = (stbi_uc*) STBI_REALLOC_SIZED( out, out_size, layers * stride );
+               void *tmp = (stbi_uc*) stbi__realloc_sized( out, out_size, layers * stride );
                if (!tmp)
                   return stbi__load_gif_main_outofmem(&g, out, delays);
                else {
@@ -7000,7 +8763,7 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
                }
 
                if (delays) {
-                  int *new_delays = (int*) STBI_REALLOC_SIZED( *delays, delays_size, sizeof(int) * layers );
+                  int *new_delays = (int*) stbi__realloc_sized( *delays, delays_size, sizeof(int) * layers );
                   if (!new_delays)
                      return stbi__load_gif_main_outofmem(&g, out, delays);
                   *delays = new_delays;
@@ -7030,9 +8793,9 @@ static void *stbi__load_gif_main(stbi__context *s, int **delays, int *x, int *y,
       } while (u != 0);
 
       // free temp buffer;
-      STBI_FREE(g.out);
-      STBI_FREE(g.history);
-      STBI_FREE(g.background);
+      stbi__free(g.out);
+      stbi__free(g.history);
+      stbi__free(g.background);
 
       // do the final conversion after loading everything;
       if (req_comp && req_comp != 4)
@@ -7064,12 +8827,12 @@ static void *stbi__gif_load(stbi__context *s, int *x, int *y, int *comp, int req
          u = stbi__convert_format(u, 4, req_comp, g.w, g.h);
    } else if (g.out) {
       // if there was an error and we allocated an image buffer, free it!
-      STBI_FREE(g.out);
+      stbi__free(g.out);
    }
 
    // free buffers needed for multiple frame loading;
-   STBI_FREE(g.history);
-   STBI_FREE(g.background);
+   stbi__free(g.history);
+   stbi__free(g.background);
 
    return u;
 }
@@ -7242,16 +9005,16 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
             stbi__hdr_convert(hdr_data, rgbe, req_comp);
             i = 1;
             j = 0;
-            STBI_FREE(scanline);
+            stbi__free(scanline);
             goto main_decode_loop; // yes, this makes no sense
          }
          len <<= 8;
          len |= stbi__get8(s);
-         if (len != width) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
+         if (len != width) { stbi__free(hdr_data); stbi__free(scanline); return stbi__errpf("invalid decoded scanline length", "corrupt HDR"); }
          if (scanline == NULL) {
             scanline = (stbi_uc *) stbi__malloc_mad2(width, 4, 0);
             if (!scanline) {
-               STBI_FREE(hdr_data);
+               stbi__free(hdr_data);
                return stbi__errpf("outofmem", "Out of memory");
             }
          }
@@ -7265,12 +9028,12 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
                   // Run
                   value = stbi__get8(s);
                   count -= 128;
-                  if ((count == 0) || (count > nleft)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                  if ((count == 0) || (count > nleft)) { stbi__free(hdr_data); stbi__free(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
                   for (z = 0; z < count; ++z)
                      scanline[i++ * 4 + k] = value;
                } else {
                   // Dump
-                  if ((count == 0) || (count > nleft)) { STBI_FREE(hdr_data); STBI_FREE(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
+                  if ((count == 0) || (count > nleft)) { stbi__free(hdr_data); stbi__free(scanline); return stbi__errpf("corrupt", "bad RLE data in HDR"); }
                   for (z = 0; z < count; ++z)
                      scanline[i++ * 4 + k] = stbi__get8(s);
                }
@@ -7280,7 +9043,7 @@ static float *stbi__hdr_load(stbi__context *s, int *x, int *y, int *comp, int re
             stbi__hdr_convert(hdr_data+(j*width + i)*req_comp, scanline + i*4, req_comp);
       }
       if (scanline)
-         STBI_FREE(scanline);
+         stbi__free(scanline);
    }
 
    return hdr_data;
@@ -7525,10 +9288,18 @@ static void *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int req
    out = (stbi_uc *) stbi__malloc_mad4(s->img_n, s->img_x, s->img_y, ri->bits_per_channel / 8, 0);
    if (!out) return stbi__errpuc("outofmem", "Out of memory");
    if (!stbi__getn(s, out, s->img_n * s->img_x * s->img_y * (ri->bits_per_channel / 8))) {
-      STBI_FREE(out);
+      stbi__free(out);
       return stbi__errpuc("bad PNM", "PNM file truncated");
    }
 
+   // 16-bit samples are big endian in the file, each is rebuilt in place over its own two bytes
+   if (ri->bits_per_channel == 16) {
+      stbi__uint16 *samples = (stbi__uint16 *) out;
+      size_t i, count = (size_t) s->img_n * s->img_x * s->img_y;
+      for (i = 0; i < count; ++i)
+         samples[i] = (stbi__uint16) ((out[i*2] << 8) | out[i*2+1]);
+   }
+
    if (req_comp && req_comp != s->img_n) {
       if (ri->bits_per_channel == 16) {
          out = (stbi_uc *) stbi__convert_format16((stbi__uint16 *) out, s->img_n, req_comp, s->img_x, s->img_y);
@@ -0,0 +1,81 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <vector>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Animation.h"
+
+namespace
+{
+    //Noisy motion capture like clip, every bone moves on every frame.
+    RawClip makeClip(int boneCount, int frameCount, float speed)
+    {
+        RawClip raw;
+        raw.frameCount = frameCount;
+        raw.boneCount = boneCount;
+        raw.frames.resize((size_t)boneCount * frameCount);
+
+        for (int frame = 0; frame < frameCount; frame++)
+        {
+            for (int bone = 0; bone < boneCount; bone++)
+            {
+                float t = frame / 30.0f * speed;
+                BoneTransform& transform = raw.frames[(size_t)frame * boneCount + bone];
+                transform.rotation = glm::angleAxis(std::sin(t * (1.0f + bone * 0.05f)) + 0.02f * std::sin(t * 17.0f), glm::normalize(glm::vec3(1.0f, bone * 0.1f, 0.3f)));
+                transform.translation = glm::vec3(std::sin(t + bone), std::cos(t * 0.5f), 0.1f * bone);
+                transform.scale = glm::vec3(1.0f);
+            }
+        }
+        return raw;
+    }
+}
+
+//Compression ratio, and one frame of 1000 characters each blending a walk and a run clip.
+BENCHMARK(animationSampling)
+{
+    const int boneCount = 60;
+    RawClip walk = makeClip(boneCount, 300, 1.0f);
+    RawClip run = makeClip(boneCount, 200, 1.7f);
+
+    AnimationClip clips[2];
+    double compressSeconds = bestTime(1, [&]()
+    {
+        compressClip(walk, clips[0]);
+        compressClip(run, clips[1]);
+    });
+
+    report("compress 2 clips", compressSeconds * 1000.0, "ms");
+    report("raw / compressed size", (double)(rawClipSize(walk) + rawClipSize(run)) / (clips[0].memorySize() + clips[1].memorySize()), "x");
+
+    BlendTree tree;
+    tree.clips = { &clips[0], &clips[1] };
+    tree.nodes = { { BlendClip, 0 }, { BlendClip, 1 }, { BlendLerp, 0 } };
+
+    const int characterCount = benchSize(1000, 50);
+    std::vector<AnimatedCharacter> characters(characterCount);
+    for (int i = 0; i < characterCount; i++)
+    {
+        characters[i].tree = &tree;
+        characters[i].parameters = { 0.0f, 0.0f, (i % 10) / 10.0f };
+    }
+
+    //Playing forward, so the cursors only step a key now and then as in a game.
+    const int frames = benchSize(120, 4);
+    int frame = 0;
+    double seconds = bestTime(frames, [&]()
+    {
+        float time = frame++ / 60.0f;
+        for (AnimatedCharacter& character : characters)
+        {
+            character.parameters[0] = std::fmod(time, clips[0].duration());
+            character.parameters[1] = std::fmod(time, clips[1].duration());
+        }
+        evaluateCharacters(characters.data(), characterCount);
+    });
+
+    report("characters", characterCount, "characters");
+    report("evaluateCharacters per frame", seconds * 1000.0, "ms");
+    benchSink += (uint64_t)characters[0].pose.values.size();
+}
@@ -0,0 +1,130 @@
+#include "Test.h"
+
+#include <cmath>
+
+#include <glm/gtc/quaternion.hpp>
+
+#include "Animation.h"
+
+namespace
+{
+    //Bones swinging and sliding at different speeds, translations spread over range.
+    RawClip makeClip(int boneCount, int frameCount, float range)
+    {
+        RawClip raw;
+        raw.frameCount = frameCount;
+        raw.boneCount = boneCount;
+        raw.frames.resize((size_t)boneCount * frameCount);
+
+        for (int frame = 0; frame < frameCount; frame++)
+        {
+            for (int bone = 0; bone < boneCount; bone++)
+            {
+                float t = frame / 30.0f;
+                BoneTransform& transform = raw.frames[(size_t)frame * boneCount + bone];
+                transform.rotation = glm::angleAxis(std::sin(t * (1.0f + bone * 0.1f)) * 1.5f, glm::normalize(glm::vec3(1.0f, bone * 0.3f, 0.5f)));
+                transform.translation = glm::vec3(std::sin(t + bone), std::cos(t * 0.7f), t / (frameCount / 30.0f)) * range;
+                transform.scale = glm::vec3(1.0f + 0.2f * std::sin(t * 2.0f));
+            }
+        }
+        return raw;
+    }
+
+    float maxComponentError(const glm::vec4& a, const glm::vec4& b)
+    {
+        glm::vec4 d = glm::abs(a - b);
+        return glm::max(glm::max(d.x, d.y), glm::max(d.z, d.w));
+    }
+
+    //Largest rotation, translation and scale error of the clip sampled at every frame of raw.
+    glm::vec3 worstErrors(const RawClip& raw, const AnimationClip& clip)
+    {
+        AnimationCursor cursor;
+        Pose pose;
+        glm::vec3 worst(0.0f);
+        for (int frame = 0; frame < raw.frameCount; frame++)
+        {
+            sampleClip(clip, frame / raw.frameRate, cursor, pose);
+            for (int bone = 0; bone < raw.boneCount; bone++)
+            {
+                const BoneTransform& exact = raw.frames[(size_t)frame * raw.boneCount + bone];
+                BoneTransform sampled = pose.bone(bone);
+
+                //q and -q are the same rotation.
+                glm::vec4 q(exact.rotation.x, exact.rotation.y, exact.rotation.z, exact.rotation.w);
+                glm::vec4 s(sampled.rotation.x, sampled.rotation.y, sampled.rotation.z, sampled.rotation.w);
+                if (glm::dot(q, s) < 0.0f) s = -s;
+
+                worst.x = glm::max(worst.x, maxComponentError(q, s));
+                worst.y = glm::max(worst.y, maxComponentError(glm::vec4(exact.translation, 0.0f), glm::vec4(sampled.translation, 0.0f)));
+                worst.z = glm::max(worst.z, maxComponentError(glm::vec4(exact.scale, 0.0f), glm::vec4(sampled.scale, 0.0f)));
+            }
+        }
+        return worst;
+    }
+
+    bool withinTolerance(const glm::vec3& worst, const ClipCompressionSettings& settings)
+    {
+        //A little slack for the float rounding of decode and interpolation.
+        return worst.x <= settings.rotationTolerance + 1e-6f && worst.y <= settings.translationTolerance + 1e-5f &&
+            worst.z <= settings.scaleTolerance + 1e-6f;
+    }
+}
+
+//Sampled at every frame the clip stays within the tolerances, keys included.
+TEST(animationErrorWithinTolerance)
+{
+    RawClip raw = makeClip(20, 300, 50.0f);
+    ClipCompressionSettings settings;
+
+    AnimationClip clip;
+    CHECK(compressClip(raw, clip, settings));
+    CHECK(clip.memorySize() < rawClipSize(raw));
+    CHECK(clip.floatValues.size() == 1);
+    CHECK(withinTolerance(worstErrors(raw, clip), settings));
+}
+
+//A 1000 unit range in 16 bit steps is 0.015 apart, far coarser than the 0.001 translation tolerance.
+//Only the translation tracks fall back to floats, and stay within tolerance.
+TEST(animationRangeTooBigForTolerance)
+{
+    RawClip raw = makeClip(2, 60, 1000.0f);
+    ClipCompressionSettings settings;
+
+    AnimationClip clip;
+    CHECK(compressClip(raw, clip, settings));
+    for (size_t track = 0; track < clip.tracks.size(); track++)
+    {
+        bool translation = track % TracksPerBone == TrackTranslation;
+        CHECK(clip.tracks[track].encoding == (translation ? (uint32_t)TrackFloat : (uint32_t)TrackQuantized));
+    }
+    CHECK(withinTolerance(worstErrors(raw, clip), settings));
+
+    ClipCompressionSettings loose;
+    loose.translationTolerance = 0.02f;
+    CHECK(compressClip(raw, clip, loose));
+    CHECK(clip.floatValues.size() == 1);
+}
+
+//Without frames there is no key for sampling to read.
+TEST(animationNoFrames)
+{
+    RawClip raw = makeClip(3, 0, 1.0f);
+
+    AnimationClip clip;
+    CHECK(!compressClip(raw, clip));
+    CHECK(clip.tracks.empty());
+}
+
+TEST(animationTooManyFrames)
+{
+    RawClip raw = makeClip(1, MaxClipFrames + 1, 1.0f);
+
+    AnimationClip clip;
+    CHECK(!compressClip(raw, clip));
+
+    raw.frameCount = MaxClipFrames;
+    raw.frames.resize(MaxClipFrames);
+    CHECK(compressClip(raw, clip));
+    CHECK(clip.keyFrames.back() == MaxClipFrames - 1);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+//Headless micro benchmarks for the engine code that runs without a GL context.
+//Every BENCHMARK(name) is run by OpenGL_Project_Bench, or only those whose name contains one of its arguments.
+//--quick shrinks the workloads so the whole suite runs as a smoke test.
+
+typedef void (*BenchmarkFunction)();
+
+struct BenchmarkRegistration
+{
+    BenchmarkRegistration(const char* name, BenchmarkFunction function);
+};
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static BenchmarkRegistration name##Registration(#name, name); \
+    static void name()
+
+//True for --quick runs, benchmarks pick smaller sizes then.
+bool quickRun();
+
+//Picks full or quick.
+inline int benchSize(int full, int quick) { return quickRun() ? quick : full; }
+
+//Best of repeats runs of body, in seconds. The best run keeps scheduler and page fault noise out.
+double bestTime(int repeats, const std::function<void()>& body);
+
+//One result line.
+void report(const char* what, double value, const char* unit);
+
+//Results go here so the optimizer can't drop the work that produced them.
+extern volatile uint64_t benchSink;
@@ -0,0 +1,77 @@
+#include "Bench.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+volatile uint64_t benchSink = 0;
+
+namespace
+{
+    struct Benchmark
+    {
+        const char* name;
+        BenchmarkFunction function;
+    };
+
+    //Function local so registrations from other files can't run before it is constructed.
+    std::vector<Benchmark>& benchmarks()
+    {
+        static std::vector<Benchmark> list;
+        return list;
+    }
+
+    bool quick = false;
+}
+
+BenchmarkRegistration::BenchmarkRegistration(const char* name, BenchmarkFunction function)
+{
+    benchmarks().push_back({ name, function });
+}
+
+bool quickRun()
+{
+    return quick;
+}
+
+double bestTime(int repeats, const std::function<void()>& body)
+{
+    double best = 1e30;
+    for (int i = 0; i < (quick ? 1 : repeats); i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (seconds < best) best = seconds;
+    }
+    return best;
+}
+
+void report(const char* what, double value, const char* unit)
+{
+    std::printf("    %-48s %12.3f %s\n", what, value, unit);
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<const char*> filters;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0) quick = true;
+        else filters.push_back(argv[i]);
+    }
+
+    for (const Benchmark& benchmark : benchmarks())
+    {
+        bool selected = filters.empty();
+        for (const char* filter : filters) selected = selected || std::strstr(benchmark.name, filter) != nullptr;
+        if (!selected) continue;
+
+        std::printf("%s\n", benchmark.name);
+        benchmark.function();
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "Bench.h"
+
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Bvh.h"
+#include "Parallel.h"
+
+namespace
+{
+    //Wavy height field, the kind of mesh picking and line of sight queries run against.
+    void makeTerrain(int size, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices)
+    {
+        for (int z = 0; z <= size; z++)
+        {
+            for (int x = 0; x <= size; x++)
+            {
+                float height = std::sin(x * 0.05f) * std::cos(z * 0.07f) * 8.0f;
+                positions.push_back(glm::vec3((float)x, height, (float)z));
+            }
+        }
+
+        for (int z = 0; z < size; z++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                unsigned int corner = (unsigned int)(z * (size + 1) + x);
+                unsigned int quad[6] = { corner, corner + 1, corner + size + 1, corner + 1, corner + size + 2, corner + size + 1 };
+                indices.insert(indices.end(), quad, quad + 6);
+            }
+        }
+    }
+}
+
+//Build time and closest hit / any hit throughput on a height field, plus the brute force loop it replaces.
+BENCHMARK(bvhBuildAndTraversal)
+{
+    const int size = benchSize(1024, 64);
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    makeTerrain(size, positions, indices);
+    int triangleCount = (int)indices.size() / 3;
+
+    MeshBvh bvh;
+    double buildSeconds = bestTime(3, [&]() { bvh.build(positions.data(), indices.data(), triangleCount); });
+    double refitSeconds = bestTime(3, [&]() { bvh.refit(); });
+
+    report("triangles", triangleCount, "triangles");
+    report("build", buildSeconds * 1000.0, "ms");
+    report("refit", refitSeconds * 1000.0, "ms");
+
+    //Rays from above the terrain, slanted so they cross many cells.
+    const int rayCount = benchSize(1 << 20, 4096);
+    std::mt19937 generator(27);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::vector<glm::vec3> origins(rayCount);
+    std::vector<glm::vec3> directions(rayCount);
+    for (int i = 0; i < rayCount; i++)
+    {
+        origins[i] = glm::vec3(unit(generator) * size, 20.0f, unit(generator) * size);
+        directions[i] = glm::normalize(glm::vec3(unit(generator) - 0.5f, -1.0f, unit(generator) - 0.5f));
+    }
+
+    std::atomic<int> hits(0);
+    auto closest = [&](int begin, int end)
+    {
+        int found = 0;
+        for (int i = begin; i < end; i++)
+        {
+            MeshHit hit;
+            hit.distance = 1000.0f;
+            found += bvh.intersect(origins[i], directions[i], hit);
+        }
+        hits += found;
+    };
+
+    double singleSeconds = bestTime(3, [&]() { closest(0, rayCount); });
+    double parallelSeconds = bestTime(3, [&]() { parallelFor(rayCount, 1024, closest); });
+    double occludedSeconds = bestTime(3, [&]()
+    {
+        int found = 0;
+        for (int i = 0; i < rayCount; i++) found += bvh.occluded(origins[i], directions[i], 1000.0f);
+        hits += found;
+    });
+
+    report("closest hit, 1 thread", rayCount / singleSeconds * 1e-6, "M rays/s");
+    report("closest hit, parallelFor", rayCount / parallelSeconds * 1e-6, "M rays/s");
+    report("any hit, 1 thread", rayCount / occludedSeconds * 1e-6, "M rays/s");
+
+    //The brute force loop is slow enough that a few rays give its rate.
+    const int bruteRays = benchSize(64, 4);
+    double bruteSeconds = bestTime(1, [&]()
+    {
+        for (int i = 0; i < bruteRays; i++)
+        {
+            float distance = 1000.0f;
+            glm::vec2 baryPosition;
+            hits += intersectRayMesh(origins[i], directions[i], positions.data(), indices.data(), triangleCount, distance, baryPosition) >= 0;
+        }
+    });
+    report("brute force intersectRayMesh, 1 thread", bruteRays / bruteSeconds, "rays/s");
+    benchSink += (uint64_t)hits.load();
+}
@@ -0,0 +1,161 @@
+#include "Test.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Bvh.h"
+
+namespace
+{
+    //Depth of the deepest leaf, the root node is depth 1.
+    int treeDepth(const Bvh& bvh, int index)
+    {
+        int depth = 0;
+        const Bvh4Node& node = bvh.node(index);
+        for (int slot = 0; slot < 4; slot++)
+        {
+            if (node.child[slot] >= 0)
+            {
+                int child = treeDepth(bvh, node.child[slot]);
+                if (child > depth) depth = child;
+            }
+        }
+        return depth + 1;
+    }
+
+    //Every primitive in exactly one leaf, no leaf bigger than a packet.
+    bool leavesCoverPrimitives(const Bvh& bvh, int count)
+    {
+        std::vector<int> seen(count, 0);
+        for (int i = 0; i < bvh.leafCount(); i++)
+        {
+            const BvhLeaf& leaf = bvh.leaf(i);
+            if (leaf.count < 1 || leaf.count > Bvh::MaxLeafSize) return false;
+            for (int slot = leaf.first; slot < leaf.first + leaf.count; slot++) seen[bvh.primitive(slot)]++;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            if (seen[i] != 1) return false;
+        }
+        return true;
+    }
+
+    //Small triangle at each center, stretched along x by stretch.
+    void makeTriangles(const std::vector<glm::vec3>& centers, float stretch, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices)
+    {
+        positions.clear();
+        indices.clear();
+        for (size_t i = 0; i < centers.size(); i++)
+        {
+            positions.push_back(centers[i] + glm::vec3(-stretch, -0.5f, 0.0f));
+            positions.push_back(centers[i] + glm::vec3(stretch, -0.5f, 0.0f));
+            positions.push_back(centers[i] + glm::vec3(0.0f, 0.5f, 0.0f));
+            for (int j = 0; j < 3; j++) indices.push_back((unsigned int)(i * 3 + j));
+        }
+    }
+
+    //Traversal against the brute force loop for rays along z through the triangle centers and in between.
+    bool matchesBruteForce(const std::vector<glm::vec3>& centers, const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices)
+    {
+        MeshBvh bvh;
+        bvh.build(positions.data(), indices.data(), (int)centers.size());
+
+        for (size_t i = 0; i < centers.size(); i++)
+        {
+            glm::vec3 orig = centers[i] + glm::vec3(0.0f, 0.0f, -10.0f);
+            glm::vec3 dir(0.0f, 0.0f, 1.0f);
+
+            MeshHit hit;
+            hit.distance = 100.0f;
+            bool found = bvh.intersect(orig, dir, hit);
+
+            float distance = 100.0f;
+            glm::vec2 baryPosition;
+            int expected = intersectRayMesh(orig, dir, positions.data(), indices.data(), (int)centers.size(), distance, baryPosition);
+
+            if (found != (expected >= 0)) return false;
+            if (found && std::fabs(hit.distance - distance) > 1e-4f) return false;
+            if (bvh.occluded(orig, dir, 100.0f) != found) return false;
+        }
+        return true;
+    }
+}
+
+TEST(bvhMatchesBruteForce)
+{
+    std::mt19937 generator(27);
+    std::uniform_real_distribution<float> unit(-50.0f, 50.0f);
+
+    std::vector<glm::vec3> centers;
+    for (int i = 0; i < 4000; i++) centers.push_back(glm::vec3(unit(generator), unit(generator), unit(generator)));
+
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    makeTriangles(centers, 0.5f, positions, indices);
+
+    MeshBvh bvh;
+    bvh.build(positions.data(), indices.data(), (int)centers.size());
+    CHECK(leavesCoverPrimitives(bvh.hierarchy(), (int)centers.size()));
+    CHECK(matchesBruteForce(centers, positions, indices));
+}
+
+//Boxes 16 times bigger than the one before leave nearly everything in the first SAH bin, so every SAH split
+//peels off one or two boxes and the binary tree becomes a chain.
+TEST(bvhSkewedInputStaysShallow)
+{
+    std::vector<Aabb> boxes;
+    for (int i = 0; i < 60; i++)
+    {
+        float size = std::ldexp(1.0f, -120 + i * 4);
+        boxes.push_back({ glm::vec3(size, 0.0f, 0.0f), glm::vec3(size * 2.0f, 1.0f, 1.0f) });
+    }
+
+    Bvh bvh;
+    bvh.build(boxes.data(), (int)boxes.size());
+    CHECK(treeDepth(bvh, 0) <= Bvh::MaxDepth);
+    CHECK(leavesCoverPrimitives(bvh, (int)boxes.size()));
+
+    //A ray along z through the middle of every box finds that box.
+    bool allFound = true;
+    for (int i = 0; i < (int)boxes.size(); i++)
+    {
+        glm::vec3 orig((boxes[i].min.x + boxes[i].max.x) * 0.5f, 0.5f, -1.0f);
+        float distance = 10.0f;
+        int found = -1;
+        bvh.closestHit(orig, glm::vec3(0.0f, 0.0f, 1.0f), distance, [&](int leaf, float& closest)
+        {
+            const BvhLeaf& range = bvh.leaf(leaf);
+            for (int slot = range.first; slot < range.first + range.count; slot++)
+            {
+                const Aabb& box = boxes[bvh.primitive(slot)];
+                if (orig.x >= box.min.x && orig.x <= box.max.x && closest > 1.0f)
+                {
+                    closest = 1.0f;
+                    found = bvh.primitive(slot);
+                    return true;
+                }
+            }
+            return false;
+        });
+        allFound = allFound && found == i;
+    }
+    CHECK(allFound);
+}
+
+//All centroids on one point, the SAH finds no plane and falls back to splitting the range in half.
+TEST(bvhDegenerateInput)
+{
+    std::vector<glm::vec3> centers(5000, glm::vec3(1.0f, 2.0f, 3.0f));
+
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> indices;
+    makeTriangles(centers, 0.5f, positions, indices);
+
+    MeshBvh bvh;
+    bvh.build(positions.data(), indices.data(), (int)centers.size());
+    CHECK(treeDepth(bvh.hierarchy(), 0) <= Bvh::MaxDepth);
+    CHECK(leavesCoverPrimitives(bvh.hierarchy(), (int)centers.size()));
+    CHECK(matchesBruteForce(centers, positions, indices));
+}
@@ -0,0 +1,68 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "ConstexprTransform.h"
+
+namespace
+{
+    constexpr ConstMat4 Translated = constTranslate(constIdentity(), { 1.0f, -2.0f, 3.0f });
+    constexpr ConstMat4 Scaled = constScale(Translated, { 2.0f, 0.5f, 4.0f });
+    constexpr ConstMat4 QuarterTurn = constRotate(constIdentity(), constRadians(90.0f), { 0.0f, 0.0f, 2.0f });
+    constexpr ConstMat4 Ortho = constOrtho(0.0f, 1280.0f, 0.0f, 720.0f, -1.0f, 1.0f);
+    constexpr ConstMat4 Perspective = constPerspective(constRadians(90.0f), 2.0f, 0.1f, 100.0f);
+
+    //Everything below is evaluated by the compiler, a non constant expression would fail to build.
+    static_assert(Translated.at(3, 0) == 1.0f && Translated.at(3, 1) == -2.0f && Translated.at(3, 2) == 3.0f && Translated.at(3, 3) == 1.0f, "translate");
+    static_assert(Scaled.at(0, 0) == 2.0f && Scaled.at(1, 1) == 0.5f && Scaled.at(2, 2) == 4.0f && Scaled.at(3, 0) == 1.0f, "scale keeps the translation");
+    static_assert(Ortho.at(0, 0) == 2.0f / 1280.0f && Ortho.at(3, 0) == -1.0f && Ortho.at(3, 1) == -1.0f && Ortho.at(2, 2) == -1.0f, "ortho");
+    static_assert(Perspective.at(2, 3) == -1.0f && Perspective.at(3, 3) == 0.0f, "perspective divides by -z");
+
+    //The series are only close to libm, so inexact results are checked against bounds.
+    static_assert(QuarterTurn.at(0, 1) > 0.9999999f && QuarterTurn.at(1, 0) < -0.9999999f, "rotate turns x into y");
+    static_assert(QuarterTurn.at(0, 0) > -1e-7f && QuarterTurn.at(0, 0) < 1e-7f && QuarterTurn.at(2, 2) > 0.9999999f, "rotate about z");
+    static_assert(Perspective.at(1, 1) > 0.9999999f && Perspective.at(1, 1) < 1.0000001f, "tan(45 degrees)");
+
+    constexpr ConstFloatArray<6> Vertices = constTransformPositions(ConstFloatArray<6>{ { 1.0f, 2.0f, 3.0f, 0.25f, 0.5f, 0.75f } }, 6, Scaled);
+    static_assert(Vertices.values[0] == 3.0f && Vertices.values[1] == -1.0f && Vertices.values[2] == 15.0f && Vertices.values[3] == 0.25f, "positions only");
+
+    //Largest difference between the matrices, in units of float epsilon times the matrix's largest element.
+    float ulpDistance(const ConstMat4& a, const glm::mat4& b)
+    {
+        float largest = 0.0f, difference = 0.0f;
+        for (int column = 0; column < 4; column++)
+        {
+            for (int row = 0; row < 4; row++)
+            {
+                largest = std::max(largest, std::fabs(b[column][row]));
+                difference = std::max(difference, std::fabs(a.at(column, row) - b[column][row]));
+            }
+        }
+        return difference / (largest * FLT_EPSILON);
+    }
+}
+
+//Compile time results against glm at run time. Products of exact inputs agree exactly, the series sin, cos and
+//sqrt are only within a few float ulps of libm.
+TEST(constexprTransformMatchesGlm)
+{
+    glm::mat4 identity(1.0f);
+    CHECK(ulpDistance(Translated, glm::translate(identity, glm::vec3(1.0f, -2.0f, 3.0f))) == 0.0f);
+    CHECK(ulpDistance(Scaled, glm::scale(glm::translate(identity, glm::vec3(1.0f, -2.0f, 3.0f)), glm::vec3(2.0f, 0.5f, 4.0f))) == 0.0f);
+    CHECK(ulpDistance(Ortho, glm::ortho(0.0f, 1280.0f, 0.0f, 720.0f, -1.0f, 1.0f)) == 0.0f);
+    CHECK(ulpDistance(QuarterTurn, glm::rotate(identity, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 2.0f))) <= 4.0f);
+    CHECK(ulpDistance(Perspective, glm::perspective(glm::radians(90.0f), 2.0f, 0.1f, 100.0f)) <= 4.0f);
+
+    constexpr ConstMat4 Turned = constRotate(Scaled, 2.5f, { 0.3f, -0.5f, 0.8f });
+    constexpr ConstMat4 Wound = constRotate(constIdentity(), -40.0f, { 1.0f, 1.0f, 1.0f });
+    constexpr ConstMat4 Narrow = constPerspective(0.3f, 0.75f, 0.5f, 1000.0f);
+    glm::mat4 scaled = glm::scale(glm::translate(identity, glm::vec3(1.0f, -2.0f, 3.0f)), glm::vec3(2.0f, 0.5f, 4.0f));
+    CHECK(ulpDistance(Turned, glm::rotate(scaled, 2.5f, glm::vec3(0.3f, -0.5f, 0.8f))) <= 4.0f);
+    CHECK(ulpDistance(Wound, glm::rotate(identity, -40.0f, glm::vec3(1.0f, 1.0f, 1.0f))) <= 4.0f);
+    CHECK(ulpDistance(Narrow, glm::perspective(0.3f, 0.75f, 0.5f, 1000.0f)) <= 4.0f);
+    CHECK(ulpDistance(constMultiply(Turned, Narrow), glm::rotate(scaled, 2.5f, glm::vec3(0.3f, -0.5f, 0.8f)) * glm::perspective(0.3f, 0.75f, 0.5f, 1000.0f)) <= 4.0f);
+}
@@ -0,0 +1,119 @@
+#include "Bench.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "DrawSort.h"
+#include "SceneComponents.h"
+
+namespace
+{
+    //Submits draws in the order given, binding state only when it changes, the way the scene loop did before sorting.
+    RenderStats submitUnsorted(const std::vector<Renderable>& renderables, const std::vector<uint32_t>& order)
+    {
+        RenderStats stats;
+        GLuint program = 0;
+        GLuint vao = 0;
+        GLuint textures[2] = { 0, 0 };
+
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const Renderable& renderable = renderables[order[i]];
+            if (renderable.program != program) { program = renderable.program; stats.programChanges++; }
+            for (int unit = 0; unit < 2; unit++)
+            {
+                if (renderable.textures[unit] == 0 || renderable.textures[unit] == textures[unit]) continue;
+                textures[unit] = renderable.textures[unit];
+                stats.textureChanges++;
+            }
+            if (renderable.vao != vao) { vao = renderable.vao; stats.vaoChanges++; }
+            stats.draws++;
+        }
+        return stats;
+    }
+}
+
+//1M packets with random keys: the radix sort against std::stable_sort on the key.
+BENCHMARK(drawPacketSort)
+{
+    const int count = benchSize(1000000, 50000);
+
+    std::mt19937_64 generator(38);
+    std::vector<DrawPacket> input(count);
+    for (int i = 0; i < count; i++) input[i] = { makeSortKey((uint32_t)(generator() % 4), (uint32_t)(generator() % 32), (uint32_t)(generator() % 1024),
+        (uint32_t)(generator() % 4096), (uint32_t)(generator() & 0xffff)), (uint32_t)i };
+
+    std::vector<DrawPacket> packets(count);
+    std::vector<DrawPacket> scratch(count);
+    std::vector<DrawPacket> reference(count);
+
+    double radixSeconds = bestTime(5, [&]()
+    {
+        packets = input;
+        sortDrawPackets(packets.data(), scratch.data(), count);
+    });
+
+    double stdSeconds = bestTime(5, [&]()
+    {
+        reference = input;
+        std::stable_sort(reference.begin(), reference.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+    });
+
+    int mismatches = 0;
+    for (int i = 0; i < count; i++) mismatches += packets[i].key != reference[i].key || packets[i].item != reference[i].item;
+
+    report("sortDrawPackets", radixSeconds * 1e3, "ms");
+    report("std::stable_sort", stdSeconds * 1e3, "ms");
+    report("speedup", stdSeconds / radixSeconds, "x");
+    report("packets out of place", mismatches, "packets");
+    benchSink += packets[0].item;
+}
+
+//A frame of draws over 8 programs, 256 materials and 2048 meshes, in scene order and sorted by key.
+BENCHMARK(drawQueueStateChanges)
+{
+    const int drawCount = benchSize(100000, 10000);
+
+    std::mt19937 generator(380);
+    std::vector<Renderable> renderables(drawCount);
+    std::vector<glm::mat4> worlds(drawCount, glm::mat4(1.0f));
+    std::vector<uint32_t> order(drawCount);
+    for (int i = 0; i < drawCount; i++)
+    {
+        Renderable& r = renderables[i];
+        r.program = 1 + generator() % 8;
+        r.modelLocation = 0;
+        uint32_t material = generator() % 256;
+        r.textures[0] = 1 + material;
+        r.textures[1] = material % 4 == 0 ? 1000 + material : 0;
+        r.vao = 1 + generator() % 2048;
+        r.indexCount = 36;
+        order[i] = (uint32_t)i;
+    }
+
+    RenderStats unsorted = submitUnsorted(renderables, order);
+
+    DrawQueue queue;
+    CommandBuffer commands;
+    RenderStats sorted;
+    double submitSeconds = bestTime(5, [&]()
+    {
+        queue.clear();
+        commands.reset();
+        for (int i = 0; i < drawCount; i++)
+        {
+            const Renderable& r = renderables[i];
+            queue.add(makeSortKey(0, r.program, queue.material(r.textures), r.vao, (uint32_t)(i & 0xffff)), &r, &worlds[i]);
+        }
+        sorted = queue.submit(commands);
+    });
+
+    report("state changes in scene order", unsorted.stateChanges(), "changes");
+    report("state changes sorted by key", sorted.stateChanges(), "changes");
+    report("program changes sorted", sorted.programChanges, "changes");
+    report("texture changes sorted", sorted.textureChanges, "changes");
+    report("vao changes sorted", sorted.vaoChanges, "changes");
+    report("add + sort + record", submitSeconds / drawCount * 1e9, "ns/draw");
+    benchSink += commands.size();
+}
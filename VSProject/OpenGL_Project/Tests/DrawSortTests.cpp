@@ -0,0 +1,47 @@
+#include "Test.h"
+
+#include <vector>
+
+#include "DrawSort.h"
+#include "SceneComponents.h"
+
+//Texture names that agree in their low bits still get materials of their own, so a queue sorted by key binds
+//each texture once instead of alternating between them by depth.
+TEST(drawQueueMaterialsDoNotCollide)
+{
+    DrawQueue queue;
+    const GLuint names[3][2] = { { 1, 0 }, { 257, 0 }, { 1, 257 } };
+    CHECK(queue.material(names[0]) == 0);
+    CHECK(queue.material(names[1]) == 1);
+    CHECK(queue.material(names[2]) == 2);
+    CHECK(queue.material(names[1]) == 1);
+
+    const int drawCount = 64;
+    std::vector<Renderable> renderables(drawCount);
+    glm::mat4 world(1.0f);
+    for (int i = 0; i < drawCount; i++)
+    {
+        Renderable& r = renderables[i];
+        r.vao = 1;
+        r.program = 1;
+        r.modelLocation = 0;
+        r.textures[0] = i % 2 ? 1 : 257;
+        r.textures[1] = 0;
+        r.indexCount = 6;
+    }
+
+    for (int frame = 0; frame < 2; frame++)
+    {
+        queue.clear();
+        CommandBuffer commands;
+        for (int i = 0; i < drawCount; i++)
+        {
+            const Renderable& r = renderables[i];
+            queue.add(makeSortKey(0, r.program, queue.material(r.textures), r.vao, (uint32_t)i), &r, &world);
+        }
+
+        RenderStats stats = queue.submit(commands);
+        CHECK(stats.draws == drawCount);
+        CHECK(stats.textureChanges == 2);
+    }
+}
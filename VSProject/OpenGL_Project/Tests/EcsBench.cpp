@@ -0,0 +1,76 @@
+#include "Bench.h"
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Ecs.h"
+
+namespace
+{
+    struct BenchPosition { glm::vec3 value; };
+    struct BenchVelocity { glm::vec3 value; };
+    struct BenchHealth { float value; };
+}
+
+//1M entities in two archetypes, integrating position by velocity through the different query styles.
+BENCHMARK(ecsIteration)
+{
+    const int entityCount = benchSize(1000000, 20000);
+
+    EcsWorld world;
+    std::vector<Entity> entities(entityCount);
+    double createSeconds = bestTime(1, [&]()
+    {
+        for (int i = 0; i < entityCount; i++)
+        {
+            BenchPosition position = { glm::vec3((float)i, 0.0f, 0.0f) };
+            BenchVelocity velocity = { glm::vec3(1.0f, 0.5f, 0.25f) };
+            if (i % 2) entities[i] = world.create(position, velocity, BenchHealth{ 100.0f });
+            else entities[i] = world.create(position, velocity);
+        }
+    });
+
+    double chunkSeconds = bestTime(10, [&]()
+    {
+        world.forEachChunk<BenchPosition, BenchVelocity>([](int count, const Entity*, BenchPosition* positions, BenchVelocity* velocities)
+        {
+            for (int i = 0; i < count; i++) positions[i].value += velocities[i].value * 0.016f;
+        });
+    });
+
+    double entitySeconds = bestTime(10, [&]()
+    {
+        world.forEach<BenchPosition, BenchVelocity>([](Entity, BenchPosition& position, BenchVelocity& velocity)
+        {
+            position.value += velocity.value * 0.016f;
+        });
+    });
+
+    double parallelSeconds = bestTime(10, [&]()
+    {
+        world.parallelForEachChunk<BenchPosition, BenchVelocity>([](int count, const Entity*, BenchPosition* positions, BenchVelocity* velocities)
+        {
+            for (int i = 0; i < count; i++) positions[i].value += velocities[i].value * 0.016f;
+        });
+    });
+
+    double getSeconds = bestTime(3, [&]()
+    {
+        float sum = 0.0f;
+        for (int i = 0; i < entityCount; i++) sum += world.get<BenchPosition>(entities[i])->value.x;
+        benchSink += (uint64_t)sum;
+    });
+
+    double destroySeconds = bestTime(1, [&]()
+    {
+        for (int i = 0; i < entityCount; i++) world.destroy(entities[i]);
+    });
+
+    report("create", createSeconds / entityCount * 1e9, "ns/entity");
+    report("forEachChunk", chunkSeconds / entityCount * 1e9, "ns/entity");
+    report("forEach", entitySeconds / entityCount * 1e9, "ns/entity");
+    report("parallelForEachChunk", parallelSeconds / entityCount * 1e9, "ns/entity");
+    report("get by handle", getSeconds / entityCount * 1e9, "ns/entity");
+    report("destroy", destroySeconds / entityCount * 1e9, "ns/entity");
+}
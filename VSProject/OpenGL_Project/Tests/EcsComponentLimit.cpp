@@ -0,0 +1,44 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Ecs.h"
+
+//Registers one component type more than masks have bits for, registration has to abort on the last one.
+//The abort handler turns that into success, getting to the end of main is the failure.
+
+template<int N>
+struct NumberedComponent
+{
+    int value[N];
+};
+
+template<int N>
+struct Register
+{
+    static void run()
+    {
+        Register<N - 1>::run();
+        componentId<NumberedComponent<N> >();
+    }
+};
+
+template<>
+struct Register<0>
+{
+    static void run() {}
+};
+
+extern "C" void aborted(int)
+{
+    std::_Exit(0);
+}
+
+int main()
+{
+    std::signal(SIGABRT, aborted);
+    Register<MaxComponentTypes + 1>::run();
+
+    std::printf("Registered %d component types without aborting\n", MaxComponentTypes + 1);
+    return 1;
+}
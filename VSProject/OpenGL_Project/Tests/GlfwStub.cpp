@@ -0,0 +1,14 @@
+#include <GLFW/glfw3.h>
+
+//The tests never open a window or make a context current. MultiDraw.cpp still links against GLFW's extension
+//lookup, these stand in for it and report that nothing is supported.
+
+int glfwExtensionSupported(const char*)
+{
+    return GLFW_FALSE;
+}
+
+GLFWglproc glfwGetProcAddress(const char*)
+{
+    return nullptr;
+}
@@ -0,0 +1,677 @@
+#include "Bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "BumpArena.h"
+#include "ImageCorpus.h"
+#include "ImageDecoders.h"
+#include "ImageInfo.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "StbAllocationCounter.h"
+#include "stb_image.h"
+
+namespace
+{
+    //Best decode time of file with decoder, mismatches is set when the pixels differ from expected.
+    double timeDecode(const ImageDecoder& decoder, const std::vector<unsigned char>& file, int channels, const std::vector<unsigned char>& expected, int repeats, bool& mismatches)
+    {
+        return bestTime(repeats, [&]()
+        {
+            int x, y, n;
+            unsigned char* pixels = decoder.load(file.data(), (int)file.size(), &x, &y, &n, channels);
+            mismatches = pixels == nullptr || (size_t)x * y * channels != expected.size() || std::memcmp(pixels, expected.data(), expected.size()) != 0;
+            if (pixels != nullptr) benchSink += pixels[0];
+            decoder.free(pixels);
+        });
+    }
+
+    //One line per decoder, marked with mismatchNote where its pixels aren't expected.
+    void reportDecoders(const std::string& image, const std::vector<unsigned char>& file, int channels, const std::vector<unsigned char>& expected, int repeats,
+        const char* mismatchNote = " (WRONG PIXELS)")
+    {
+        //One untimed round first, or the first decoder measured pays for growing the heap and clocking up.
+        bool mismatches;
+        for (const ImageDecoder* decoder : imageDecoders()) timeDecode(*decoder, file, channels, expected, 1, mismatches);
+
+        for (const ImageDecoder* decoder : imageDecoders())
+        {
+            double seconds = timeDecode(*decoder, file, channels, expected, repeats, mismatches);
+
+            std::string what = image + ", " + decoder->name + (mismatches ? mismatchNote : "");
+            report(what.c_str(), expected.size() / seconds * 1e-6, "MB/s");
+        }
+    }
+}
+
+//Large RGB and RGBA PNGs (UI atlas sized) with every row using one filter type. Stored without compression
+//the inflate step is a copy, so the time is mostly unfiltering. Adaptive filtering at the usual level is the
+//case real files are.
+BENCHMARK(pngUnfilter)
+{
+    const int size = benchSize(2048, 256);
+
+    struct FilterCase { PngFilter filter; const char* name; int level; };
+    const FilterCase cases[] =
+    {
+        { PngFilterSub, "sub, stored", 0 },
+        { PngFilterUp, "up, stored", 0 },
+        { PngFilterAverage, "average, stored", 0 },
+        { PngFilterPaeth, "paeth, stored", 0 },
+        { PngFilterAdaptive, "adaptive, level 6", 6 },
+    };
+
+    for (int channels = 3; channels <= 4; channels++)
+    {
+        std::vector<unsigned char> pixels = makeTestPixels(size, size, channels, 41);
+        for (const FilterCase& c : cases)
+        {
+            PngOptions options;
+            options.filter = c.filter;
+            options.level = c.level;
+            std::vector<unsigned char> png = encodePng(pixels.data(), size, size, channels, options);
+
+            reportDecoders(std::string(channels == 3 ? "rgb8 " : "rgba8 ") + c.name, png, channels, pixels, 5);
+        }
+    }
+}
+
+namespace
+{
+    //Words from a small vocabulary, many medium length matches at all distances like text chunks and shaders.
+    std::vector<unsigned char> makeWords(size_t size, uint32_t seed)
+    {
+        static const char* words[] = { "vec3 ", "float ", "uniform ", "texture", "(", ")", ";\n", "    ", "gl_Position", " = ", "normal", "0.5", "mat4 ", "model", "view", "*" };
+        RandomStream random(seed);
+        std::vector<unsigned char> data;
+        while (data.size() < size)
+        {
+            const char* word = words[random.nextUInt() % 16];
+            data.insert(data.end(), word, word + std::strlen(word));
+        }
+        data.resize(size);
+        return data;
+    }
+
+    //Runs repeating the last 1 to 8 bytes, so nearly every match overlaps its own output.
+    std::vector<unsigned char> makeRuns(size_t size, uint32_t seed)
+    {
+        RandomStream random(seed);
+        std::vector<unsigned char> data;
+        while (data.size() < size)
+        {
+            int period = 1 + (int)(random.nextUInt() % 8);
+            int length = 16 + (int)(random.nextUInt() % 500);
+            size_t start = data.size();
+            for (int i = 0; i < period; i++) data.push_back((unsigned char)random.nextUInt());
+            for (int i = period; i < length; i++) data.push_back(data[start + i - period]);
+        }
+        data.resize(size);
+        return data;
+    }
+
+    std::vector<unsigned char> zlibCompress(const std::vector<unsigned char>& data, int level)
+    {
+        uLongf size = compressBound((uLong)data.size());
+        std::vector<unsigned char> compressed(size);
+        compress2(compressed.data(), &size, data.data(), (uLong)data.size(), level);
+        compressed.resize(size);
+        return compressed;
+    }
+}
+
+//zlib streams on their own: image pixels, text and overlapping runs, inflated by every stb_image build and by
+//zlib itself for reference. Then whole PNGs at low and high compression, where inflate is most of the decode.
+BENCHMARK(zlibInflate)
+{
+    const int size = benchSize(2048, 256);
+    const size_t bytes = (size_t)size * size * 4;
+
+    struct Stream { const char* name; std::vector<unsigned char> data; int level; };
+    std::vector<unsigned char> pixels = makeTestPixels(size, size, 4, 42);
+    Stream streams[] =
+    {
+        { "rgba pixels, level 1", pixels, 1 },
+        { "rgba pixels, level 9", pixels, 9 },
+        { "words, level 6", makeWords(bytes, 42), 6 },
+        { "short runs, level 6", makeRuns(bytes, 42), 6 },
+    };
+
+    for (Stream& stream : streams)
+    {
+        std::vector<unsigned char> compressed = zlibCompress(stream.data, stream.level);
+        report((std::string(stream.name) + ", compression ratio").c_str(), (double)stream.data.size() / compressed.size(), ": 1");
+
+        for (const ImageDecoder* decoder : imageDecoders())
+        {
+            bool wrong = false;
+            double seconds = bestTime(5, [&]()
+            {
+                int length = 0;
+                char* output = decoder->inflate((const char*)compressed.data(), (int)compressed.size(), &length);
+                wrong = output == nullptr || (size_t)length != stream.data.size() || std::memcmp(output, stream.data.data(), length) != 0;
+                decoder->free(output);
+            });
+
+            std::string what = std::string(stream.name) + ", " + decoder->name + (wrong ? " (WRONG OUTPUT)" : "");
+            report(what.c_str(), stream.data.size() / seconds * 1e-6, "MB/s");
+        }
+
+        std::vector<unsigned char> output(stream.data.size());
+        double zlibSeconds = bestTime(5, [&]()
+        {
+            uLongf length = (uLongf)output.size();
+            uncompress(output.data(), &length, compressed.data(), (uLong)compressed.size());
+        });
+        report((std::string(stream.name) + ", zlib uncompress").c_str(), stream.data.size() / zlibSeconds * 1e-6, "MB/s");
+    }
+
+    for (int level = 1; level <= 9; level += 8)
+    {
+        PngOptions options;
+        options.level = level;
+        std::vector<unsigned char> png = encodePng(pixels.data(), size, size, 4, options);
+        reportDecoders(std::string("rgba8 png, level ") + std::to_string(level), png, 4, pixels, 5);
+    }
+}
+
+namespace
+{
+    void stbiParallelFor(void*, int count, stbi_parallel_task* task, void* taskData)
+    {
+        parallelFor(count, 1, [=](int begin, int end) { task(taskData, begin, end); });
+    }
+}
+
+//A 24 MP photo decoded serially and with parallelFor lent to stb_image: without restart markers (only IDCT
+//and color conversion spread out), with a restart every MCU row or every 8, and progressive.
+//On one worker the difference is the cost of splitting the work up.
+BENCHMARK(jpegParallelDecode)
+{
+    report("workers", workerCount(), "threads");
+
+    const int width = benchSize(6000, 640);
+    const int height = benchSize(4000, 480);
+    std::vector<unsigned char> pixels = makeTestPixels(width, height, 3, 43);
+
+    struct JpegCase { const char* name; int restartRows; bool progressive; };
+    const JpegCase cases[] =
+    {
+        { "no restarts", 0, false },
+        { "restart every MCU row", 1, false },
+        { "restart every 8 MCU rows", 8, false },
+        { "progressive", 0, true },
+    };
+
+    for (const JpegCase& c : cases)
+    {
+        JpegOptions options;
+        options.restartRows = c.restartRows;
+        options.progressive = c.progressive;
+        std::vector<unsigned char> jpeg = encodeJpeg(pixels.data(), width, height, 3, options);
+
+        std::vector<unsigned char> serialPixels;
+        auto decode = [&](std::vector<unsigned char>& output)
+        {
+            int x, y, n;
+            unsigned char* decoded = stbi_load_from_memory(jpeg.data(), (int)jpeg.size(), &x, &y, &n, 3);
+            if (decoded != nullptr) output.assign(decoded, decoded + (size_t)x * y * 3);
+            stbi_image_free(decoded);
+        };
+
+        double serialSeconds = bestTime(3, [&]() { decode(serialPixels); });
+
+        std::vector<unsigned char> parallelPixels;
+        stbi_set_parallel_for(stbiParallelFor, nullptr);
+        double parallelSeconds = bestTime(3, [&]() { decode(parallelPixels); });
+        stbi_set_parallel_for(nullptr, nullptr);
+
+        bool identical = !serialPixels.empty() && serialPixels == parallelPixels;
+        report((std::string(c.name) + ", serial").c_str(), pixels.size() / serialSeconds * 1e-6, "MB/s");
+        report((std::string(c.name) + ", parallel").c_str(), pixels.size() / parallelSeconds * 1e-6, "MB/s");
+        report((std::string(c.name) + ", speedup").c_str(), serialSeconds / parallelSeconds, identical ? "x" : "x (OUTPUT DIFFERS)");
+    }
+}
+
+//JPEG decode with the AVX2 kernels, SSE2 only, no SIMD and the baseline: 4:2:0 (the h2v2 upsampler and color
+//conversion), 4:4:4 and gray, each at quality 90 and 50. The SIMD kernels have to match the scalar ones exactly.
+BENCHMARK(jpegSimdKernels)
+{
+    const int width = benchSize(4096, 512);
+    const int height = benchSize(3072, 384);
+
+    struct KernelCase { const char* name; int channels; bool subsampled; };
+    const KernelCase cases[] =
+    {
+        { "rgb 4:2:0", 3, true },
+        { "rgb 4:4:4", 3, false },
+        { "gray", 1, false },
+    };
+
+    for (const KernelCase& c : cases)
+    {
+        std::vector<unsigned char> pixels = makeTestPixels(width, height, c.channels, 44);
+        for (int quality = 90; quality >= 50; quality -= 40)
+        {
+            JpegOptions options;
+            options.quality = quality;
+            options.subsampled = c.subsampled;
+            std::vector<unsigned char> jpeg = encodeJpeg(pixels.data(), width, height, c.channels, options);
+
+            int x, y, n;
+            unsigned char* scalar = stbImageScalarDecoder().load(jpeg.data(), (int)jpeg.size(), &x, &y, &n, c.channels);
+            std::vector<unsigned char> expected(scalar, scalar + (size_t)x * y * c.channels);
+            stbImageScalarDecoder().free(scalar);
+
+            reportDecoders(std::string(c.name) + " q" + std::to_string(quality), jpeg, c.channels, expected, 3, " (DIFFERS FROM SCALAR)");
+        }
+    }
+}
+
+//Decoding for a texture upload: stbi_load and a copy into the upload buffer (a pixel unpack buffer, rows 256
+//byte aligned), against stbi_load_into writing there directly. RGB files are expanded to RGBA on the way.
+BENCHMARK(decodeIntoBuffer)
+{
+    const int size = benchSize(2048, 256);
+    const int stride = (size * 4 + 255) / 256 * 256;
+
+    std::vector<unsigned char> rgb = makeTestPixels(size, size, 3, 45);
+    std::vector<unsigned char> rgba = makeTestPixels(size, size, 4, 45);
+    struct UploadCase { const char* name; std::vector<unsigned char> file; };
+    UploadCase cases[] =
+    {
+        { "rgba png", encodePng(rgba.data(), size, size, 4) },
+        { "rgb png to rgba", encodePng(rgb.data(), size, size, 3) },
+        { "rgb jpeg to rgba", encodeJpeg(rgb.data(), size, size, 3) },
+    };
+
+    std::vector<unsigned char> upload((size_t)stride * size);
+    for (UploadCase& c : cases)
+    {
+        StbAllocationCounter copyCounter;
+        double copySeconds = bestTime(5, [&]()
+        {
+            int x, y, n;
+            unsigned char* pixels = stbi_load_from_memory(c.file.data(), (int)c.file.size(), &x, &y, &n, 4);
+            for (int row = 0; row < y; row++) std::memcpy(&upload[(size_t)row * stride], pixels + (size_t)row * x * 4, (size_t)x * 4);
+            stbi_image_free(pixels);
+        });
+        int copyAllocations = copyCounter.allocations;
+        size_t copyPeak = copyCounter.peakBytes;
+        std::vector<unsigned char> copied = upload;
+
+        StbAllocationCounter intoCounter;
+        double intoSeconds = bestTime(5, [&]()
+        {
+            int x, y, n;
+            stbi_load_into_from_memory(c.file.data(), (int)c.file.size(), upload.data(), stride, size, size, &x, &y, &n, 4);
+        });
+
+        //Per decode, bestTime ran each the same number of times.
+        int runs = quickRun() ? 1 : 5;
+        std::string name = c.name;
+        report((name + ", load + copy").c_str(), (double)size * size * 4 / copySeconds * 1e-6, "MB/s");
+        report((name + ", load_into").c_str(), (double)size * size * 4 / intoSeconds * 1e-6, upload == copied ? "MB/s" : "MB/s (PIXELS DIFFER)");
+        report((name + ", load + copy allocations").c_str(), copyAllocations / runs, "per decode");
+        report((name + ", load_into allocations").c_str(), intoCounter.allocations / runs, "per decode");
+        report((name + ", load + copy peak").c_str(), copyPeak / 1048576.0, "MB");
+        report((name + ", load_into peak").c_str(), intoCounter.peakBytes / 1048576.0, "MB");
+    }
+}
+
+//A batch of small and medium textures (PNG and JPEG, 64 to 512 pixels) decoded into one upload buffer, the
+//scratch coming from malloc or out of a bump arena rewound after every image the way loadImageInto does it.
+BENCHMARK(arenaBatchDecode)
+{
+    const int imageCount = benchSize(1000, 40);
+
+    RandomStream random(46);
+    std::vector<std::vector<unsigned char> > files;
+    std::vector<std::vector<unsigned char> > distinct;
+    for (int i = 0; i < 16; i++)
+    {
+        int size = 64 << (random.nextUInt() % 4);
+        bool jpeg = i % 3 == 0;
+        std::vector<unsigned char> pixels = makeTestPixels(size, size, jpeg ? 3 : 4, 46 + i);
+        distinct.push_back(jpeg ? encodeJpeg(pixels.data(), size, size, 3) : encodePng(pixels.data(), size, size, 4));
+    }
+    for (int i = 0; i < imageCount; i++) files.push_back(distinct[random.nextUInt() % distinct.size()]);
+
+    std::vector<unsigned char> upload(512 * 512 * 4);
+    size_t bytes = 0;
+    auto decodeAll = [&]()
+    {
+        bytes = 0;
+        for (const std::vector<unsigned char>& file : files)
+        {
+            int x = 0, y = 0, n;
+            stbi_load_into_from_memory(file.data(), (int)file.size(), upload.data(), 512 * 4, 512, 512, &x, &y, &n, 4);
+            bytes += (size_t)x * y * 4;
+        }
+    };
+
+    double mallocSeconds = bestTime(5, decodeAll);
+
+    int allocations;
+    size_t mallocPeak;
+    {
+        StbAllocationCounter counter;
+        decodeAll();
+        allocations = counter.allocations;
+        mallocPeak = counter.peakBytes;
+    }
+
+    BumpArena arena;
+    stbi_allocator allocator;
+    allocator.alloc = [](void* user, size_t size) { return ((BumpArena*)user)->allocate(size); };
+    allocator.realloc = [](void* user, void* p, size_t oldSize, size_t newSize) { return ((BumpArena*)user)->reallocate(p, oldSize, newSize); };
+    allocator.free = [](void*, void*) {};
+    allocator.user = &arena;
+
+    const stbi_allocator* previous = stbi_set_allocator_thread(&allocator);
+    double arenaSeconds = bestTime(5, [&]()
+    {
+        bytes = 0;
+        for (const std::vector<unsigned char>& file : files)
+        {
+            BumpArena::Marker start = arena.mark();
+            int x = 0, y = 0, n;
+            stbi_load_into_from_memory(file.data(), (int)file.size(), upload.data(), 512 * 4, 512, 512, &x, &y, &n, 4);
+            bytes += (size_t)x * y * 4;
+            arena.rewind(start);
+        }
+    });
+    stbi_set_allocator_thread(previous);
+
+    report("malloc", imageCount / mallocSeconds, "images/s");
+    report("bump arena", imageCount / arenaSeconds, "images/s");
+    report("speedup", mallocSeconds / arenaSeconds, "x");
+    report("malloc calls", (double)allocations / imageCount, "per image");
+    report("peak scratch with malloc", mallocPeak / 1048576.0, "MB");
+    report("peak scratch in the arena", arena.peakUsage() / 1048576.0, "MB");
+    report("arena reserved from the system", arena.capacity() / 1048576.0, "MB");
+    benchSink += bytes;
+}
+
+namespace
+{
+    //The passes stb_image used to make after decoding, the same arithmetic as its premultiply.
+    void flipRows(unsigned char* pixels, int width, int height, int channels)
+    {
+        size_t rowBytes = (size_t)width * channels;
+        std::vector<unsigned char> row(rowBytes);
+        for (int y = 0; y < height / 2; y++)
+        {
+            unsigned char* top = pixels + y * rowBytes;
+            unsigned char* bottom = pixels + (height - 1 - y) * rowBytes;
+            std::memcpy(row.data(), top, rowBytes);
+            std::memcpy(top, bottom, rowBytes);
+            std::memcpy(bottom, row.data(), rowBytes);
+        }
+    }
+
+    void premultiply(unsigned char* p, size_t count)
+    {
+        for (size_t i = 0; i < count; i++, p += 4)
+        {
+            unsigned int a = p[3];
+            for (int c = 0; c < 3; c++)
+            {
+                unsigned int t = p[c] * a + 128;
+                p[c] = (unsigned char)((t + (t >> 8)) >> 8);
+            }
+        }
+    }
+}
+
+//Loading for GL: RGBA out, bottom row first, premultiplied. The decoders doing all of it while writing rows,
+//against decoding plain and then flipping and premultiplying in passes of their own.
+BENCHMARK(fusedRowConversion)
+{
+    const int size = benchSize(2048, 256);
+
+    std::vector<unsigned char> rgb = makeTestPixels(size, size, 3, 47);
+    std::vector<unsigned char> rgba = makeTestPixels(size, size, 4, 47);
+    struct FusedCase { const char* name; std::vector<unsigned char> file; };
+    FusedCase cases[] =
+    {
+        { "rgba png", encodePng(rgba.data(), size, size, 4) },
+        { "rgb png", encodePng(rgb.data(), size, size, 3) },
+        { "rgb jpeg", encodeJpeg(rgb.data(), size, size, 3) },
+    };
+
+    for (FusedCase& c : cases)
+    {
+        std::vector<unsigned char> separate;
+        double separateSeconds = bestTime(5, [&]()
+        {
+            int x, y, n;
+            unsigned char* pixels = stbi_load_from_memory(c.file.data(), (int)c.file.size(), &x, &y, &n, 4);
+            flipRows(pixels, x, y, 4);
+            premultiply(pixels, (size_t)x * y);
+            separate.assign(pixels, pixels + (size_t)x * y * 4);
+            stbi_image_free(pixels);
+        });
+
+        std::vector<unsigned char> fused;
+        stbi_set_flip_vertically_on_load_thread(1);
+        stbi_set_premultiply_on_load_thread(1);
+        double fusedSeconds = bestTime(5, [&]()
+        {
+            int x, y, n;
+            unsigned char* pixels = stbi_load_from_memory(c.file.data(), (int)c.file.size(), &x, &y, &n, 4);
+            fused.assign(pixels, pixels + (size_t)x * y * 4);
+            stbi_image_free(pixels);
+        });
+        stbi_set_flip_vertically_on_load_thread(0);
+        stbi_set_premultiply_on_load_thread(0);
+
+        std::string name = c.name;
+        report((name + ", decode then flip and premultiply").c_str(), (double)size * size * 4 / separateSeconds * 1e-6, "MB/s");
+        report((name + ", fused into the decoder").c_str(), (double)size * size * 4 / fusedSeconds * 1e-6, fused == separate ? "MB/s" : "MB/s (PIXELS DIFFER)");
+        report((name + ", speedup").c_str(), separateSeconds / fusedSeconds, "x");
+    }
+}
+
+//One tile out of a big atlas and the whole atlas in bands, against decoding all of it: time and peak memory.
+//A tile near the top lets both decoders stop early, one in the middle only saves JPEG its IDCTs above.
+BENCHMARK(regionAndBandDecode)
+{
+    const int jpegSize = benchSize(8192, 1024);
+    const int pngSize = benchSize(4096, 512);
+    const int tile = 512;
+
+    struct AtlasCase { const char* name; int size; std::vector<unsigned char> file; };
+    std::vector<AtlasCase> cases;
+    {
+        std::vector<unsigned char> rgb = makeTestPixels(jpegSize, jpegSize, 3, 48);
+        cases.push_back({ "jpeg", jpegSize, encodeJpeg(rgb.data(), jpegSize, jpegSize, 3) });
+    }
+    {
+        std::vector<unsigned char> rgba = makeTestPixels(pngSize, pngSize, 4, 48);
+        cases.push_back({ "png", pngSize, encodePng(rgba.data(), pngSize, pngSize, 4) });
+    }
+
+    for (AtlasCase& c : cases)
+    {
+        auto measure = [&](const char* what, const std::function<void()>& decode)
+        {
+            size_t peak;
+            {
+                StbAllocationCounter counter;
+                decode();
+                peak = counter.peakBytes;
+            }
+            double seconds = bestTime(3, decode);
+
+            std::string name = std::string(c.name) + " " + std::to_string(c.size) + ", " + what;
+            report((name + " time").c_str(), seconds * 1e3, "ms");
+            report((name + " peak").c_str(), peak / 1048576.0, "MB");
+        };
+
+        measure("whole image", [&]()
+        {
+            int x, y, n;
+            stbi_image_free(stbi_load_from_memory(c.file.data(), (int)c.file.size(), &x, &y, &n, 4));
+        });
+
+        int middle = (c.size - tile) / 2;
+        measure("middle tile", [&]()
+        {
+            int x, y, n;
+            stbi_image_free(stbi_load_region_from_memory(c.file.data(), (int)c.file.size(), middle, middle, tile, tile, &x, &y, &n, 4));
+        });
+
+        measure("top tile", [&]()
+        {
+            int x, y, n;
+            stbi_image_free(stbi_load_region_from_memory(c.file.data(), (int)c.file.size(), middle, 0, tile, tile, &x, &y, &n, 4));
+        });
+
+        //The middle tile has to be exactly that part of the whole image.
+        int x, y, n, tileX, tileY;
+        unsigned char* whole = stbi_load_from_memory(c.file.data(), (int)c.file.size(), &x, &y, &n, 4);
+        unsigned char* part = stbi_load_region_from_memory(c.file.data(), (int)c.file.size(), middle, middle, tile, tile, &tileX, &tileY, &n, 4);
+        int differentRows = 0;
+        for (int row = 0; row < tile; row++)
+        {
+            differentRows += std::memcmp(part + (size_t)row * tile * 4, whole + ((size_t)(middle + row) * x + middle) * 4, (size_t)tile * 4) != 0;
+        }
+        report((std::string(c.name) + ", tile rows differing from the whole image").c_str(), differentRows, "rows");
+        stbi_image_free(whole);
+        stbi_image_free(part);
+
+        measure("64 row bands", [&]()
+        {
+            int x, y, n;
+            stbi_load_bands_from_memory(c.file.data(), (int)c.file.size(), 64, [](void*, const stbi_uc* pixels, int, int, int)
+            {
+                benchSink += pixels[0];
+                return 1;
+            }, nullptr, &x, &y, &n, 4);
+        });
+    }
+}
+
+namespace
+{
+    void makeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _mkdir(path.c_str());
+#else
+        mkdir(path.c_str(), 0755);
+#endif
+    }
+
+    void removeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        _rmdir(path.c_str());
+#else
+        rmdir(path.c_str());
+#endif
+    }
+
+    bool writeFile(const std::string& path, const std::vector<unsigned char>& data)
+    {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) return false;
+        bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        return std::fclose(file) == 0 && written;
+    }
+}
+
+//An asset directory of small PNGs and JPEGs (what an asset registry build reads), and the same images in one
+//pack file: scanned for sizes with scanImageDirectory, scanImageInfo and scanPackImageInfo, against the
+//stbi_info per file it replaced. The files are fresh, so this is the warm cache case.
+BENCHMARK(imageInfoScan)
+{
+    const int fileCount = benchSize(20000, 500);
+    const std::string directory = BENCH_SCRATCH_DIRECTORY "/imageInfoScan";
+
+    std::vector<std::vector<unsigned char> > distinct;
+    for (int i = 0; i < 8; i++)
+    {
+        int width = 16 + 8 * i, height = 64 - 4 * i;
+        std::vector<unsigned char> pixels = makeTestPixels(width, height, 3, 49 + i);
+        distinct.push_back(i % 2 ? encodeJpeg(pixels.data(), width, height, 3) : encodePng(pixels.data(), width, height, 3));
+    }
+
+    //One JPEG whose frame header is beyond the first few KB, behind a 10 KB comment like a big EXIF block.
+    std::vector<unsigned char> comment = { 0xff, 0xfe, 10002 >> 8, 10002 & 0xff };
+    comment.resize(4 + 10000, ' ');
+    distinct[1].insert(distinct[1].begin() + 2, comment.begin(), comment.end());
+
+    makeDirectory(BENCH_SCRATCH_DIRECTORY);
+    makeDirectory(directory);
+    std::vector<std::string> paths;
+    std::vector<unsigned char> pack;
+    std::vector<PackRange> ranges;
+    for (int i = 0; i < fileCount; i++)
+    {
+        const std::vector<unsigned char>& file = distinct[i % distinct.size()];
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%06d.%s", i, i % 2 ? "jpg" : "png");
+        paths.push_back(directory + name);
+        if (!writeFile(paths.back(), file))
+        {
+            report("couldn't write the files in " BENCH_SCRATCH_DIRECTORY, 0, "");
+            return;
+        }
+
+        ranges.push_back({ pack.size(), file.size() });
+        pack.insert(pack.end(), file.begin(), file.end());
+    }
+    const std::string packPath = std::string(BENCH_SCRATCH_DIRECTORY) + "/imageInfoScan.pack";
+    writeFile(packPath, pack);
+
+    std::vector<ImageInfo> stdioInfos(fileCount);
+    double stdioSeconds = bestTime(3, [&]()
+    {
+        for (int i = 0; i < fileCount; i++)
+        {
+            int x = 0, y = 0, n = 0;
+            stbi_info(paths[i].c_str(), &x, &y, &n);
+            stdioInfos[i] = { (uint32_t)x, (uint32_t)y, (uint8_t)n };
+        }
+    });
+
+    std::vector<ImageInfo> pathInfos, directoryInfos, packInfos;
+    std::vector<std::string> names;
+    double pathSeconds = bestTime(3, [&]() { pathInfos = scanImageInfo(paths); });
+    double directorySeconds = bestTime(3, [&]() { directoryInfos = scanImageDirectory(directory, names); });
+    double packSeconds = bestTime(3, [&]() { packInfos = scanPackImageInfo(packPath, ranges); });
+
+    //Every scan has to agree with stbi_info (the directory is listed sorted, like the paths were made).
+    int disagreements = 0;
+    for (int i = 0; i < fileCount; i++)
+    {
+        const ImageInfo& a = stdioInfos[i];
+        const ImageInfo* others[3] = { &pathInfos[i], i < (int)directoryInfos.size() ? &directoryInfos[i] : &a, &packInfos[i] };
+        for (const ImageInfo* b : others) disagreements += a.width != b->width || a.height != b->height || a.channels != b->channels || a.channels == 0;
+    }
+
+    report("stbi_info per file", fileCount / stdioSeconds, "files/s");
+    report("scanImageInfo", fileCount / pathSeconds, "files/s");
+    report("scanImageDirectory", fileCount / directorySeconds, "files/s");
+    report("scanPackImageInfo", fileCount / packSeconds, "files/s");
+    report("results differing from stbi_info", disagreements + (directoryInfos.size() != (size_t)fileCount), "files");
+    report("workers", workerCount(), "threads");
+
+    for (const std::string& path : paths) std::remove(path.c_str());
+    std::remove(packPath.c_str());
+    removeDirectory(directory);
+}
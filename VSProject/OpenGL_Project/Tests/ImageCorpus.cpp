@@ -0,0 +1,820 @@
+#include "ImageCorpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <jpeglib.h>
+#include <zlib.h>
+
+#include "Noise.h"
+#include "Random.h"
+
+namespace
+{
+    struct Shape
+    {
+        int x0, y0, x1, y1;
+        bool disc;
+        unsigned char color[4];
+    };
+
+    //Noise for every channel, scaled to [0, 1].
+    std::vector<float> channelNoise(int width, int height, int channels, uint32_t seed)
+    {
+        NoiseSettings settings;
+        settings.fractal = FractalFbm;
+        settings.octaves = 5;
+        settings.scale = 4.0f / (float)(width > height ? width : height);
+
+        std::vector<float> noise((size_t)width * height * channels);
+        std::vector<float> plane((size_t)width * height);
+        for (int c = 0; c < channels; c++)
+        {
+            settings.offset = glm::vec3((float)(seed % 1000) + 17.0f * c, 31.0f * c, 0.0f);
+            fillNoise2D(plane.data(), width, height, settings);
+            for (size_t i = 0; i < plane.size(); i++)
+            {
+                float v = plane[i] * 0.6f + 0.5f;
+                noise[i * channels + c] = v < 0.0f ? 0.0f : (v > 1.0f ? 1.0f : v);
+            }
+        }
+        return noise;
+    }
+
+    std::vector<Shape> makeShapes(int width, int height, uint32_t seed)
+    {
+        RandomStream random(seed);
+        std::vector<Shape> shapes(24);
+        for (Shape& s : shapes)
+        {
+            int w = 1 + (int)(random.nextUInt() % (uint32_t)(width / 4 + 1));
+            int h = 1 + (int)(random.nextUInt() % (uint32_t)(height / 4 + 1));
+            s.x0 = (int)(random.nextUInt() % (uint32_t)width);
+            s.y0 = (int)(random.nextUInt() % (uint32_t)height);
+            s.x1 = s.x0 + w;
+            s.y1 = s.y0 + h;
+            s.disc = random.nextUInt() % 3 == 0;
+            for (int c = 0; c < 4; c++) s.color[c] = (unsigned char)random.nextUInt();
+        }
+        return shapes;
+    }
+
+    const Shape* shapeAt(const std::vector<Shape>& shapes, int x, int y)
+    {
+        for (size_t i = shapes.size(); i-- > 0;)
+        {
+            const Shape& s = shapes[i];
+            if (x < s.x0 || x >= s.x1 || y < s.y0 || y >= s.y1) continue;
+            if (!s.disc) return &s;
+
+            //Ellipse inscribed in the rectangle.
+            float dx = (2.0f * (x - s.x0) + 1.0f) / (s.x1 - s.x0) - 1.0f;
+            float dy = (2.0f * (y - s.y0) + 1.0f) / (s.y1 - s.y0) - 1.0f;
+            if (dx * dx + dy * dy <= 1.0f) return &s;
+        }
+        return nullptr;
+    }
+
+    void putBigEndian(std::vector<unsigned char>& out, uint32_t value)
+    {
+        out.push_back((unsigned char)(value >> 24));
+        out.push_back((unsigned char)(value >> 16));
+        out.push_back((unsigned char)(value >> 8));
+        out.push_back((unsigned char)value);
+    }
+
+    void putLittleEndian16(std::vector<unsigned char>& out, int value)
+    {
+        out.push_back((unsigned char)value);
+        out.push_back((unsigned char)(value >> 8));
+    }
+
+    void putLittleEndian32(std::vector<unsigned char>& out, uint32_t value)
+    {
+        putLittleEndian16(out, (int)(value & 0xffff));
+        putLittleEndian16(out, (int)(value >> 16));
+    }
+
+    void putText(std::vector<unsigned char>& out, const char* text)
+    {
+        out.insert(out.end(), text, text + std::strlen(text));
+    }
+
+    void putChunk(std::vector<unsigned char>& png, const char* type, const std::vector<unsigned char>& data)
+    {
+        putBigEndian(png, (uint32_t)data.size());
+        size_t start = png.size();
+        png.insert(png.end(), type, type + 4);
+        png.insert(png.end(), data.begin(), data.end());
+        putBigEndian(png, (uint32_t)crc32(0, &png[start], (uInt)(png.size() - start)));
+    }
+
+    int paeth(int a, int b, int c)
+    {
+        int p = a + b - c;
+        int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+        if (pa <= pb && pa <= pc) return a;
+        return pb <= pc ? b : c;
+    }
+
+    //Appends the filter byte and row filtered with filter, prior is the previous row of the same pass (zeros for the first).
+    void filterRow(std::vector<unsigned char>& out, const unsigned char* row, const unsigned char* prior, int bytes, int bpp, int filter)
+    {
+        out.push_back((unsigned char)filter);
+        for (int i = 0; i < bytes; i++)
+        {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = prior[i];
+            int c = i >= bpp ? prior[i - bpp] : 0;
+            int predicted = 0;
+            switch (filter)
+            {
+            case PngFilterSub: predicted = a; break;
+            case PngFilterUp: predicted = b; break;
+            case PngFilterAverage: predicted = (a + b) / 2; break;
+            case PngFilterPaeth: predicted = paeth(a, b, c); break;
+            }
+            out.push_back((unsigned char)(row[i] - predicted));
+        }
+    }
+
+    void addRow(std::vector<unsigned char>& out, const unsigned char* row, const unsigned char* prior, int bytes, int bpp, PngFilter filter)
+    {
+        if (filter != PngFilterAdaptive)
+        {
+            filterRow(out, row, prior, bytes, bpp, filter);
+            return;
+        }
+
+        std::vector<unsigned char> best;
+        long bestSum = -1;
+        for (int f = PngFilterNone; f <= PngFilterPaeth; f++)
+        {
+            std::vector<unsigned char> candidate;
+            filterRow(candidate, row, prior, bytes, bpp, f);
+
+            long sum = 0;
+            for (size_t i = 1; i < candidate.size(); i++) sum += candidate[i] < 128 ? candidate[i] : 256 - candidate[i];
+            if (bestSum < 0 || sum < bestSum)
+            {
+                bestSum = sum;
+                best.swap(candidate);
+            }
+        }
+        out.insert(out.end(), best.begin(), best.end());
+    }
+}
+
+std::vector<unsigned char> makeTestPixels(int width, int height, int channels, uint32_t seed)
+{
+    std::vector<float> noise = channelNoise(width, height, channels, seed);
+    std::vector<Shape> shapes = makeShapes(width, height, seed);
+
+    std::vector<unsigned char> pixels((size_t)width * height * channels);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            size_t i = ((size_t)y * width + x) * channels;
+            const Shape* shape = shapeAt(shapes, x, y);
+            for (int c = 0; c < channels; c++)
+            {
+                //Alpha (the last of 2 or 4 channels) is opaque inside shapes and fades out with the noise elsewhere.
+                bool alpha = (channels == 2 || channels == 4) && c == channels - 1;
+                if (shape != nullptr) pixels[i + c] = alpha ? 255 : shape->color[c];
+                else pixels[i + c] = (unsigned char)(noise[i + c] * 255.0f + 0.5f);
+            }
+        }
+    }
+    return pixels;
+}
+
+std::vector<uint16_t> makeTestPixels16(int width, int height, int channels, uint32_t seed)
+{
+    std::vector<unsigned char> high = makeTestPixels(width, height, channels, seed);
+    std::vector<float> low = channelNoise(width, height, channels, seed + 1);
+
+    std::vector<uint16_t> pixels(high.size());
+    for (size_t i = 0; i < pixels.size(); i++) pixels[i] = (uint16_t)(high[i] << 8 | (int)(low[i] * 255.0f));
+    return pixels;
+}
+
+namespace
+{
+    //image holds every sample as one byte below 16 bits (already in the range of the bit depth, palette indices
+    //for color type 3) and as two big endian bytes at 16. Rows below 8 bits are packed here.
+    std::vector<unsigned char> writePng(const std::vector<unsigned char>& image, int width, int height, int channels, int colorType,
+        const std::vector<unsigned char>& palette, const PngOptions& options)
+    {
+        static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+        int bitDepth = options.bitDepth;
+        //Filters look back a whole pixel, or one byte for packed rows.
+        int pixelBytes = bitDepth < 8 ? 1 : channels * bitDepth / 8;
+
+        //Adam7 passes: start and step in x and y. A plain image is one pass over everything.
+        static const int adam7[7][4] = { { 0, 0, 8, 8 }, { 4, 0, 8, 8 }, { 0, 4, 4, 8 }, { 2, 0, 4, 4 }, { 0, 2, 2, 4 }, { 1, 0, 2, 2 }, { 0, 1, 1, 2 } };
+        static const int plain[1][4] = { { 0, 0, 1, 1 } };
+        const int (*passes)[4] = options.interlaced ? adam7 : plain;
+        int passCount = options.interlaced ? 7 : 1;
+
+        std::vector<unsigned char> filtered;
+        for (int pass = 0; pass < passCount; pass++)
+        {
+            int x0 = passes[pass][0], y0 = passes[pass][1], dx = passes[pass][2], dy = passes[pass][3];
+            int passWidth = (width - x0 + dx - 1) / dx;
+            int passHeight = (height - y0 + dy - 1) / dy;
+            if (passWidth <= 0 || passHeight <= 0) continue;
+
+            int bytes = bitDepth < 8 ? (passWidth * bitDepth + 7) / 8 : passWidth * pixelBytes;
+            std::vector<unsigned char> row(bytes);
+            std::vector<unsigned char> prior(bytes, 0);
+            for (int y = 0; y < passHeight; y++)
+            {
+                std::fill(row.begin(), row.end(), 0);
+                for (int x = 0; x < passWidth; x++)
+                {
+                    size_t sourceIndex = ((size_t)(y0 + y * dy)) * width + x0 + x * dx;
+                    if (bitDepth < 8)
+                    {
+                        //Leftmost pixel in the high bits.
+                        int bit = x * bitDepth;
+                        row[bit / 8] |= (unsigned char)(image[sourceIndex] << (8 - bitDepth - bit % 8));
+                    }
+                    else
+                    {
+                        const unsigned char* source = &image[sourceIndex * pixelBytes];
+                        for (int b = 0; b < pixelBytes; b++) row[x * pixelBytes + b] = source[b];
+                    }
+                }
+                addRow(filtered, row.data(), prior.data(), bytes, pixelBytes, options.filter);
+                row.swap(prior);
+            }
+        }
+
+        uLongf compressedSize = compressBound((uLong)filtered.size());
+        std::vector<unsigned char> compressed(compressedSize);
+        compress2(compressed.data(), &compressedSize, filtered.data(), (uLong)filtered.size(), options.level);
+        compressed.resize(compressedSize);
+
+        std::vector<unsigned char> header;
+        putBigEndian(header, (uint32_t)width);
+        putBigEndian(header, (uint32_t)height);
+        header.push_back((unsigned char)bitDepth);
+        header.push_back((unsigned char)colorType);
+        header.push_back(0);
+        header.push_back(0);
+        header.push_back(options.interlaced ? 1 : 0);
+
+        std::vector<unsigned char> png(signature, signature + 8);
+        putChunk(png, "IHDR", header);
+        if (!palette.empty()) putChunk(png, "PLTE", palette);
+        putChunk(png, "IDAT", compressed);
+        putChunk(png, "IEND", std::vector<unsigned char>());
+        return png;
+    }
+}
+
+std::vector<unsigned char> encodePng(const void* pixels, int width, int height, int channels, const PngOptions& options)
+{
+    static const unsigned char colorTypes[5] = { 0, 0, 4, 2, 6 };
+
+    size_t samples = (size_t)width * height * channels;
+    std::vector<unsigned char> image;
+    if (options.bitDepth == 16)
+    {
+        const uint16_t* p = (const uint16_t*)pixels;
+        image.resize(samples * 2);
+        for (size_t i = 0; i < samples; i++)
+        {
+            image[i * 2] = (unsigned char)(p[i] >> 8);
+            image[i * 2 + 1] = (unsigned char)p[i];
+        }
+    }
+    else
+    {
+        const unsigned char* p = (const unsigned char*)pixels;
+        image.assign(p, p + samples);
+        if (options.bitDepth < 8)
+        {
+            for (unsigned char& v : image) v = (unsigned char)(v >> (8 - options.bitDepth));
+        }
+    }
+
+    return writePng(image, width, height, channels, colorTypes[channels], std::vector<unsigned char>(), options);
+}
+
+std::vector<unsigned char> encodePalettePng(const unsigned char* indices, int width, int height, const std::vector<unsigned char>& palette, const PngOptions& options)
+{
+    std::vector<unsigned char> image(indices, indices + (size_t)width * height);
+    return writePng(image, width, height, 1, 3, palette, options);
+}
+
+std::vector<unsigned char> quantizeToPalette(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& palette)
+{
+    palette.resize(216 * 3);
+    for (int i = 0; i < 216; i++)
+    {
+        palette[i * 3] = (unsigned char)(i / 36 * 51);
+        palette[i * 3 + 1] = (unsigned char)(i / 6 % 6 * 51);
+        palette[i * 3 + 2] = (unsigned char)(i % 6 * 51);
+    }
+
+    std::vector<unsigned char> indices((size_t)width * height);
+    for (size_t i = 0; i < indices.size(); i++)
+    {
+        const unsigned char* p = &pixels[i * channels];
+        int r = (p[0] + 25) / 51, g = (p[1] + 25) / 51, b = (p[2] + 25) / 51;
+        indices[i] = (unsigned char)(r * 36 + g * 6 + b);
+    }
+    return indices;
+}
+
+std::vector<unsigned char> encodeJpeg(const unsigned char* pixels, int width, int height, int channels, const JpegOptions& options)
+{
+    jpeg_compress_struct info;
+    jpeg_error_mgr errors;
+    info.err = jpeg_std_error(&errors);
+    jpeg_create_compress(&info);
+
+    unsigned char* buffer = nullptr;
+    unsigned long size = 0;
+    jpeg_mem_dest(&info, &buffer, &size);
+
+    info.image_width = (JDIMENSION)width;
+    info.image_height = (JDIMENSION)height;
+    info.input_components = channels;
+    info.in_color_space = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&info);
+    jpeg_set_quality(&info, options.quality, TRUE);
+    info.restart_in_rows = options.restartRows;
+    if (channels == 3)
+    {
+        info.comp_info[0].h_samp_factor = options.subsampled ? 2 : 1;
+        info.comp_info[0].v_samp_factor = options.subsampled ? 2 : 1;
+    }
+    if (options.progressive) jpeg_simple_progression(&info);
+
+    jpeg_start_compress(&info, TRUE);
+    while (info.next_scanline < info.image_height)
+    {
+        JSAMPROW row = (JSAMPROW)&pixels[(size_t)info.next_scanline * width * channels];
+        jpeg_write_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_compress(&info);
+    jpeg_destroy_compress(&info);
+
+    std::vector<unsigned char> jpeg(buffer, buffer + size);
+    std::free(buffer);
+    return jpeg;
+}
+
+std::vector<unsigned char> decodeJpeg(const std::vector<unsigned char>& jpeg, int channels)
+{
+    jpeg_decompress_struct info;
+    jpeg_error_mgr errors;
+    info.err = jpeg_std_error(&errors);
+    jpeg_create_decompress(&info);
+
+    jpeg_mem_src(&info, jpeg.data(), (unsigned long)jpeg.size());
+    jpeg_read_header(&info, TRUE);
+    info.out_color_space = channels == 1 ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_start_decompress(&info);
+
+    std::vector<unsigned char> pixels((size_t)info.output_width * info.output_height * channels);
+    while (info.output_scanline < info.output_height)
+    {
+        JSAMPROW row = (JSAMPROW)&pixels[(size_t)info.output_scanline * info.output_width * channels];
+        jpeg_read_scanlines(&info, &row, 1);
+    }
+    jpeg_finish_decompress(&info);
+    jpeg_destroy_decompress(&info);
+    return pixels;
+}
+
+std::vector<unsigned char> encodeGif(const unsigned char* indices, int width, int height, const std::vector<unsigned char>& palette)
+{
+    std::vector<unsigned char> gif;
+    putText(gif, "GIF89a");
+    putLittleEndian16(gif, width);
+    putLittleEndian16(gif, height);
+    gif.push_back(0xf7);        //Global color table of 256 entries, 8 bits per primary.
+    gif.push_back(0);
+    gif.push_back(0);
+    std::vector<unsigned char> table(palette);
+    table.resize(256 * 3, 0);
+    gif.insert(gif.end(), table.begin(), table.end());
+
+    gif.push_back(0x2c);
+    putLittleEndian16(gif, 0);
+    putLittleEndian16(gif, 0);
+    putLittleEndian16(gif, width);
+    putLittleEndian16(gif, height);
+    gif.push_back(0);
+
+    //LZW with 8 bit symbols. Codes go out least significant bit first, the table is cleared when it is full.
+    const int Clear = 256, End = 257;
+    std::vector<unsigned char> codes;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    int codeSize = 9;
+    auto emit = [&](int code)
+    {
+        bits |= (uint32_t)code << bitCount;
+        for (bitCount += codeSize; bitCount >= 8; bitCount -= 8, bits >>= 8) codes.push_back((unsigned char)bits);
+    };
+
+    //Entries are valid for one generation, so clearing the table is a counter increment instead of a memset.
+    std::vector<uint32_t> dictionary((size_t)4096 * 256, 0);
+    uint32_t generation = 1;
+    int next = End + 1;
+    int sinceClear = 0;
+
+    emit(Clear);
+    size_t count = (size_t)width * height;
+    int prefix = indices[0];
+    for (size_t i = 1; i < count; i++)
+    {
+        uint32_t& entry = dictionary[(size_t)prefix * 256 + indices[i]];
+        if (entry >> 12 == generation)
+        {
+            prefix = (int)(entry & 0xfff);
+            continue;
+        }
+
+        emit(prefix);
+        sinceClear++;
+        entry = generation << 12 | (uint32_t)next++;
+        //The decoder adds its entries one code later, so it widens its codes once next is past the current width.
+        if (next > (1 << codeSize) && codeSize < 12) codeSize++;
+        if (next == 4096)
+        {
+            emit(Clear);
+            generation++;
+            next = End + 1;
+            codeSize = 9;
+            sinceClear = 0;
+        }
+        prefix = indices[i];
+    }
+    emit(prefix);
+    //Reading the last code adds an entry on the decoder's side, which can widen the end code.
+    if (sinceClear > 0 && next == (1 << codeSize) && codeSize < 12) codeSize++;
+    emit(End);
+    if (bitCount > 0) codes.push_back((unsigned char)bits);
+
+    gif.push_back(8);
+    for (size_t i = 0; i < codes.size(); i += 255)
+    {
+        size_t block = codes.size() - i < 255 ? codes.size() - i : 255;
+        gif.push_back((unsigned char)block);
+        gif.insert(gif.end(), codes.begin() + i, codes.begin() + i + block);
+    }
+    gif.push_back(0);
+    gif.push_back(0x3b);
+    return gif;
+}
+
+std::vector<unsigned char> encodeBmp(const unsigned char* pixels, int width, int height, int channels)
+{
+    int rowBytes = (width * channels + 3) & ~3;
+    uint32_t imageBytes = (uint32_t)rowBytes * height;
+
+    std::vector<unsigned char> bmp;
+    putText(bmp, "BM");
+    putLittleEndian32(bmp, 54 + imageBytes);
+    putLittleEndian32(bmp, 0);
+    putLittleEndian32(bmp, 54);
+
+    putLittleEndian32(bmp, 40);
+    putLittleEndian32(bmp, (uint32_t)width);
+    putLittleEndian32(bmp, (uint32_t)height);
+    putLittleEndian16(bmp, 1);
+    putLittleEndian16(bmp, channels * 8);
+    putLittleEndian32(bmp, 0);     //BI_RGB, 32 bits per pixel reads the top byte as alpha.
+    putLittleEndian32(bmp, imageBytes);
+    putLittleEndian32(bmp, 2835);
+    putLittleEndian32(bmp, 2835);
+    putLittleEndian32(bmp, 0);
+    putLittleEndian32(bmp, 0);
+
+    //Bottom row first, BGR(A), rows padded to 4 bytes.
+    for (int y = height - 1; y >= 0; y--)
+    {
+        size_t start = bmp.size();
+        for (int x = 0; x < width; x++)
+        {
+            const unsigned char* p = &pixels[((size_t)y * width + x) * channels];
+            bmp.push_back(p[2]);
+            bmp.push_back(p[1]);
+            bmp.push_back(p[0]);
+            if (channels == 4) bmp.push_back(p[3]);
+        }
+        bmp.resize(start + rowBytes, 0);
+    }
+    return bmp;
+}
+
+std::vector<unsigned char> encodeTga(const unsigned char* pixels, int width, int height, int channels, bool rle)
+{
+    std::vector<unsigned char> tga;
+    tga.push_back(0);
+    tga.push_back(0);
+    tga.push_back(rle ? 10 : 2);
+    tga.insert(tga.end(), 5, 0);
+    putLittleEndian16(tga, 0);
+    putLittleEndian16(tga, 0);
+    putLittleEndian16(tga, width);
+    putLittleEndian16(tga, height);
+    tga.push_back((unsigned char)(channels * 8));
+    //Top row first, and the number of alpha bits.
+    tga.push_back((unsigned char)(0x20 | (channels == 4 ? 8 : 0)));
+
+    auto putPixel = [&](const unsigned char* p)
+    {
+        tga.push_back(p[2]);
+        tga.push_back(p[1]);
+        tga.push_back(p[0]);
+        if (channels == 4) tga.push_back(p[3]);
+    };
+    auto same = [&](const unsigned char* a, const unsigned char* b) { return std::memcmp(a, b, channels) == 0; };
+
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* row = &pixels[(size_t)y * width * channels];
+        if (!rle)
+        {
+            for (int x = 0; x < width; x++) putPixel(row + x * channels);
+            continue;
+        }
+
+        //Packets of up to 128 pixels that stay within the row: runs of one pixel, or literal pixels up to the next run.
+        int x = 0;
+        while (x < width)
+        {
+            int run = 1;
+            while (x + run < width && run < 128 && same(row + x * channels, row + (x + run) * channels)) run++;
+            if (run > 1)
+            {
+                tga.push_back((unsigned char)(0x80 | (run - 1)));
+                putPixel(row + x * channels);
+                x += run;
+                continue;
+            }
+
+            int start = x;
+            while (x < width && x - start < 128 && !(x + 1 < width && same(row + x * channels, row + (x + 1) * channels))) x++;
+            if (x == start) x++;
+            tga.push_back((unsigned char)(x - start - 1));
+            for (int i = start; i < x; i++) putPixel(row + i * channels);
+        }
+    }
+    return tga;
+}
+
+std::vector<unsigned char> encodePnm(const void* pixels, int width, int height, int channels, int bitDepth)
+{
+    char header[64];
+    std::snprintf(header, sizeof(header), "P%d\n%d %d\n%d\n", channels == 1 ? 5 : 6, width, height, bitDepth == 16 ? 65535 : 255);
+
+    std::vector<unsigned char> pnm;
+    putText(pnm, header);
+    size_t samples = (size_t)width * height * channels;
+    if (bitDepth == 16)
+    {
+        const uint16_t* p = (const uint16_t*)pixels;
+        for (size_t i = 0; i < samples; i++)
+        {
+            pnm.push_back((unsigned char)(p[i] >> 8));
+            pnm.push_back((unsigned char)p[i]);
+        }
+    }
+    else
+    {
+        const unsigned char* p = (const unsigned char*)pixels;
+        pnm.insert(pnm.end(), p, p + samples);
+    }
+    return pnm;
+}
+
+void toRgbe(const float* rgb, unsigned char* rgbe)
+{
+    float v = std::max(rgb[0], std::max(rgb[1], rgb[2]));
+    if (v < 1e-32f)
+    {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+        return;
+    }
+
+    int exponent;
+    float scale = std::frexp(v, &exponent) * 256.0f / v;
+    for (int c = 0; c < 3; c++) rgbe[c] = (unsigned char)(rgb[c] * scale);
+    rgbe[3] = (unsigned char)(exponent + 128);
+}
+
+void fromRgbe(const unsigned char* rgbe, float* rgb)
+{
+    //The same arithmetic as stb_image, so the round trip is exact.
+    float scale = rgbe[3] != 0 ? (float)std::ldexp(1.0f, rgbe[3] - (128 + 8)) : 0.0f;
+    for (int c = 0; c < 3; c++) rgb[c] = rgbe[c] * scale;
+}
+
+std::vector<unsigned char> encodeHdr(const float* pixels, int width, int height, bool rle)
+{
+    char header[128];
+    std::snprintf(header, sizeof(header), "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n", height, width);
+
+    std::vector<unsigned char> hdr;
+    putText(hdr, header);
+
+    std::vector<unsigned char> row((size_t)width * 4);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++) toRgbe(&pixels[((size_t)y * width + x) * 3], &row[x * 4]);
+        if (!rle)
+        {
+            hdr.insert(hdr.end(), row.begin(), row.end());
+            continue;
+        }
+
+        //New style RLE: a 2, 2, width header, then each component on its own, as runs (count + 128, value)
+        //of at least 3 bytes and literals (count, bytes) of up to 128.
+        hdr.push_back(2);
+        hdr.push_back(2);
+        hdr.push_back((unsigned char)(width >> 8));
+        hdr.push_back((unsigned char)width);
+        for (int c = 0; c < 4; c++)
+        {
+            auto at = [&](int x) { return row[x * 4 + c]; };
+            int x = 0;
+            while (x < width)
+            {
+                int run = 1;
+                while (x + run < width && run < 127 && at(x + run) == at(x)) run++;
+                if (run >= 3)
+                {
+                    hdr.push_back((unsigned char)(128 + run));
+                    hdr.push_back(at(x));
+                    x += run;
+                    continue;
+                }
+
+                int start = x;
+                while (x < width && x - start < 128 && !(x + 2 < width && at(x) == at(x + 1) && at(x) == at(x + 2))) x++;
+                hdr.push_back((unsigned char)(x - start));
+                for (int i = start; i < x; i++) hdr.push_back(at(i));
+            }
+        }
+    }
+    return hdr;
+}
+
+namespace
+{
+    template<typename T>
+    std::vector<unsigned char> bytesOf(const std::vector<T>& samples)
+    {
+        const unsigned char* p = (const unsigned char*)samples.data();
+        return std::vector<unsigned char>(p, p + samples.size() * sizeof(T));
+    }
+
+    //Linear RGB from a test image, with highlights up to 16 so the exponents vary.
+    std::vector<float> makeHdrPixels(int width, int height, uint32_t seed)
+    {
+        std::vector<unsigned char> ldr = makeTestPixels(width, height, 3, seed);
+        std::vector<float> hdr(ldr.size());
+        for (size_t i = 0; i < hdr.size(); i++)
+        {
+            float v = ldr[i] / 255.0f;
+            hdr[i] = v * v * (1.0f + 15.0f * v * v);
+        }
+        return hdr;
+    }
+}
+
+std::vector<CorpusImage> makeImageCorpus(bool quick)
+{
+    std::vector<CorpusImage> corpus;
+
+    const int sizes[2] = { quick ? 40 : 256, quick ? 120 : 1024 };
+    for (int size : sizes)
+    {
+        int width = size + 3;
+        int height = size * 3 / 4 + 1;
+        std::string dimensions = std::to_string(width) + "x" + std::to_string(height);
+
+        auto add = [&](const std::string& name, const char* format, int channels, int bitDepth, bool lossy, std::vector<unsigned char> file, std::vector<unsigned char> expected)
+        {
+            CorpusImage image;
+            image.name = name + " " + dimensions;
+            image.format = format;
+            image.width = width;
+            image.height = height;
+            image.channels = channels;
+            image.bitDepth = bitDepth;
+            image.lossy = lossy;
+            image.file.swap(file);
+            image.expected.swap(expected);
+            corpus.push_back(std::move(image));
+        };
+
+        uint32_t seed = (uint32_t)size;
+        std::vector<unsigned char> gray = makeTestPixels(width, height, 1, seed);
+        std::vector<unsigned char> grayAlpha = makeTestPixels(width, height, 2, seed);
+        std::vector<unsigned char> rgb = makeTestPixels(width, height, 3, seed);
+        std::vector<unsigned char> rgba = makeTestPixels(width, height, 4, seed);
+        std::vector<uint16_t> rgb16 = makeTestPixels16(width, height, 3, seed);
+        std::vector<uint16_t> rgba16 = makeTestPixels16(width, height, 4, seed);
+
+        add("png gray", "png", 1, 8, false, encodePng(gray.data(), width, height, 1), gray);
+        add("png gray alpha", "png", 2, 8, false, encodePng(grayAlpha.data(), width, height, 2), grayAlpha);
+        add("png rgb", "png", 3, 8, false, encodePng(rgb.data(), width, height, 3), rgb);
+        add("png rgba", "png", 4, 8, false, encodePng(rgba.data(), width, height, 4), rgba);
+
+        //stb_image scales low bit depth gray up to the full 8 bits.
+        for (int depth = 1; depth <= 4; depth *= 2)
+        {
+            PngOptions options;
+            options.bitDepth = depth;
+            std::vector<unsigned char> expected(gray.size());
+            for (size_t i = 0; i < gray.size(); i++) expected[i] = (unsigned char)((gray[i] >> (8 - depth)) * (255 / ((1 << depth) - 1)));
+            add("png gray " + std::to_string(depth) + " bit", "png low bit depth", 1, 8, false, encodePng(gray.data(), width, height, 1, options), expected);
+        }
+
+        std::vector<unsigned char> palette;
+        std::vector<unsigned char> indices = quantizeToPalette(rgb.data(), width, height, 3, palette);
+        std::vector<unsigned char> paletted(indices.size() * 3);
+        std::vector<unsigned char> palettedAlpha(indices.size() * 4);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            for (int c = 0; c < 3; c++) paletted[i * 3 + c] = palettedAlpha[i * 4 + c] = palette[indices[i] * 3 + c];
+            palettedAlpha[i * 4 + 3] = 255;
+        }
+        add("png palette", "png palette", 3, 8, false, encodePalettePng(indices.data(), width, height, palette), paletted);
+
+        PngOptions interlaced;
+        interlaced.interlaced = true;
+        add("png rgb interlaced", "png interlaced", 3, 8, false, encodePng(rgb.data(), width, height, 3, interlaced), rgb);
+        add("png rgba interlaced", "png interlaced", 4, 8, false, encodePng(rgba.data(), width, height, 4, interlaced), rgba);
+
+        PngOptions deep;
+        deep.bitDepth = 16;
+        add("png rgb 16 bit", "png 16 bit", 3, 16, false, encodePng(rgb16.data(), width, height, 3, deep), bytesOf(rgb16));
+        add("png rgba 16 bit", "png 16 bit", 4, 16, false, encodePng(rgba16.data(), width, height, 4, deep), bytesOf(rgba16));
+        deep.interlaced = true;
+        add("png rgba 16 bit interlaced", "png 16 bit", 4, 16, false, encodePng(rgba16.data(), width, height, 4, deep), bytesOf(rgba16));
+
+        //What libjpeg decodes is expected, stb_image rounds and upsamples a little differently.
+        auto addJpeg = [&](const std::string& name, const char* format, const std::vector<unsigned char>& pixels, int channels, const JpegOptions& options)
+        {
+            std::vector<unsigned char> jpeg = encodeJpeg(pixels.data(), width, height, channels, options);
+            std::vector<unsigned char> expected = decodeJpeg(jpeg, channels);
+            add(name, format, channels, 8, true, jpeg, expected);
+        };
+
+        JpegOptions jpeg;
+        addJpeg("jpeg gray", "jpeg", gray, 1, jpeg);
+        addJpeg("jpeg 4:2:0", "jpeg", rgb, 3, jpeg);
+        jpeg.restartRows = 1;
+        addJpeg("jpeg 4:2:0 restarts", "jpeg", rgb, 3, jpeg);
+        jpeg.restartRows = 0;
+        jpeg.subsampled = false;
+        addJpeg("jpeg 4:4:4", "jpeg", rgb, 3, jpeg);
+
+        JpegOptions progressive;
+        progressive.progressive = true;
+        addJpeg("jpeg progressive gray", "jpeg progressive", gray, 1, progressive);
+        addJpeg("jpeg progressive 4:2:0", "jpeg progressive", rgb, 3, progressive);
+        progressive.subsampled = false;
+        addJpeg("jpeg progressive 4:4:4", "jpeg progressive", rgb, 3, progressive);
+
+        //stb_image always gives GIFs an alpha channel.
+        add("gif", "gif", 4, 8, false, encodeGif(indices.data(), width, height, palette), palettedAlpha);
+
+        add("bmp rgb", "bmp", 3, 8, false, encodeBmp(rgb.data(), width, height, 3), rgb);
+        add("bmp rgba", "bmp", 4, 8, false, encodeBmp(rgba.data(), width, height, 4), rgba);
+
+        add("tga rgb", "tga", 3, 8, false, encodeTga(rgb.data(), width, height, 3, false), rgb);
+        add("tga rgba rle", "tga", 4, 8, false, encodeTga(rgba.data(), width, height, 4, true), rgba);
+
+        add("pgm", "pnm", 1, 8, false, encodePnm(gray.data(), width, height, 1, 8), gray);
+        add("ppm", "pnm", 3, 8, false, encodePnm(rgb.data(), width, height, 3, 8), rgb);
+        add("ppm 16 bit", "pnm", 3, 16, false, encodePnm(rgb16.data(), width, height, 3, 16), bytesOf(rgb16));
+
+        std::vector<float> hdr = makeHdrPixels(width, height, seed);
+        std::vector<float> rounded(hdr.size());
+        for (size_t i = 0; i < hdr.size(); i += 3)
+        {
+            unsigned char rgbe[4];
+            toRgbe(&hdr[i], rgbe);
+            fromRgbe(rgbe, &rounded[i]);
+        }
+        add("hdr", "hdr", 3, 32, false, encodeHdr(hdr.data(), width, height, false), bytesOf(rounded));
+        add("hdr rle", "hdr", 3, 32, false, encodeHdr(hdr.data(), width, height, true), bytesOf(rounded));
+    }
+
+    return corpus;
+}
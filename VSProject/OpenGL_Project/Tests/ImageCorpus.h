@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//Generated images for the image decoder benchmarks, so no binary test files have to live in the repository.
+//Pixels are deterministic for a seed: fBm noise for photographic texture, under flat rectangles and discs with
+//hard edges like a UI atlas. Alpha comes from the same shapes.
+
+std::vector<unsigned char> makeTestPixels(int width, int height, int channels, uint32_t seed);
+
+//16 bits per sample. The low bytes carry noise of their own, so they don't compress like padded 8 bit data.
+std::vector<uint16_t> makeTestPixels16(int width, int height, int channels, uint32_t seed);
+
+enum PngFilter
+{
+    PngFilterNone,
+    PngFilterSub,
+    PngFilterUp,
+    PngFilterAverage,
+    PngFilterPaeth,
+    PngFilterAdaptive       //Per row, the filter with the smallest sum of absolute values (what libpng does).
+};
+
+struct PngOptions
+{
+    int bitDepth = 8;       //8 or 16, 16 reads the pixels as uint16_t. 1, 2 and 4 keep the top bits of gray pixels.
+    bool interlaced = false;
+    PngFilter filter = PngFilterAdaptive;
+    int level = 6;          //zlib compression level, 0 stores the data uncompressed.
+};
+
+//Gray, gray + alpha, RGB or RGBA for 1 to 4 channels.
+std::vector<unsigned char> encodePng(const void* pixels, int width, int height, int channels, const PngOptions& options = PngOptions());
+
+//Color type 3, one index per pixel into palette (RGB triples, up to 256 of them). 8 bit indices only.
+std::vector<unsigned char> encodePalettePng(const unsigned char* indices, int width, int height, const std::vector<unsigned char>& palette, const PngOptions& options = PngOptions());
+
+//Nearest color of a 6x6x6 cube for every RGB(A) pixel, the cube is put in palette.
+std::vector<unsigned char> quantizeToPalette(const unsigned char* pixels, int width, int height, int channels, std::vector<unsigned char>& palette);
+
+struct JpegOptions
+{
+    int quality = 90;
+    bool progressive = false;
+    int restartRows = 0;        //Restart marker every so many MCU rows, 0 for none.
+    bool subsampled = true;     //4:2:0 chroma, 4:4:4 otherwise.
+};
+
+//Gray or RGB (1 or 3 channels) through libjpeg.
+std::vector<unsigned char> encodeJpeg(const unsigned char* pixels, int width, int height, int channels, const JpegOptions& options = JpegOptions());
+
+//libjpeg's decode, as gray or RGB.
+std::vector<unsigned char> decodeJpeg(const std::vector<unsigned char>& jpeg, int channels);
+
+//One frame, no transparency, the palette is padded to 256 entries.
+std::vector<unsigned char> encodeGif(const unsigned char* indices, int width, int height, const std::vector<unsigned char>& palette);
+
+//Uncompressed BMP with 24 or 32 bits per pixel (3 or 4 channels).
+std::vector<unsigned char> encodeBmp(const unsigned char* pixels, int width, int height, int channels);
+
+//True color TGA with 3 or 4 channels, uncompressed or run length encoded.
+std::vector<unsigned char> encodeTga(const unsigned char* pixels, int width, int height, int channels, bool rle);
+
+//Binary PGM (1 channel) or PPM (3 channels) with 8 or 16 bits per sample, 16 reads the pixels as uint16_t.
+std::vector<unsigned char> encodePnm(const void* pixels, int width, int height, int channels, int bitDepth);
+
+//Radiance HDR from RGB floats, with flat or run length encoded scanlines.
+std::vector<unsigned char> encodeHdr(const float* pixels, int width, int height, bool rle);
+
+//The shared exponent form HDR files store, and back.
+void toRgbe(const float* rgb, unsigned char* rgbe);
+void fromRgbe(const unsigned char* rgbe, float* rgb);
+
+//An encoded image for the decoder harness, with what decoding it has to give.
+struct CorpusImage
+{
+    std::string name;           //Unique, baselines are keyed by it.
+    std::string format;         //What results are summed up by: "png", "png interlaced", "jpeg progressive"...
+    int width, height;
+    int channels;               //As stored in the file.
+    int bitDepth;               //Of the decoded samples: 8 (stbi_load), 16 (stbi_load_16) or 32 (stbi_loadf).
+    bool lossy;                 //expected is another decoder's output, decoding only has to come close.
+    std::vector<unsigned char> file;
+    std::vector<unsigned char> expected;    //Decoded samples in memory order, channels as in the file.
+};
+
+//Every format stb_image is used for, at a small and a large size (odd ones, so partial blocks and padding
+//come up), with the variants that take other decoder paths: interlaced, 16 bit, palette and low bit depth PNG,
+//progressive, 4:4:4 and gray JPEG, RLE TGA and HDR. quick keeps the sizes small.
+std::vector<CorpusImage> makeImageCorpus(bool quick);
@@ -0,0 +1,60 @@
+#include "ImageDecoders.h"
+
+#include "stb_image.h"
+
+const ImageDecoder& stbImageNoAvx2Decoder();
+#ifdef HAVE_STB_IMAGE_BASELINE
+const ImageDecoder& stbImageBaselineDecoder();
+#endif
+
+namespace
+{
+    unsigned char* load(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels)
+    {
+        return stbi_load_from_memory(data, size, x, y, channels, desiredChannels);
+    }
+
+    unsigned short* load16(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels)
+    {
+        return stbi_load_16_from_memory(data, size, x, y, channels, desiredChannels);
+    }
+
+    float* loadf(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels)
+    {
+        return stbi_loadf_from_memory(data, size, x, y, channels, desiredChannels);
+    }
+
+    char* inflate(const char* data, int size, int* outSize)
+    {
+        return stbi_zlib_decode_malloc(data, size, outSize);
+    }
+}
+
+const ImageDecoder& stbImageDecoder()
+{
+    static const ImageDecoder decoder = { "stb_image", load, load16, loadf, inflate, stbi_image_free };
+    return decoder;
+}
+
+const ImageDecoder* baselineImageDecoder()
+{
+#ifdef HAVE_STB_IMAGE_BASELINE
+    return &stbImageBaselineDecoder();
+#else
+    return nullptr;
+#endif
+}
+
+const std::vector<const ImageDecoder*>& imageDecoders()
+{
+    static const std::vector<const ImageDecoder*> decoders =
+    {
+        &stbImageDecoder(),
+        &stbImageNoAvx2Decoder(),
+        &stbImageScalarDecoder(),
+#ifdef HAVE_STB_IMAGE_BASELINE
+        &stbImageBaselineDecoder(),
+#endif
+    };
+    return decoders;
+}
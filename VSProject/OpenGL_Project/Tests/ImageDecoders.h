@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vector>
+
+//The stb_image.h builds the image benchmarks compare. Besides the one the application uses, the same header
+//is compiled again without AVX2 and without any SIMD, and optionally an unmodified stb_image.h given to CMake
+//as STB_IMAGE_BASELINE. Each of those lives in a namespace of its own (StbImageVariant.cpp) so they can sit
+//next to each other in one executable.
+
+struct ImageDecoder
+{
+    const char* name;
+
+    unsigned char* (*load)(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels);
+    unsigned short* (*load16)(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels);
+    float* (*loadf)(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels);
+    //zlib stream (with header) to a malloc'd buffer.
+    char* (*inflate)(const char* data, int size, int* outSize);
+    void (*free)(void* pixels);
+};
+
+//stb_image as the application builds it, first in imageDecoders().
+const ImageDecoder& stbImageDecoder();
+//The same without any SIMD, the reference the SIMD kernels have to match.
+const ImageDecoder& stbImageScalarDecoder();
+
+//The unmodified stb_image.h given as STB_IMAGE_BASELINE, null when there is none.
+const ImageDecoder* baselineImageDecoder();
+
+//Every build, the application's first and the baseline (when configured) last.
+const std::vector<const ImageDecoder*>& imageDecoders();
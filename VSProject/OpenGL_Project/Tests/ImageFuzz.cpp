@@ -0,0 +1,229 @@
+#include "ImageFuzz.h"
+
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "stb_image.h"
+
+namespace
+{
+    //Images claiming more pixels than this are only checked with stbi_info, decoding them finds nothing but
+    //the fuzzer's memory limit.
+    const uint64_t MaxPixels = 1 << 22;
+
+    //All frames of a GIF together.
+    const uint64_t MaxGifBytes = 1 << 28;
+
+    const size_t MaxOutliers = 10;
+
+    //Bytes added to every input when its cost is worked out, so the fixed cost of the calls doesn't make
+    //every tiny input an outlier.
+    const double CallAllowanceBytes = 4096.0;
+
+    std::vector<FuzzOutlier> outliers;
+
+    volatile unsigned char sink = 0;
+
+    //Reads every byte, so a buffer shorter than stb_image claims shows up under ASan.
+    void touch(const void* pixels, size_t bytes)
+    {
+        const unsigned char* p = (const unsigned char*)pixels;
+        unsigned char sum = 0;
+        for (size_t i = 0; i < bytes; i++) sum = (unsigned char)(sum + p[i]);
+        sink = (unsigned char)(sink + sum);
+    }
+
+    uint32_t hashInput(const uint8_t* data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++) hash = (hash ^ data[i]) * 16777619u;
+        return hash;
+    }
+
+    struct BandReader
+    {
+        int rowBytes;
+        size_t bytes;
+    };
+
+    int readBand(void* user, const stbi_uc* pixels, int stride, int, int rows)
+    {
+        BandReader& reader = *(BandReader*)user;
+        for (int row = 0; row < rows; row++) touch(pixels + (size_t)row * stride, reader.rowBytes);
+        reader.bytes += (size_t)reader.rowBytes * rows;
+        return 1;
+    }
+
+    //Every decoding call on data, returns the bytes they gave altogether.
+    size_t decodeEverything(const uint8_t* data, int size, uint32_t hash)
+    {
+        size_t decoded = 0;
+        int x, y, channels;
+
+        //Load on its own when the header can't be read, so what load does with such files is still covered.
+        if (!stbi_info_from_memory(data, size, &x, &y, &channels))
+        {
+            stbi_uc* pixels = stbi_load_from_memory(data, size, &x, &y, &channels, 0);
+            if (pixels != nullptr && (uint64_t)x * y <= MaxPixels)
+            {
+                decoded += (size_t)x * y * channels;
+                touch(pixels, (size_t)x * y * channels);
+            }
+            stbi_image_free(pixels);
+            return decoded;
+        }
+        if (x <= 0 || y <= 0 || (uint64_t)x * y > MaxPixels) return 0;
+
+        stbi_set_flip_vertically_on_load_thread(hash & 1);
+        stbi_set_premultiply_on_load_thread(hash >> 1 & 1);
+
+        size_t pixelCount = (size_t)x * y;
+        int w, h, n;
+        for (int desired = 0; desired <= 4; desired += 4)
+        {
+            stbi_uc* pixels = stbi_load_from_memory(data, size, &w, &h, &n, desired);
+            if (pixels != nullptr)
+            {
+                size_t bytes = (size_t)w * h * (desired != 0 ? desired : n);
+                touch(pixels, bytes);
+                decoded += bytes;
+            }
+            stbi_image_free(pixels);
+        }
+
+        if (stbi_is_16_bit_from_memory(data, size))
+        {
+            stbi_us* pixels = stbi_load_16_from_memory(data, size, &w, &h, &n, 0);
+            if (pixels != nullptr)
+            {
+                touch(pixels, (size_t)w * h * n * 2);
+                decoded += (size_t)w * h * n * 2;
+            }
+            stbi_image_free(pixels);
+        }
+
+        if (stbi_is_hdr_from_memory(data, size))
+        {
+            float* pixels = stbi_loadf_from_memory(data, size, &w, &h, &n, 0);
+            if (pixels != nullptr)
+            {
+                touch(pixels, (size_t)w * h * n * 4);
+                decoded += (size_t)w * h * n * 4;
+            }
+            stbi_image_free(pixels);
+        }
+
+        //Into a buffer with a spare pixel at the end of every row, which has to stay untouched.
+        int stride = (x + 1) * 4;
+        std::vector<stbi_uc> into((size_t)stride * y, 0xcd);
+        if (stbi_load_into_from_memory(data, size, into.data(), stride, x, y, &w, &h, &n, 4))
+        {
+            for (int row = 0; row < y; row++)
+            {
+                const stbi_uc* spare = &into[(size_t)row * stride + (size_t)x * 4];
+                if (spare[0] != 0xcd || spare[1] != 0xcd || spare[2] != 0xcd || spare[3] != 0xcd) std::abort();
+            }
+            decoded += pixelCount * 4;
+        }
+
+        BandReader reader = { x * channels, 0 };
+        stbi_load_bands_from_memory(data, size, 1 + (int)(hash >> 2 & 31), readBand, &reader, &w, &h, &n, 0);
+        decoded += reader.bytes;
+
+        stbi_uc* region = stbi_load_region_from_memory(data, size, x / 4, y / 3, x / 2 + 1, y / 2 + 1, &w, &h, &n, 0);
+        if (region != nullptr)
+        {
+            touch(region, (size_t)w * h * n);
+            decoded += (size_t)w * h * n;
+        }
+        stbi_image_free(region);
+
+        //Every frame takes at least 12 bytes of the file, which bounds what all of them can take decoded.
+        bool gif = size >= 3 && data[0] == 'G' && data[1] == 'I' && data[2] == 'F';
+        if (gif && pixelCount * 4 * (size / 12 + 1) <= MaxGifBytes)
+        {
+            int* delays = nullptr;
+            int frames = 0;
+            stbi_uc* pixels = stbi_load_gif_from_memory(data, size, &delays, &w, &h, &frames, &n, 4);
+            if (pixels != nullptr)
+            {
+                touch(pixels, (size_t)w * h * 4 * frames);
+                touch(delays, sizeof(int) * frames);
+                decoded += (size_t)w * h * 4 * frames;
+            }
+            stbi_image_free(pixels);
+            stbi_image_free(delays);
+        }
+
+        stbi_set_flip_vertically_on_load_thread(0);
+        stbi_set_premultiply_on_load_thread(0);
+        return decoded;
+    }
+
+    void recordTime(const uint8_t* data, size_t size, size_t decodedBytes, double seconds)
+    {
+        double cost = seconds * 1e9 / ((double)size + (double)decodedBytes + CallAllowanceBytes);
+        if (outliers.size() == MaxOutliers && cost <= outliers.back().nanosecondsPerByte) return;
+
+        FuzzOutlier outlier = { seconds, cost, decodedBytes, std::vector<unsigned char>(data, data + size) };
+        size_t at = outliers.size();
+        while (at > 0 && outliers[at - 1].nanosecondsPerByte < cost) at--;
+        outliers.insert(outliers.begin() + at, std::move(outlier));
+        if (outliers.size() > MaxOutliers) outliers.pop_back();
+    }
+}
+
+extern "C" int LLVMFuzzerInitialize(int*, char***)
+{
+    std::atexit(reportFuzzOutliers);
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size > INT_MAX) return 0;
+
+    auto start = std::chrono::steady_clock::now();
+    size_t decoded = decodeEverything(data, (int)size, hashInput(data, size));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    recordTime(data, size, decoded, seconds);
+    return 0;
+}
+
+const std::vector<FuzzOutlier>& fuzzOutliers()
+{
+    return outliers;
+}
+
+void reportFuzzOutliers()
+{
+    if (outliers.empty()) return;
+
+    const char* directory = std::getenv("IMAGE_FUZZ_OUTLIERS");
+    std::printf("decode time outliers\n");
+    for (size_t i = 0; i < outliers.size(); i++)
+    {
+        const FuzzOutlier& o = outliers[i];
+        std::printf("    %9.3f ms %9.1f ns/byte %9zu input bytes %11zu decoded bytes", o.seconds * 1e3, o.nanosecondsPerByte, o.input.size(), o.decodedBytes);
+
+        if (directory != nullptr)
+        {
+            char name[64];
+            std::snprintf(name, sizeof(name), "/outlier-%zu-%08x", i, hashInput(o.input.data(), o.input.size()));
+            std::string path = std::string(directory) + name;
+            FILE* file = std::fopen(path.c_str(), "wb");
+            if (file != nullptr)
+            {
+                std::fwrite(o.input.data(), 1, o.input.size(), file);
+                std::fclose(file);
+                std::printf(" %s", path.c_str());
+            }
+        }
+        std::printf("\n");
+    }
+    std::fflush(stdout);
+}
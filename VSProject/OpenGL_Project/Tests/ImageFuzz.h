@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//libFuzzer entry points for stb_image, the only parser in the project that reads files from outside.
+//An input goes through every call the application decodes with: info, load as stored and as RGBA, 16 bit,
+//float, load_into, bands, region and GIF frames, flipped and premultiplied for some inputs.
+//
+//Each input is timed too. The ones that cost the most per byte (read plus decoded, see fuzzOutliers) are kept
+//and printed at exit, and written to the directory IMAGE_FUZZ_OUTLIERS names when it is set, so decode time
+//outliers can be replayed like crashes. Built with libFuzzer as OpenGL_Project_ImageFuzzer (IMAGE_FUZZER in
+//CMakeLists.txt), and with a driver of its own as OpenGL_Project_ImageFuzz (ImageFuzzMain.cpp).
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv);
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+struct FuzzOutlier
+{
+    double seconds;
+    double nanosecondsPerByte;  //Over the input, the decoded bytes and a fixed allowance for the calls themselves.
+    size_t decodedBytes;
+    std::vector<unsigned char> input;
+};
+
+//The costliest inputs so far, costliest first.
+const std::vector<FuzzOutlier>& fuzzOutliers();
+
+//Prints them, and writes them out when IMAGE_FUZZ_OUTLIERS is set. Registered with atexit by LLVMFuzzerInitialize.
+void reportFuzzOutliers();
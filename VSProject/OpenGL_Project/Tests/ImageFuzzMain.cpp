@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ImageCorpus.h"
+#include "ImageFuzz.h"
+#include "Parallel.h"
+#include "Random.h"
+#include "stb_image.h"
+
+//Runs the fuzz entry points (ImageFuzz.cpp) without libFuzzer, for compilers that don't have it and for ctest:
+//
+//   OpenGL_Project_ImageFuzz [--runs 10000] [--seed 1] [--parallel] [files...]
+//
+//Files are replayed as they are (crashes and outliers libFuzzer wrote). Without any, the quick image corpus is
+//mutated at random for --runs inputs: bit flips, special bytes, truncation, copied and inserted runs, mostly in
+//the headers. --parallel lends stb_image parallelFor, for runs under TSan. The driver itself only notices crashes:
+//build with SANITIZE=address,undefined (and run with UBSAN_OPTIONS=halt_on_error=1) or SANITIZE=thread.
+
+namespace
+{
+    void stbiParallelFor(void*, int count, stbi_parallel_task* task, void* taskData)
+    {
+        parallelFor(count, 1, [=](int begin, int end) { task(taskData, begin, end); });
+    }
+
+    bool readFile(const char* path, std::vector<unsigned char>& data)
+    {
+        FILE* file = std::fopen(path, "rb");
+        if (file == nullptr) return false;
+
+        unsigned char buffer[4096];
+        size_t read;
+        data.clear();
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + read);
+        std::fclose(file);
+        return true;
+    }
+
+    std::vector<unsigned char> mutate(const std::vector<unsigned char>& seed, RandomStream& random)
+    {
+        static const unsigned char special[] = { 0x00, 0x01, 0x7f, 0x80, 0xff };
+
+        std::vector<unsigned char> input(seed);
+        int mutations = 1 + (int)(random.nextUInt() % 8);
+        for (int m = 0; m < mutations && !input.empty(); m++)
+        {
+            //Half of the changes land in the first 256 bytes, where the headers are.
+            size_t range = random.nextUInt() % 2 == 0 && input.size() > 256 ? 256 : input.size();
+            size_t at = random.nextUInt() % range;
+            switch (random.nextUInt() % 6)
+            {
+            case 0:
+                input[at] ^= (unsigned char)(1 << random.nextUInt() % 8);
+                break;
+            case 1:
+                input[at] = special[random.nextUInt() % sizeof(special)];
+                break;
+            case 2:
+                input[at] = (unsigned char)random.nextUInt();
+                break;
+            case 3:
+                input.resize(at + (input.size() - at) * (random.nextUInt() % 4) / 4);
+                break;
+            case 4:
+            {
+                size_t from = random.nextUInt() % input.size();
+                size_t length = 1 + random.nextUInt() % 64;
+                for (size_t i = 0; i < length && at + i < input.size() && from + i < input.size(); i++) input[at + i] = input[from + i];
+                break;
+            }
+            default:
+                input.insert(input.begin() + at, 1 + random.nextUInt() % 16, (unsigned char)random.nextUInt());
+                break;
+            }
+        }
+        return input;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int runs = 10000;
+    uint32_t seed = 1;
+    std::vector<const char*> files;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--runs") == 0 && i + 1 < argc) runs = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--parallel") == 0) stbi_set_parallel_for(stbiParallelFor, nullptr);
+        else files.push_back(argv[i]);
+    }
+
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    if (!files.empty())
+    {
+        for (const char* path : files)
+        {
+            std::vector<unsigned char> data;
+            if (!readFile(path, data))
+            {
+                std::printf("can't read %s\n", path);
+                return 2;
+            }
+            LLVMFuzzerTestOneInput(data.data(), data.size());
+        }
+        std::printf("%zu files replayed\n", files.size());
+        return 0;
+    }
+
+    std::vector<CorpusImage> corpus = makeImageCorpus(true);
+    for (const CorpusImage& image : corpus) LLVMFuzzerTestOneInput(image.file.data(), image.file.size());
+
+    RandomStream random(seed);
+    for (int run = 0; run < runs; run++)
+    {
+        const CorpusImage& image = corpus[random.nextUInt() % corpus.size()];
+        std::vector<unsigned char> input = mutate(image.file, random);
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    std::printf("%d mutated inputs from %zu images, seed %u\n", runs, corpus.size(), seed);
+    return 0;
+}
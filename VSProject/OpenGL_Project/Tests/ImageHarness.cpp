@@ -0,0 +1,558 @@
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ImageCorpus.h"
+#include "ImageDecoders.h"
+#include "StbAllocationCounter.h"
+
+//Decodes a generated corpus of every image format and variant the application hands to stb_image (makeImageCorpus),
+//checks the pixels, and reports per image and per format: MB/s of decoded pixels, allocations and peak memory of one
+//decode, and the speed against the baseline stb_image when CMake was given STB_IMAGE_BASELINE.
+//
+//   OpenGL_Project_ImageHarness [--quick] [--write baseline.json] [--check baseline.json] [--tolerance 0.2]
+//                               [--corpus directory] [name filters...]
+//
+//--write stores the results as a JSON baseline, --check compares with one and fails on a regression: an image with
+//more allocations or peak bytes than the baseline, or a format's MB/s lower by more than the tolerance (a fraction).
+//Timings only compare on the machine and build that wrote the baseline. --corpus writes the encoded images out, e.g. as seeds for the fuzzer.
+//Exits with 1 when an image decodes wrong or --check finds a regression.
+
+namespace
+{
+    //Against libjpeg's decode, stb_image only differs by a rounding step here and there (above 55 dB).
+    //One broken block or row drops below this.
+    const double MinJpegPsnr = 45.0;
+
+    struct Options
+    {
+        bool quick = false;
+        const char* writePath = nullptr;
+        const char* checkPath = nullptr;
+        const char* corpusDirectory = nullptr;
+        double tolerance = 0.2;
+        std::vector<const char*> filters;
+    };
+
+    struct Result
+    {
+        std::string name;
+        std::string format;
+        bool correct = false;
+        double decodedBytes = 0.0;
+        double seconds = 0.0;               //Best decode.
+        double baselineSeconds = 0.0;       //0 without a baseline decoder.
+        int allocations = 0;
+        double peakBytes = 0.0;
+
+        double megabytesPerSecond() const { return decodedBytes / seconds * 1e-6; }
+    };
+
+    void* load(const ImageDecoder& decoder, const CorpusImage& image, int& x, int& y, int& channels)
+    {
+        const unsigned char* data = image.file.data();
+        int size = (int)image.file.size();
+        if (image.bitDepth == 16) return decoder.load16(data, size, &x, &y, &channels, 0);
+        if (image.bitDepth == 32) return decoder.loadf(data, size, &x, &y, &channels, 0);
+        return decoder.load(data, size, &x, &y, &channels, 0);
+    }
+
+    double psnr(const unsigned char* a, const unsigned char* b, size_t count)
+    {
+        double squares = 0.0;
+        for (size_t i = 0; i < count; i++) squares += (double)(a[i] - b[i]) * (a[i] - b[i]);
+        if (squares == 0.0) return 99.0;
+        return 10.0 * std::log10(255.0 * 255.0 * count / squares);
+    }
+
+    //One decode with the application's stb_image, counting its allocations, and the check of its pixels.
+    void decodeOnce(const CorpusImage& image, Result& result)
+    {
+        StbAllocationCounter counter;
+        int x = 0, y = 0, channels = 0;
+        const unsigned char* pixels = (const unsigned char*)load(stbImageDecoder(), image, x, y, channels);
+
+        result.allocations = counter.allocations;
+        result.peakBytes = (double)counter.peakBytes;
+        result.correct = pixels != nullptr && x == image.width && y == image.height && channels == image.channels;
+        if (result.correct)
+        {
+            if (image.lossy) result.correct = psnr(pixels, image.expected.data(), image.expected.size()) >= MinJpegPsnr;
+            else result.correct = std::memcmp(pixels, image.expected.data(), image.expected.size()) == 0;
+        }
+        stbi_image_free((void*)pixels);
+    }
+
+    //Best of at least minRepeats decodes, repeated until they took minSeconds altogether.
+    double timeDecode(const ImageDecoder& decoder, const CorpusImage& image, int minRepeats, double minSeconds)
+    {
+        double best = 1e30;
+        double total = 0.0;
+        for (int i = 0; i < minRepeats || total < minSeconds; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            int x, y, channels;
+            void* pixels = load(decoder, image, x, y, channels);
+            decoder.free(pixels);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            if (seconds < best) best = seconds;
+            total += seconds;
+        }
+        return best;
+    }
+
+    std::string fileName(const CorpusImage& image)
+    {
+        std::string name = image.name;
+        for (char& c : name)
+        {
+            if (!std::isalnum((unsigned char)c)) c = '_';
+        }
+        std::string format = image.format.substr(0, image.format.find(' '));
+        return name + "." + format;
+    }
+
+    bool writeCorpus(const std::vector<CorpusImage>& corpus, const char* directory)
+    {
+        for (const CorpusImage& image : corpus)
+        {
+            std::string path = std::string(directory) + "/" + fileName(image);
+            FILE* file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr) return false;
+            bool written = std::fwrite(image.file.data(), 1, image.file.size(), file) == image.file.size();
+            if (std::fclose(file) != 0 || !written) return false;
+        }
+        return true;
+    }
+
+    //What a baseline file holds, just enough of JSON to read it back: objects, arrays, strings, numbers and literals.
+    struct JsonValue
+    {
+        enum Type { Null, Boolean, Number, String, Array, Object };
+
+        Type type = Null;
+        double number = 0.0;
+        std::string string;
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue>> members;
+
+        const JsonValue* member(const char* key) const
+        {
+            for (const auto& m : members)
+            {
+                if (m.first == key) return &m.second;
+            }
+            return nullptr;
+        }
+    };
+
+    class JsonParser
+    {
+    public:
+        explicit JsonParser(const std::string& text) : text(text) {}
+
+        bool parse(JsonValue& value)
+        {
+            if (!parseValue(value, 0)) return false;
+            skipSpace();
+            return position == text.size();
+        }
+
+    private:
+        const std::string& text;
+        size_t position = 0;
+
+        void skipSpace()
+        {
+            while (position < text.size() && std::isspace((unsigned char)text[position])) position++;
+        }
+
+        bool consume(char c)
+        {
+            skipSpace();
+            if (position >= text.size() || text[position] != c) return false;
+            position++;
+            return true;
+        }
+
+        bool consumeWord(const char* word)
+        {
+            size_t length = std::strlen(word);
+            if (text.compare(position, length, word) != 0) return false;
+            position += length;
+            return true;
+        }
+
+        //Names are plain ASCII, so \u escapes aren't needed.
+        bool parseString(std::string& out)
+        {
+            if (!consume('"')) return false;
+            out.clear();
+            while (position < text.size() && text[position] != '"')
+            {
+                char c = text[position++];
+                if (c == '\\')
+                {
+                    if (position >= text.size()) return false;
+                    c = text[position++];
+                    if (c == 'n') c = '\n';
+                    else if (c == 't') c = '\t';
+                    else if (c != '"' && c != '\\' && c != '/') return false;
+                }
+                out.push_back(c);
+            }
+            return position++ < text.size();
+        }
+
+        bool parseValue(JsonValue& value, int depth)
+        {
+            skipSpace();
+            if (position >= text.size() || depth > 32) return false;
+
+            char c = text[position];
+            if (c == '{')
+            {
+                position++;
+                value.type = JsonValue::Object;
+                if (consume('}')) return true;
+                do
+                {
+                    std::pair<std::string, JsonValue> member;
+                    if (!parseString(member.first) || !consume(':') || !parseValue(member.second, depth + 1)) return false;
+                    value.members.push_back(std::move(member));
+                } while (consume(','));
+                return consume('}');
+            }
+            if (c == '[')
+            {
+                position++;
+                value.type = JsonValue::Array;
+                if (consume(']')) return true;
+                do
+                {
+                    value.items.emplace_back();
+                    if (!parseValue(value.items.back(), depth + 1)) return false;
+                } while (consume(','));
+                return consume(']');
+            }
+            if (c == '"')
+            {
+                value.type = JsonValue::String;
+                return parseString(value.string);
+            }
+            if (consumeWord("true"))
+            {
+                value.type = JsonValue::Boolean;
+                value.number = 1.0;
+                return true;
+            }
+            if (consumeWord("false"))
+            {
+                value.type = JsonValue::Boolean;
+                return true;
+            }
+            if (consumeWord("null")) return true;
+
+            const char* start = text.c_str() + position;
+            char* end = nullptr;
+            value.number = std::strtod(start, &end);
+            if (end == start) return false;
+            value.type = JsonValue::Number;
+            position += end - start;
+            return true;
+        }
+    };
+
+    std::string quoted(const std::string& s)
+    {
+        std::string out = "\"";
+        for (char c : s)
+        {
+            if (c == '"' || c == '\\') out.push_back('\\');
+            out.push_back(c);
+        }
+        return out + "\"";
+    }
+
+    //One format's images together: MB/s over all of them, allocations averaged, the largest peak.
+    struct FormatResult
+    {
+        std::string format;
+        double megabytesPerSecond = 0.0;
+        double baselineRatio = 0.0;
+        double allocations = 0.0;
+        double peakBytes = 0.0;
+        double peakRatio = 0.0;
+    };
+
+    //Formats in corpus order.
+    std::vector<FormatResult> sumFormats(const std::vector<Result>& results)
+    {
+        std::vector<FormatResult> formats;
+        for (const Result& r : results)
+        {
+            bool known = false;
+            for (const FormatResult& f : formats) known = known || f.format == r.format;
+            if (known) continue;
+
+            double bytes = 0.0, seconds = 0.0, baselineSeconds = 0.0;
+            int images = 0;
+            FormatResult f;
+            f.format = r.format;
+            for (const Result& other : results)
+            {
+                if (other.format != r.format) continue;
+                bytes += other.decodedBytes;
+                seconds += other.seconds;
+                baselineSeconds += other.baselineSeconds;
+                f.allocations += other.allocations;
+                if (other.peakBytes > f.peakBytes)
+                {
+                    f.peakBytes = other.peakBytes;
+                    f.peakRatio = other.peakBytes / other.decodedBytes;
+                }
+                images++;
+            }
+            f.megabytesPerSecond = bytes / seconds * 1e-6;
+            f.baselineRatio = baselineSeconds / seconds;
+            f.allocations /= images;
+            formats.push_back(f);
+        }
+        return formats;
+    }
+
+    //Speed per format, single images vary too much from run to run. Allocations and peak bytes don't vary
+    //at all, so those are kept per image.
+    bool writeBaseline(const char* path, const Options& options, const std::vector<FormatResult>& formats, const std::vector<Result>& results)
+    {
+        FILE* file = std::fopen(path, "w");
+        if (file == nullptr) return false;
+
+        std::fprintf(file, "{\n    \"corpus\": \"%s\",\n    \"formats\":\n    [\n", options.quick ? "quick" : "full");
+        for (size_t i = 0; i < formats.size(); i++)
+        {
+            std::fprintf(file, "        { \"format\": %s, \"megabytesPerSecond\": %.3f }%s\n",
+                quoted(formats[i].format).c_str(), formats[i].megabytesPerSecond, i + 1 < formats.size() ? "," : "");
+        }
+        std::fprintf(file, "    ],\n    \"images\":\n    [\n");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const Result& r = results[i];
+            std::fprintf(file, "        { \"name\": %s, \"format\": %s, \"allocations\": %d, \"peakBytes\": %.0f }%s\n",
+                quoted(r.name).c_str(), quoted(r.format).c_str(), r.allocations, r.peakBytes, i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(file, "    ]\n}\n");
+        return std::fclose(file) == 0;
+    }
+
+    bool readFile(const char* path, std::string& text)
+    {
+        FILE* file = std::fopen(path, "rb");
+        if (file == nullptr) return false;
+
+        char buffer[4096];
+        size_t read;
+        text.clear();
+        while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, read);
+        std::fclose(file);
+        return true;
+    }
+
+    //Number members of every object in array, keyed by its member key. Entries missing any of them are left out.
+    std::map<std::string, std::vector<double>> readEntries(const JsonValue* array, const char* key, const std::vector<const char*>& numbers)
+    {
+        std::map<std::string, std::vector<double>> entries;
+        if (array == nullptr) return entries;
+
+        for (const JsonValue& item : array->items)
+        {
+            const JsonValue* name = item.member(key);
+            if (name == nullptr) continue;
+
+            std::vector<double> values;
+            for (const char* number : numbers)
+            {
+                const JsonValue* value = item.member(number);
+                if (value != nullptr && value->type == JsonValue::Number) values.push_back(value->number);
+            }
+            if (values.size() == numbers.size()) entries[name->string] = values;
+        }
+        return entries;
+    }
+
+    //Prints every difference from the baseline, returns the number of regressions or -1 when it can't be read.
+    int checkBaseline(const char* path, const Options& options, const std::vector<FormatResult>& formats, const std::vector<Result>& results)
+    {
+        std::string text;
+        JsonValue root;
+        if (!readFile(path, text) || !JsonParser(text).parse(root) || root.type != JsonValue::Object)
+        {
+            std::printf("%s: can't be read as a baseline\n", path);
+            return -1;
+        }
+
+        const JsonValue* corpus = root.member("corpus");
+        if (corpus == nullptr || corpus->string != (options.quick ? "quick" : "full"))
+        {
+            std::printf("%s: not written for the %s corpus\n", path, options.quick ? "quick" : "full");
+            return -1;
+        }
+
+        std::map<std::string, std::vector<double>> baseFormats = readEntries(root.member("formats"), "format", { "megabytesPerSecond" });
+        std::map<std::string, std::vector<double>> baseImages = readEntries(root.member("images"), "name", { "allocations", "peakBytes" });
+
+        std::printf("against %s\n", path);
+        int regressions = 0;
+        for (const FormatResult& f : formats)
+        {
+            auto found = baseFormats.find(f.format);
+            if (found == baseFormats.end())
+            {
+                std::printf("    %-40s not in the baseline\n", f.format.c_str());
+                continue;
+            }
+
+            double before = found->second[0];
+            if (f.megabytesPerSecond < before * (1.0 - options.tolerance))
+            {
+                std::printf("    %-40s REGRESSION %.1f -> %.1f MB/s\n", f.format.c_str(), before, f.megabytesPerSecond);
+                regressions++;
+            }
+            else if (f.megabytesPerSecond > before * (1.0 + options.tolerance))
+            {
+                std::printf("    %-40s faster, %.1f -> %.1f MB/s\n", f.format.c_str(), before, f.megabytesPerSecond);
+            }
+        }
+
+        for (const Result& r : results)
+        {
+            auto found = baseImages.find(r.name);
+            if (found == baseImages.end())
+            {
+                std::printf("    %-40s not in the baseline\n", r.name.c_str());
+                continue;
+            }
+
+            double allocations = found->second[0];
+            double peak = found->second[1];
+            if (r.allocations > allocations || r.peakBytes > peak)
+            {
+                std::printf("    %-40s REGRESSION %.0f -> %d allocations, %.0f -> %.0f peak bytes\n", r.name.c_str(), allocations, r.allocations, peak, r.peakBytes);
+                regressions++;
+            }
+            else if (r.allocations < allocations || r.peakBytes < peak)
+            {
+                std::printf("    %-40s less, %.0f -> %d allocations, %.0f -> %.0f peak bytes\n", r.name.c_str(), allocations, r.allocations, peak, r.peakBytes);
+            }
+        }
+
+        //Better results are only noted, the baseline wants rewriting once they stick.
+        std::printf("    %d regressions\n", regressions);
+        return regressions;
+    }
+
+    void printResult(const char* what, double megabytesPerSecond, double baselineRatio, double allocations, double peakBytes, double peakRatio)
+    {
+        std::printf("    %-40s %9.1f MB/s", what, megabytesPerSecond);
+        if (baselineRatio > 0.0) std::printf(" %6.2fx baseline", baselineRatio);
+        std::printf(" %8.1f allocations %9.3f MB peak %6.2fx output\n", allocations, peakBytes * 1e-6, peakRatio);
+        std::fflush(stdout);
+    }
+
+    bool parseOptions(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            bool hasValue = i + 1 < argc;
+            if (std::strcmp(argv[i], "--quick") == 0) options.quick = true;
+            else if (std::strcmp(argv[i], "--write") == 0 && hasValue) options.writePath = argv[++i];
+            else if (std::strcmp(argv[i], "--check") == 0 && hasValue) options.checkPath = argv[++i];
+            else if (std::strcmp(argv[i], "--corpus") == 0 && hasValue) options.corpusDirectory = argv[++i];
+            else if (std::strcmp(argv[i], "--tolerance") == 0 && hasValue) options.tolerance = std::atof(argv[++i]);
+            else if (argv[i][0] == '-') return false;
+            else options.filters.push_back(argv[i]);
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::printf("usage: %s [--quick] [--write baseline.json] [--check baseline.json] [--tolerance 0.2] [--corpus directory] [name filters...]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<CorpusImage> corpus;
+    for (CorpusImage& image : makeImageCorpus(options.quick))
+    {
+        bool selected = options.filters.empty();
+        for (const char* filter : options.filters) selected = selected || image.name.find(filter) != std::string::npos;
+        if (selected) corpus.push_back(std::move(image));
+    }
+
+    if (options.corpusDirectory != nullptr && !writeCorpus(corpus, options.corpusDirectory))
+    {
+        std::printf("can't write the corpus to %s\n", options.corpusDirectory);
+        return 2;
+    }
+
+    const ImageDecoder* baseline = baselineImageDecoder();
+    int minRepeats = options.quick ? 1 : 5;
+    double minSeconds = options.quick ? 0.0 : 0.2;
+
+    std::printf("images\n");
+    std::vector<Result> results;
+    int wrong = 0;
+    for (const CorpusImage& image : corpus)
+    {
+        Result r;
+        r.name = image.name;
+        r.format = image.format;
+        r.decodedBytes = (double)image.expected.size();
+
+        //Also the untimed first round, so the heap has grown before anything is measured.
+        decodeOnce(image, r);
+        r.seconds = timeDecode(stbImageDecoder(), image, minRepeats, minSeconds);
+        if (baseline != nullptr) r.baselineSeconds = timeDecode(*baseline, image, minRepeats, minSeconds);
+
+        std::string what = r.name + (r.correct ? "" : " (WRONG PIXELS)");
+        printResult(what.c_str(), r.megabytesPerSecond(), r.baselineSeconds / r.seconds, r.allocations, r.peakBytes, r.peakBytes / r.decodedBytes);
+        if (!r.correct) wrong++;
+        results.push_back(r);
+    }
+
+    std::printf("formats\n");
+    std::vector<FormatResult> formats = sumFormats(results);
+    for (const FormatResult& f : formats) printResult(f.format.c_str(), f.megabytesPerSecond, f.baselineRatio, f.allocations, f.peakBytes, f.peakRatio);
+
+    if (options.writePath != nullptr)
+    {
+        if (!writeBaseline(options.writePath, options, formats, results))
+        {
+            std::printf("can't write %s\n", options.writePath);
+            return 2;
+        }
+        std::printf("baseline written to %s\n", options.writePath);
+    }
+
+    int regressions = 0;
+    if (options.checkPath != nullptr)
+    {
+        regressions = checkBaseline(options.checkPath, options, formats, results);
+        if (regressions < 0) return 2;
+    }
+
+    if (wrong > 0) std::printf("%d images decoded wrong\n", wrong);
+    return wrong > 0 || regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "ImageCorpus.h"
+#include "ImageInfo.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    bool writeFile(const std::string& path, const std::vector<unsigned char>& data)
+    {
+        FILE* file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr) return false;
+        bool written = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        return std::fclose(file) == 0 && written;
+    }
+}
+
+//A FIFO nobody writes to blocks a plain open for reading forever. The directory scan has to leave it out, and a
+//scan given its path has to report it as no image, next to a PNG, a link to it and a subdirectory.
+TEST(imageInfoSkipsFifos)
+{
+    const std::string directory = TEST_SCRATCH_DIRECTORY "/imageInfo";
+    mkdir(TEST_SCRATCH_DIRECTORY, 0755);
+    mkdir(directory.c_str(), 0755);
+
+    const std::string image = directory + "/image.png";
+    const std::string link = directory + "/link.png";
+    const std::string fifo = directory + "/pipe";
+    const std::string subdirectory = directory + "/sub";
+    unlink(link.c_str());
+    unlink(fifo.c_str());
+
+    std::vector<unsigned char> pixels = makeTestPixels(8, 4, 3, 49);
+    CHECK(writeFile(image, encodePng(pixels.data(), 8, 4, 3)));
+    CHECK(symlink("image.png", link.c_str()) == 0);
+    CHECK(mkfifo(fifo.c_str(), 0644) == 0);
+    mkdir(subdirectory.c_str(), 0755);
+
+    std::vector<std::string> names;
+    std::vector<ImageInfo> infos = scanImageDirectory(directory, names);
+    CHECK(names.size() == 2 && infos.size() == 2);
+    for (size_t i = 0; i < infos.size(); i++)
+    {
+        CHECK(infos[i].width == 8 && infos[i].height == 4 && infos[i].channels == 3);
+    }
+
+    infos = scanImageInfo({ fifo, image, subdirectory });
+    CHECK(infos.size() == 3);
+    CHECK(infos[0].channels == 0);
+    CHECK(infos[1].channels == 3);
+    CHECK(infos[2].channels == 0);
+
+    unlink(link.c_str());
+    unlink(fifo.c_str());
+    unlink(image.c_str());
+    rmdir(subdirectory.c_str());
+    rmdir(directory.c_str());
+}
+#endif
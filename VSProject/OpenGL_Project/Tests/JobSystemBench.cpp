@@ -0,0 +1,87 @@
+#include "Bench.h"
+
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Parallel.h"
+
+namespace
+{
+    //Thread counts from 1 up to the core count, doubling.
+    std::vector<int> threadCounts()
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        if (cores < 1) cores = 1;
+
+        std::vector<int> counts;
+        for (int threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+        counts.push_back(cores);
+        return counts;
+    }
+
+    //Some arithmetic per item, enough that the loop is compute bound.
+    float work(int item)
+    {
+        float x = (float)item;
+        for (int i = 0; i < 32; i++) x = std::sqrt(x * 1.0001f + 1.0f);
+        return x;
+    }
+}
+
+//Scaling of the job system from 1 thread to every core: a coarse compute loop, a fine grained loop where
+//splitting overhead shows, and raw throughput of tiny independent jobs.
+BENCHMARK(jobSystemScaling)
+{
+    const int items = benchSize(1 << 22, 1 << 14);
+    const int jobs = benchSize(200000, 2000);
+    std::vector<float> output(items);
+
+    double baseCoarse = 0.0, baseFine = 0.0;
+    for (int threads : threadCounts())
+    {
+        startJobSystem(threads - 1);
+
+        double coarse = bestTime(5, [&]()
+        {
+            parallelFor(items, 16384, [&](int begin, int end)
+            {
+                for (int i = begin; i < end; i++) output[i] = work(i);
+            });
+        });
+
+        double fine = bestTime(5, [&]()
+        {
+            parallelFor(items, 64, [&](int begin, int end)
+            {
+                for (int i = begin; i < end; i++) output[i] = (float)i * 0.5f;
+            });
+        });
+
+        double tiny = bestTime(5, [&]()
+        {
+            JobCounter counter;
+            for (int i = 0; i < jobs; i++) scheduleJob([&output, i]() { output[i] = 1.0f; }, &counter);
+            waitForCounter(counter);
+        });
+
+        stopJobSystem();
+
+        if (threads == 1)
+        {
+            baseCoarse = coarse;
+            baseFine = fine;
+        }
+
+        std::string prefix = std::to_string(threads) + (threads == 1 ? " thread, " : " threads, ");
+        report((prefix + "compute loop").c_str(), items / coarse * 1e-6, "M items/s");
+        report((prefix + "compute loop speedup").c_str(), baseCoarse / coarse, "x");
+        report((prefix + "grain 64 loop").c_str(), items / fine * 1e-6, "M items/s");
+        report((prefix + "grain 64 loop speedup").c_str(), baseFine / fine, "x");
+        report((prefix + "empty jobs").c_str(), jobs / tiny * 1e-6, "M jobs/s");
+    }
+
+    benchSink += (uint64_t)output[1];
+}
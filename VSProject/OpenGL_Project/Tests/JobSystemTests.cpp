@@ -0,0 +1,121 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Parallel.h"
+#include "Random.h"
+
+namespace
+{
+    //Chunks jobParallelFor hands to body, sorted by begin.
+    std::vector<std::pair<int, int> > recordChunks(int count, int grainSize)
+    {
+        std::mutex mutex;
+        std::vector<std::pair<int, int> > chunks;
+        jobParallelFor(count, grainSize, [&](int begin, int end)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks.push_back(std::make_pair(begin, end));
+        });
+
+        std::sort(chunks.begin(), chunks.end());
+        return chunks;
+    }
+}
+
+//However the range gets split between threads, body sees the chunks a serial parallelFor would.
+TEST(jobParallelForChunksFollowGrainSize)
+{
+    startJobSystem(7);
+
+    const int counts[] = { 1, 7, 64, 1000, 65537, 262146 };
+    const int grainSizes[] = { 1, 3, 64, 1000 };
+    bool aligned = true;
+
+    for (int count : counts)
+    {
+        for (int grainSize : grainSizes)
+        {
+            for (int repeat = 0; repeat < 10; repeat++)
+            {
+                std::vector<std::pair<int, int> > chunks = recordChunks(count, grainSize);
+
+                int next = 0;
+                for (const std::pair<int, int>& chunk : chunks)
+                {
+                    aligned = aligned && chunk.first == next && chunk.first % grainSize == 0;
+                    aligned = aligned && chunk.second == std::min(chunk.first + grainSize, count);
+                    next = chunk.second;
+                }
+                aligned = aligned && next == count;
+            }
+        }
+    }
+
+    stopJobSystem();
+    CHECK(aligned);
+}
+
+//The random fills promise the same output for any number of threads. Gaussian values come in Box-Muller
+//pairs, so this breaks as soon as a chunk starts on an odd index.
+TEST(jobSystemRandomFillsMatchSerial)
+{
+    const int count = 262146;
+    std::vector<float> serialGauss(count), serialLinear(count);
+    std::vector<glm::vec3> serialSphere(count);
+
+    RandomStream gauss(29, 1);
+    gauss.gaussRand(serialGauss.data(), count, 0.0f, 1.0f);
+    RandomStream linear(29, 2);
+    linear.linearRand(serialLinear.data(), count, -1.0f, 1.0f);
+    RandomStream sphere(29, 3);
+    sphere.sphericalRand(serialSphere.data(), count, 2.0f);
+
+    startJobSystem(7);
+
+    bool same = true;
+    std::vector<float> values(count);
+    std::vector<glm::vec3> directions(count);
+    for (int repeat = 0; repeat < 20; repeat++)
+    {
+        fillGaussRand(values.data(), count, 29, 1, 0.0f, 1.0f);
+        same = same && std::memcmp(values.data(), serialGauss.data(), count * sizeof(float)) == 0;
+
+        fillLinearRand(values.data(), count, 29, 2, -1.0f, 1.0f);
+        same = same && std::memcmp(values.data(), serialLinear.data(), count * sizeof(float)) == 0;
+
+        fillSphericalRand(directions.data(), count, 29, 3, 2.0f);
+        same = same && std::memcmp(directions.data(), serialSphere.data(), count * sizeof(glm::vec3)) == 0;
+    }
+
+    stopJobSystem();
+    CHECK(same);
+}
+
+//A job waiting on a counter only runs once every job counted by it has finished.
+TEST(jobDependenciesRunInOrder)
+{
+    startJobSystem(3);
+
+    std::atomic<int> firstDone(0);
+    std::atomic<bool> orderKept(true);
+    JobCounter first, second;
+
+    for (int i = 0; i < 100; i++) scheduleJob([&]() { firstDone++; }, &first);
+    for (int i = 0; i < 100; i++)
+    {
+        scheduleJob([&]() { if (firstDone.load() != 100) orderKept = false; }, &second, &first);
+    }
+
+    waitForCounter(second);
+    stopJobSystem();
+
+    CHECK(firstDone.load() == 100);
+    CHECK(orderKept.load());
+}
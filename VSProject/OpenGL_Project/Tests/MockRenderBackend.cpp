@@ -0,0 +1,78 @@
+#include "MockRenderBackend.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+void MockRenderBackend::log(const char* format, ...)
+{
+    char line[256];
+    va_list arguments;
+    va_start(arguments, format);
+    std::vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+    calls.push_back(line);
+}
+
+void MockRenderBackend::clear(const float* color, GLbitfield mask)
+{
+    log("clear %g %g %g %g %u", color[0], color[1], color[2], color[3], mask);
+}
+
+void MockRenderBackend::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    log("viewport %d %d %d %d", x, y, width, height);
+}
+
+void MockRenderBackend::useProgram(GLuint program)
+{
+    log("useProgram %u", program);
+}
+
+void MockRenderBackend::bindTexture(GLuint unit, GLuint texture)
+{
+    log("bindTexture %u %u", unit, texture);
+}
+
+void MockRenderBackend::bindVertexArray(GLuint vao)
+{
+    log("bindVertexArray %u", vao);
+}
+
+void MockRenderBackend::setUniformInt(GLint location, GLint value)
+{
+    log("setUniformInt %d %d", location, value);
+}
+
+void MockRenderBackend::setUniformMat4(GLint location, const float* value)
+{
+    log("setUniformMat4 %d %g %g %g %g", location, value[0], value[5], value[10], value[15]);
+}
+
+void MockRenderBackend::drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset)
+{
+    log("drawElements %u %d %u %u", mode, count, type, offset);
+}
+
+void MockRenderBackend::drawIndirectBatch(const IndirectBatch& batch, int frame)
+{
+    log("drawIndirectBatch %p %d", (const void*)&batch, frame);
+}
+
+void MockRenderBackend::copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size)
+{
+    log("copyBuffer %u %u %u %u %u", source, target, sourceOffset, targetOffset, size);
+
+    std::vector<unsigned char>& from = buffers[source];
+    std::vector<unsigned char>& to = buffers[target];
+
+    bool overlaps = source == target && sourceOffset < targetOffset + size && targetOffset < sourceOffset + size;
+    bool outside = (size_t)sourceOffset + size > from.size() || (size_t)targetOffset + size > to.size();
+    if (overlaps || outside)
+    {
+        invalidCopies++;
+        return;
+    }
+
+    std::memcpy(to.data() + targetOffset, from.data() + sourceOffset, size);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "RenderCommands.h"
+
+//RenderBackend that logs every call as one line of text instead of touching GL, so tests can replay a recorded
+//frame and compare what would have been issued. Buffers are plain byte arrays: copyBuffer really copies, and
+//flags what GL would reject (overlapping ranges within one buffer, ranges past the end).
+class MockRenderBackend : public RenderBackend
+{
+public:
+    std::vector<std::string> calls;
+    std::map<GLuint, std::vector<unsigned char> > buffers;
+    int invalidCopies = 0;
+
+    void clear(const float* color, GLbitfield mask) override;
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+    void useProgram(GLuint program) override;
+    void bindTexture(GLuint unit, GLuint texture) override;
+    void bindVertexArray(GLuint vao) override;
+    void setUniformInt(GLint location, GLint value) override;
+    void setUniformMat4(GLint location, const float* value) override;
+    void drawElements(GLenum mode, GLsizei count, GLenum type, GLuint offset) override;
+    void drawIndirectBatch(const IndirectBatch& batch, int frame) override;
+    void copyBuffer(GLuint source, GLuint target, GLuint sourceOffset, GLuint targetOffset, GLuint size) override;
+
+private:
+    void log(const char* format, ...);
+};
@@ -0,0 +1,78 @@
+#include "Test.h"
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "MockRenderBackend.h"
+#include "MultiDraw.h"
+
+namespace
+{
+    const GLuint Buffer = 1;
+    const GLuint Scratch = 2;
+
+    //Records the moves, replays them on the mock and compares the buffer with memmove doing the same moves.
+    bool movesCopyLikeMemmove(const std::vector<AllocationMove>& moves, uint32_t unitSize, uint32_t bufferBytes)
+    {
+        MockRenderBackend backend;
+        std::vector<unsigned char>& buffer = backend.buffers[Buffer];
+        buffer.resize(bufferBytes);
+        for (uint32_t i = 0; i < bufferBytes; i++) buffer[i] = (unsigned char)(i * 7 + i / 251);
+        backend.buffers[Scratch].resize(MoveScratchBytes);
+
+        std::vector<unsigned char> expected = buffer;
+        for (const AllocationMove& move : moves) std::memmove(&expected[move.to * unitSize], &expected[move.from * unitSize], move.size * unitSize);
+
+        CommandBuffer commands;
+        recordAllocationMoves(commands, Buffer, Scratch, moves, unitSize);
+        replayCommands(commands, backend);
+
+        return backend.invalidCopies == 0 && backend.buffers[Buffer] == expected;
+    }
+
+    AllocationMove makeMove(uint32_t from, uint32_t to, uint32_t size)
+    {
+        AllocationMove move = { NullAllocation, from, to, size };
+        return move;
+    }
+}
+
+//Every way a move can be copied: apart, overlapping by a long distance (pieces of the distance), overlapping by a
+//short one (through scratch, also more than a scratch buffer long), in bytes and in 12 byte vertices.
+TEST(recordAllocationMovesCopiesOverlaps)
+{
+    CHECK(movesCopyLikeMemmove({ makeMove(5000, 100, 3000) }, 1, 10000));
+    CHECK(movesCopyLikeMemmove({ makeMove(100000, 20000, 150000) }, 1, 300000));
+    CHECK(movesCopyLikeMemmove({ makeMove(4, 0, 1000) }, 1, 2000));
+    CHECK(movesCopyLikeMemmove({ makeMove(1, 0, 200000) }, 1, 300000));
+    CHECK(movesCopyLikeMemmove({ makeMove(MoveScratchBytes, 0, 3 * MoveScratchBytes + 5) }, 1, 5 * MoveScratchBytes));
+    CHECK(movesCopyLikeMemmove({ makeMove(100, 90, 20000), makeMove(20100, 20090, 7), makeMove(30000, 20097, 9000) }, 12, 40000 * 12));
+}
+
+//The moves of a real defragment on a fragmented allocator, copied in one go.
+TEST(recordAllocationMovesFollowsDefragment)
+{
+    const uint32_t capacity = 1 << 16;
+    const uint32_t stride = 12;
+
+    std::mt19937 generator(400);
+    TlsfAllocator allocator(capacity);
+    std::vector<AllocationHandle> handles;
+    for (;;)
+    {
+        AllocationHandle handle = allocator.allocate(1 + generator() % 2000);
+        if (handle == NullAllocation) break;
+        handles.push_back(handle);
+    }
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        if (generator() % 3 == 0) allocator.release(handles[i]);
+    }
+
+    std::vector<AllocationMove> moves;
+    allocator.defragment(0xffffffffu, moves);
+    CHECK(allocator.compact());
+    CHECK(!moves.empty());
+    CHECK(movesCopyLikeMemmove(moves, stride, capacity * stride));
+}
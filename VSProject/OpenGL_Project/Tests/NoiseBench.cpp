@@ -0,0 +1,88 @@
+#include "Bench.h"
+
+#include <cstdio>
+#include <vector>
+
+#include <glm/gtc/noise.hpp>
+
+#include "Noise.h"
+
+//A 4096 x 4096 heightmap (the size the request's "well under a second" is about) with every noise type, against
+//glm::perlin / glm::simplex called per cell on one thread. glm is timed on a 512 row slice and scaled up.
+BENCHMARK(noiseFill)
+{
+    const int size = benchSize(4096, 512);
+    const int glmRows = benchSize(512, 64);
+    std::vector<float> grid((size_t)size * size);
+
+    struct Case
+    {
+        const char* name;
+        NoiseType type;
+        FractalType fractal;
+        int octaves;
+    };
+    const Case cases[] =
+    {
+        { "perlin", NoisePerlin, FractalNone, 1 },
+        { "simplex", NoiseSimplex, FractalNone, 1 },
+        { "perlin fBm 6 octaves", NoisePerlin, FractalFbm, 6 },
+        { "simplex ridged 6 octaves", NoiseSimplex, FractalRidged, 6 },
+    };
+
+    for (const Case& c : cases)
+    {
+        NoiseSettings settings;
+        settings.type = c.type;
+        settings.fractal = c.fractal;
+        settings.octaves = c.octaves;
+        settings.scale = 1.0f / 64.0f;
+
+        double fillSeconds = bestTime(3, [&]()
+        {
+            fillNoise2D(grid.data(), size, size, settings);
+        });
+        benchSink += (uint64_t)(grid[grid.size() / 2] * 1000.0f);
+
+        char line[96];
+        std::snprintf(line, sizeof(line), "fillNoise2D %s, %dx%d", c.name, size, size);
+        report(line, fillSeconds * 1e3, "ms");
+
+        //Single octaves only, glm has no fractal sums.
+        if (c.fractal != FractalNone) continue;
+
+        double glmSeconds = bestTime(1, [&]()
+        {
+            float sum = 0.0f;
+            for (int y = 0; y < glmRows; y++)
+            {
+                for (int x = 0; x < size; x++)
+                {
+                    glm::vec2 p = glm::vec2((float)x, (float)y) * settings.scale;
+                    sum += c.type == NoisePerlin ? glm::perlin(p) : glm::simplex(p);
+                }
+            }
+            benchSink += (uint64_t)sum;
+        }) * size / glmRows;
+
+        std::snprintf(line, sizeof(line), "glm::%s per cell, %dx%d", c.name, size, size);
+        report(line, glmSeconds * 1e3, "ms");
+        std::snprintf(line, sizeof(line), "fillNoise2D %s speedup", c.name);
+        report(line, glmSeconds / fillSeconds, "x");
+    }
+
+    NoiseSettings settings;
+    settings.type = NoiseSimplex;
+    settings.scale = 1.0f / 32.0f;
+    const int depth = benchSize(256, 32);
+    std::vector<float> volume((size_t)depth * depth * depth);
+    double volumeSeconds = bestTime(3, [&]()
+    {
+        fillNoise3D(volume.data(), depth, depth, depth, settings);
+    });
+    benchSink += (uint64_t)(volume[volume.size() / 2] * 1000.0f);
+
+    char line[96];
+    std::snprintf(line, sizeof(line), "fillNoise3D simplex, %d^3", depth);
+    report(line, volumeSeconds * 1e3, "ms");
+}
@@ -0,0 +1,148 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/noise.hpp>
+
+#include "Noise.h"
+
+namespace
+{
+    //Noise values are within [-1, 1]. The lanes run glm's formulas in glm's order, only FMA contraction and
+    //vectorized floor/division may round differently.
+    const float Tolerance = 1e-5f;
+
+    //glm, octave by octave, the way fractal2D/3D sum them.
+    float referenceNoise(const NoiseSettings& settings, const glm::vec3& p, bool is3D)
+    {
+        int octaves = settings.fractal == FractalNone ? 1 : settings.octaves;
+        float sum = 0.0f, amplitude = 1.0f, frequency = 1.0f, totalAmplitude = 0.0f;
+        for (int octave = 0; octave < octaves; octave++)
+        {
+            glm::vec3 q = p * frequency;
+            float n;
+            if (is3D) n = settings.type == NoisePerlin ? glm::perlin(q) : glm::simplex(q);
+            else n = settings.type == NoisePerlin ? glm::perlin(glm::vec2(q)) : glm::simplex(glm::vec2(q));
+
+            if (settings.fractal == FractalRidged) n = (1.0f - std::fabs(n)) * (1.0f - std::fabs(n));
+            sum += n * amplitude;
+            totalAmplitude += amplitude;
+            amplitude *= settings.gain;
+            frequency *= settings.lacunarity;
+        }
+        return settings.fractal == FractalNone ? sum : sum / totalAmplitude;
+    }
+
+    float worstError(const std::vector<float>& grid, int width, int height, int depth, const NoiseSettings& settings, bool is3D)
+    {
+        float worst = 0.0f;
+        for (int z = 0; z < depth; z++)
+        {
+            for (int y = 0; y < height; y++)
+            {
+                for (int x = 0; x < width; x++)
+                {
+                    glm::vec3 p = settings.offset + glm::vec3((float)x, (float)y, (float)z) * settings.scale;
+                    float error = std::fabs(grid[((size_t)z * height + y) * width + x] - referenceNoise(settings, p, is3D));
+                    worst = std::max(worst, error);
+                }
+            }
+        }
+        return worst;
+    }
+
+    NoiseSettings randomSettings(std::mt19937& generator, NoiseType type, FractalType fractal)
+    {
+        std::uniform_real_distribution<float> offset(-300.0f, 300.0f);
+        std::uniform_real_distribution<float> scale(0.01f, 0.5f);
+
+        NoiseSettings settings;
+        settings.type = type;
+        settings.fractal = fractal;
+        settings.octaves = fractal == FractalNone ? 1 : 5;
+        settings.offset = glm::vec3(offset(generator), offset(generator), offset(generator));
+        settings.scale = scale(generator);
+        return settings;
+    }
+}
+
+//Random grids of every noise and fractal type against glm, widths that leave a partial group of lanes at the end
+//of every row.
+TEST(noiseMatchesGlm)
+{
+    std::mt19937 generator(28);
+    const NoiseType types[] = { NoisePerlin, NoiseSimplex };
+    const FractalType fractals[] = { FractalNone, FractalFbm, FractalRidged };
+
+    for (NoiseType type : types)
+    {
+        for (FractalType fractal : fractals)
+        {
+            NoiseSettings settings = randomSettings(generator, type, fractal);
+            std::vector<float> grid(61 * 37);
+            fillNoise2D(grid.data(), 61, 37, settings);
+            CHECK(worstError(grid, 61, 37, 1, settings, false) <= Tolerance);
+            CHECK(std::fabs(sampleNoise2D(glm::vec2(settings.offset), settings) - grid[0]) <= Tolerance);
+
+            settings = randomSettings(generator, type, fractal);
+            grid.resize(19 * 13 * 11);
+            fillNoise3D(grid.data(), 19, 13, 11, settings);
+            CHECK(worstError(grid, 19, 13, 11, settings, true) <= Tolerance);
+            CHECK(std::fabs(sampleNoise3D(settings.offset, settings) - grid[0]) <= Tolerance);
+        }
+    }
+}
+
+//A big grid is split into row ranges over the threads. Filling it in tiles (offset moved to the tile's corner)
+//has to give the same values as one fill, so neither row ranges nor tiles leave seams.
+TEST(noiseTilesWithoutSeams)
+{
+    std::mt19937 generator(280);
+    NoiseSettings settings = randomSettings(generator, NoiseSimplex, FractalFbm);
+
+    //Sample positions exact in floats, so a tile's moved offset lands on the very same positions.
+    settings.offset = glm::floor(settings.offset);
+    settings.scale = 1.0f / 32.0f;
+
+    const int size = 512;
+    const int tileSize = 128;
+    std::vector<float> whole((size_t)size * size);
+    fillNoise2D(whole.data(), size, size, settings);
+
+    float worst = 0.0f;
+    std::vector<float> tile((size_t)tileSize * tileSize);
+    for (int tileY = 0; tileY < size; tileY += tileSize)
+    {
+        for (int tileX = 0; tileX < size; tileX += tileSize)
+        {
+            NoiseSettings tileSettings = settings;
+            tileSettings.offset = settings.offset + glm::vec3((float)tileX, (float)tileY, 0.0f) * settings.scale;
+            fillNoise2D(tile.data(), tileSize, tileSize, tileSettings);
+
+            for (int y = 0; y < tileSize; y++)
+            {
+                for (int x = 0; x < tileSize; x++)
+                {
+                    float error = std::fabs(tile[(size_t)y * tileSize + x] - whole[(size_t)(tileY + y) * size + tileX + x]);
+                    worst = std::max(worst, error);
+                }
+            }
+        }
+    }
+    CHECK(worst <= Tolerance);
+
+    //The whole grid against glm along the rows where parallelFor ranges meet.
+    float seamWorst = 0.0f;
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x += 7)
+        {
+            glm::vec3 p = settings.offset + glm::vec3((float)x, (float)y, 0.0f) * settings.scale;
+            seamWorst = std::max(seamWorst, std::fabs(whole[(size_t)y * size + x] - referenceNoise(settings, p, false)));
+        }
+    }
+    CHECK(seamWorst <= Tolerance);
+}
@@ -0,0 +1,112 @@
+#include "Test.h"
+
+#include <cstring>
+#include <vector>
+
+#include "JobSystem.h"
+#include "Random.h"
+
+namespace
+{
+    struct PhiloxVector
+    {
+        uint32_t counter[4];
+        uint32_t key[2];
+        uint32_t expected[4];
+    };
+
+    //philox4x32 10 from Random123's kat_vectors.
+    const PhiloxVector KnownAnswers[3] =
+    {
+        { { 0x00000000, 0x00000000, 0x00000000, 0x00000000 }, { 0x00000000, 0x00000000 }, { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+        { { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff }, { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+        { { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 }, { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } }
+    };
+
+    struct Fills
+    {
+        std::vector<float> linear;
+        std::vector<float> gauss;
+        std::vector<glm::vec3> spherical;
+
+        bool operator==(const Fills& other) const
+        {
+            return std::memcmp(linear.data(), other.linear.data(), linear.size() * sizeof(float)) == 0 &&
+                std::memcmp(gauss.data(), other.gauss.data(), gauss.size() * sizeof(float)) == 0 &&
+                std::memcmp(spherical.data(), other.spherical.data(), spherical.size() * sizeof(glm::vec3)) == 0;
+        }
+    };
+
+    //Counts that aren't a multiple of the grain sizes, or of the 16 words the batch functions generate per step.
+    Fills fill(uint64_t seed, uint32_t stream)
+    {
+        Fills fills;
+        fills.linear.resize(300001);
+        fills.gauss.resize(200001);
+        fills.spherical.resize(100003);
+        fillLinearRand(fills.linear.data(), (int)fills.linear.size(), seed, stream, -2.0f, 5.0f);
+        fillGaussRand(fills.gauss.data(), (int)fills.gauss.size(), seed, stream, 1.0f, 3.0f);
+        fillSphericalRand(fills.spherical.data(), (int)fills.spherical.size(), seed, stream, 2.0f);
+        return fills;
+    }
+}
+
+//The scalar block against the published vectors, and RandomStream's first words (counter and key 0) against the first.
+TEST(randomPhiloxKnownAnswers)
+{
+    for (const PhiloxVector& vector : KnownAnswers)
+    {
+        uint32_t output[4];
+        philox4x32(vector.counter, vector.key, output);
+        CHECK(std::memcmp(output, vector.expected, sizeof(output)) == 0);
+    }
+
+    RandomStream random(0, 0);
+    for (int i = 0; i < 4; i++) CHECK(random.nextUInt() == KnownAnswers[0].expected[i]);
+}
+
+//The batch functions (SIMD blocks) produce the same words as one value at a time from any starting position.
+TEST(randomBatchMatchesScalar)
+{
+    const uint64_t seed = 0x123456789abcdefull;
+    for (int start = 0; start < 5; start++)
+    {
+        RandomStream batch(seed, 7), scalar(seed, 7);
+        batch.seek(start);
+        scalar.seek(start);
+
+        std::vector<float> values(1001);
+        batch.linearRand(values.data(), (int)values.size(), 0.0f, 1.0f);
+
+        bool same = true;
+        for (float value : values) same = same && value == scalar.linearRand(0.0f, 1.0f);
+        CHECK(same);
+        CHECK(batch.position() == scalar.position());
+    }
+}
+
+//The parallel fills give the same bits with the job system stopped, one worker or seven, and different streams
+//give different values.
+TEST(randomFillsIndependentOfThreadCount)
+{
+    const uint64_t seed = 29;
+    Fills reference = fill(seed, 3);
+
+    const int workerCounts[2] = { 1, 7 };
+    for (int workers : workerCounts)
+    {
+        startJobSystem(workers);
+        Fills threaded = fill(seed, 3);
+        stopJobSystem();
+        CHECK(threaded == reference);
+    }
+
+    //Sequential reference for the linear fill, straight from one stream.
+    std::vector<float> sequential(reference.linear.size());
+    RandomStream random(seed, 3);
+    random.linearRand(sequential.data(), (int)sequential.size(), -2.0f, 5.0f);
+    CHECK(std::memcmp(sequential.data(), reference.linear.data(), sequential.size() * sizeof(float)) == 0);
+
+    Fills other = fill(seed, 4);
+    CHECK(!(other == reference));
+}
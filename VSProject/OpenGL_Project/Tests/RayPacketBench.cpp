@@ -0,0 +1,164 @@
+#include "Bench.h"
+
+#include <random>
+#include <vector>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtx/intersect.hpp>
+
+#include "RayPacket.h"
+
+namespace
+{
+    //Triangle soup filling a unit cube, plus rays from outside aimed at random points inside it.
+    struct RayScene
+    {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+        std::vector<glm::vec3> origins;
+        std::vector<glm::vec3> directions;
+    };
+
+    RayScene makeScene(int triangleCount, int rayCount)
+    {
+        std::mt19937 generator(26);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::uniform_real_distribution<float> offset(-0.02f, 0.02f);
+
+        RayScene scene;
+        for (int i = 0; i < triangleCount; i++)
+        {
+            glm::vec3 center(unit(generator), unit(generator), unit(generator));
+            for (int j = 0; j < 3; j++)
+            {
+                scene.positions.push_back(center + glm::vec3(offset(generator), offset(generator), offset(generator)));
+                scene.indices.push_back((unsigned int)(i * 3 + j));
+            }
+        }
+
+        for (int i = 0; i < rayCount; i++)
+        {
+            glm::vec3 origin(unit(generator) * 3.0f - 1.0f, unit(generator) * 3.0f - 1.0f, -1.0f);
+            glm::vec3 target(unit(generator), unit(generator), unit(generator));
+            scene.origins.push_back(origin);
+            scene.directions.push_back(glm::normalize(target - origin));
+        }
+
+        return scene;
+    }
+
+    //Closest hit the way the code did before packets, one glm::intersectRayTriangle per triangle.
+    int scalarClosest(const RayScene& scene, int ray, float& closest)
+    {
+        int hitTriangle = -1;
+        int triangleCount = (int)scene.indices.size() / 3;
+        for (int t = 0; t < triangleCount; t++)
+        {
+            glm::vec2 baryPosition;
+            float distance;
+            if (glm::intersectRayTriangle(scene.origins[ray], scene.directions[ray], scene.positions[scene.indices[t * 3]],
+                scene.positions[scene.indices[t * 3 + 1]], scene.positions[scene.indices[t * 3 + 2]], baryPosition, distance) &&
+                distance > 0.0f && distance < closest)
+            {
+                closest = distance;
+                hitTriangle = t;
+            }
+        }
+        return hitTriangle;
+    }
+}
+
+//One ray against 8 triangles at a time (intersectRayMesh) against the scalar glm loop, on the same mesh.
+BENCHMARK(rayAgainstTrianglePackets)
+{
+    const int triangleCount = benchSize(200000, 4000);
+    const int rayCount = benchSize(256, 32);
+    RayScene scene = makeScene(triangleCount, rayCount);
+
+    std::vector<int> scalarHits(rayCount);
+    std::vector<int> packetHits(rayCount);
+
+    double scalarSeconds = bestTime(3, [&]()
+    {
+        for (int r = 0; r < rayCount; r++)
+        {
+            float closest = 1e30f;
+            scalarHits[r] = scalarClosest(scene, r, closest);
+        }
+    });
+
+    double packetSeconds = bestTime(3, [&]()
+    {
+        for (int r = 0; r < rayCount; r++)
+        {
+            float closest = 1e30f;
+            glm::vec2 baryPosition;
+            packetHits[r] = intersectRayMesh(scene.origins[r], scene.directions[r], scene.positions.data(), scene.indices.data(), triangleCount, closest, baryPosition);
+        }
+    });
+
+    int mismatches = 0;
+    for (int r = 0; r < rayCount; r++) mismatches += scalarHits[r] != packetHits[r];
+
+    double tests = (double)triangleCount * rayCount;
+    report("glm::intersectRayTriangle", tests / scalarSeconds * 1e-6, "M tests/s");
+    report("intersectRayMesh (1 ray x 8 triangles)", tests / packetSeconds * 1e-6, "M tests/s");
+    report("speedup", scalarSeconds / packetSeconds, "x");
+    report("rays with a different closest triangle", mismatches, "rays");
+    benchSink += (uint64_t)packetHits[0];
+}
+
+//8 rays at a time against one triangle, same scene and the same scalar baseline.
+BENCHMARK(rayPacketsAgainstTriangle)
+{
+    const int triangleCount = benchSize(100000, 2000);
+    const int rayCount = benchSize(256, 32);
+    RayScene scene = makeScene(triangleCount, rayCount);
+
+    std::vector<RayPacket8> packets((rayCount + 7) / 8);
+    for (size_t p = 0; p < packets.size(); p++)
+    {
+        int count = rayCount - (int)p * 8 < 8 ? rayCount - (int)p * 8 : 8;
+        loadRayPacket(packets[p], &scene.origins[p * 8], &scene.directions[p * 8], count);
+    }
+
+    std::vector<float> scalarDistances(rayCount);
+    std::vector<float> packetDistances(packets.size() * 8);
+
+    double scalarSeconds = bestTime(3, [&]()
+    {
+        for (int r = 0; r < rayCount; r++)
+        {
+            scalarDistances[r] = 1e30f;
+            scalarClosest(scene, r, scalarDistances[r]);
+        }
+    });
+
+    double packetSeconds = bestTime(3, [&]()
+    {
+        for (size_t p = 0; p < packets.size(); p++)
+        {
+            RayHitPacket8 hits;
+            hits.distance = Float8(1e30f);
+            hits.u = Float8(0.0f);
+            hits.v = Float8(0.0f);
+
+            for (int t = 0; t < triangleCount; t++)
+            {
+                intersectRayPacketTriangle(packets[p], scene.positions[scene.indices[t * 3]], scene.positions[scene.indices[t * 3 + 1]],
+                    scene.positions[scene.indices[t * 3 + 2]], hits);
+            }
+            hits.distance.store(&packetDistances[p * 8]);
+        }
+    });
+
+    int mismatches = 0;
+    for (int r = 0; r < rayCount; r++) mismatches += glm::abs(scalarDistances[r] - packetDistances[r]) > 1e-4f;
+
+    double tests = (double)triangleCount * rayCount;
+    report("glm::intersectRayTriangle", tests / scalarSeconds * 1e-6, "M tests/s");
+    report("intersectRayPacketTriangle (8 rays x 1 triangle)", tests / packetSeconds * 1e-6, "M tests/s");
+    report("speedup", scalarSeconds / packetSeconds, "x");
+    report("rays with a different closest distance", mismatches, "rays");
+    benchSink += (uint64_t)packetDistances[0];
+}
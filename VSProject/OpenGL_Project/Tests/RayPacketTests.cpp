@@ -0,0 +1,47 @@
+#include "Test.h"
+
+#include <cmath>
+
+#include "RayPacket.h"
+
+namespace
+{
+    //count rays from inside a sphere around the world origin, so padding lanes (zero origin and direction)
+    //sit inside it too. Only the filled lanes may hit, each at the radius.
+    template<typename RayPacketT, typename RayHitPacketT>
+    bool onlyFilledLanesHit(int count)
+    {
+        const int width = decltype(RayPacketT::originX)::Width;
+
+        glm::vec3 origins[8], directions[8];
+        for (int i = 0; i < width; i++)
+        {
+            origins[i] = glm::vec3(0.0f);
+            directions[i] = glm::normalize(glm::vec3(1.0f, (float)i - 3.5f, 0.5f));
+        }
+
+        RayPacketT rays;
+        loadRayPacket(rays, origins, directions, count);
+
+        RayHitPacketT hits;
+        hits.distance = decltype(hits.distance)(100.0f);
+        hits.u = hits.v = decltype(hits.distance)(0.0f);
+        int bits = intersectRayPacketSphere(rays, glm::vec3(0.0f), 2.0f, hits);
+        if (bits != (1 << count) - 1) return false;
+
+        float distances[8];
+        hits.distance.store(distances);
+        for (int i = 0; i < width; i++)
+        {
+            float expected = i < count ? 2.0f : 100.0f;
+            if (std::fabs(distances[i] - expected) > 1e-4f) return false;
+        }
+        return true;
+    }
+}
+
+TEST(rayPacketSpherePaddingLanesMiss)
+{
+    for (int count = 1; count < 4; count++) CHECK((onlyFilledLanesHit<RayPacket4, RayHitPacket4>(count)));
+    for (int count = 1; count < 8; count++) CHECK((onlyFilledLanesHit<RayPacket8, RayHitPacket8>(count)));
+}
@@ -0,0 +1,111 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MockRenderBackend.h"
+#include "RenderCommands.h"
+
+namespace
+{
+    //One frame using every command type.
+    void recordFrame(CommandBuffer& commands, const IndirectBatch* batch)
+    {
+        const float model[16] = { 2.0f, 0, 0, 0, 0, 3.0f, 0, 0, 0, 0, 4.0f, 0, 0, 0, 0, 1.0f };
+
+        commands.clear(0.5f, 0.25f, 1.0f, 1.0f, GL_COLOR_BUFFER_BIT);
+        commands.viewport(0, 0, 1280, 720);
+        commands.useProgram(7);
+        commands.setUniformInt(2, 1);
+        commands.bindTexture(1, 12);
+        commands.bindVertexArray(3);
+        commands.setUniformMat4(4, model);
+        commands.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 24);
+        commands.drawIndirectBatch(batch, 1);
+        commands.copyBuffer(5, 6, 0, 16, 32);
+    }
+}
+
+//A recorded frame replays as the same calls in the same order, with the same arguments.
+TEST(renderCommandsReplayInOrder)
+{
+    const IndirectBatch* batch = (const IndirectBatch*)0x1000;
+
+    CommandBuffer commands;
+    recordFrame(commands, batch);
+
+    MockRenderBackend backend;
+    backend.buffers[5].resize(64, 1);
+    backend.buffers[6].resize(64, 0);
+    replayCommands(commands, backend);
+
+    char batchCall[64];
+    std::snprintf(batchCall, sizeof(batchCall), "drawIndirectBatch %p 1", (const void*)batch);
+
+    std::vector<std::string> expected =
+    {
+        "clear 0.5 0.25 1 1 16384",
+        "viewport 0 0 1280 720",
+        "useProgram 7",
+        "setUniformInt 2 1",
+        "bindTexture 1 12",
+        "bindVertexArray 3",
+        "setUniformMat4 4 2 3 4 1",
+        "drawElements 4 6 5125 24",
+        batchCall,
+        "copyBuffer 5 6 0 16 32"
+    };
+    CHECK(backend.calls == expected);
+    CHECK(backend.invalidCopies == 0);
+    CHECK(backend.buffers[6][15] == 0 && backend.buffers[6][16] == 1 && backend.buffers[6][47] == 1 && backend.buffers[6][48] == 0);
+}
+
+//Commands are 8 byte aligned records, every one padded to a multiple of 8.
+TEST(renderCommandsAreAligned)
+{
+    CommandBuffer commands;
+    recordFrame(commands, nullptr);
+
+    const unsigned char* p = commands.data();
+    const unsigned char* end = p + commands.size();
+    int count = 0;
+    bool aligned = true;
+    while (p < end)
+    {
+        const CommandHeader& header = *(const CommandHeader*)p;
+        aligned = aligned && header.size % 8 == 0 && (size_t)(p - commands.data()) % 8 == 0;
+        p += header.size;
+        count++;
+    }
+
+    CHECK(aligned);
+    CHECK(p == end);
+    CHECK(count == 10);
+}
+
+//After the first frame the arena has its working size, recording the same frame again doesn't grow it,
+//and reset really forgets the previous frame.
+TEST(renderCommandsReuseTheArena)
+{
+    CommandBuffer commands;
+    for (int i = 0; i < 100; i++) recordFrame(commands, nullptr);
+    size_t size = commands.size();
+
+    commands.reset();
+    for (int i = 0; i < 100; i++) recordFrame(commands, nullptr);
+    size_t capacity = commands.capacity();
+    CHECK(commands.size() == size);
+
+    for (int frame = 0; frame < 10; frame++)
+    {
+        commands.reset();
+        for (int i = 0; i < 100; i++) recordFrame(commands, nullptr);
+    }
+    CHECK(commands.capacity() == capacity);
+
+    commands.reset();
+    MockRenderBackend backend;
+    replayCommands(commands, backend);
+    CHECK(backend.calls.empty());
+}
@@ -0,0 +1,69 @@
+#include "Bench.h"
+
+#include <random>
+#include <vector>
+
+#include "SceneGraph.h"
+
+//200k nodes in 1000 trees of random shape, 5% of them moved every frame, against updating every node.
+//Added depth first, so building never sorts.
+BENCHMARK(sceneGraphUpdate)
+{
+    const int nodeCount = benchSize(200000, 20000);
+    const int treeSize = 200;
+    const int movedCount = nodeCount / 20;
+
+    std::mt19937 generator(34);
+    SceneGraph graph;
+    std::vector<int> path;
+    double buildSeconds = bestTime(1, [&]()
+    {
+        for (int i = 0; i < nodeCount; i++)
+        {
+            if (i % treeSize == 0)
+            {
+                path.clear();
+                path.push_back(graph.addNode(SceneGraph::NoParent));
+                continue;
+            }
+
+            //Child of a random node on the path to the last one added, which keeps subtree ranges in order.
+            path.resize(1 + generator() % path.size());
+            path.push_back(graph.addNode(path.back(), glm::vec3(0.1f, 0.0f, 0.0f)));
+        }
+        graph.update();
+    });
+
+    std::vector<int> moved(movedCount);
+    float angle = 0.0f;
+    auto moveNodes = [&]()
+    {
+        for (int i = 0; i < movedCount; i++) moved[i] = (int)(generator() % nodeCount);
+    };
+
+    moveNodes();
+    int updatedNodes = 0;
+    double movedSeconds = bestTime(20, [&]()
+    {
+        angle += 0.01f;
+        glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+        for (int node : moved) graph.setRotation(node, rotation);
+        graph.update();
+        updatedNodes = graph.updatedCount();
+    });
+
+    double allSeconds = bestTime(10, [&]()
+    {
+        angle += 0.01f;
+        glm::quat rotation = glm::angleAxis(angle, glm::vec3(0.0f, 0.0f, 1.0f));
+        for (int node = 0; node < nodeCount; node++) graph.setRotation(node, rotation);
+        graph.update();
+    });
+
+    benchSink += (uint64_t)graph.world(nodeCount - 1)[3].x;
+    report("build", buildSeconds * 1e3, "ms");
+    report("nodes recomputed for 5% moved", updatedNodes * 100.0 / nodeCount, "%");
+    report("update, 5% moved", movedSeconds * 1e3, "ms");
+    report("update, all moved", allSeconds * 1e3, "ms");
+    report("all / 5% moved", allSeconds / movedSeconds, "x");
+}
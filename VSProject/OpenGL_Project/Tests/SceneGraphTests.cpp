@@ -0,0 +1,147 @@
+#include "Test.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SceneGraph.h"
+
+namespace
+{
+    glm::quat randomRotation(std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        glm::vec3 axis(unit(generator), unit(generator), 1.0f);
+        return glm::angleAxis(angle(generator), glm::normalize(axis));
+    }
+
+    //Product of the local matrices up the parent chain, the way a pointer tree would compute it.
+    glm::mat4 bruteForceWorld(const SceneGraph& graph, int node)
+    {
+        glm::mat4 world(1.0f);
+        for (int n = node; n != SceneGraph::NoParent; n = graph.parent(n))
+        {
+            glm::mat4 local = glm::translate(glm::mat4(1.0f), graph.translation(n)) * glm::mat4_cast(graph.rotation(n)) *
+                glm::scale(glm::mat4(1.0f), graph.scale(n));
+            world = local * world;
+        }
+        return world;
+    }
+
+    bool matchesBruteForce(const SceneGraph& graph)
+    {
+        for (int node = 0; node < graph.nodeCount(); node++)
+        {
+            glm::mat4 expected = bruteForceWorld(graph, node);
+            const glm::mat4& world = graph.world(node);
+            for (int column = 0; column < 4; column++)
+            {
+                for (int row = 0; row < 4; row++)
+                {
+                    float difference = std::fabs(world[column][row] - expected[column][row]);
+                    if (difference > 1e-3f * (1.0f + std::fabs(expected[column][row]))) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool isAncestor(const SceneGraph& graph, int ancestor, int node)
+    {
+        for (int n = node; n != SceneGraph::NoParent; n = graph.parent(n))
+        {
+            if (n == ancestor) return true;
+        }
+        return false;
+    }
+}
+
+//Random moves, new nodes and reparenting, checked against the parent chain product after every update.
+//A round of moves alone recomputes exactly the moved subtrees.
+TEST(sceneGraphMatchesBruteForce)
+{
+    std::mt19937 generator(34);
+    std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+    std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+
+    SceneGraph graph;
+    for (int i = 0; i < 2000; i++)
+    {
+        int parent = i < 4 ? SceneGraph::NoParent : (int)(generator() % i);
+        graph.addNode(parent, glm::vec3(offset(generator), offset(generator), offset(generator)), randomRotation(generator), glm::vec3(scale(generator)));
+    }
+    graph.update();
+    CHECK(graph.updatedCount() == graph.nodeCount());
+    CHECK(matchesBruteForce(graph));
+
+    for (int round = 0; round < 20; round++)
+    {
+        std::vector<int> moved;
+        for (int i = 0; i < 50; i++)
+        {
+            int node = (int)(generator() % graph.nodeCount());
+            moved.push_back(node);
+            switch (generator() % 3)
+            {
+            case 0: graph.setTranslation(node, glm::vec3(offset(generator), offset(generator), offset(generator))); break;
+            case 1: graph.setRotation(node, randomRotation(generator)); break;
+            default: graph.setScale(node, glm::vec3(scale(generator))); break;
+            }
+        }
+
+        if (round % 2 == 1)
+        {
+            //Structural changes too: reparenting, with the cycles it must refuse, and new leaves.
+            for (int i = 0; i < 10; i++)
+            {
+                int node = (int)(generator() % graph.nodeCount());
+                int parent = i == 0 ? SceneGraph::NoParent : (int)(generator() % graph.nodeCount());
+                bool cycle = parent != SceneGraph::NoParent && isAncestor(graph, node, parent);
+                CHECK(graph.setParent(node, parent) == !cycle);
+                CHECK(graph.parent(node) == (cycle ? graph.parent(node) : parent));
+            }
+            for (int i = 0; i < 10; i++) graph.addNode((int)(generator() % graph.nodeCount()), glm::vec3(offset(generator)));
+            graph.update();
+        }
+        else
+        {
+            int expected = 0;
+            for (int node = 0; node < graph.nodeCount(); node++)
+            {
+                bool inMoved = false;
+                for (int m : moved) inMoved = inMoved || isAncestor(graph, m, node);
+                expected += inMoved;
+            }
+            graph.update();
+            CHECK(graph.updatedCount() == expected);
+        }
+        CHECK(matchesBruteForce(graph));
+    }
+
+    graph.update();
+    CHECK(graph.updatedCount() == 0);
+}
+
+//A tree added depth first stays in order: its subtree ranges are kept up to date without sorting, so a move
+//deep inside only recomputes that subtree.
+TEST(sceneGraphDepthFirstAdds)
+{
+    SceneGraph graph;
+    int root = graph.addNode(SceneGraph::NoParent);
+    int arm = graph.addNode(root, glm::vec3(1.0f, 0.0f, 0.0f));
+    int hand = graph.addNode(arm, glm::vec3(1.0f, 0.0f, 0.0f));
+    graph.addNode(hand, glm::vec3(0.5f, 0.0f, 0.0f));
+    int leg = graph.addNode(root, glm::vec3(0.0f, -1.0f, 0.0f));
+    graph.addNode(leg, glm::vec3(0.0f, -1.0f, 0.0f));
+    graph.update();
+    CHECK(matchesBruteForce(graph));
+
+    graph.setTranslation(arm, glm::vec3(2.0f, 0.0f, 0.0f));
+    graph.update();
+    CHECK(graph.updatedCount() == 3);
+    CHECK(matchesBruteForce(graph));
+    CHECK(std::fabs(graph.world(hand)[3].x - 3.0f) < 1e-6f);
+}
@@ -0,0 +1,109 @@
+#include "Bench.h"
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "JobSystem.h"
+#include "Skinning.h"
+
+namespace
+{
+    //Thread counts from 1 up to the core count, doubling.
+    std::vector<int> threadCounts()
+    {
+        int cores = (int)std::thread::hardware_concurrency();
+        if (cores < 1) cores = 1;
+
+        std::vector<int> counts;
+        for (int threads = 1; threads < cores; threads *= 2) counts.push_back(threads);
+        counts.push_back(cores);
+        return counts;
+    }
+}
+
+//A crowd of skinned meshes written in the 16 byte vertex (half position, unorm8 color, unorm16 texture
+//coordinate), both methods, from 1 thread to every core.
+BENCHMARK(skinningScaling)
+{
+    const int meshCount = benchSize(256, 4);
+    const int vertexCount = benchSize(4096, 1000);
+    const int boneCount = 64;
+
+    std::mt19937 generator(31);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> positive(0.0f, 1.0f);
+    std::uniform_int_distribution<int> bone(0, boneCount - 1);
+
+    std::vector<glm::mat4> skinMatrices;
+    for (int b = 0; b < boneCount; b++)
+    {
+        glm::vec3 axis = glm::normalize(glm::vec3(unit(generator), unit(generator), 1.0f));
+        glm::vec3 translation(unit(generator), unit(generator), unit(generator));
+        skinMatrices.push_back(glm::translate(glm::mat4(1.0f), translation) * glm::rotate(glm::mat4(1.0f), unit(generator) * 3.0f, axis));
+    }
+    std::vector<BoneMatrix> matrices(boneCount);
+    std::vector<BoneDualQuat> dualQuats(boneCount);
+    makeBoneMatrices(skinMatrices.data(), boneCount, matrices.data());
+    makeBoneDualQuats(skinMatrices.data(), boneCount, dualQuats.data());
+
+    const VertexAttributeSource sources[3] =
+    {
+        { 0, 3, 0, VertexHalf },
+        { 1, 3, 3, VertexUnorm8 },
+        { 2, 2, 6, VertexUnorm16 }
+    };
+
+    std::vector<SkinnedMesh> meshes(meshCount);
+    for (SkinnedMesh& mesh : meshes)
+    {
+        std::vector<float> vertices;
+        std::vector<uint16_t> indices;
+        std::vector<float> weights;
+        for (int v = 0; v < vertexCount; v++)
+        {
+            for (int f = 0; f < 8; f++) vertices.push_back(f < 3 ? unit(generator) : positive(generator));
+
+            float w0 = positive(generator), w1 = 1.0f - w0;
+            float vertexWeights[4] = { w0 * 0.7f, w1 * 0.7f, 0.2f, 0.1f };
+            for (int k = 0; k < 4; k++)
+            {
+                indices.push_back((uint16_t)bone(generator));
+                weights.push_back(vertexWeights[k]);
+            }
+        }
+        makeSkinnedMesh(vertices.data(), vertexCount, 8, sources, 3, 0, indices.data(), weights.data(), mesh);
+    }
+
+    std::vector<unsigned char> output((size_t)meshCount * vertexCount * meshes[0].layout.stride);
+    const char* names[2] = { "linear blend", "dual quaternion" };
+    double base[2] = {};
+    for (int threads : threadCounts())
+    {
+        startJobSystem(threads - 1);
+
+        for (int method = 0; method < 2; method++)
+        {
+            std::vector<SkinningJob> jobs;
+            for (int m = 0; m < meshCount; m++)
+            {
+                jobs.push_back({ &meshes[m], method == 0 ? SkinLinearBlend : SkinDualQuaternion, matrices.data(), dualQuats.data(),
+                    &output[(size_t)m * vertexCount * meshes[m].layout.stride] });
+            }
+
+            double seconds = bestTime(5, [&]() { skinMeshes(jobs.data(), meshCount); });
+            if (threads == 1) base[method] = seconds;
+
+            std::string prefix = std::to_string(threads) + (threads == 1 ? " thread, " : " threads, ") + names[method];
+            report(prefix.c_str(), (double)meshCount * vertexCount / seconds * 1e-6, "M vertices/s");
+            report((prefix + " speedup").c_str(), base[method] / seconds, "x");
+        }
+
+        stopJobSystem();
+    }
+
+    benchSink += output[output.size() / 2];
+}
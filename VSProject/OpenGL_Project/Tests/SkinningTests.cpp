@@ -0,0 +1,223 @@
+#include "Test.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtx/dual_quaternion.hpp>
+
+#include "Skinning.h"
+
+namespace
+{
+    const int BoneCount = 12;
+
+    //Position, color, texture coordinate, like createSquare.
+    const int FloatsPerVertex = 8;
+
+    struct TestSkeleton
+    {
+        std::vector<glm::mat4> skinMatrices;
+        std::vector<BoneMatrix> matrices;
+        std::vector<BoneDualQuat> dualQuats;
+    };
+
+    struct TestMesh
+    {
+        int vertexCount;
+        std::vector<float> vertices;
+        std::vector<uint16_t> boneIndices;
+        std::vector<float> boneWeights;
+    };
+
+    //Rigid bones, so linear blending and dual quaternions both apply.
+    TestSkeleton makeSkeleton(std::mt19937& generator)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> angle(-3.0f, 3.0f);
+
+        TestSkeleton skeleton;
+        for (int b = 0; b < BoneCount; b++)
+        {
+            glm::vec3 axis = glm::normalize(glm::vec3(unit(generator), unit(generator), unit(generator)) + glm::vec3(0.0f, 0.0f, 1e-3f));
+            glm::vec3 translation(unit(generator) * 4.0f, unit(generator) * 4.0f, unit(generator) * 4.0f);
+            skeleton.skinMatrices.push_back(glm::translate(glm::mat4(1.0f), translation) * glm::rotate(glm::mat4(1.0f), angle(generator), axis));
+        }
+
+        skeleton.matrices.resize(BoneCount);
+        skeleton.dualQuats.resize(BoneCount);
+        makeBoneMatrices(skeleton.skinMatrices.data(), BoneCount, skeleton.matrices.data());
+        makeBoneDualQuats(skeleton.skinMatrices.data(), BoneCount, skeleton.dualQuats.data());
+        return skeleton;
+    }
+
+    //Up to 4 random influences per vertex, some of them unused.
+    TestMesh makeMesh(std::mt19937& generator, int vertexCount)
+    {
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> positive(0.0f, 1.0f);
+        std::uniform_int_distribution<int> bone(0, BoneCount - 1);
+        std::uniform_int_distribution<int> influences(1, 4);
+
+        TestMesh mesh;
+        mesh.vertexCount = vertexCount;
+        for (int v = 0; v < vertexCount; v++)
+        {
+            float vertex[FloatsPerVertex] =
+            {
+                unit(generator) * 2.0f, unit(generator) * 2.0f, unit(generator) * 2.0f,
+                positive(generator), positive(generator), positive(generator),
+                positive(generator), positive(generator)
+            };
+            mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + FloatsPerVertex);
+
+            int used = influences(generator);
+            float weights[4] = {};
+            float sum = 0.0f;
+            for (int k = 0; k < used; k++)
+            {
+                weights[k] = positive(generator) + 0.05f;
+                sum += weights[k];
+            }
+            for (int k = 0; k < 4; k++)
+            {
+                mesh.boneIndices.push_back((uint16_t)bone(generator));
+                mesh.boneWeights.push_back(weights[k] / sum);
+            }
+        }
+        return mesh;
+    }
+
+    glm::vec3 bindPosition(const TestMesh& mesh, int v)
+    {
+        const float* p = &mesh.vertices[(size_t)v * FloatsPerVertex];
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+
+    //Weighted sum of the full 4x4 matrices.
+    glm::vec3 linearBlendReference(const TestMesh& mesh, const TestSkeleton& skeleton, int v)
+    {
+        glm::mat4 blended(0.0f);
+        for (int k = 0; k < 4; k++) blended += skeleton.skinMatrices[mesh.boneIndices[v * 4 + k]] * mesh.boneWeights[v * 4 + k];
+        return glm::vec3(blended * glm::vec4(bindPosition(mesh, v), 1.0f));
+    }
+
+    //glm's dual quaternions, blended in the first influence's hemisphere and normalized.
+    glm::vec3 dualQuaternionReference(const TestMesh& mesh, const TestSkeleton& skeleton, int v)
+    {
+        glm::dualquat bones[4];
+        for (int k = 0; k < 4; k++)
+        {
+            const glm::mat4& m = skeleton.skinMatrices[mesh.boneIndices[v * 4 + k]];
+            bones[k] = glm::dualquat(glm::normalize(glm::quat_cast(glm::mat3(m))), glm::vec3(m[3]));
+        }
+
+        glm::dualquat blended(glm::quat(0.0f, 0.0f, 0.0f, 0.0f), glm::quat(0.0f, 0.0f, 0.0f, 0.0f));
+        for (int k = 0; k < 4; k++)
+        {
+            float weight = mesh.boneWeights[v * 4 + k];
+            if (glm::dot(bones[0].real, bones[k].real) < 0.0f) weight = -weight;
+            blended.real = blended.real + bones[k].real * weight;
+            blended.dual = blended.dual + bones[k].dual * weight;
+        }
+        return glm::normalize(blended) * bindPosition(mesh, v);
+    }
+
+    const VertexAttributeSource FloatSources[3] =
+    {
+        { 0, 3, 0, VertexFloat },
+        { 1, 3, 3, VertexUnorm8 },
+        { 2, 2, 6, VertexUnorm16 }
+    };
+
+    //The 16 byte vertex: half position, unorm8 color, unorm16 texture coordinate.
+    const VertexAttributeSource PackedSources[3] =
+    {
+        { 0, 3, 0, VertexHalf },
+        { 1, 3, 3, VertexUnorm8 },
+        { 2, 2, 6, VertexUnorm16 }
+    };
+
+    //Skins mesh with both methods through skinMeshes and checks every position against the references within
+    //tolerance (relative for halves, absolute otherwise), and every other byte against the packed bind pose.
+    bool skinsLikeReference(const TestMesh& source, const TestSkeleton& skeleton, const VertexAttributeSource* sources)
+    {
+        SkinnedMesh mesh;
+        if (!makeSkinnedMesh(source.vertices.data(), source.vertexCount, FloatsPerVertex, sources, 3, 0,
+            source.boneIndices.data(), source.boneWeights.data(), mesh)) return false;
+
+        int stride = mesh.layout.stride;
+        std::vector<unsigned char> linear((size_t)mesh.vertexCount * stride), dual((size_t)mesh.vertexCount * stride);
+        SkinningJob jobs[2] =
+        {
+            { &mesh, SkinLinearBlend, skeleton.matrices.data(), nullptr, linear.data() },
+            { &mesh, SkinDualQuaternion, nullptr, skeleton.dualQuats.data(), dual.data() }
+        };
+        skinMeshes(jobs, 2);
+
+        bool half = sources[0].format == VertexHalf;
+        int positionBytes = half ? 6 : 12;
+        for (int v = 0; v < mesh.vertexCount; v++)
+        {
+            glm::vec3 expected[2] = { linearBlendReference(source, skeleton, v), dualQuaternionReference(source, skeleton, v) };
+            const unsigned char* outputs[2] = { &linear[(size_t)v * stride], &dual[(size_t)v * stride] };
+
+            for (int method = 0; method < 2; method++)
+            {
+                const unsigned char* vertex = outputs[method];
+                for (int c = 0; c < 3; c++)
+                {
+                    float value;
+                    if (half)
+                    {
+                        uint16_t bits;
+                        std::memcpy(&bits, vertex + c * 2, sizeof(bits));
+                        value = glm::unpackHalf1x16(bits);
+                    }
+                    else std::memcpy(&value, vertex + c * 4, sizeof(value));
+
+                    float tolerance = half ? std::fabs(expected[method][c]) * (1.0f / 1024.0f) + 1e-4f : 1e-4f;
+                    if (std::fabs(value - expected[method][c]) > tolerance) return false;
+                }
+
+                const unsigned char* bind = &mesh.packedVertices[(size_t)v * stride];
+                if (std::memcmp(vertex + positionBytes, bind + positionBytes, stride - positionBytes) != 0) return false;
+            }
+        }
+        return true;
+    }
+}
+
+//Float positions keep the comparison to float rounding, half ones check the packed 16 byte vertex. The vertex
+//counts leave partial lanes and a partial chunk.
+TEST(skinningMatchesGlm)
+{
+    std::mt19937 generator(31);
+    TestSkeleton skeleton = makeSkeleton(generator);
+    TestMesh mesh = makeMesh(generator, 2049);
+
+    CHECK(skinsLikeReference(mesh, skeleton, FloatSources));
+    CHECK(skinsLikeReference(mesh, skeleton, PackedSources));
+
+    TestMesh small = makeMesh(generator, 3);
+    CHECK(skinsLikeReference(small, skeleton, PackedSources));
+}
+
+TEST(skinningPackedLayout)
+{
+    std::mt19937 generator(310);
+    TestMesh source = makeMesh(generator, 4);
+
+    SkinnedMesh mesh;
+    CHECK(makeSkinnedMesh(source.vertices.data(), 4, FloatsPerVertex, PackedSources, 3, 0, source.boneIndices.data(), source.boneWeights.data(), mesh));
+    CHECK(mesh.layout.stride == 16);
+    CHECK(mesh.packedVertices.size() == 4 * 16);
+
+    //Positions have to stay 3 floats or halves.
+    const VertexAttributeSource quantized[1] = { { 0, 3, 0, VertexSnorm16 } };
+    CHECK(!makeSkinnedMesh(source.vertices.data(), 4, FloatsPerVertex, quantized, 1, 0, source.boneIndices.data(), source.boneWeights.data(), mesh));
+}
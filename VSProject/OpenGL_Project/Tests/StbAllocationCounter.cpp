@@ -0,0 +1,58 @@
+#include "StbAllocationCounter.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    //Every block starts with its size, free isn't told it. 16 bytes keep the block as aligned as malloc's.
+    const size_t HeaderBytes = 16;
+
+    void* countedAlloc(void* user, size_t size)
+    {
+        StbAllocationCounter& counter = *(StbAllocationCounter*)user;
+        unsigned char* block = (unsigned char*)std::malloc(size + HeaderBytes);
+        if (block == nullptr) return nullptr;
+
+        *(size_t*)block = size;
+        counter.allocations++;
+        counter.currentBytes += size;
+        if (counter.currentBytes > counter.peakBytes) counter.peakBytes = counter.currentBytes;
+        return block + HeaderBytes;
+    }
+
+    void countedFree(void* user, void* p)
+    {
+        if (p == nullptr) return;
+        StbAllocationCounter& counter = *(StbAllocationCounter*)user;
+        unsigned char* block = (unsigned char*)p - HeaderBytes;
+        counter.currentBytes -= *(size_t*)block;
+        std::free(block);
+    }
+
+    void* countedRealloc(void* user, void* p, size_t oldSize, size_t newSize)
+    {
+        if (p == nullptr) return countedAlloc(user, newSize);
+
+        //Both blocks count while the copy is made, like a realloc that has to move.
+        void* moved = countedAlloc(user, newSize);
+        if (moved == nullptr) return nullptr;
+        std::memcpy(moved, p, oldSize < newSize ? oldSize : newSize);
+        countedFree(user, p);
+        return moved;
+    }
+}
+
+StbAllocationCounter::StbAllocationCounter()
+{
+    allocator.alloc = countedAlloc;
+    allocator.realloc = countedRealloc;
+    allocator.free = countedFree;
+    allocator.user = this;
+    previous = stbi_set_allocator_thread(&allocator);
+}
+
+StbAllocationCounter::~StbAllocationCounter()
+{
+    stbi_set_allocator_thread(previous);
+}
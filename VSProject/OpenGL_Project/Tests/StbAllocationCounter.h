@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+
+#include "stb_image.h"
+
+//Counts what the application's stb_image build allocates on this thread while it exists
+//(stbi_set_allocator_thread), and restores the allocator it replaced afterwards.
+class StbAllocationCounter
+{
+public:
+    StbAllocationCounter();
+    ~StbAllocationCounter();
+
+    StbAllocationCounter(const StbAllocationCounter&) = delete;
+    StbAllocationCounter& operator=(const StbAllocationCounter&) = delete;
+
+    int allocations = 0;        //Allocations and reallocations.
+    size_t currentBytes = 0;
+    size_t peakBytes = 0;
+
+private:
+    stbi_allocator allocator;
+    const stbi_allocator* previous;
+};
@@ -0,0 +1,3 @@
+//stb_image for the engine sources and the image benchmarks, built the way main.cpp builds it.
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
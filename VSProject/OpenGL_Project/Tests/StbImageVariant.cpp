@@ -0,0 +1,59 @@
+#include "ImageDecoders.h"
+
+//Compiled once per variant, see CMakeLists.txt: STB_VARIANT is the namespace the whole of stb_image.h goes into,
+//STB_VARIANT_DECODER the function that hands it out and STB_VARIANT_NAME its name in the results. The other
+//switches (STBI_NO_SIMD...) come from the compile definitions too, and the include path decides which
+//stb_image.h it is.
+
+//Everything stb_image.h includes, so its own includes inside the namespace find them done already.
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+namespace STB_VARIANT
+{
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+    static unsigned char* load(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels)
+    {
+        return stbi_load_from_memory(data, size, x, y, channels, desiredChannels);
+    }
+
+    static unsigned short* load16(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels)
+    {
+        return stbi_load_16_from_memory(data, size, x, y, channels, desiredChannels);
+    }
+
+    static float* loadf(const unsigned char* data, int size, int* x, int* y, int* channels, int desiredChannels)
+    {
+        return stbi_loadf_from_memory(data, size, x, y, channels, desiredChannels);
+    }
+
+    static char* inflate(const char* data, int size, int* outSize)
+    {
+        return stbi_zlib_decode_malloc(data, size, outSize);
+    }
+}
+
+const ImageDecoder& STB_VARIANT_DECODER()
+{
+    static const ImageDecoder decoder = { STB_VARIANT_NAME, STB_VARIANT::load, STB_VARIANT::load16, STB_VARIANT::loadf, STB_VARIANT::inflate, STB_VARIANT::stbi_image_free };
+    return decoder;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+//Unit tests for the engine code that runs without a GL context.
+//Every TEST(name) is run by OpenGL_Project_Tests, or only those whose name contains one of its arguments.
+//A failed CHECK reports and carries on, the executable fails when any check did.
+
+typedef void (*TestFunction)();
+
+struct TestRegistration
+{
+    TestRegistration(const char* name, TestFunction function);
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistration name##Registration(#name, name); \
+    static void name()
+
+void reportFailure(const char* file, int line, const char* expression);
+
+#define CHECK(expression) \
+    do { if (!(expression)) reportFailure(__FILE__, __LINE__, #expression); } while (0)
@@ -0,0 +1,59 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    struct Test
+    {
+        const char* name;
+        TestFunction function;
+    };
+
+    //Function local so registrations from other files can't run before it is constructed.
+    std::vector<Test>& tests()
+    {
+        static std::vector<Test> list;
+        return list;
+    }
+
+    int failures = 0;
+}
+
+TestRegistration::TestRegistration(const char* name, TestFunction function)
+{
+    tests().push_back({ name, function });
+}
+
+void reportFailure(const char* file, int line, const char* expression)
+{
+    std::printf("    %s(%d): CHECK(%s) failed\n", file, line, expression);
+    std::fflush(stdout);
+    failures++;
+}
+
+int main(int argc, char** argv)
+{
+    int run = 0;
+    int failed = 0;
+
+    for (const Test& test : tests())
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) selected = selected || std::strstr(test.name, argv[i]) != nullptr;
+        if (!selected) continue;
+
+        std::printf("%s\n", test.name);
+        std::fflush(stdout);
+
+        int before = failures;
+        test.function();
+        run++;
+        if (failures != before) failed++;
+    }
+
+    std::printf("%d of %d tests passed\n", run - failed, run);
+    return failed == 0 ? 0 : 1;
+}
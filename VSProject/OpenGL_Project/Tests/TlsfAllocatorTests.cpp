@@ -0,0 +1,163 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "TlsfAllocator.h"
+
+namespace
+{
+    struct Live
+    {
+        AllocationHandle handle;
+        uint32_t size;
+        uint32_t tag;
+    };
+
+    //Checks the allocator against what the test handed out: every allocation inside the capacity, none
+    //overlapping, the totals and the largest hole the same as recounted from the offsets, and every
+    //allocation's units (in memory, moved the way defragment said) still holding its own tag.
+    bool consistent(const TlsfAllocator& allocator, const std::vector<Live>& live, const std::vector<uint32_t>& memory)
+    {
+        std::vector<std::pair<uint32_t, uint32_t> > ranges;
+        uint32_t used = 0;
+        for (const Live& l : live)
+        {
+            if (!allocator.valid(l.handle) || allocator.size(l.handle) != l.size) return false;
+            uint32_t offset = allocator.offset(l.handle);
+            if (offset + l.size > allocator.capacity()) return false;
+            if (memory[offset] != l.tag || memory[offset + l.size - 1] != l.tag) return false;
+            ranges.push_back(std::make_pair(offset, l.size));
+            used += l.size;
+        }
+        std::sort(ranges.begin(), ranges.end());
+
+        uint32_t largestGap = 0;
+        uint32_t end = 0;
+        for (size_t i = 0; i < ranges.size(); i++)
+        {
+            if (ranges[i].first < end) return false;
+            largestGap = std::max(largestGap, ranges[i].first - end);
+            end = ranges[i].first + ranges[i].second;
+        }
+        largestGap = std::max(largestGap, allocator.capacity() - end);
+
+        return allocator.usedSpace() == used && allocator.allocationCount() == (int)live.size() && allocator.largestFreeBlock() == largestGap;
+    }
+
+    void applyMoves(std::vector<uint32_t>& memory, const std::vector<AllocationMove>& moves)
+    {
+        for (const AllocationMove& move : moves) std::memmove(&memory[move.to], &memory[move.from], move.size * sizeof(uint32_t));
+    }
+}
+
+//Random allocations and releases with a partial defragment now and then, checked after every step.
+//At the end a full defragment has to leave everything packed at the start.
+TEST(tlsfRandomAllocateReleaseDefragment)
+{
+    const uint32_t capacity = 1 << 16;
+
+    std::mt19937 generator(40);
+    TlsfAllocator allocator(capacity);
+    std::vector<uint32_t> memory(capacity, 0);
+    std::vector<Live> live;
+    std::vector<AllocationMove> moves;
+
+    uint32_t nextTag = 1;
+    int failedSteps = 0;
+    int failedAllocations = 0;
+    for (int step = 0; step < 20000; step++)
+    {
+        //Allocating gets less likely as the allocator fills, so it hovers around half full and still runs out now and then.
+        uint32_t choice = generator() % 16;
+        bool allocate = generator() % capacity >= allocator.usedSpace() / 2 + capacity / 4;
+        if (choice == 15)
+        {
+            moves.clear();
+            uint32_t moved = allocator.defragment(1 + generator() % 4096, moves);
+
+            //Every move goes down, and the units add up to what defragment returned.
+            uint32_t total = 0;
+            bool down = true;
+            for (const AllocationMove& move : moves)
+            {
+                total += move.size;
+                down = down && move.to < move.from;
+            }
+            if (total != moved || !down) failedSteps++;
+            applyMoves(memory, moves);
+        }
+        else if (allocate || live.empty())
+        {
+            //Mostly small sizes with the odd big one, like meshes.
+            uint32_t size = 1 + (generator() % 16 == 0 ? generator() % 8192 : generator() % 64);
+            AllocationHandle handle = allocator.allocate(size);
+            if (handle == NullAllocation)
+            {
+                //Only when no free block is big enough.
+                if (allocator.largestFreeBlock() >= size) failedSteps++;
+                failedAllocations++;
+                continue;
+            }
+
+            uint32_t tag = nextTag++;
+            std::fill(memory.begin() + allocator.offset(handle), memory.begin() + allocator.offset(handle) + size, tag);
+            live.push_back({ handle, size, tag });
+        }
+        else
+        {
+            size_t index = generator() % live.size();
+            allocator.release(live[index].handle);
+            if (allocator.valid(live[index].handle)) failedSteps++;
+            live[index] = live.back();
+            live.pop_back();
+        }
+
+        if (!consistent(allocator, live, memory)) failedSteps++;
+    }
+
+    CHECK(failedSteps == 0);
+    CHECK(failedAllocations > 0);
+    CHECK(!live.empty());
+
+    int calls = 0;
+    for (;;)
+    {
+        moves.clear();
+        if (allocator.defragment(0xffffffffu, moves) == 0) break;
+        applyMoves(memory, moves);
+        calls++;
+    }
+
+    CHECK(calls == 1);
+    CHECK(allocator.compact());
+    CHECK(consistent(allocator, live, memory));
+    CHECK(allocator.largestFreeBlock() == capacity - allocator.usedSpace());
+}
+
+//A hole that fits exactly is reused, releasing everything merges back into one free block.
+TEST(tlsfReleaseMergesNeighbours)
+{
+    TlsfAllocator allocator(1000);
+    AllocationHandle a = allocator.allocate(100);
+    AllocationHandle b = allocator.allocate(200);
+    AllocationHandle c = allocator.allocate(300);
+    CHECK(allocator.largestFreeBlock() == 400);
+
+    allocator.release(b);
+    AllocationHandle d = allocator.allocate(200);
+    CHECK(allocator.offset(d) == 100);
+    CHECK(!allocator.valid(b));
+
+    CHECK(allocator.allocate(401) == NullAllocation);
+    CHECK(allocator.allocate(0) == NullAllocation);
+
+    allocator.release(a);
+    allocator.release(c);
+    allocator.release(d);
+    CHECK(allocator.usedSpace() == 0);
+    CHECK(allocator.largestFreeBlock() == 1000);
+    CHECK(allocator.compact());
+}
@@ -0,0 +1,182 @@
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <glm/gtc/packing.hpp>
+
+#include "VertexPacking.h"
+
+namespace
+{
+    //The decode the shader's octahedral comment describes.
+    glm::vec3 decodeOctahedral(float ex, float ey)
+    {
+        glm::vec3 n(ex, ey, 1.0f - std::fabs(ex) - std::fabs(ey));
+        if (n.z < 0.0f)
+        {
+            float x = (1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+            float y = (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+            n.x = x;
+            n.y = y;
+        }
+        return glm::normalize(n);
+    }
+}
+
+//Every finite half converts back to itself, and random floats round to the nearest half (ties to even), also
+//through denormals, overflow to infinity and NaN. Counts that aren't a multiple of 8 cover the scalar tail.
+TEST(vertexPackingHalfRoundTrip)
+{
+    std::vector<float> input;
+    std::vector<uint16_t> expected;
+    for (uint32_t h = 0; h < 0x10000; h++)
+    {
+        if ((h & 0x7c00) == 0x7c00) continue;
+        input.push_back(glm::unpackHalf1x16((uint16_t)h));
+        expected.push_back((uint16_t)h);
+    }
+
+    std::vector<uint16_t> output(input.size());
+    packHalfBulk(input.data(), output.data(), (int)input.size());
+    CHECK(std::memcmp(output.data(), expected.data(), expected.size() * sizeof(uint16_t)) == 0);
+
+    //Nearest representable half: the error is at most half a step of the half's exponent.
+    std::mt19937 generator(30);
+    std::uniform_real_distribution<float> exponent(-26.0f, 16.0f);
+    std::uniform_real_distribution<float> mantissa(1.0f, 2.0f);
+    input.clear();
+    for (int i = 0; i < 100003; i++) input.push_back(std::ldexp(mantissa(generator), (int)exponent(generator)) * (i & 1 ? -1.0f : 1.0f));
+    output.resize(input.size());
+    packHalfBulk(input.data(), output.data(), (int)input.size());
+
+    bool nearest = true;
+    for (size_t i = 0; i < input.size(); i++)
+    {
+        float value = glm::unpackHalf1x16(output[i]);
+        float magnitude = std::fabs(input[i]);
+        if (magnitude >= 65520.0f)
+        {
+            nearest = nearest && std::isinf(value) && (value < 0.0f) == (input[i] < 0.0f);
+            continue;
+        }
+
+        //Spacing of halves around the input: 2^(e - 10), denormals share the smallest one.
+        int e;
+        std::frexp(magnitude, &e);
+        float spacing = std::ldexp(1.0f, std::max(e - 1, -14) - 10);
+        nearest = nearest && std::fabs(value - input[i]) <= spacing * 0.5f;
+    }
+    CHECK(nearest);
+
+    float special[3] = { INFINITY, -INFINITY, NAN };
+    uint16_t packed[3];
+    packHalfBulk(special, packed, 3);
+    CHECK(packed[0] == 0x7c00 && packed[1] == 0xfc00 && (packed[2] & 0x7c00) == 0x7c00 && (packed[2] & 0x3ff) != 0);
+}
+
+//Quantized values decode to within half a step of the clamped input.
+TEST(vertexPackingNormalizedRoundTrip)
+{
+    std::mt19937 generator(300);
+    std::uniform_real_distribution<float> value(-1.25f, 1.25f);
+    std::vector<float> input(4099);
+    for (float& v : input) v = value(generator);
+    input[0] = 0.0f;
+    input[1] = 1.0f;
+    input[2] = -1.0f;
+
+    int count = (int)input.size();
+    std::vector<uint8_t> unorm8(count);
+    std::vector<uint16_t> unorm16(count);
+    std::vector<int16_t> snorm16(count);
+    packUnorm8Bulk(input.data(), unorm8.data(), count);
+    packUnorm16Bulk(input.data(), unorm16.data(), count);
+    packSnorm16Bulk(input.data(), snorm16.data(), count);
+
+    float worst8 = 0.0f, worst16 = 0.0f, worstSigned = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        float unit = glm::clamp(input[i], 0.0f, 1.0f);
+        float signedUnit = glm::clamp(input[i], -1.0f, 1.0f);
+        worst8 = std::max(worst8, std::fabs(unorm8[i] / 255.0f - unit));
+        worst16 = std::max(worst16, std::fabs(unorm16[i] / 65535.0f - unit));
+        worstSigned = std::max(worstSigned, std::fabs(snorm16[i] / 32767.0f - signedUnit));
+    }
+    CHECK(worst8 <= 0.5f / 255.0f + 1e-7f);
+    CHECK(worst16 <= 0.5f / 65535.0f + 1e-7f);
+    CHECK(worstSigned <= 0.5f / 32767.0f + 1e-7f);
+    CHECK(unorm8[1] == 255 && unorm16[1] == 65535 && snorm16[1] == 32767 && snorm16[2] == -32767);
+}
+
+//Random unit normals, the axes and the octahedron's folded edges through encode and snorm16, decoded as the
+//shader does. Both the 4 wide loop and the scalar tail run.
+TEST(vertexPackingOctahedralRoundTrip)
+{
+    std::mt19937 generator(3000);
+    std::normal_distribution<float> gaussian;
+    std::vector<glm::vec3> normals =
+    {
+        glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f),
+        glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+        glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)), glm::normalize(glm::vec3(-1.0f, 1.0f, -1e-4f))
+    };
+    while (normals.size() < 10007) normals.push_back(glm::normalize(glm::vec3(gaussian(generator), gaussian(generator), gaussian(generator))));
+
+    int count = (int)normals.size();
+    std::vector<float> encoded(count * 2);
+    std::vector<int16_t> packed(count * 2);
+    encodeOctahedralBulk(&normals[0].x, encoded.data(), count);
+    packSnorm16Bulk(encoded.data(), packed.data(), count * 2);
+
+    //The cross product's length is the sine of the angle, a dot product this close to 1 loses it to float rounding.
+    float worstSine = 0.0f;
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 decoded = decodeOctahedral(packed[i * 2] / 32767.0f, packed[i * 2 + 1] / 32767.0f);
+        worstSine = std::max(worstSine, glm::length(glm::cross(decoded, normals[i])));
+    }
+
+    //16 bit octahedral coordinates are good to about 1e-4 radians.
+    CHECK(worstSine < 2e-4f);
+}
+
+//A whole vertex through makePackedLayout and packVertices, and a source too wide for the chunk buffers.
+TEST(vertexPackingVertices)
+{
+    const float vertices[2 * 9] =
+    {
+        0.5f, -0.25f, 2.0f,   1.0f, 0.5f, 0.0f,   0.25f, 0.75f,   0.0f,
+        -1.0f, 1.5f, -3.0f,   0.0f, 1.0f, 0.2f,   1.0f, 0.0f,     0.0f
+    };
+    const VertexAttributeSource sources[3] =
+    {
+        { 0, 3, 0, VertexHalf },
+        { 1, 3, 3, VertexUnorm8 },
+        { 2, 2, 6, VertexUnorm16 }
+    };
+
+    PackedVertexLayout layout = makePackedLayout(sources, 3);
+    CHECK(layout.stride == 16);
+    CHECK(layout.attributes[1].offset == 8 && layout.attributes[2].offset == 12);
+
+    unsigned char packed[32];
+    CHECK(packVertices(vertices, 2, 9, sources, 3, layout, packed));
+
+    uint16_t halves[3];
+    std::memcpy(halves, packed + 16, sizeof(halves));
+    CHECK(glm::unpackHalf1x16(halves[0]) == -1.0f && glm::unpackHalf1x16(halves[1]) == 1.5f && glm::unpackHalf1x16(halves[2]) == -3.0f);
+    CHECK(packed[8] == 255 && packed[9] == 128 && packed[10] == 0 && packed[11] == 0);
+
+    uint16_t texCoords[2];
+    std::memcpy(texCoords, packed + 12, sizeof(texCoords));
+    CHECK(texCoords[0] == 16384 && texCoords[1] == 49151);
+
+    VertexAttributeSource wide = { 0, 5, 0, VertexFloat };
+    PackedVertexLayout wideLayout = makePackedLayout(&wide, 1);
+    std::vector<unsigned char> wideOutput(2 * wideLayout.stride);
+    CHECK(!packVertices(vertices, 2, 9, &wide, 1, wideLayout, wideOutput.data()));
+}